@@ -0,0 +1,44 @@
+#!/bin/bash
+# Ping throughput from A to C through B against the number of concurrent clients.
+#
+# usage: bench/clients.sh [count] [servers] [window]
+#
+# N ping_bench clients on A each send 'count' PINGs at the same time, with up to 'window'
+# outstanding, to 'servers' ping_servers on C. The MIP daemon on C hands the PINGs to its
+# servers in turn. For every N the total answered messages per second is printed, from the
+# start of the first client to the end of the last, and every client's own line goes to
+# $LOG_DIR/clients.log.
+
+cd "$(dirname "$0")/.." || exit 1
+. bench/netns.sh
+
+COUNT=${1:-5000}
+SERVERS=${2:-2}
+WINDOW=${3:-8}
+
+# start_network starts one ping_server on C
+start_network
+for i in $(seq 2 $SERVERS); do
+    ip netns exec C ./ping_server usockC > /dev/null 2>&1 &
+done
+sleep 0.3
+
+# Resolve the neighbors before measuring
+ip netns exec A bench/ping_bench -n 1 usockA 30 > /dev/null
+: > "$LOG_DIR/clients.log"
+
+printf "%8s %10s %10s %12s\n" "clients" "answered" "seconds" "msg/s"
+for clients in 1 2 4 8 16; do
+    pids=""
+    start=$(date +%s.%N)
+    for i in $(seq $clients); do
+        ip netns exec A bench/ping_bench -n $COUNT -w $WINDOW usockA 30 >> "$LOG_DIR/clients.log" &
+        pids="$pids $!"
+    done
+    wait $pids
+    end=$(date +%s.%N)
+
+    answered=$(tail -n $clients "$LOG_DIR/clients.log" | awk '{ sum += $7 } END { print sum + 0 }')
+    awk -v c=$clients -v a=$answered -v s=$start -v e=$end \
+        'BEGIN { printf "%8d %10d %10.3f %12.0f\n", c, a, e - s, a / (e - s) }'
+done
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "ebr.h"
+
+#define BENCH_SECONDS  1   // How long the readers read per run
+#define BENCH_ENTRIES  256 // Entries of a table, like the next hops of the forwarding threads
+#define BENCH_WRITE_US 100 // Microseconds between two tables the writer publishes
+
+static const int reader_counts[] = { 1, 2, 4 };
+
+// How the readers are kept from a table being freed
+enum mode {
+    MODE_EBR,
+    MODE_RWLOCK,
+    MODE_MUTEX,
+    MODE_COUNT
+};
+
+static const char *mode_names[MODE_COUNT] = { "ebr", "rwlock", "mutex" };
+
+struct table {
+    uint64_t entries[BENCH_ENTRIES];
+};
+
+static enum mode mode;
+static struct table *_Atomic published;
+static struct ebr domain;
+static pthread_rwlock_t rwlock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic int stop;
+static _Atomic uint64_t reads;
+static _Atomic uint64_t sink; // Keeps the compiler from dropping the reads
+
+
+// Monotonic time in seconds
+static double now_s(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Look up one entry after another until told to stop, each lookup a read-side section of
+ * its own, as a forwarding thread does per batch.
+ */
+static void *reader_main(void *arg) {
+    struct ebr_reader *reader = arg;
+    uint64_t count = 0, sum = 0;
+
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        const struct table *table;
+        size_t i = count % BENCH_ENTRIES;
+
+        switch (mode) {
+            case MODE_EBR:
+                ebr_enter(&domain, reader);
+                table = atomic_load_explicit(&published, memory_order_acquire);
+                sum += table->entries[i];
+                ebr_exit(reader);
+                break;
+            case MODE_RWLOCK:
+                pthread_rwlock_rdlock(&rwlock);
+                table = atomic_load_explicit(&published, memory_order_relaxed);
+                sum += table->entries[i];
+                pthread_rwlock_unlock(&rwlock);
+                break;
+            default:
+                pthread_mutex_lock(&mutex);
+                table = atomic_load_explicit(&published, memory_order_relaxed);
+                sum += table->entries[i];
+                pthread_mutex_unlock(&mutex);
+                break;
+        }
+        count++;
+    }
+
+    atomic_fetch_add(&reads, count);
+    atomic_fetch_add(&sink, sum);
+    return NULL;
+}
+
+// Replace the published table with a copy, and free the old one once it is safe
+static void publish(void) {
+    struct table *next = malloc(sizeof(*next));
+
+    if (next == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    switch (mode) {
+        case MODE_EBR: {
+            struct table *old = atomic_load_explicit(&published, memory_order_relaxed);
+            memcpy(next, old, sizeof(*next));
+            next->entries[0]++;
+            atomic_store_explicit(&published, next, memory_order_release);
+            ebr_retire(&domain, old, free);
+            break;
+        }
+        case MODE_RWLOCK:
+            pthread_rwlock_wrlock(&rwlock);
+            memcpy(next, published, sizeof(*next));
+            next->entries[0]++;
+            free(atomic_exchange(&published, next));
+            pthread_rwlock_unlock(&rwlock);
+            break;
+        default:
+            pthread_mutex_lock(&mutex);
+            memcpy(next, published, sizeof(*next));
+            next->entries[0]++;
+            free(atomic_exchange(&published, next));
+            pthread_mutex_unlock(&mutex);
+            break;
+    }
+}
+
+/**
+ * Run the readers for BENCH_SECONDS while this thread publishes a table every
+ * BENCH_WRITE_US microseconds.
+ *
+ * Returns the lookups per second of all readers together.
+ */
+static double run(int readers) {
+    pthread_t threads[EBR_MAX_READERS];
+    struct timespec pause = { 0, BENCH_WRITE_US * 1000 };
+
+    ebr_init(&domain);
+    published = calloc(1, sizeof(struct table));
+    atomic_store(&stop, 0);
+    atomic_store(&reads, 0);
+
+    for (int i = 0; i < readers; i++) {
+        if (pthread_create(&threads[i], NULL, reader_main, ebr_register(&domain)) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    double start = now_s();
+    while (now_s() - start < BENCH_SECONDS) {
+        publish();
+        nanosleep(&pause, NULL);
+    }
+    atomic_store(&stop, 1);
+
+    for (int i = 0; i < readers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = now_s() - start;
+
+    ebr_reclaim(&domain);
+    free(published);
+
+    return atomic_load(&reads) / elapsed;
+}
+
+/**
+ * Benchmark lookups in a table published with epoch-based reclamation against the same
+ * lookups under a read-write lock and a mutex.
+ *
+ * The readers look up one entry per read-side section. A writer replaces the table every
+ * BENCH_WRITE_US microseconds, far more often than routes change, and frees the old one
+ * once no reader can see it, or under the write lock.
+ */
+int main(void) {
+    printf("%8s", "readers");
+    for (int m = 0; m < MODE_COUNT; m++) {
+        printf(" %16s", mode_names[m]);
+    }
+    printf("  (million lookups per second)\n");
+
+    for (size_t r = 0; r < sizeof(reader_counts) / sizeof(reader_counts[0]); r++) {
+        printf("%8d", reader_counts[r]);
+        for (mode = 0; mode < MODE_COUNT; mode++) {
+            printf(" %16.1f", run(reader_counts[r]) / 1e6);
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,30 @@
+#!/bin/bash
+# Goodput and latency from A to C through B with and without forward error correction.
+#
+# usage: bench/fec.sh [k] [count]
+#
+# The MIP daemons on A and C drop the given percentage of the frames they receive. With FEC
+# every daemon protects the traffic between A and C on its hops with one parity frame per 'k'
+# data frames. ping_bench measures the round-trip time of single messages, stop-and-wait, and
+# how many are lost for good. The transport protocol measures goodput, it retransmits what
+# FEC cannot repair.
+
+cd "$(dirname "$0")/.." || exit 1
+. bench/netns.sh
+
+K=${1:-4}
+COUNT=${2:-5000}
+
+for loss in 1 5 10; do
+    for fec in off on; do
+        echo "loss $loss% FEC $fec"
+
+        if [ $fec = on ]; then
+            MIPD_A="-p $loss -f 30:$K" MIPD_B="-f 10:$K -f 30:$K" MIPD_C="-p $loss -f 10:$K" start_network
+        else
+            MIPD_A="-p $loss" MIPD_B="" MIPD_C="-p $loss" start_network
+        fi
+        ip netns exec A bench/ping_bench -n 200 -s 64 -w 1 -t 1000 usockA 30
+        transport_run $COUNT 1000
+    done
+done
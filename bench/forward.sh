@@ -0,0 +1,32 @@
+#!/bin/bash
+# Frames per second B forwards from A to C against the number of forwarding threads.
+#
+# usage: bench/forward.sh [seconds] [size] [flows]
+#
+# mip_blast sends PING frames for C from A's interface straight to B, from 'flows' MIP
+# sources, and counts what arrives on C's interface. After every run B prints how many frames
+# each of its forwarding threads received, which shows how the frames were spread.
+
+cd "$(dirname "$0")/.." || exit 1
+. bench/netns.sh
+
+SECONDS_RUN=${1:-5}
+SIZE=${2:-64}
+FLOWS=${3:-16}
+
+for threads in 0 1 2 4; do
+    echo "$threads forwarding threads"
+
+    MIPD_B="-w $threads" start_network
+    B_MAC=$(ip -n B -o link show B-eth0 | grep -o 'link/ether [0-9a-f:]*' | cut -d' ' -f2)
+
+    ip netns exec C bench/mip_blast -c -n $SECONDS_RUN C-eth0 30 &
+    counter=$!
+    sleep 0.3
+    ip netns exec A bench/mip_blast -n $((SECONDS_RUN + 1)) -s $SIZE -f $FLOWS A-eth0 $B_MAC 30
+    wait $counter
+
+    kill -USR1 $(mipd_pid B)
+    sleep 0.2
+    grep "thread [0-9]" "$LOG_DIR/mipdB.log"
+done
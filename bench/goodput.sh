@@ -0,0 +1,24 @@
+#!/bin/bash
+# Transport goodput from A to C through B against the packet loss.
+#
+# usage: bench/goodput.sh [count] [size]
+#
+# The MIP daemons on A and C drop the given percentage of the frames they receive, which
+# loses data on its way to C and acknowledgements on their way back to A. For every loss
+# rate the transport protocol sends 'count' messages of 'size' bytes, then ping_bench sends
+# the same messages stop-and-wait as a reference, the way an application without the
+# transport protocol has to, where a lost message costs a full timeout.
+
+cd "$(dirname "$0")/.." || exit 1
+. bench/netns.sh
+
+COUNT=${1:-5000}
+SIZE=${2:-1000}
+
+for loss in 0 1 5 10; do
+    echo "loss $loss%"
+
+    MIPD_A="-p $loss" MIPD_C="-p $loss" start_network
+    ip netns exec A bench/ping_bench -n 200 -s $SIZE -w 1 -t 1000 usockA 30
+    transport_run $COUNT $SIZE
+done
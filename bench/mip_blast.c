@@ -0,0 +1,259 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+
+#include "ether.h"
+#include "pdu.h"
+
+#define BLAST_BATCH     64  // Frames sent or received with one system call
+#define BLAST_FIRST_SRC 100 // MIP source of the first flow, the others follow
+
+void parse_arguments(int argc, char *argv[], int *count_mode, int *seconds, int *size, int *flows,
+                     int *ifindex, uint8_t *dst_mac, uint8_t *destination);
+
+
+// Monotonic time in microseconds
+static uint64_t now_us(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/**
+ * Open a RAW socket for MIP frames on one interface.
+ *
+ * ifindex: Index of the interface.
+ * addr: Set to the link-layer address of the interface.
+ *
+ * Returns the socket, the program exits on error.
+ */
+static int open_interface(int ifindex, struct sockaddr_ll *addr) {
+    int sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_MIP));
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sll_family = AF_PACKET;
+    addr->sll_protocol = htons(ETH_P_MIP);
+    addr->sll_ifindex = ifindex;
+
+    if (sock == -1 || bind(sock, (struct sockaddr *) addr, sizeof(*addr)) == -1) {
+        perror("socket");
+        exit(EXIT_FAILURE);
+    }
+
+    return sock;
+}
+
+/**
+ * Send PING frames as fast as the interface takes them.
+ *
+ * sock: RAW socket bound to the interface.
+ * addr: Link-layer address of the interface, the frames go to 'dst_mac' on it.
+ * seconds: How long to send.
+ * size: Bytes of SDU in every frame, a multiple of four.
+ * flows: Number of MIP sources the frames take in turn, from BLAST_FIRST_SRC on.
+ * dst_mac: MAC address of the neighbor that forwards the frames.
+ * destination: MIP address the frames go to.
+ */
+static void blast(int sock, struct sockaddr_ll *addr, int seconds, int size, int flows,
+                  const uint8_t *dst_mac, uint8_t destination) {
+    static uint8_t frames[BLAST_BATCH][MAX_BUF_SIZE];
+    struct mmsghdr msgs[BLAST_BATCH];
+    struct iovec iov[BLAST_BATCH];
+    size_t len = ETH_HDR_LEN + MIP_HDR_LEN + size;
+
+    memcpy(addr->sll_addr, dst_mac, MAC_ADDR_SIZE);
+    addr->sll_halen = MAC_ADDR_SIZE;
+
+    // Every flow has a frame of its own in the batch
+    for (int i = 0; i < BLAST_BATCH; i++) {
+        struct eth_hdr *ethhdr = (struct eth_hdr *) frames[i];
+        uint32_t header = (uint32_t) destination << 24 |
+                          (uint32_t) (BLAST_FIRST_SRC + i % flows) << 16 |
+                          (uint32_t) 0xf << 12 |
+                          (uint32_t) (size / 4) << 3 |
+                          SDU_TYPE_PING;
+
+        memcpy(ethhdr->dst_mac, dst_mac, MAC_ADDR_SIZE);
+        ethhdr->ethertype = htons(ETH_P_MIP);
+        header = htonl(header);
+        memcpy(frames[i] + ETH_HDR_LEN, &header, sizeof(header));
+        memset(frames[i] + ETH_HDR_LEN + MIP_HDR_LEN, 'x', size);
+
+        iov[i].iov_base = frames[i];
+        iov[i].iov_len = len;
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_name = addr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(*addr);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    uint64_t start = now_us();
+    uint64_t end = start + (uint64_t) seconds * 1000000;
+    long sent = 0;
+
+    while (now_us() < end) {
+        int rc = sendmmsg(sock, msgs, BLAST_BATCH, 0);
+        if (rc == -1) {
+            if (errno == ENOBUFS || errno == EINTR) {
+                continue;
+            }
+            perror("sendmmsg");
+            exit(EXIT_FAILURE);
+        }
+        sent += rc;
+    }
+
+    double elapsed = (now_us() - start) / 1e6;
+    printf("sent %ld frames of %d bytes in %.3f s, %.0f pps\n", sent, size, elapsed, sent / elapsed);
+}
+
+/**
+ * Count the PING frames to a destination that arrive on the interface.
+ *
+ * sock: RAW socket bound to the interface.
+ * seconds: How long to count from the first frame on.
+ * destination: MIP address the frames go to.
+ */
+static void count(int sock, int seconds, uint8_t destination) {
+    static uint8_t frames[BLAST_BATCH][MAX_BUF_SIZE];
+    struct mmsghdr msgs[BLAST_BATCH];
+    struct iovec iov[BLAST_BATCH];
+    struct timeval timeout = { 0, 100000 };
+    uint64_t start = 0, end = 0;
+    long received = 0;
+
+    if (setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == -1) {
+        perror("setsockopt");
+        exit(EXIT_FAILURE);
+    }
+
+    while (start == 0 || now_us() < end) {
+        memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < BLAST_BATCH; i++) {
+            iov[i].iov_base = frames[i];
+            iov[i].iov_len = sizeof(frames[i]);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int rc = recvmmsg(sock, msgs, BLAST_BATCH, MSG_WAITFORONE, NULL);
+        if (rc == -1) {
+            if (errno == EAGAIN || errno == EINTR) {
+                continue;
+            }
+            perror("recvmmsg");
+            exit(EXIT_FAILURE);
+        }
+
+        for (int i = 0; i < rc; i++) {
+            uint32_t header;
+
+            if (msgs[i].msg_len < ETH_HDR_LEN + MIP_HDR_LEN) {
+                continue;
+            }
+            memcpy(&header, frames[i] + ETH_HDR_LEN, sizeof(header));
+            header = ntohl(header);
+            if (header >> 24 != destination || (header & 0x7) != SDU_TYPE_PING ||
+                ((header >> 16) & 0xff) < BLAST_FIRST_SRC) {
+                continue;
+            }
+
+            if (start == 0) {
+                start = now_us();
+                end = start + (uint64_t) seconds * 1000000;
+            }
+            received++;
+        }
+    }
+
+    double elapsed = (now_us() - start) / 1e6;
+    printf("received %ld frames in %.3f s, %.0f pps\n", received, elapsed, received / elapsed);
+}
+
+/**
+ * Generate or count MIP frames below the MIP daemons.
+ *
+ * To measure how many frames a daemon forwards, one end sends PING frames from a RAW socket
+ * straight to the daemon's MAC address, without a daemon of its own, and the other end
+ * counts what arrives. The frames take 'flows' MIP sources in turn, so a daemon with
+ * forwarding threads spreads them over its sockets. Run the counter first, it counts for
+ * 'seconds' from the first frame on.
+ */
+int main(int argc, char *argv[]) {
+    int count_mode = 0, seconds = 5, size = 64, flows = 16, ifindex;
+    uint8_t dst_mac[MAC_ADDR_SIZE], destination;
+    struct sockaddr_ll addr;
+
+    parse_arguments(argc, argv, &count_mode, &seconds, &size, &flows, &ifindex, dst_mac, &destination);
+
+    int sock = open_interface(ifindex, &addr);
+    if (count_mode) {
+        count(sock, seconds, destination);
+    } else {
+        blast(sock, &addr, seconds, size, flows, dst_mac, destination);
+    }
+
+    close(sock);
+    return 0;
+}
+
+// Definition of the parse_arguments function
+void parse_arguments(int argc, char *argv[], int *count_mode, int *seconds, int *size, int *flows,
+                     int *ifindex, uint8_t *dst_mac, uint8_t *destination) {
+    const char *usage = "Usage: %s [-h] [-n <seconds>] [-s <size>] [-f <flows>] <interface> <dst_mac> <destination_host>\n"
+                        "       %s -c [-n <seconds>] <interface> <destination_host>\n";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hcn:s:f:")) != -1) {
+        switch (opt) {
+            case 'h':
+                printf(usage, argv[0], argv[0]);
+                exit(0);
+            case 'c':
+                *count_mode = 1;
+                break;
+            case 'n':
+                *seconds = atoi(optarg);
+                break;
+            case 's':
+                *size = atoi(optarg);
+                break;
+            case 'f':
+                *flows = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, usage, argv[0], argv[0]);
+                exit(1);
+        }
+    }
+
+    if (optind + (*count_mode ? 2 : 3) != argc || *seconds <= 0 || *size < 0 || *size % 4 != 0 ||
+        *size > MIP_MAX_SDU_LEN || *flows < 1 || *flows > BLAST_BATCH) {
+        fprintf(stderr, usage, argv[0], argv[0]);
+        exit(1);
+    }
+
+    *ifindex = if_nametoindex(argv[optind]);
+    if (*ifindex == 0) {
+        perror(argv[optind]);
+        exit(1);
+    }
+
+    if (!*count_mode && sscanf(argv[optind + 1], "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", &dst_mac[0], &dst_mac[1],
+                               &dst_mac[2], &dst_mac[3], &dst_mac[4], &dst_mac[5]) != 6) {
+        fprintf(stderr, "Invalid MAC address %s\n", argv[optind + 1]);
+        exit(1);
+    }
+    *destination = atoi(argv[argc - 1]);
+}
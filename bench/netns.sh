@@ -0,0 +1,99 @@
+#!/bin/bash
+# Helpers for the namespace benchmarks, sourced by bench/*.sh.
+#
+# Three network namespaces in a line, connected by veth pairs:
+#
+#   A (MIP 10) --- B (MIP 20) --- C (MIP 30)
+#
+# Run the benchmarks as root from the repository root after 'make' and 'make bench'. The
+# daemons log to $LOG_DIR, and MTU sets the MTU of every veth.
+
+LOG_DIR=${LOG_DIR:-/tmp/mip-bench}
+MTU=${MTU:-1500}
+
+# Stop every process in the namespaces and remove them
+topo_down() {
+    for ns in A B C; do
+        ip netns pids $ns 2>/dev/null | xargs -r kill 2>/dev/null
+    done
+    sleep 0.2
+    for ns in A B C; do
+        ip netns del $ns 2>/dev/null
+    done
+    rm -f usockA usockB usockC
+}
+
+# Create the namespaces and the links between them
+topo_up() {
+    topo_down
+    mkdir -p "$LOG_DIR"
+    for ns in A B C; do
+        ip netns add $ns
+        ip -n $ns link set lo up
+    done
+    ip link add A-eth0 netns A mtu $MTU type veth peer name B-eth0 netns B mtu $MTU
+    ip link add B-eth1 netns B mtu $MTU type veth peer name C-eth0 netns C mtu $MTU
+    ip -n A link set A-eth0 up
+    ip -n B link set B-eth0 up
+    ip -n B link set B-eth1 up
+    ip -n C link set C-eth0 up
+}
+
+# Process id of the MIP daemon in a namespace
+mipd_pid() {
+    ip netns pids $1 | xargs -r ps -o pid=,comm= -p | awk '$2 == "mipd" { print $1 }'
+}
+
+# start_network [mipd options]
+#
+# Start a MIP daemon and a routing daemon in every namespace, and a ping_server on C. The
+# options go to every MIP daemon, MIPD_A, MIPD_B and MIPD_C add options for one of them.
+# Returns once A and C have routes to each other.
+start_network() {
+    topo_up
+    ip netns exec A stdbuf -oL ./mipd "$@" $MIPD_A usockA 10 > "$LOG_DIR/mipdA.log" 2>&1 &
+    ip netns exec B stdbuf -oL ./mipd "$@" $MIPD_B usockB 20 > "$LOG_DIR/mipdB.log" 2>&1 &
+    ip netns exec C stdbuf -oL ./mipd "$@" $MIPD_C usockC 30 > "$LOG_DIR/mipdC.log" 2>&1 &
+    sleep 0.3
+    for ns in A B C; do
+        ip netns exec $ns ./routingd -d usock$ns > "$LOG_DIR/routingd$ns.log" 2>&1 &
+    done
+    ip netns exec C ./ping_server usockC > /dev/null 2>&1 &
+
+    # The routing daemons publish their tables once they have synchronized
+    for i in $(seq 100); do
+        grep -q "resynchronized" "$LOG_DIR/mipdA.log" && grep -q "resynchronized" "$LOG_DIR/mipdC.log" && break
+        sleep 0.1
+    done
+    sleep 1
+}
+
+# transport_run <count> <size> [transport_app options]
+#
+# Send 'count' messages of 'size' bytes with the transport protocol from A to C and print
+# the goodput C measured. The sender hands its messages to the MIP daemon and exits, so the
+# transfer is over once C has had nothing new for 3 seconds. C's MIP daemon is stopped then,
+# which makes the receiver print its totals, so the network has to be started again after.
+transport_run() {
+    local count=$1 size=$2
+    shift 2
+
+    ip netns exec C stdbuf -oL ./transport_app "$@" -s usockC > "$LOG_DIR/receiver.log" 2>&1 &
+    local receiver=$!
+    sleep 0.3
+    ip netns exec A ./transport_app "$@" usockA 30 7 $count $size > /dev/null
+
+    local last=-1 quiet=0 now
+    while [ $quiet -lt 3 ]; do
+        sleep 1
+        now=$(stat -c %s "$LOG_DIR/receiver.log")
+        [ "$now" = "$last" ] && quiet=$((quiet + 1)) || quiet=0
+        last=$now
+    done
+
+    kill $(mipd_pid C)
+    wait $receiver 2>/dev/null
+    grep "^Total" "$LOG_DIR/receiver.log" || echo "Nothing received"
+}
+
+trap topo_down EXIT
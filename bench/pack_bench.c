@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "pack.h"
+#include "mip.h"
+
+#define BENCH_BYTES (64 * 1024 * 1024) // Bytes every kernel packs per payload size
+
+static const size_t sizes[] = { 4, 16, 32, 64, 128, 256, 512, 1024, 2044 };
+
+static volatile uint32_t sink; // Keeps the compiler from dropping the work
+
+
+// Monotonic time in nanoseconds
+static uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Pack bytes the way uint8ArrayToUint32Array did before pack.c.
+ *
+ * One shift and one OR per byte into a zeroed array allocated per call. The length is a
+ * size_t here, the original took a uint8_t and could not pack more than 255 bytes.
+ */
+static uint32_t *shift_pack(const uint8_t *src, size_t len, size_t *words) {
+    *words = (len + 3) / 4;
+
+    uint32_t *arr = calloc(*words, sizeof(uint32_t));
+    if (arr == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        arr[i / 4] |= (uint32_t) src[i] << ((3 - (i % 4)) * 8);
+    }
+
+    return arr;
+}
+
+/**
+ * Unpack words the way uint32_to_uint8 did before pack.c, four shifts per word.
+ */
+static void shift_unpack(uint8_t *dst, const uint32_t *src, size_t words) {
+    for (size_t i = 0; i < words; i++) {
+        dst[i * 4]     = (src[i] >> 24) & 0xff;
+        dst[i * 4 + 1] = (src[i] >> 16) & 0xff;
+        dst[i * 4 + 2] = (src[i] >> 8) & 0xff;
+        dst[i * 4 + 3] = src[i] & 0xff;
+    }
+}
+
+/**
+ * Pack bytes with one bswap per word and nothing else, the scalar kernel of pack.c on a
+ * little-endian host.
+ */
+static size_t bswap_pack(uint32_t *dst, const uint8_t *src, size_t len) {
+    size_t words = len / 4;
+
+    for (size_t i = 0; i < words; i++) {
+        uint32_t word;
+        memcpy(&word, src + i * 4, sizeof(word));
+        dst[i] = __builtin_bswap32(word);
+    }
+    if (len % 4) {
+        uint8_t tail[4] = {0};
+        memcpy(tail, src + words * 4, len % 4);
+        memcpy(&dst[words], tail, sizeof(uint32_t));
+        dst[words] = __builtin_bswap32(dst[words]);
+        words++;
+    }
+
+    return words;
+}
+
+/**
+ * Unpack words with one bswap per word, the inverse of bswap_pack.
+ */
+static void bswap_unpack(uint8_t *dst, const uint32_t *src, size_t words) {
+    for (size_t i = 0; i < words; i++) {
+        uint32_t word = __builtin_bswap32(src[i]);
+        memcpy(dst + i * 4, &word, sizeof(word));
+    }
+}
+
+/**
+ * Time one way of packing and unpacking a payload.
+ *
+ * kernel: 0 for the shift loops, 1 for the scalar bswap, 2 for pack_words and unpack_words.
+ * payload: Bytes to pack.
+ * len: Length of the payload in bytes.
+ * rounds: Times the payload is packed and unpacked.
+ *
+ * Returns the nanoseconds one pack and unpack took on average.
+ */
+static double run(int kernel, const uint8_t *payload, size_t len, size_t rounds) {
+    uint32_t words_buf[MIP_MAX_SDU_WORDS];
+    uint8_t bytes_buf[MIP_MAX_SDU_WORDS * 4];
+    uint64_t start = now_ns();
+
+    for (size_t r = 0; r < rounds; r++) {
+        size_t words;
+
+        if (kernel == 0) {
+            uint32_t *arr = shift_pack(payload, len, &words);
+            shift_unpack(bytes_buf, arr, words);
+            free(arr);
+        } else if (kernel == 1) {
+            words = bswap_pack(words_buf, payload, len);
+            bswap_unpack(bytes_buf, words_buf, words);
+        } else {
+            words = pack_words(words_buf, payload, len);
+            unpack_words(bytes_buf, words_buf, words);
+        }
+        sink += bytes_buf[r % len];
+    }
+
+    return (double) (now_ns() - start) / rounds;
+}
+
+/**
+ * Benchmark the SDU packing kernels.
+ *
+ * For every payload size from 4 to 2044 bytes, the largest SDU, the payload is packed into
+ * SDU words and unpacked again, BENCH_BYTES bytes in total. "shift" are the byte-at-a-time
+ * loops with a calloc per call that pack.c replaced, "bswap" is the scalar kernel of pack.c,
+ * and "pack" is pack_words and unpack_words, which use the pshufb kernels from
+ * PACK_SIMD_MIN bytes on where the CPU has them. Every kernel is checked against the shift
+ * loops first.
+ */
+int main(void) {
+    uint8_t payload[MIP_MAX_SDU_WORDS * 4];
+
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t) (i * 7 + 1);
+    }
+
+    printf("%8s %14s %14s %14s %10s\n", "bytes", "shift ns/op", "bswap ns/op", "pack ns/op", "pack GB/s");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t len = sizes[s];
+        size_t rounds = BENCH_BYTES / len;
+        uint32_t expected_buf[MIP_MAX_SDU_WORDS];
+        uint32_t words_buf[MIP_MAX_SDU_WORDS];
+        size_t words;
+
+        uint32_t *expected = shift_pack(payload, len, &words);
+        memcpy(expected_buf, expected, words * 4);
+        free(expected);
+
+        if (pack_words(words_buf, payload, len) != words || memcmp(words_buf, expected_buf, words * 4) != 0 ||
+            bswap_pack(words_buf, payload, len) != words || memcmp(words_buf, expected_buf, words * 4) != 0) {
+            fprintf(stderr, "Packed %zu bytes wrong\n", len);
+            return EXIT_FAILURE;
+        }
+
+        double shift = run(0, payload, len, rounds);
+        double bswap = run(1, payload, len, rounds);
+        double pack = run(2, payload, len, rounds);
+
+        printf("%8zu %14.1f %14.1f %14.1f %10.2f\n", len, shift, bswap, pack, 2 * len / pack);
+    }
+
+    return EXIT_SUCCESS;
+}
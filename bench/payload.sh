@@ -0,0 +1,22 @@
+#!/bin/bash
+# Ping throughput from A to C through B against the payload size.
+#
+# usage: bench/payload.sh [count] [window]
+#
+# Up to 2035 bytes a message fits in one SDU of 511 words, larger ones are fragmented. The
+# veths get an MTU large enough for the largest SDU unless MTU is set.
+
+cd "$(dirname "$0")/.." || exit 1
+MTU=${MTU:-2100}
+. bench/netns.sh
+
+COUNT=${1:-2000}
+WINDOW=${2:-32}
+
+start_network
+
+# Resolve the neighbors before measuring
+ip netns exec A bench/ping_bench -n 1 usockA 30 > /dev/null
+for size in 16 64 256 512 1024 2035 4096 16000; do
+    ip netns exec A bench/ping_bench -n $COUNT -s $size -w $WINDOW usockA 30
+done
@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+
+#include "libmip.h"
+
+#define PING_BENCH_MAX_WINDOW 64 // PINGs a ping_server takes before it answers, APP_MAX_PENDING
+#define PING_BENCH_SEQ_LEN    10 // Digits of the sequence number every message starts with
+
+// A PING that has not been answered yet
+struct outstanding {
+    int      used;
+    uint32_t seq;
+    uint64_t sent;  // Monotonic time in microseconds the PING was sent
+};
+
+void parse_arguments(int argc, char *argv[], long *count, long *size, int *window, int *timeout_ms,
+                     char **socket_lower, uint8_t *destination);
+
+
+// Monotonic time in microseconds
+static uint64_t now_us(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Measure ping throughput and round-trip time through the MIP daemon.
+ *
+ * Up to 'window' PINGs of 'size' bytes are kept outstanding to a ping_server until 'count'
+ * have been sent. Every message starts with its sequence number, so a PONG is matched to its
+ * PING however late it arrives. A PING without a PONG after 'timeout_ms' is lost. With a
+ * window of 1 this is stop-and-wait, like ping_client, and the round-trip times are those of
+ * single messages. The summary line has the answered messages per second, the payload bit
+ * rate one way, and the median and 99th percentile round-trip time. The rates are taken up
+ * to the last PONG, the wait for lost PINGs is not counted.
+ */
+int main(int argc, char *argv[]) {
+    long count = 1000, size = 64;
+    int window = 1, timeout_ms = 1000;
+    char *socket_lower;
+    uint8_t destination;
+
+    parse_arguments(argc, argv, &count, &size, &window, &timeout_ms, &socket_lower, &destination);
+
+    int fd = mip_open(socket_lower, MIP_ROLE_CLIENT, MIP_NONBLOCK, NULL);
+    if (fd < 0) {
+        perror("mip_open");
+        exit(EXIT_FAILURE);
+    }
+
+    struct outstanding slots[PING_BENCH_MAX_WINDOW];
+    double *rtts = malloc(count * sizeof(double));
+    char *msg = malloc(size + 1);
+    char reply[MIP_MSG_MAX];
+    if (rtts == NULL || msg == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    memset(slots, 0, sizeof(slots));
+    memset(msg, 'x', size);
+
+    long sent = 0, answered = 0, lost = 0, unreachable = 0;
+    int in_flight = 0;
+    uint64_t start = now_us();
+    uint64_t last_answer = start;
+
+    while (sent < count || in_flight > 0) {
+        uint64_t now = now_us();
+
+        // Fill the window
+        while (sent < count && in_flight < window) {
+            int slot = 0;
+            while (slots[slot].used) {
+                slot++;
+            }
+
+            char seq[32];
+            snprintf(seq, sizeof(seq), "%0*ld", PING_BENCH_SEQ_LEN, sent);
+            memcpy(msg, seq, PING_BENCH_SEQ_LEN);
+
+            if (mip_sendto(fd, msg, size, destination, 8) < 0) {
+                if (errno == EAGAIN) {
+                    break;
+                }
+                perror("mip_sendto");
+                exit(EXIT_FAILURE);
+            }
+            slots[slot] = (struct outstanding) { 1, sent, now };
+            sent++;
+            in_flight++;
+        }
+
+        // PINGs that have waited too long are lost
+        for (int i = 0; i < window; i++) {
+            if (slots[i].used && now - slots[i].sent >= (uint64_t) timeout_ms * 1000) {
+                slots[i].used = 0;
+                in_flight--;
+                lost++;
+            }
+        }
+
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if (in_flight > 0 && poll(&pfd, 1, 1) == -1 && errno != EINTR) {
+            perror("poll");
+            exit(EXIT_FAILURE);
+        }
+
+        while (1) {
+            ssize_t len = mip_recvfrom(fd, reply, sizeof(reply) - 1, NULL, NULL);
+            now = now_us();
+
+            if (len == -1 && errno == EAGAIN) {
+                break;
+            }
+            if (len == 0 || (len == -1 && errno != EHOSTUNREACH)) {
+                perror("mip_recvfrom");
+                exit(EXIT_FAILURE);
+            }
+
+            // The daemon could not reach the destination, that answers the oldest PING
+            if (len == -1) {
+                int oldest = -1;
+                for (int i = 0; i < window; i++) {
+                    if (slots[i].used && (oldest == -1 || slots[i].seq < slots[oldest].seq)) {
+                        oldest = i;
+                    }
+                }
+                if (oldest != -1) {
+                    slots[oldest].used = 0;
+                    in_flight--;
+                    unreachable++;
+                }
+                continue;
+            }
+
+            reply[len] = '\0';
+            uint32_t seq = strtoul(reply, NULL, 10);
+            for (int i = 0; i < window; i++) {
+                if (slots[i].used && slots[i].seq == seq) {
+                    slots[i].used = 0;
+                    in_flight--;
+                    rtts[answered++] = (now - slots[i].sent) / 1000.0;
+                    last_answer = now;
+                    break;
+                }
+            }
+        }
+    }
+
+    double seconds = (last_answer - start) / 1e6;
+    double median = 0, p99 = 0;
+
+    if (answered > 0) {
+        qsort(rtts, answered, sizeof(double), compare_doubles);
+        median = rtts[answered / 2];
+        p99 = rtts[(answered * 99) / 100];
+    }
+
+    printf("size %ld window %d: %ld sent, %ld answered, %ld lost, %ld unreachable in %.3f s, "
+           "%.0f msg/s, %.1f kbit/s, rtt median %.3f ms p99 %.3f ms\n",
+           size, window, sent, answered, lost, unreachable, seconds, answered / seconds,
+           answered * size * 8 / seconds / 1000, median, p99);
+
+    free(rtts);
+    free(msg);
+    mip_close(fd);
+    return 0;
+}
+
+// Definition of the parse_arguments function
+void parse_arguments(int argc, char *argv[], long *count, long *size, int *window, int *timeout_ms,
+                     char **socket_lower, uint8_t *destination) {
+    const char *usage = "Usage: %s [-h] [-n <count>] [-s <size>] [-w <window>] [-t <timeout_ms>] <socket_lower> <destination_host>\n";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hn:s:w:t:")) != -1) {
+        switch (opt) {
+            case 'h':
+                printf(usage, argv[0]);
+                exit(0);
+            case 'n':
+                *count = atol(optarg);
+                break;
+            case 's':
+                *size = atol(optarg);
+                break;
+            case 'w':
+                *window = atoi(optarg);
+                break;
+            case 't':
+                *timeout_ms = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, usage, argv[0]);
+                exit(1);
+        }
+    }
+
+    if (optind + 2 != argc || *count <= 0 || *size < PING_BENCH_SEQ_LEN || *size > MIP_MSG_MAX ||
+        *window < 1 || *window > PING_BENCH_MAX_WINDOW || *timeout_ms <= 0) {
+        fprintf(stderr, usage, argv[0]);
+        exit(1);
+    }
+
+    *socket_lower = argv[optind];
+    *destination = atoi(argv[optind + 1]);
+}
@@ -0,0 +1,24 @@
+#!/bin/bash
+# Transport goodput from A to C through B with and without the shared memory rings.
+#
+# usage: bench/ring.sh [count] [size]
+#
+# transport_app -r moves its messages through a ring shared with the MIP daemon instead of
+# the socket to it, on both the sender and the receiver.
+
+cd "$(dirname "$0")/.." || exit 1
+. bench/netns.sh
+
+COUNT=${1:-50000}
+SIZE=${2:-1000}
+
+for mode in socket ring; do
+    echo "$mode"
+
+    start_network
+    if [ $mode = ring ]; then
+        transport_run $COUNT $SIZE -r
+    else
+        transport_run $COUNT $SIZE
+    fi
+done
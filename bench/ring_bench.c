@@ -0,0 +1,177 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include "ring.h"
+
+#define BENCH_MESSAGES 1000000 // Messages sent per message size and channel
+
+static const size_t sizes[] = { 16, 64, 256, 1024 };
+
+// The two ends of a channel between the threads
+struct channel {
+    struct ring_end daemon;     // Consumer of the ring
+    struct ring_end app;        // Producer of the ring
+    int control[2];             // Never written, ring_wait needs a socket to watch for hangups
+    int pair[2];                // SOCK_SEQPACKET socket pair, [0] sends and [1] receives
+    size_t size;                // Message size in bytes
+};
+
+
+// Monotonic time in nanoseconds
+static uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Receive BENCH_MESSAGES from the ring the way the daemon does.
+ *
+ * The ring is drained, the producer is told there is room, and only when the ring stays
+ * empty after ring_arm does the thread sleep on its eventfd.
+ */
+static void *ring_consumer(void *arg) {
+    struct channel *ch = arg;
+    uint8_t buf[RING_MSG_MAX];
+    long received = 0;
+
+    while (received < BENCH_MESSAGES) {
+        ssize_t len;
+        while ((len = ring_pop(&ch->daemon, buf, sizeof(buf))) >= 0) {
+            if ((size_t) len != ch->size) {
+                fprintf(stderr, "Message of %zd bytes, expected %zu\n", len, ch->size);
+                exit(EXIT_FAILURE);
+            }
+            received++;
+        }
+        ring_notify(&ch->daemon);
+
+        if (received < BENCH_MESSAGES && !ring_arm(&ch->daemon)) {
+            ring_wait(&ch->daemon, ch->control[0]);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Send BENCH_MESSAGES through the ring the way libmip does.
+ *
+ * The consumer is woken once per RING_BATCH messages, and when the ring is full.
+ */
+static void ring_producer(struct channel *ch) {
+    uint8_t msg[RING_MSG_MAX];
+
+    memset(msg, 'x', ch->size);
+
+    for (long sent = 0; sent < BENCH_MESSAGES; sent++) {
+        while (ring_push(&ch->app, msg, ch->size) == -1) {
+            ring_notify(&ch->app);
+            ring_wait(&ch->app, ch->control[1]);
+        }
+        if (sent % RING_BATCH == RING_BATCH - 1) {
+            ring_notify(&ch->app);
+        }
+    }
+    ring_notify(&ch->app);
+}
+
+// Receive BENCH_MESSAGES from the socket pair
+static void *socket_consumer(void *arg) {
+    struct channel *ch = arg;
+    uint8_t buf[RING_MSG_MAX];
+
+    for (long received = 0; received < BENCH_MESSAGES; received++) {
+        ssize_t len = recv(ch->pair[1], buf, sizeof(buf), 0);
+        if (len != (ssize_t) ch->size) {
+            perror("recv");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return NULL;
+}
+
+// Send BENCH_MESSAGES through the socket pair
+static void socket_producer(struct channel *ch) {
+    uint8_t msg[RING_MSG_MAX];
+
+    memset(msg, 'x', ch->size);
+
+    for (long sent = 0; sent < BENCH_MESSAGES; sent++) {
+        if (send(ch->pair[0], msg, ch->size, 0) != (ssize_t) ch->size) {
+            perror("send");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/**
+ * Time one channel.
+ *
+ * ch: The channel, with the message size set.
+ * ring: 1 to send through the ring, 0 through the socket pair.
+ *
+ * Returns the messages per second from the first send to the last receive.
+ */
+static double run(struct channel *ch, int ring) {
+    pthread_t consumer;
+    uint64_t start = now_ns();
+
+    if (pthread_create(&consumer, NULL, ring ? ring_consumer : socket_consumer, ch) != 0) {
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    if (ring) {
+        ring_producer(ch);
+    } else {
+        socket_producer(ch);
+    }
+    pthread_join(consumer, NULL);
+
+    return BENCH_MESSAGES / ((now_ns() - start) / 1e9);
+}
+
+/**
+ * Benchmark the shared memory ring against the socket the applications used before it.
+ *
+ * One thread sends BENCH_MESSAGES messages to another, through a ring set up with
+ * ring_create and ring_attach and through a SOCK_SEQPACKET socket pair like the one between
+ * an application and the MIP daemon. Both ends of the ring live in this process, the
+ * synchronization and wakeups are the same as between two processes.
+ */
+int main(void) {
+    struct channel ch;
+    int app_fds[RING_FDS];
+
+    if (ring_create(&ch.daemon, app_fds) == -1 || ring_attach(&ch.app, app_fds) == -1) {
+        return EXIT_FAILURE;
+    }
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, ch.control) == -1 ||
+        socketpair(AF_UNIX, SOCK_SEQPACKET, 0, ch.pair) == -1) {
+        perror("socketpair");
+        return EXIT_FAILURE;
+    }
+
+    printf("%8s %14s %14s %8s\n", "bytes", "ring msg/s", "socket msg/s", "speedup");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        ch.size = sizes[s];
+
+        double ring = run(&ch, 1);
+        double sock = run(&ch, 0);
+
+        printf("%8zu %14.0f %14.0f %8.1f\n", ch.size, ring, sock, ring / sock);
+    }
+
+    return EXIT_SUCCESS;
+}
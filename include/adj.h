@@ -0,0 +1,30 @@
+#ifndef _ADJ_H_
+#define _ADJ_H_
+
+#include <stdint.h>
+#include <linux/if_packet.h>
+
+#include "ether.h"
+#include "utils.h"
+#include "timer.h"
+
+#define ADJ_TABLE_SIZE 256 // Adjacencies are indexed directly by neighbor MIP address
+#define ADJ_LIFETIME   300000 // Milliseconds an adjacency is kept after MIP-ARP last resolved the neighbor
+
+// Everything needed to put a frame on the wire towards one neighbor
+struct adjacency {
+    uint8_t valid;              // 1 once the neighbor has been resolved by MIP-ARP
+    uint8_t interface;          // Index of the interface the neighbor is reached on
+    uint8_t mip;                // MIP address of the neighbor, BROADCAST_MIP_ADDR for a broadcast adjacency
+    struct eth_hdr ethhdr;      // Prebuilt Ethernet header, sent as-is in front of every frame
+    struct sockaddr_ll addr;    // Link-layer address passed to sendmsg
+    struct timer age;           // Expires ADJ_LIFETIME ms after the last MIP-ARP message from the neighbor
+};
+
+void adj_init(struct ifs_data *ifs);
+void adj_update(struct ifs_data *ifs, uint8_t mip, const uint8_t *mac, int interface);
+const struct adjacency *adj_lookup(uint8_t mip);
+const struct adjacency *adj_broadcast(int interface);
+uint32_t adj_version(void);
+
+#endif /* _ADJ_H_ */
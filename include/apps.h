@@ -0,0 +1,49 @@
+#ifndef _APPS_H_
+#define _APPS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ratelimit.h"
+
+// Identifiers an application writes first after connecting to the MIP daemon
+#define APP_ID_PING      0x01 // ping_client or ping_server, followed by the SDU type and role
+#define APP_ID_ROUTING   0x02 // The routing daemon
+#define APP_ID_TRANSPORT 0x03 // The transport application
+
+#define APP_REGISTER_LEN   3   // Identifier, SDU type and role (CLIENT or SERVER, see arp.h)
+#define APP_MAX_PENDING    64  // PINGs a server has not answered yet
+#define APP_MAX_OUTSTANDING 256 // PINGs sent by clients that are waiting for a PONG
+#define APP_RESUME_FILL    50  // Percent of the forward queue in use below which a throttled application is read again
+#define APP_TXQ_FILL       75  // Percent of the transmit queue of an interface in use at which applications are not read
+
+// A ping application connected to the MIP daemon
+struct app_client {
+    int      fd;                        // -1 while the slot is free
+    uint8_t  sdu_type;                  // SDU type the application registered for
+    uint8_t  role;                      // CLIENT sends PINGs, SERVER answers them
+    uint8_t  src_header;                // 1 if messages are written with the source MIP address and TTL in front
+    uint8_t  throttled;                 // 1 while the socket is not read, the forward or transmit queue is full
+    uint8_t  throttled_dst;             // Destination whose queue the application waits for
+    uint8_t  head;                      // Server side, index of the oldest unanswered PING
+    uint8_t  count;                     // Server side, unanswered PINGs
+    uint8_t  peers[APP_MAX_PENDING];    // Server side, source MIP address of every unanswered PING
+    uint8_t  ttls[APP_MAX_PENDING];     // Server side, TTL the PONG is sent with
+    struct token_bucket bucket;         // Messages read from the application, see ratelimit_configure
+};
+
+int apps_register(int fd, const uint8_t *msg, size_t len);
+void apps_unregister(int fd);
+struct app_client *apps_lookup(int fd);
+int apps_deliver_ping(uint8_t src, uint8_t ttl, const uint32_t *sdu, size_t sdu_len);
+int apps_deliver_pong(uint8_t src, uint8_t ttl, const uint32_t *sdu, size_t sdu_len);
+int apps_reply_to(int fd, uint8_t *dst, uint8_t *ttl);
+void apps_ping_sent(int fd, uint8_t dst, const char *msg);
+void apps_unreachable(uint8_t dst);
+struct queue_f;
+void apps_throttle(int epoll_fd, int fd, uint8_t dst);
+void apps_unthrottle(int epoll_fd, const struct queue_f *queue);
+int apps_admit(int fd, uint64_t now);
+void apps_print_stats(void);
+
+#endif /* _APPS_H_ */
@@ -0,0 +1,31 @@
+#ifndef _BUNDLE_H_
+#define _BUNDLE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "mip.h"
+#include "utils.h"
+
+#define BUNDLE_MAX_RECORD_WORDS 32 // Largest SDU that waits for others, larger frames are sent right away
+#define BUNDLE_MAX_PEERS        8  // Neighbors and broadcast interfaces with a bundle being filled at the same time
+
+struct adjacency;
+struct pdu;
+
+// Small frames waiting to go out together towards one neighbor, or broadcast on one interface
+struct bundle {
+    const struct adjacency *adj;            // Where the bundle goes, NULL while the slot is free
+    uint8_t  count;                         // Frames in the bundle
+    size_t   len;                           // Words in use, the LINK header included
+    uint32_t words[MIP_MAX_SDU_WORDS];      // LINK header, then a MIP header and a SDU per frame
+};
+
+int bundle_init(uint32_t delay_us, size_t max_words);
+int bundle_add(struct ifs_data *ifs, const struct adjacency *adj, uint32_t miphdr, const uint32_t *sdu, size_t sdu_len);
+void bundle_flush(struct ifs_data *ifs);
+int bundle_input(struct pdu *pdu, int interface);
+struct pdu *bundle_next(int *interface);
+int bundle_pending(void);
+
+#endif /* _BUNDLE_H_ */
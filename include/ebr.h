@@ -0,0 +1,47 @@
+#ifndef _EBR_H_
+#define _EBR_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define EBR_MAX_READERS 32 // Threads that may read what a domain protects
+#define EBR_IDLE        0  // Epoch of a reader outside a read-side section
+
+#define EBR_CACHELINE 64
+
+// Frees memory that no reader can see any more
+typedef void (*ebr_free_fn)(void *ptr);
+
+// One reading thread, only written by that thread
+struct ebr_reader {
+    _Atomic uint64_t epoch __attribute__((aligned(EBR_CACHELINE))); // Epoch the reader entered in, EBR_IDLE outside
+};
+
+// Memory unpublished by the writer, freed once every reader has moved past its epoch
+struct ebr_retired {
+    struct ebr_retired *next;
+    void *ptr;
+    ebr_free_fn free_fn;
+    uint64_t epoch;         // Epoch the memory was unpublished in
+};
+
+// Memory shared by one writing thread with any number of reading threads
+struct ebr {
+    _Atomic uint64_t epoch;                         // Current epoch, bumped by the writer on every retire
+    _Atomic int reader_count;                       // Readers registered so far
+    struct ebr_reader readers[EBR_MAX_READERS];
+    struct ebr_retired *limbo;                      // Retired memory, newest first, only touched by the writer
+    size_t pending;                                 // Retired and not yet freed
+    uint64_t retired;                               // Retired in total
+    uint64_t freed;                                 // Freed in total
+};
+
+void ebr_init(struct ebr *ebr);
+struct ebr_reader *ebr_register(struct ebr *ebr);
+void ebr_enter(struct ebr *ebr, struct ebr_reader *reader);
+void ebr_exit(struct ebr_reader *reader);
+void ebr_retire(struct ebr *ebr, void *ptr, ebr_free_fn free_fn);
+size_t ebr_reclaim(struct ebr *ebr);
+
+#endif /* _EBR_H_ */
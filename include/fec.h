@@ -0,0 +1,38 @@
+#ifndef _FEC_H_
+#define _FEC_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "mip.h"
+#include "utils.h"
+#include "timer.h"
+
+#define FEC_HDR_WORDS  2  // LINK header and the MIP header of the protected frame
+#define FEC_DEFAULT_K  4  // Data frames per parity frame unless configured otherwise
+#define FEC_MAX_K      16 // Largest block, the receiver keeps one bit per frame
+#define FEC_MAX_PEERS  16 // Neighbors with a block being sent or received at the same time
+#define FEC_FLUSH      10 // Milliseconds a partial block waits for more frames before its parity is sent
+
+// The frames of one block towards or from one neighbor
+struct fec_block {
+    uint8_t  valid;                             // 1 while the block is in use
+    uint8_t  neighbor;                          // MIP address of the neighbor
+    uint16_t id;                                // Block ID, chosen by the sender
+    uint8_t  k;                                 // Sender side, frames that close the block
+    uint8_t  count;                             // Frames sent or received so far
+    uint16_t received;                          // Receiver side, one bit per frame index
+    uint16_t words;                             // Longest frame so far in words, MIP header included
+    uint64_t started;                           // Monotonic time in ms of the first frame
+    struct timer flush;                         // Sender side, expires FEC_FLUSH ms after the first frame
+    uint32_t parity[1 + MIP_MAX_SDU_WORDS];     // XOR of the MIP headers and SDUs, zero padded
+};
+
+struct adjacency;
+
+int fec_configure(uint8_t dst, int k);
+int fec_wanted(uint8_t dst);
+void fec_send(struct ifs_data *ifs, const struct adjacency *adj, const struct pdu *pdu);
+int fec_input(struct pdu *pdu, uint64_t now);
+
+#endif /* _FEC_H_ */
@@ -0,0 +1,36 @@
+#ifndef _FIB_H_
+#define _FIB_H_
+
+#include <stdint.h>
+
+#define FIB_SIZE   256  // Entries are indexed directly by destination MIP address
+#define FIB_NO_HOP 0xFF // Same value the routing daemon uses for "no next hop"
+
+#define FIB_NEGATIVE_TTL 1000 // Milliseconds an "unreachable" answer is cached
+
+// Next hops learned from the routing daemon for one destination
+struct fib_entry {
+    uint8_t valid;       // 1 if the routing daemon has published or answered for this destination
+    uint8_t next_hop;    // Primary next hop
+    uint8_t backup_hop;  // Loop-free alternate next hop, FIB_NO_HOP if there is none
+    uint8_t rerouted;    // 1 if next_hop is a backup we switched to on a neighbor down event
+    uint8_t requested;   // 1 while a request for this destination is outstanding
+    uint32_t generation; // Routing daemon generation the entry was learned in
+    uint64_t expires;    // Monotonic time in ms a negative entry expires, unused for routes
+};
+
+void fib_init(void);
+void fib_update(uint8_t dst, uint8_t next_hop, uint8_t backup_hop);
+void fib_withdraw(uint8_t dst);
+uint8_t fib_select(uint8_t dst);
+int fib_is_unreachable(uint8_t dst);
+int fib_is_stale(uint8_t dst);
+int fib_need_request(uint8_t dst);
+int fib_neighbor_down(uint8_t neighbor);
+int fib_mark_stale(void);
+int fib_purge_stale(void);
+void fib_begin_sync(void);
+int fib_end_sync(void);
+uint32_t fib_version(void);
+
+#endif /* _FIB_H_ */
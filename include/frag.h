@@ -0,0 +1,38 @@
+#ifndef _FRAG_H_
+#define _FRAG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "mip.h"
+#include "utils.h"
+#include "timer.h"
+
+#define FRAG_HDR_WORDS  2    // Fragment header in front of the payload of every fragment
+#define FRAG_TABLE_SIZE 16   // Messages reassembled at the same time
+#define FRAG_TIMEOUT    2000 // Milliseconds a partial message is kept after its first fragment
+
+#define FRAG_MORE 0x08 // More fragments follow, set on every fragment but the last
+
+// A message from one source being put back together
+struct frag_entry {
+    uint8_t  valid;                                 // 1 while the entry is in use
+    uint8_t  src;                                   // MIP address of the source
+    uint16_t id;                                    // Message ID chosen by the source
+    uint8_t  sdu_type;                              // SDU type of the whole message
+    uint16_t total_words;                           // Length of the message, 0 until the last fragment arrived
+    uint16_t received_words;                        // Distinct words received so far
+    uint64_t expires;                               // Monotonic time in ms the entry is dropped
+    struct timer timer;                             // Expires at 'expires'
+    uint8_t  received[MIP_MAX_MSG_WORDS / 8];       // One bit per word, so duplicates are not counted twice
+    uint32_t words[MIP_MAX_MSG_WORDS];              // Message being reassembled
+};
+
+void frag_init(struct ifs_data *ifs);
+size_t frag_max_sdu_words(void);
+uint16_t frag_next_id(void);
+size_t frag_build(uint32_t *sdu, const uint32_t *msg, size_t msg_words, uint8_t sdu_type, uint16_t id, size_t offset);
+const uint32_t *frag_input(uint8_t src, const uint32_t *sdu, size_t sdu_len, uint64_t now,
+                           uint8_t *sdu_type, size_t *msg_words);
+
+#endif /* _FRAG_H_ */
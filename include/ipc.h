@@ -8,5 +8,8 @@
 
 int create_unix_sock(const char *);
 int add_to_epoll_table(int efd, int fd);
+int create_timer_fd(long interval_ms);
+int send_fds(int sd, const int *fds, int count);
+int recv_fds(int sd, int *fds, int count);
 
 #endif
\ No newline at end of file
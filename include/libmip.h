@@ -0,0 +1,33 @@
+#ifndef _LIBMIP_H_
+#define _LIBMIP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#define MIP_ROLE_CLIENT 0       // Sends requests and gets the replies, CLIENT in arp.h
+#define MIP_ROLE_SERVER 1       // Gets requests and answers them in order, SERVER in arp.h
+
+#define MIP_NONBLOCK    0x01    // mip_open flag, calls that would block fail with EAGAIN
+
+#define MIP_MSG_MAX     16375   // Longest message in bytes, the daemon limit less the "PING:" prefix
+#define MIP_MMSG_MAX    64      // Messages one batched call handles at most
+
+// One message of mip_sendmmsg or mip_recvmmsg
+struct mip_mmsg {
+    uint8_t addr;   // Destination when sending, source when receiving
+    uint8_t ttl;    // TTL to send with, or the TTL the message arrived with
+    int     error;  // Receiving, 0, or EHOSTUNREACH if the daemon could not reach 'addr'
+    void   *buf;    // The message
+    size_t  size;   // Receiving, size of 'buf'
+    size_t  len;    // Length of the message
+};
+
+int mip_open(const char *socket_path, int role, int flags, uint8_t *local_addr);
+int mip_close(int fd);
+ssize_t mip_sendto(int fd, const void *buf, size_t len, uint8_t dst, uint8_t ttl);
+ssize_t mip_recvfrom(int fd, void *buf, size_t size, uint8_t *src, uint8_t *ttl);
+int mip_sendmmsg(int fd, struct mip_mmsg *msgs, unsigned int count);
+int mip_recvmmsg(int fd, struct mip_mmsg *msgs, unsigned int count);
+
+#endif /* _LIBMIP_H_ */
@@ -0,0 +1,39 @@
+#ifndef _LIVENESS_H_
+#define _LIVENESS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "utils.h"
+#include "timer.h"
+
+#define LIVENESS_DEFAULT_MULT   3   // Missed hellos before a neighbor is declared down
+#define LIVENESS_MIN_INTERVAL   10  // Milliseconds
+#define LIVENESS_MAX_NEIGHBORS  256 // Sessions are indexed directly by MIP address
+
+#define LIVENESS_SDU_LEN 2 // SDU length in 32-bit words
+
+#define LIVENESS_DOWN 0
+#define LIVENESS_UP   1
+
+// Per-neighbor liveness session, one for every MIP address we have heard from
+struct liveness_session {
+    uint8_t  state;              // LIVENESS_UP or LIVENESS_DOWN
+    uint8_t  interface;          // Interface index the last hello arrived on
+    uint8_t  remote_mult;        // Detection multiplier advertised by the neighbor
+    uint32_t remote_interval;    // Hello interval in ms advertised by the neighbor
+    uint64_t last_rx;            // Monotonic time in ms of the last hello
+    struct timer detect;         // Expires when the neighbor has been silent for its detection time
+};
+
+// Called when a neighbor is declared down
+typedef void (*liveness_down_fn)(uint8_t mip, void *ctx);
+
+void liveness_init(struct ifs_data *ifs, uint32_t interval_ms, uint8_t detect_mult, liveness_down_fn down, void *ctx);
+int liveness_enabled(void);
+int liveness_is_up(uint8_t mip);
+void send_liveness_hellos(struct ifs_data *ifs);
+int liveness_rx(uint8_t mip, int interface, const uint32_t *sdu, size_t sdu_len, uint64_t now);
+uint32_t liveness_version(void);
+
+#endif /* _LIVENESS_H_ */
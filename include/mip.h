@@ -14,6 +14,12 @@
 
 #define MIP_DST_ADDR	0xff
 
+#define MIP_MAX_TTL	15 // Largest value of the 4-bit TTL field
+#define MIP_MAX_SDU_WORDS	511 // Largest value of the 9-bit SDU length field
+#define MIP_MAX_SDU_LEN	(MIP_MAX_SDU_WORDS * 4) // 2044 bytes
+#define MIP_MAX_MSG_WORDS	4096 // Largest message in words, larger than one SDU when fragmented
+#define MIP_MAX_MSG_LEN	(MIP_MAX_MSG_WORDS * 4) // 16 KiB
+
 struct mip_hdr {
     uint8_t dst : 8;     // Destination MIP address
     uint8_t src : 8;     // Source MIP address
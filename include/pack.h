@@ -0,0 +1,14 @@
+#ifndef _PACK_H_
+#define _PACK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define PACK_SIMD_MIN 64 // Payloads shorter than this (in bytes) are always swapped one word at a time
+
+size_t pack_words(uint32_t *dst, const uint8_t *src, size_t len);
+void unpack_words(uint8_t *dst, const uint32_t *src, size_t words);
+size_t pack_string(uint32_t *dst, size_t dst_words, const char *str);
+size_t unpack_string(char *dst, size_t dst_size, const uint32_t *src, size_t src_words);
+
+#endif /* _PACK_H_ */
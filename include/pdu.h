@@ -6,16 +6,47 @@
 
 #include "ether.h"
 #include "mip.h"
+#include "timer.h"
 
 #define MIP_HDR_LEN	sizeof(struct mip_hdr)
-#define MAX_BUF_SIZE	1024
+#define MAX_BUF_SIZE	(ETH_HDR_LEN + MIP_HDR_LEN + MIP_MAX_SDU_LEN) // Largest MIP frame
+
+#define APP_MAX_MSG_LEN	(MIP_MAX_MSG_LEN - 4) // Longest application string, after its length word
+#define APP_HDR_LEN	2 // Destination MIP address and TTL in front of application messages
 
 #define SDU_TYPE_MIPARP 0x01
 #define SDU_TYPE_PING   0x02
+#define SDU_TYPE_CTRL   0x03
 #define SDU_TYPE_ROUTE  0x04
+#define SDU_TYPE_FRAG   0x05 // Fragment of a message larger than one SDU, see frag.h
+#define SDU_TYPE_TRANSPORT 0x06 // Reliable transport segment, see transport.h
+#define SDU_TYPE_LINK   0x07 // Between neighbors only, carries other frames, see fec.h
+
+// Control codes carried in the most significant byte of the first word of a SDU_TYPE_CTRL SDU
+#define CTRL_LIVENESS   0x01
+#define CTRL_UNREACH    0x02 // Destination unreachable, the second byte carries the destination
+
+// Kinds carried in the most significant byte of the first word of a SDU_TYPE_LINK SDU
+#define LINK_FEC_DATA   0x01 // A frame protected by FEC, the block ID and the index of the frame follow
+#define LINK_FEC_PARITY 0x02 // XOR of the frames of a FEC block, the block ID and the number of frames follow
+#define LINK_BUNDLE     0x03 // Small frames to the same neighbor, the number of frames follows, see bundle.h
 
 #define MAX_RETURN_SIZE 4
-#define MAX_QUEUE_SIZE 8
+#define MAX_QUEUE_SIZE 64 // Room for every fragment of a message while its next hop is resolved
+#define ARP_QUEUE_TIMEOUT 1000 // Milliseconds a PDU waits for its next hop to be resolved
+#define ARP_QUEUE_HOP_LIMIT 16 // PDUs waiting for one next hop, every fragment of a message on a 1500 byte MTU
+
+#define FORWARD_QUEUE_LIMIT 256 // PDUs waiting for a route, all destinations together, unless configured otherwise
+#define FORWARD_QUEUE_TIMEOUT 5000 // Milliseconds a PDU waits for a route, long enough for a routing daemon to restart
+#define FORWARD_RED_WEIGHT  3   // The RED average moves 1/8 of the way to the queue length per PDU
+#define FORWARD_RED_MAX_P   10  // Percent of PDUs RED drops as the average reaches its upper threshold
+
+// What the forward queue does with a PDU that does not fit
+enum forward_drop {
+    FORWARD_DROP_TAIL,  // Drop the new PDU
+    FORWARD_DROP_HEAD,  // Drop the oldest PDU to the same destination, or the oldest of all
+    FORWARD_DROP_RED    // Drop new PDUs early, more often the longer the queue has been
+};
 
 
 
@@ -28,13 +59,15 @@ struct pdu {
 struct ping_data {
     uint8_t dst_mip_addr;
     uint8_t ttl;
-    char   msg[512];
+    char   msg[APP_MAX_MSG_LEN + 1];
 };
 
  struct pdu_queue_slot {
     struct pdu* packet;
     uint8_t next_hop;  // New field for the next hop
     int is_occupied;
+    uint32_t seq;        // Order the PDUs were queued in
+    struct timer expiry; // Expires ARP_QUEUE_TIMEOUT ms after the PDU was queued
 };
 
 struct pdu_with_hop {
@@ -45,16 +78,33 @@ struct pdu_with_hop {
 struct queue_node {
     struct pdu* packet;
     struct queue_node* next;
+    uint64_t expires;   // Monotonic time in ms the PDU is dropped
 };
 
 struct queue_f {
     struct queue_node* front;
     struct queue_node* rear;
     int size;
+
+    int limit;                  // Most PDUs queued, all destinations together
+    int dst_limit;              // Most PDUs queued for one destination
+    enum forward_drop policy;   // What happens to a PDU that does not fit
+    uint16_t dst_size[256];     // PDUs queued per destination
+    uint32_t red_avg;           // RED average queue length, scaled by 2^FORWARD_RED_WEIGHT
+    struct timer expiry;        // Expires when the PDU at the front has waited FORWARD_QUEUE_TIMEOUT ms
+
+    // Counters
+    uint32_t tail_drops;        // New PDUs dropped because the queue was full
+    uint32_t head_drops;        // Queued PDUs dropped to make room for new ones
+    uint32_t early_drops;       // New PDUs dropped by RED before the queue was full
+    uint32_t expired;           // Queued PDUs dropped after waiting FORWARD_QUEUE_TIMEOUT ms
 };
 
 extern struct pdu_queue_slot queue_arp[MAX_QUEUE_SIZE];
 
+// Called with a PDU that waited too long for its route or next hop, the function owns it
+typedef void (*pending_expired_fn)(struct pdu *pdu, void *ctx);
+
 struct pdu * alloc_pdu(void);
 void fill_pdu(struct pdu *pdu,
               uint8_t src_mip_addr,
@@ -63,16 +113,24 @@ void fill_pdu(struct pdu *pdu,
               uint8_t sdu_type,
               const uint32_t *sdu,
               uint16_t sdu_len);
+uint32_t mip_pack_header(const struct mip_hdr *);
+void mip_unpack_header(uint32_t, struct mip_hdr *);
 size_t mip_serialize_pdu(struct pdu *, uint8_t *);
-size_t mip_deserialize_pdu(struct pdu *, uint8_t *);
+size_t mip_deserialize_pdu(struct pdu *, uint8_t *, size_t);
 void print_pdu_content(struct pdu *);
 void destroy_pdu(struct pdu *);
 void initialize_queue_arp();
-void enqueue_arp(struct pdu* packet, uint8_t next_hop);
-struct pdu_with_hop remove_packet_by_mac(uint8_t* mac_address);
+int enqueue_arp(struct pdu* packet, uint8_t next_hop);
+struct pdu_with_hop remove_packet_by_next_hop(uint8_t next_hop);
+void set_pending_expired(pending_expired_fn fn, void *ctx);
+void print_pending_stats(const struct queue_f* queue);
 
 void clear_ping_data(struct ping_data *data);
 void initialize_queue_forward(struct queue_f* queue);
+int configure_queue_forward(struct queue_f* queue, const char *spec);
 int enqueue_forward(struct queue_f* queue, struct pdu* packet);
+int queue_forward_fill(const struct queue_f* queue, uint8_t dst);
+uint32_t queue_forward_drops(const struct queue_f* queue);
 struct pdu* dequeue_forward(struct queue_f* queue);
+struct pdu* dequeue_forward_by_dst(struct queue_f* queue, uint8_t dst);
 #endif /* _PDU_H_ */
@@ -0,0 +1,29 @@
+#ifndef _RATELIMIT_H_
+#define _RATELIMIT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define RATELIMIT_BURST_MS 100 // Default burst, what the rate lets through in this many milliseconds
+#define RATELIMIT_TYPES    8   // SDU types, the 3-bit SDU type field
+
+// Frames or messages let through at a steady rate, with room for a burst
+struct token_bucket {
+    uint32_t rate;      // Per second, 0 while unlimited
+    uint32_t burst;     // Most let through back to back
+    uint64_t tokens;    // What may pass now, in thousandths
+    uint64_t last;      // Monotonic time in ms of the last refill
+    uint64_t passed;    // Let through
+    uint64_t dropped;   // Dropped for exceeding the rate
+};
+
+void bucket_init(struct token_bucket *bucket, uint32_t rate, uint32_t burst);
+int bucket_take(struct token_bucket *bucket, uint64_t now);
+int ratelimit_configure(const char *spec);
+void ratelimit_app_bucket(struct token_bucket *bucket);
+int ratelimit_frames_limited(void);
+int ratelimit_admit(uint8_t src, uint8_t sdu_type, uint64_t now);
+int ratelimit_frame(const uint8_t *frame, size_t len, uint64_t now);
+void ratelimit_print_stats(void);
+
+#endif /* _RATELIMIT_H_ */
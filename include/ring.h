@@ -0,0 +1,57 @@
+#ifndef _RING_H_
+#define _RING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+
+#define RING_SLOTS     256  // Messages one ring holds, a power of two
+#define RING_MSG_MAX   1032 // Longest message in bytes, a transport message with its header fits
+#define RING_BATCH     16   // Messages a producer writes before it wakes the other end
+#define RING_FDS       3    // Descriptors passed to the application: memfd, its eventfd, the daemon's eventfd
+
+#define RING_CACHELINE 64
+
+// One message in a ring
+struct ring_slot {
+    uint32_t len;                   // Length of the message in bytes
+    uint8_t  data[RING_MSG_MAX];    // The message
+};
+
+// One direction, written by one process and read by the other. The indices only grow, a
+// slot is the index modulo RING_SLOTS
+struct ring {
+    _Atomic uint32_t head __attribute__((aligned(RING_CACHELINE))); // Next message to read, moved by the consumer
+    _Atomic uint32_t tail __attribute__((aligned(RING_CACHELINE))); // Next slot to write, moved by the producer
+    _Atomic uint32_t consumer_waiting __attribute__((aligned(RING_CACHELINE))); // 1 while the consumer sleeps for a message
+    _Atomic uint32_t producer_waiting;                                          // 1 while the producer sleeps for a free slot
+    struct ring_slot slots[RING_SLOTS] __attribute__((aligned(RING_CACHELINE)));
+};
+
+// The shared memory of one application
+struct ring_shm {
+    struct ring to_daemon;  // Messages from the application to the MIP daemon
+    struct ring to_app;     // Messages from the MIP daemon to the application
+};
+
+// One end of the shared memory, the daemon's or the application's
+struct ring_end {
+    struct ring_shm *shm;   // Mapping of the shared memory, NULL while closed
+    struct ring *tx;        // Ring this end writes
+    struct ring *rx;        // Ring this end reads
+    int wait_fd;            // Eventfd the other end writes to wake this end
+    int notify_fd;          // Eventfd this end writes to wake the other end
+};
+
+int ring_create(struct ring_end *end, int app_fds[RING_FDS]);
+int ring_attach(struct ring_end *end, const int app_fds[RING_FDS]);
+void ring_close(struct ring_end *end);
+int ring_push(struct ring_end *end, const void *msg, size_t len);
+ssize_t ring_pop(struct ring_end *end, void *buf, size_t len);
+int ring_arm(struct ring_end *end);
+void ring_notify(struct ring_end *end);
+void ring_clear(struct ring_end *end);
+int ring_wait(struct ring_end *end, int control_fd);
+
+#endif /* _RING_H_ */
@@ -14,25 +14,29 @@
 #include "mip.h"
 #include "arp.h"
 #include "pdu.h"
+#include "timer.h"
 
 #define MAX_NODES 52 // Maximum number of nodes in the network
 #define TIMEOUT_INTERVAL 30 // Seconds
+#define VECTOR_INFINITY 255 // Distance used for unreachable destinations in routing updates
 
 
 struct RoutingEntry {
     int destination;
     int next_hop;
     int distance;
+    int backup_hop; // Loop-free alternate next hop, -1 if there is none
 };
 
 struct NeighborStatus {
-    time_t lastHelloReceived;
+    struct timer timeout; // Expires TIMEOUT_INTERVAL seconds after the last Hello
     int isReachable;
 };
 
 extern int neighborTable[MAX_NODES];
 extern struct RoutingEntry routingTable[MAX_NODES];
 extern struct NeighborStatus neighborStatus[MAX_NODES];
+extern uint8_t neighborVectors[MAX_NODES][MAX_NODES];
 
 extern int routingTableHasChanged;
 
@@ -41,24 +45,32 @@ void initializeRoutingTable(struct RoutingEntry *table, int size);
 struct RoutingEntry lookupRoutingEntry(int mipAddress, struct RoutingEntry* routingTable);
 
 void updateRoutingTable(int sourceMIP, struct RoutingEntry receivedTable[MAX_NODES]);
+void computeBackupRoutes(void);
 
 
 
 void handleHelloMessage(int MIPgreeter);
+void handleNeighborUp(int neighborMIP);
+void handleNeighborDown(int route_fd, int neighborMIP);
 
 void sendUpdateFromApp (int route_fd);
 
 
 
 void sendHelloFromApp(int route_fd);
+void sendSyncRequestFromApp(int route_fd);
+void sendRouteSyncFromApp(int route_fd);
+int publishRouteChanges(int route_fd);
+void handleSyncRequest(int route_fd, int neighborMIP);
 
 void handleIncomingMessages(int route_fd);
-void checkForNeighborTimeouts(int route_fd);
+void startNeighborTimers(int route_fd);
 void handleRequestMessage(int route_fd, uint8_t *requestMessage, int messageLength);
 void handleUpdateMessage(uint8_t *updateMessage, int messageLength);
-void sendResponseFromApp(int route_fd, int next_hop);
+void sendResponseFromApp(int route_fd, int next_hop, int backup_hop, int destinationMIP);
 
 int getNextHopMIP(int destinationMIP);
+int getBackupHopMIP(int destinationMIP);
 
 
 
@@ -0,0 +1,32 @@
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TIMER_BITS   6                  // Slots per level, as a power of two
+#define TIMER_SLOTS  (1 << TIMER_BITS)
+#define TIMER_MASK   (TIMER_SLOTS - 1)
+#define TIMER_LEVELS 4                  // Levels, the wheel reaches TIMER_SLOTS^TIMER_LEVELS ticks ahead
+
+// Called when a timer expires, the timer is no longer pending and may be added again
+typedef void (*timer_fn)(void *arg);
+
+// A timer, embedded in whatever it times
+struct timer {
+    struct timer *next;     // Next timer in the same slot
+    struct timer **pprev;   // Pointer to the pointer to this timer, NULL while not pending
+    uint64_t expires;       // Tick the timer expires on
+    timer_fn fn;            // Called on expiry
+    void *arg;              // Passed to fn
+};
+
+int timer_wheel_init(uint32_t tick_ms);
+void timer_init(struct timer *timer, timer_fn fn, void *arg);
+void timer_add(struct timer *timer, uint64_t delay_ms);
+void timer_cancel(struct timer *timer);
+int timer_pending(const struct timer *timer);
+size_t timer_count(void);
+void timer_run(uint64_t now);
+
+#endif /* _TIMER_H_ */
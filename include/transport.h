@@ -0,0 +1,113 @@
+#ifndef _TRANSPORT_H_
+#define _TRANSPORT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "timer.h"
+
+#define TRANSPORT_HDR_WORDS 4    // Segment header in front of the payload of every segment
+#define TRANSPORT_MSS       1024 // Largest payload of one segment in bytes, one application message
+#define TRANSPORT_WINDOW    32   // Segments in flight per connection, also the reach of a SACK
+#define TRANSPORT_MAX_CONNS 8    // Connections, each one is a peer MIP address and a port
+
+#define TRANSPORT_INITIAL_RTO 1000 // Milliseconds, until the first RTT sample
+#define TRANSPORT_MIN_RTO     50   // Milliseconds, a few daemon ticks
+#define TRANSPORT_MAX_RTO     8000 // Milliseconds, the limit of the exponential backoff
+#define TRANSPORT_DUPACKS     3    // Duplicate ACKs that trigger a fast retransmit
+#define TRANSPORT_MAX_BACKOFF 8    // Timeouts in a row before the sender gives up on what is in flight
+#define TRANSPORT_INITIAL_CWND 4   // Segments a new connection may send before the first ACK
+#define TRANSPORT_RETRY       10   // Milliseconds between deliveries to an application that had no room
+
+#define TRANSPORT_APP_HDR_LEN 2 // Peer MIP address and port in front of every application message
+#define TRANSPORT_APP_RING    0x01 // Second registration byte, the application exchanges messages through shared memory rings
+
+// Segment kinds, carried in the lower half of the most significant byte of the first header word
+#define TRANSPORT_DATA 0x01
+#define TRANSPORT_ACK  0x02
+#define TRANSPORT_KIND_MASK 0x0f
+
+// Flags, carried in the upper half of the same byte
+#define TRANSPORT_FLAG_CE  0x80 // DATA, set by a MIP daemon on the path whose transmit queue is filling up
+#define TRANSPORT_FLAG_ECE 0x40 // ACK, the receiver got a DATA segment with TRANSPORT_FLAG_CE
+
+// One segment in a send or receive window
+struct transport_segment {
+    uint8_t  in_use;                // 1 while the slot holds a segment
+    uint8_t  sacked;                // Sender side, 1 once the receiver reported the segment in a SACK
+    uint8_t  retransmitted;         // Sender side, 1 once sent more than once, no RTT sample is taken
+    uint16_t len;                   // Payload length in bytes
+    uint64_t sent_at;               // Sender side, monotonic time in ms of the last transmission
+    uint8_t  data[TRANSPORT_MSS];   // Payload
+};
+
+// Both directions of the conversation with one port on one peer
+struct transport_conn {
+    uint8_t  valid;                 // 1 while the connection is in use
+    uint8_t  peer;                  // MIP address of the peer
+    uint8_t  port;                  // Port, chosen by the applications
+
+    // Sender
+    uint32_t local_epoch;           // Identifies this incarnation of the sender, echoed in ACKs
+    uint32_t snd_una;               // Oldest unacknowledged sequence number
+    uint32_t snd_nxt;               // Next sequence number to send
+    uint32_t recover;               // snd_nxt when the last fast retransmit started
+    uint8_t  in_recovery;           // 1 until everything up to 'recover' has been acknowledged
+    uint8_t  dupacks;               // Duplicate ACKs in a row
+    uint8_t  backoffs;              // Timeouts in a row without progress
+    uint8_t  rtt_valid;             // 1 once srtt and rttvar hold a sample
+    uint32_t srtt;                  // Smoothed RTT in ms
+    uint32_t rttvar;                // RTT variation in ms
+    uint32_t rto;                   // Retransmission timeout in ms
+    uint32_t cwnd;                  // Congestion window in segments, set by the congestion controller
+    uint32_t ssthresh;              // Slow start threshold in segments
+    uint32_t cwnd_cnt;              // Segments acknowledged towards the next additive increase
+    uint32_t cwr_recover;           // snd_nxt when the window was last reduced for a CE echo
+    uint8_t  in_cwr;                // 1 until everything up to 'cwr_recover' has been acknowledged
+    uint32_t peer_rwnd;             // Receive window in segments the peer advertised last
+    uint64_t last_ack_at;           // Monotonic time in ms of the last ACK, paces zero window probes
+    struct timer rto_timer;         // Expires when the oldest segment in flight has waited an RTO, or a probe is due
+    struct transport_segment snd[TRANSPORT_WINDOW]; // Indexed by sequence number modulo the window
+
+    // Receiver
+    uint8_t  remote_known;          // 1 once a segment from the peer has been received
+    uint32_t remote_epoch;          // Epoch of the peer's sender, a new one restarts the sequence
+    uint32_t rcv_nxt;               // Next sequence number expected, everything below it has arrived
+    uint32_t rcv_delivered;         // Next sequence number to write to the application
+    uint8_t  ece_pending;           // 1 if the next ACK carries TRANSPORT_FLAG_ECE
+    struct transport_segment rcv[TRANSPORT_WINDOW]; // Segments the application has not taken yet
+    struct timer deliver_timer;     // Expires when delivery to an application that had no room is retried
+
+    // Counters
+    uint32_t timeouts;              // Retransmissions after the RTO expired
+    uint32_t fast_retransmits;      // Retransmissions triggered by duplicate ACKs or partial ACKs
+    uint32_t ce_echoes;             // ACKs received with TRANSPORT_FLAG_ECE
+};
+
+// Congestion controller, decides how many segments a connection may have in flight
+struct transport_cc {
+    const char *name;
+    void (*init)(struct transport_conn *conn);                      // Set the initial window
+    void (*on_ack)(struct transport_conn *conn, uint32_t acked);    // 'acked' new segments were acknowledged
+    void (*on_congestion)(struct transport_conn *conn, int timeout); // Loss, CE echo or, if 'timeout', RTO
+};
+
+extern const struct transport_cc transport_cc_aimd;
+extern const struct transport_cc transport_cc_fixed;
+
+struct ring_end;
+
+// Called to put a segment on the network
+typedef void (*transport_output)(void *ctx, uint8_t dst, const uint32_t *sdu, size_t sdu_len);
+
+void transport_init(transport_output output, void *ctx);
+int transport_set_cc(const char *name);
+void transport_set_app(int app_fd);
+void transport_set_app_ring(struct ring_end *ring);
+int transport_send(uint8_t peer, uint8_t port, const uint8_t *data, size_t len, uint64_t now);
+int transport_window_full(void);
+void transport_input(uint8_t src, const uint32_t *sdu, size_t sdu_len, uint64_t now);
+void transport_resume(void);
+void transport_mark_ce(uint32_t *sdu, size_t sdu_len);
+
+#endif /* _TRANSPORT_H_ */
@@ -0,0 +1,72 @@
+#ifndef _TXQ_H_
+#define _TXQ_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "mip.h"
+#include "utils.h"
+
+#define TXQ_LIMIT       256   // Frames waiting on one interface, all classes together
+#define TXQ_QUANTUM     2064  // Bytes a data class may send per round and weight, one largest frame
+#define TXQ_SNDBUF      16384 // Send buffer of the RAW socket, what may wait below the queues in any order
+#define TXQ_BATCH       64    // Frames of the receive pipeline sent with one system call, see txq_batch_begin
+
+// Weights of the data classes, a class gets this many quanta per round
+#define TXQ_WEIGHT_PING      1
+#define TXQ_WEIGHT_TRANSPORT 2
+#define TXQ_WEIGHT_LINK      1
+
+// Transmit classes, control is always sent first and the others share what is left
+enum txq_class {
+    TXQ_CONTROL,    // MIP-ARP, routing and CTRL frames, and bundles carrying any of them
+    TXQ_PING,       // Ping messages and their fragments
+    TXQ_TRANSPORT,  // Transport segments
+    TXQ_LINK,       // FEC frames, kept in one class so a block is not reordered
+    TXQ_CLASSES
+};
+
+// A frame waiting for room in the socket send buffer
+struct txq_frame {
+    struct txq_frame *next;
+    const struct adjacency *adj;    // Where the frame goes
+    uint32_t miphdr;                // MIP header in network byte order
+    size_t sdu_len;                 // Length of the SDU in 32-bit words
+    uint32_t sdu[];                 // Copy of the SDU
+};
+
+// Counters of one class on one interface
+struct txq_stats {
+    uint64_t sent;      // Frames handed to the socket
+    uint64_t delayed;   // Of those, frames that had to wait in the queue
+    uint64_t dropped;   // Frames dropped because the interface queue was full
+    uint32_t depth;     // Frames waiting now
+    uint32_t max_depth; // Most frames that waited at the same time
+};
+
+// One class queue of one interface
+struct txq_class_queue {
+    struct txq_frame *head;
+    struct txq_frame *tail;
+    size_t deficit;             // Bytes the class may still send this round
+    struct txq_stats stats;
+};
+
+// The transmit queues of one interface
+struct txq {
+    struct txq_class_queue classes[TXQ_CLASSES];
+    int drr;                    // Data class whose turn it is
+    size_t len;                 // Frames waiting, all classes together
+};
+
+int txq_init(int epoll_fd, int rsock);
+ssize_t txq_send(int rsock, const struct adjacency *adj, uint32_t miphdr, const uint32_t *sdu, size_t sdu_len);
+void txq_flush(int rsock);
+void txq_batch_begin(void);
+size_t txq_batch_end(int rsock);
+size_t txq_backlog(enum txq_class class);
+int txq_fill(void);
+void txq_print_stats(const struct ifs_data *ifs);
+
+#endif /* _TXQ_H_ */
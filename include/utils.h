@@ -19,6 +19,7 @@
 
 #define MAX_EVENTS	10
 #define MAX_IF		3
+#define TX_CE_FRACTION	4 // Transport segments are marked CE when this part of the send buffer is in use
 
 
 
@@ -42,19 +43,30 @@ typedef enum {
     MIP_PONG,
     MIP_ARP_REQUEST,
     MIP_ARP_REPLY,
-    MIP_ROUTE
+    MIP_ROUTE,
+    MIP_LIVENESS,
+    MIP_UNREACH,
+    MIP_FRAG,
+    MIP_TRANSPORT,
+    MIP_LINK
 } MIP_handle;
 
 typedef enum {
     APP_PING,
     APP_PONG,
-    APP_ROUTE
+    APP_ROUTE,
+    APP_DISCONNECT
 } APP_handle;
 
 typedef enum {
     ROUTE_HELLO,
     ROUTE_UPDATE,
-    ROUTE_RESPONSE
+    ROUTE_RESPONSE,
+    ROUTE_SYNC_REQUEST,
+    ROUTE_CHANGE,
+    ROUTE_WITHDRAW,
+    ROUTE_END_OF_RIB,
+    ROUTE_DISCONNECT
 } ROUTE_handle;
 
 
@@ -66,7 +78,8 @@ uint32_t* create_sdu_miparp(int arp_type, uint8_t mip_addr);
 
 void fill_ping_buf(char *buf, size_t buf_size, const char *destination_host, const char *message, const char *ttl);
 void fill_pong_buf(char *buf, size_t buf_size, const char *destination_host, const char *message);
-MIP_handle handle_mip_packet(struct ifs_data *ifs, struct pdu *pdu, int *recv_ifs_index);
+MIP_handle handle_mip_packet(struct pdu *pdu, uint8_t *rcv_buf, ssize_t rc);
+MIP_handle get_mip_handle(struct pdu *pdu);
 // int send_mip_packet(struct ifs_data *ifs,
 //                     uint8_t *src_mac_addr,
 //                     uint8_t *dst_mac_addr,
@@ -78,13 +91,10 @@ MIP_handle handle_mip_packet(struct ifs_data *ifs, struct pdu *pdu, int *recv_if
 //                     uint16_t sdu_len);
 //HANDLE
 APP_handle handle_app_message(int app_fd, uint8_t *dst_mip_addr, char *msg, uint8_t *ttl);
-struct sockaddr_ll* find_matching_sockaddr(struct ifs_data *ifs, uint8_t *dst_mac_addr);
-uint32_t* stringToUint32Array(const char* str, uint8_t *length);
 uint32_t find_matching_if_index(struct ifs_data *ifs, struct sockaddr_ll *from_addr);
 void clear_ping_data(struct ping_data *data);
 void decode_sdu_miparp(uint32_t* sdu_array, uint8_t* mip_addr);
 void decode_fill_ping_buf(const char *buf, size_t buf_size, char *destination_host, char *message);
-char* uint32ArrayToString(uint32_t* arr);
 // uint8_t routing_lookup(uint8_t host_mip_addr, int *route_fd);
 // void send_arp_request_to_all_interfaces(struct ifs_data *ifs, uint8_t target_mip_addr, int debug_mode);
 // void fill_forward_data(struct forward_data *forward_data, uint8_t next_hop_MIP, struct pdu *pdu, int *waiting_to_forward);
@@ -101,10 +111,15 @@ struct pdu* create_PDU(uint8_t src_mip_addr,
             const uint32_t *sdu,
             uint16_t sdu_len);
 
-void send_PDU(struct ifs_data *ifs, struct pdu *pdu, struct sockaddr_ll *interface);
+struct adjacency;
+ssize_t send_frame(int rsock, const struct adjacency *adj, uint32_t miphdr, const uint32_t *sdu, size_t sdu_len);
+void send_PDU(struct ifs_data *ifs, struct pdu *pdu, const struct adjacency *adj);
+void broadcast_PDU(struct ifs_data *ifs, uint8_t sdu_type, const uint32_t *sdu, uint16_t sdu_len);
+int tx_queue_congested(struct ifs_data *ifs);
 
 void uint32_to_uint8(uint32_t *input, size_t input_size, uint8_t *output);
 uint32_t* uint8ArrayToUint32Array(const uint8_t* byte_array, uint8_t array_length, uint8_t *length);
 void sendRequestToApp(int route_fd, int destinationMIP, int localMIP);
-void fill_ethhdr(struct pdu *pdu, const uint8_t *src_mac, const uint8_t *dst_mac);
+void sendNeighborEventToApp(int route_fd, int neighborMIP, int localMIP, int isUp);
+uint64_t now_ms(void);
 #endif
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef _VECTOR_H_
+#define _VECTOR_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "utils.h"
+
+#define VECTOR_SIZE 256 // Most packets a node of the receive pipeline handles at once
+
+// Nodes of the receive pipeline, in the order they run
+enum vector_node {
+    VECTOR_RX,          // Frames read from bundles, forwarding threads and the RAW socket
+    VECTOR_PARSE,       // Rate limits, MIP header and SDU, emulated loss, LINK frames unwrapped
+    VECTOR_CLASSIFY,    // Split by destination and SDU type
+    VECTOR_ARP,         // MIP-ARP requests and replies
+    VECTOR_LOCAL,       // Other PDUs for this daemon
+    VECTOR_ROUTE,       // Routing messages, passed to the routing daemon
+    VECTOR_FORWARD,     // PDUs in transit, sent on or queued
+    VECTOR_TX,          // Data frames the other nodes sent, handed to the socket together
+    VECTOR_NODES
+};
+
+// PDUs on their way through the pipeline
+struct packet_vector {
+    size_t count;
+    struct pdu *pdus[VECTOR_SIZE];
+    int interfaces[VECTOR_SIZE];        // Index of the interface each PDU arrived on
+    MIP_handle types[VECTOR_SIZE];      // How each PDU is handled, see get_mip_handle
+};
+
+// Handles every PDU of a vector and frees them or passes them on
+typedef void (*vector_fn)(struct packet_vector *vec, void *ctx);
+
+// Counters of one node
+struct vector_stats {
+    uint64_t vectors;   // Times the node ran
+    uint64_t packets;   // Packets it was given
+    uint64_t dropped;   // Packets it dropped
+    uint64_t ns;        // Nanoseconds it ran for
+};
+
+void vector_init(int loss_percent);
+void vector_register(enum vector_node node, vector_fn fn, void *ctx);
+void vector_run(struct ifs_data *ifs);
+int vector_pending(void);
+void vector_print_stats(void);
+
+#endif /* _VECTOR_H_ */
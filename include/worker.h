@@ -0,0 +1,24 @@
+#ifndef _WORKER_H_
+#define _WORKER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "utils.h"
+
+#define WORKER_MAX   16  // Most forwarding threads
+#define WORKER_BATCH 32  // Frames a forwarding thread reads, or sends, with one system call
+#define WORKER_RING  256 // Frames a forwarding thread holds for the main thread, a power of two
+#define WORKER_TXQ   256 // Frames a forwarding thread holds until its socket has room, a power of two
+#define WORKER_HOLD  1   // Milliseconds a forwarding thread waits before it looks at its held frames again
+
+int worker_start(struct ifs_data *ifs, int count, int fast_path);
+void worker_sync(void);
+void worker_wakeup(void);
+int worker_pending(void);
+int worker_congested(void);
+ssize_t worker_next(uint8_t *buf, size_t size, int *recv_interface);
+void worker_print_stats(void);
+
+#endif /* _WORKER_H_ */
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+
+#include "adj.h"
+
+static struct adjacency adjacencies[ADJ_TABLE_SIZE];
+static struct adjacency broadcasts[MAX_IF]; // One broadcast adjacency per interface
+static uint32_t version;                    // Bumped every time an adjacency changes, see adj_version
+
+
+/**
+ * Forget a neighbor that has not been resolved for ADJ_LIFETIME ms.
+ *
+ * arg: Adjacency of the neighbor.
+ *
+ * The next frame to the neighbor resolves it again, so a neighbor that changed its MAC
+ * address without telling is found again.
+ */
+static void adj_expired(void *arg) {
+    struct adjacency *adj = arg;
+
+    if (debug_mode) {
+        printf("Adjacency of %u aged out\n", adj->mip);
+    }
+    adj->valid = 0;
+    version++;
+}
+
+/**
+ * Fill in an adjacency for a destination MAC address on an interface.
+ *
+ * ifs: Pointer to the interface data structure.
+ * adj: Adjacency to fill in.
+ * mip: MIP address of the neighbor.
+ * mac: Destination MAC address.
+ * interface: Index of the interface to send on.
+ */
+static void adj_build(struct ifs_data *ifs, struct adjacency *adj, uint8_t mip, const uint8_t *mac, int interface) {
+    adj->interface = interface;
+    adj->mip = mip;
+
+    memcpy(adj->ethhdr.dst_mac, mac, MAC_ADDR_SIZE);
+    memcpy(adj->ethhdr.src_mac, ifs->addr[interface].sll_addr, MAC_ADDR_SIZE);
+    adj->ethhdr.ethertype = htons(ETH_P_MIP);
+
+    adj->addr = ifs->addr[interface];
+    memcpy(adj->addr.sll_addr, mac, MAC_ADDR_SIZE);
+    adj->addr.sll_halen = MAC_ADDR_SIZE;
+
+    adj->valid = 1;
+    version++;
+}
+
+/**
+ * Initialize the adjacency table.
+ *
+ * ifs: Pointer to the interface data structure, the interfaces must already be known.
+ *
+ * This function forgets every neighbor and prebuilds one broadcast adjacency per interface,
+ * used for MIP-ARP requests and routing messages.
+ */
+void adj_init(struct ifs_data *ifs) {
+    const uint8_t broadcast_mac[MAC_ADDR_SIZE] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+
+    memset(adjacencies, 0, sizeof(adjacencies));
+    memset(broadcasts, 0, sizeof(broadcasts));
+    for (int mip = 0; mip < ADJ_TABLE_SIZE; mip++) {
+        timer_init(&adjacencies[mip].age, adj_expired, &adjacencies[mip]);
+    }
+
+    for (int interface = 0; interface < ifs->ifn; interface++) {
+        adj_build(ifs, &broadcasts[interface], BROADCAST_MIP_ADDR, broadcast_mac, interface);
+    }
+}
+
+/**
+ * Store the resolved link-layer address of a neighbor.
+ *
+ * ifs: Pointer to the interface data structure.
+ * mip: MIP address of the neighbor.
+ * mac: MAC address of the neighbor.
+ * interface: Index of the interface the neighbor was heard on.
+ *
+ * The Ethernet header and sockaddr_ll are built once here, so sending to the neighbor needs
+ * neither a MAC lookup nor an interface lookup. A neighbor that moves to another interface
+ * or changes its MAC address simply overwrites its adjacency. The adjacency ages out after
+ * ADJ_LIFETIME ms unless MIP-ARP resolves the neighbor again.
+ */
+void adj_update(struct ifs_data *ifs, uint8_t mip, const uint8_t *mac, int interface) {
+    if (interface < 0 || interface >= ifs->ifn) {
+        return;
+    }
+
+    adj_build(ifs, &adjacencies[mip], mip, mac, interface);
+    timer_add(&adjacencies[mip].age, ADJ_LIFETIME);
+}
+
+/**
+ * Look up the adjacency of a neighbor.
+ *
+ * mip: MIP address of the neighbor.
+ *
+ * Returns a pointer to the adjacency, or NULL if the neighbor has not been resolved yet.
+ */
+const struct adjacency *adj_lookup(uint8_t mip) {
+    if (!adjacencies[mip].valid) {
+        return NULL;
+    }
+
+    return &adjacencies[mip];
+}
+
+/**
+ * Get the broadcast adjacency of an interface.
+ *
+ * interface: Index of the interface.
+ *
+ * Returns a pointer to the adjacency, or NULL if the interface does not exist.
+ */
+const struct adjacency *adj_broadcast(int interface) {
+    if (interface < 0 || interface >= MAX_IF || !broadcasts[interface].valid) {
+        return NULL;
+    }
+
+    return &broadcasts[interface];
+}
+
+/**
+ * Get the version of the adjacency table.
+ *
+ * The version changes whenever a neighbor is resolved, resolved again or ages out.
+ *
+ * Returns the version.
+ */
+uint32_t adj_version(void) {
+    return version;
+}
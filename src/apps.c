@@ -0,0 +1,429 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+#include "apps.h"
+#include "txq.h"
+#include "arp.h"
+#include "utils.h"
+#include "pack.h"
+
+static struct app_client *clients; // Indexed by file descriptor, grown as needed
+static int clients_len;            // Slots in 'clients'
+static int next_server;            // Where the search for a server starts, spreads PINGs over servers
+
+// PINGs sent by clients, oldest first, so a PONG goes to the client that asked for it
+static struct {
+    int     fd;     // Client that sent the PING, -1 once answered or given up
+    uint8_t dst;    // Destination of the PING
+    uint32_t hash;  // Hash of the text of the PING, which the PONG echoes
+} outstanding[APP_MAX_OUTSTANDING];
+static int outstanding_head;
+static int outstanding_count;
+
+
+/**
+ * Register a newly connected ping application.
+ *
+ * fd: File descriptor of the application socket.
+ * msg: The first message of the application, the identifier, SDU type and role.
+ * len: Length of the message.
+ *
+ * An application that only sends its identifier is registered as a ping client, as every
+ * ping application was before servers announced themselves, and is written the bare SDU as
+ * before. Applications that register fully get the source MIP address and TTL in front of
+ * every message, see libmip.h. A server is sent the local MIP address by the caller.
+ *
+ * Returns 0 on success, or -1 if the registration is not valid or memory runs out.
+ */
+int apps_register(int fd, const uint8_t *msg, size_t len) {
+    if (fd < 0 || len < 1 || msg[0] != APP_ID_PING) {
+        return -1;
+    }
+
+    if (fd >= clients_len) {
+        int new_len = fd + 16;
+        struct app_client *grown = realloc(clients, new_len * sizeof(*clients));
+        if (grown == NULL) {
+            return -1;
+        }
+        for (int i = clients_len; i < new_len; i++) {
+            grown[i].fd = -1;
+        }
+        clients = grown;
+        clients_len = new_len;
+    }
+
+    struct app_client *client = &clients[fd];
+
+    memset(client, 0, sizeof(*client));
+    client->fd = fd;
+    client->sdu_type = len >= APP_REGISTER_LEN ? msg[1] : SDU_TYPE_PING;
+    client->role = len >= APP_REGISTER_LEN ? msg[2] : CLIENT;
+    client->src_header = len >= APP_REGISTER_LEN;
+    ratelimit_app_bucket(&client->bucket);
+
+    if (client->sdu_type != SDU_TYPE_PING || (client->role != CLIENT && client->role != SERVER)) {
+        client->fd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Forget an application that closed its connection.
+ *
+ * fd: File descriptor of the application socket, the caller closes it.
+ *
+ * PINGs the application was waiting for are given up. PINGs a server did not answer are
+ * lost, their clients time out.
+ */
+void apps_unregister(int fd) {
+    if (apps_lookup(fd) == NULL) {
+        return;
+    }
+
+    clients[fd].fd = -1;
+
+    for (int i = 0; i < outstanding_count; i++) {
+        int slot = (outstanding_head + i) % APP_MAX_OUTSTANDING;
+        if (outstanding[slot].fd == fd) {
+            outstanding[slot].fd = -1;
+        }
+    }
+}
+
+/**
+ * Look up a ping application.
+ *
+ * fd: File descriptor of the application socket.
+ *
+ * Returns a pointer to the application, or NULL if the descriptor is not a registered one.
+ */
+struct app_client *apps_lookup(int fd) {
+    if (fd < 0 || fd >= clients_len || clients[fd].fd == -1) {
+        return NULL;
+    }
+
+    return &clients[fd];
+}
+
+/**
+ * Write a SDU to an application.
+ *
+ * client: The application.
+ * src: MIP address the SDU came from.
+ * ttl: TTL the SDU arrived with.
+ * sdu: The SDU.
+ * sdu_len: Length of the SDU in words.
+ *
+ * The header and the SDU go out as one message.
+ *
+ * Returns 0 on success, or -1 if the write failed, e.g. because the application is gone.
+ */
+static int write_sdu(const struct app_client *client, uint8_t src, uint8_t ttl, const uint32_t *sdu, size_t sdu_len) {
+    uint8_t hdr[APP_HDR_LEN] = { src, ttl };
+    struct iovec iov[2] = {
+        { .iov_base = hdr, .iov_len = client->src_header ? sizeof(hdr) : 0 },
+        { .iov_base = (void *) sdu, .iov_len = sdu_len * sizeof(uint32_t) }
+    };
+
+    if (writev(client->fd, iov, 2) == -1) {
+        perror("write");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Hand a PING from another node to a ping server.
+ *
+ * src: MIP address of the node that sent the PING.
+ * ttl: TTL the PONG is sent back with.
+ * sdu: SDU of the PING.
+ * sdu_len: Length of the SDU in words.
+ *
+ * Servers take turns, skipping those that have APP_MAX_PENDING PINGs to answer. The source
+ * is remembered with the server, which answers in order, see apps_reply_to.
+ *
+ * Returns 0 on success, or -1 if no server could take the PING.
+ */
+int apps_deliver_ping(uint8_t src, uint8_t ttl, const uint32_t *sdu, size_t sdu_len) {
+    for (int i = 0; i < clients_len; i++) {
+        struct app_client *server = &clients[(next_server + i) % clients_len];
+
+        if (server->fd == -1 || server->role != SERVER || server->sdu_type != SDU_TYPE_PING ||
+            server->count == APP_MAX_PENDING) {
+            continue;
+        }
+        if (write_sdu(server, src, ttl, sdu, sdu_len) == -1) {
+            continue;
+        }
+
+        int slot = (server->head + server->count) % APP_MAX_PENDING;
+        server->peers[slot] = src;
+        server->ttls[slot] = ttl;
+        server->count++;
+
+        next_server = (server->fd + 1) % clients_len;
+        return 0;
+    }
+
+    if (debug_mode) {
+        printf("No ping server to take the PING from %u\n", src);
+    }
+    return -1;
+}
+
+/**
+ * Find out where a PONG from a ping server goes.
+ *
+ * fd: File descriptor of the server socket.
+ * dst: Pointer to store the MIP address of the node that sent the PING.
+ * ttl: Pointer to store the TTL to send the PONG with.
+ *
+ * Returns 0 on success, or -1 if the server has no unanswered PING.
+ */
+int apps_reply_to(int fd, uint8_t *dst, uint8_t *ttl) {
+    struct app_client *server = apps_lookup(fd);
+
+    if (server == NULL || server->count == 0) {
+        return -1;
+    }
+
+    *dst = server->peers[server->head];
+    *ttl = server->ttls[server->head];
+    server->head = (server->head + 1) % APP_MAX_PENDING;
+    server->count--;
+
+    return 0;
+}
+
+/**
+ * Hash the text of a PING or PONG.
+ *
+ * msg: The message, starting with "PING:" or "PONG:".
+ *
+ * Returns the FNV-1a hash of the text after the prefix.
+ */
+static uint32_t text_hash(const char *msg) {
+    uint32_t hash = 2166136261u;
+
+    for (const char *c = strlen(msg) >= 5 ? msg + 5 : msg; *c != '\0'; c++) {
+        hash = (hash ^ (uint8_t) *c) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Remember that a ping client sent a PING.
+ *
+ * fd: File descriptor of the client socket.
+ * dst: Destination of the PING.
+ * msg: The PING message, "PING:<text>".
+ *
+ * When APP_MAX_OUTSTANDING PINGs are waiting, the oldest is given up.
+ */
+void apps_ping_sent(int fd, uint8_t dst, const char *msg) {
+    if (outstanding_count == APP_MAX_OUTSTANDING) {
+        outstanding_head = (outstanding_head + 1) % APP_MAX_OUTSTANDING;
+        outstanding_count--;
+    }
+
+    int slot = (outstanding_head + outstanding_count) % APP_MAX_OUTSTANDING;
+    outstanding[slot].fd = fd;
+    outstanding[slot].dst = dst;
+    outstanding[slot].hash = text_hash(msg);
+    outstanding_count++;
+}
+
+/**
+ * Drop answered PINGs from the front of the outstanding queue.
+ */
+static void outstanding_trim(void) {
+    while (outstanding_count > 0 && outstanding[outstanding_head].fd == -1) {
+        outstanding_head = (outstanding_head + 1) % APP_MAX_OUTSTANDING;
+        outstanding_count--;
+    }
+}
+
+/**
+ * Hand a PONG from another node to the client that sent the PING.
+ *
+ * src: MIP address of the node that sent the PONG.
+ * ttl: TTL the PONG arrived with.
+ * sdu: SDU of the PONG.
+ * sdu_len: Length of the SDU in words.
+ *
+ * Several clients may ping the same node, and PONGs can come back in another order when the
+ * node runs several servers. The PONG goes to the client whose PING had the same text, or
+ * if none did, to the client that has waited longest.
+ *
+ * Returns 0 on success, or -1 if no client is waiting for a PONG from the node.
+ */
+int apps_deliver_pong(uint8_t src, uint8_t ttl, const uint32_t *sdu, size_t sdu_len) {
+    char msg[MIP_MAX_MSG_LEN];
+    int match = -1;
+
+    unpack_string(msg, sizeof(msg), sdu, sdu_len);
+    uint32_t hash = text_hash(msg);
+
+    for (int i = 0; i < outstanding_count; i++) {
+        int slot = (outstanding_head + i) % APP_MAX_OUTSTANDING;
+
+        if (outstanding[slot].fd == -1 || outstanding[slot].dst != src) {
+            continue;
+        }
+        if (match == -1 || outstanding[slot].hash == hash) {
+            match = slot;
+        }
+        if (outstanding[slot].hash == hash) {
+            break;
+        }
+    }
+
+    if (match != -1) {
+        int fd = outstanding[match].fd;
+
+        outstanding[match].fd = -1;
+        outstanding_trim();
+
+        return write_sdu(&clients[fd], src, ttl, sdu, sdu_len);
+    }
+
+    if (debug_mode) {
+        printf("No ping client waiting for a PONG from %u\n", src);
+    }
+    return -1;
+}
+
+/**
+ * Tell every client waiting for a PONG from a node that the node is unreachable.
+ *
+ * dst: MIP address of the unreachable node.
+ *
+ * The message is "UNREACHABLE:<dst>", packed like a PONG, with 'dst' as its source.
+ */
+void apps_unreachable(uint8_t dst) {
+    char msg[32];
+    uint32_t sdu[1 + sizeof(msg) / 4];
+
+    snprintf(msg, sizeof(msg), "UNREACHABLE:%u", dst);
+    size_t sdu_len = pack_string(sdu, sizeof(sdu) / sizeof(sdu[0]), msg);
+
+    for (int i = 0; i < outstanding_count; i++) {
+        int slot = (outstanding_head + i) % APP_MAX_OUTSTANDING;
+
+        if (outstanding[slot].fd != -1 && outstanding[slot].dst == dst) {
+            write_sdu(&clients[outstanding[slot].fd], dst, 0, sdu, sdu_len);
+            outstanding[slot].fd = -1;
+        }
+    }
+
+    outstanding_trim();
+}
+
+/**
+ * Stop reading from an application whose messages the forward queue or the transmit queues
+ * cannot take.
+ *
+ * epoll_fd: The epoll instance the application socket is in.
+ * fd: File descriptor of the application socket.
+ * dst: Destination of the message that filled a queue or was dropped.
+ *
+ * The socket stays in the epoll instance with no events, so a hangup is still reported. The
+ * application blocks once its socket buffer is full, see apps_unthrottle.
+ */
+void apps_throttle(int epoll_fd, int fd, uint8_t dst) {
+    struct app_client *client = apps_lookup(fd);
+    struct epoll_event ev = { .events = 0, .data.fd = fd };
+
+    if (client == NULL || client->throttled) {
+        return;
+    }
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+        perror("epoll_ctl");
+        return;
+    }
+
+    client->throttled = 1;
+    client->throttled_dst = dst;
+
+    if (debug_mode) {
+        printf("Queues towards %u are full, not reading from application %d\n", dst, fd);
+    }
+}
+
+/**
+ * Read again from throttled applications once the queues have drained.
+ *
+ * epoll_fd: The epoll instance the application sockets are in.
+ * queue: The forward queue.
+ *
+ * Called from the daemon tick. An application is read again when the forward queue is less 
+ * than APP_RESUME_FILL percent full for its destination, and the transmit queues are too, so 
+ * it does not flap at the limit.
+ */
+void apps_unthrottle(int epoll_fd, const struct queue_f *queue) {
+    for (int i = 0; i < clients_len; i++) {
+        struct app_client *client = &clients[i];
+        struct epoll_event ev = { .events = EPOLLIN, .data.fd = client->fd };
+
+        if (client->fd == -1 || !client->throttled || txq_fill() >= APP_RESUME_FILL ||
+            queue_forward_fill(queue, client->throttled_dst) >= APP_RESUME_FILL) {
+            continue;
+        }
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &ev) == -1) {
+            perror("epoll_ctl");
+            continue;
+        }
+        client->throttled = 0;
+    }
+}
+
+/**
+ * Let the next message of an application through its rate limit.
+ *
+ * fd: File descriptor of the application socket, readable.
+ * now: Current monotonic time in milliseconds.
+ *
+ * A message over the rate is read and thrown away here, without being copied, parsed or
+ * queued. A hangup is left for the caller to find.
+ *
+ * Returns 1 if the caller should read the message, or 0 if it was dropped.
+ */
+int apps_admit(int fd, uint64_t now) {
+    struct app_client *client = apps_lookup(fd);
+    char byte;
+
+    if (client == NULL || bucket_take(&client->bucket, now)) {
+        return 1;
+    }
+
+    // A truncated read of a SOCK_SEQPACKET socket discards the rest of the message
+    if (recv(fd, &byte, sizeof(byte), MSG_TRUNC | MSG_DONTWAIT) > 0) {
+        return 0;
+    }
+
+    client->bucket.dropped--; // Nothing was dropped
+    return 1;
+}
+
+/**
+ * Print the rate limit counters of every limited application.
+ */
+void apps_print_stats(void) {
+    for (int i = 0; i < clients_len; i++) {
+        const struct token_bucket *bucket = &clients[i].bucket;
+        if (clients[i].fd != -1 && bucket->rate != 0) {
+            printf("\t application %d rate %u/s burst %u passed %llu dropped %llu\n", i, bucket->rate, bucket->burst,
+                   (unsigned long long) bucket->passed, (unsigned long long) bucket->dropped);
+        }
+    }
+}
@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+#include <sys/timerfd.h>
+
+#include "bundle.h"
+#include "adj.h"
+#include "mip.h"
+
+static struct bundle bundles[BUNDLE_MAX_PEERS];
+static int timer_fd = -1;        // One-shot timer for the oldest waiting frame, -1 while bundling is off
+static uint32_t flush_delay_us;  // Longest time a frame waits for others
+static size_t capacity;          // Largest bundle SDU in words
+static int armed;                // 1 while the timer runs
+
+// The bundle being taken apart, its frames are handed out one at a time
+static struct {
+    uint32_t words[MIP_MAX_SDU_WORDS];  // Frames of the bundle, the LINK header removed
+    size_t   len;                       // Words in 'words'
+    size_t   offset;                    // Word offset of the next frame
+    struct eth_hdr ethhdr;              // Ethernet header of the bundle
+    int      interface;                 // Interface the bundle was received on
+} rx;
+
+
+/**
+ * Turn on bundling of small frames.
+ *
+ * delay_us: Longest time in microseconds a small frame waits for others to the same neighbor.
+ * max_words: Largest bundle SDU in words, see frag_max_sdu_words.
+ *
+ * Returns the timer file descriptor, which the caller must watch and answer with
+ * bundle_flush, or -1 on error.
+ */
+int bundle_init(uint32_t delay_us, size_t max_words) {
+    memset(bundles, 0, sizeof(bundles));
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd == -1) {
+        perror("timerfd_create");
+        return -1;
+    }
+
+    flush_delay_us = delay_us;
+    capacity = max_words < MIP_MAX_SDU_WORDS ? max_words : MIP_MAX_SDU_WORDS;
+    armed = 0;
+
+    return timer_fd;
+}
+
+/**
+ * Put a bundle on the wire and free its slot.
+ *
+ * ifs: Pointer to the interface data structure.
+ * bundle: The bundle.
+ *
+ * A bundle of one frame is sent as that frame, it would gain nothing from the LINK header.
+ */
+static void send_bundle(struct ifs_data *ifs, struct bundle *bundle) {
+    if (bundle->count == 1) {
+        send_frame(ifs->rsock, bundle->adj, htonl(bundle->words[1]), bundle->words + 2, bundle->len - 2);
+    } else if (bundle->count > 1) {
+        struct mip_hdr hdr = {
+            .dst = bundle->adj->mip,
+            .src = ifs->local_mip_addr,
+            .ttl = 1,
+            .sdu_len = bundle->len,
+            .sdu_type = SDU_TYPE_LINK
+        };
+
+        bundle->words[0] = ((uint32_t) LINK_BUNDLE << 24) | bundle->count;
+        send_frame(ifs->rsock, bundle->adj, mip_pack_header(&hdr), bundle->words, bundle->len);
+    }
+
+    bundle->adj = NULL;
+    bundle->count = 0;
+    bundle->len = 1;
+}
+
+/**
+ * Add a frame to the bundle towards its neighbor.
+ *
+ * ifs: Pointer to the interface data structure.
+ * adj: Adjacency of the neighbor, or broadcast adjacency of an interface.
+ * miphdr: MIP header in network byte order, see mip_pack_header.
+ * sdu: Pointer to the SDU data.
+ * sdu_len: Length of the SDU in 32-bit words.
+ *
+ * The frame is copied. A bundle goes out once the next frame could not fit, or when the
+ * timer started by the first frame of any bundle expires, so no frame waits longer than
+ * the delay given to bundle_init. A frame too large to be bundled first sends what is
+ * waiting for the same neighbor, so frames are not reordered.
+ *
+ * Returns 1 if the frame was taken, or 0 if the caller must send it itself.
+ */
+int bundle_add(struct ifs_data *ifs, const struct adjacency *adj, uint32_t miphdr, const uint32_t *sdu, size_t sdu_len) {
+    struct bundle *bundle = NULL;
+    struct bundle *free_slot = NULL;
+
+    if (timer_fd == -1 || adj == NULL) {
+        return 0;
+    }
+
+    for (int i = 0; i < BUNDLE_MAX_PEERS; i++) {
+        if (bundles[i].adj == adj) {
+            bundle = &bundles[i];
+        } else if (bundles[i].adj == NULL && free_slot == NULL) {
+            free_slot = &bundles[i];
+        }
+    }
+
+    if (sdu_len > BUNDLE_MAX_RECORD_WORDS || 2 + sdu_len > capacity) {
+        if (bundle != NULL) {
+            send_bundle(ifs, bundle);
+        }
+        return 0;
+    }
+
+    if (bundle != NULL && bundle->len + 1 + sdu_len > capacity) {
+        send_bundle(ifs, bundle);
+    }
+    if (bundle == NULL) {
+        // Every slot is in use, the first one goes out early
+        if (free_slot == NULL) {
+            free_slot = &bundles[0];
+            send_bundle(ifs, free_slot);
+        }
+        bundle = free_slot;
+    }
+    if (bundle->adj == NULL) {
+        bundle->adj = adj;
+        bundle->count = 0;
+        bundle->len = 1;
+    }
+
+    bundle->words[bundle->len] = ntohl(miphdr);
+    memcpy(bundle->words + bundle->len + 1, sdu, sdu_len * sizeof(uint32_t));
+    bundle->len += 1 + sdu_len;
+    bundle->count++;
+
+    // Full, not even the smallest frame fits any more
+    if (bundle->len + 2 > capacity) {
+        send_bundle(ifs, bundle);
+    }
+
+    if (!armed) {
+        struct itimerspec its;
+
+        memset(&its, 0, sizeof(its));
+        its.it_value.tv_sec = flush_delay_us / 1000000;
+        its.it_value.tv_nsec = (flush_delay_us % 1000000) * 1000;
+        if (timerfd_settime(timer_fd, 0, &its, NULL) == 0) {
+            armed = 1;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Send every bundle that is waiting.
+ *
+ * ifs: Pointer to the interface data structure.
+ *
+ * This function is called when the timer from bundle_init expires, after the caller has 
+ * read the timer.
+ */
+void bundle_flush(struct ifs_data *ifs) {
+    armed = 0;
+
+    for (int i = 0; i < BUNDLE_MAX_PEERS; i++) {
+        if (bundles[i].adj != NULL) {
+            send_bundle(ifs, &bundles[i]);
+        }
+    }
+}
+
+/**
+ * Take the next frame out of the bundle being taken apart.
+ *
+ * hdr: Pointer to store the MIP header of the frame.
+ *
+ * A frame that does not fit the rest of the bundle ends it, as do frames that carry
+ * nothing or are themselves LINK frames.
+ *
+ * Returns a pointer to the SDU of the frame, or NULL if there are no more frames.
+ */
+static const uint32_t *next_record(struct mip_hdr *hdr) {
+    if (rx.offset >= rx.len) {
+        return NULL;
+    }
+
+    mip_unpack_header(rx.words[rx.offset], hdr);
+    if (hdr->sdu_len == 0 || hdr->sdu_type == SDU_TYPE_LINK || rx.offset + 1 + hdr->sdu_len > rx.len) {
+        rx.len = 0;
+        return NULL;
+    }
+
+    const uint32_t *sdu = rx.words + rx.offset + 1;
+    rx.offset += 1 + hdr->sdu_len;
+
+    return sdu;
+}
+
+/**
+ * Process a received LINK_BUNDLE PDU.
+ *
+ * pdu: The received PDU.
+ * interface: Index of the interface the PDU was received on.
+ *
+ * The PDU is rewritten in place to hold the first frame of the bundle, which the caller
+ * handles as if it had been received as is. The other frames are kept, see bundle_next.
+ *
+ * Returns 1 if the PDU holds a frame to handle, or 0 if the bundle is empty.
+ */
+int bundle_input(struct pdu *pdu, int interface) {
+    size_t sdu_len = pdu->miphdr->sdu_len;
+    struct mip_hdr hdr;
+
+    if (sdu_len < 1) {
+        return 0;
+    }
+
+    memcpy(rx.words, pdu->sdu + 1, (sdu_len - 1) * sizeof(uint32_t));
+    rx.len = sdu_len - 1;
+    rx.offset = 0;
+    rx.ethhdr = *pdu->ethhdr;
+    rx.interface = interface;
+
+    const uint32_t *sdu = next_record(&hdr);
+    if (sdu == NULL) {
+        return 0;
+    }
+
+    memcpy(pdu->sdu, sdu, hdr.sdu_len * sizeof(uint32_t));
+    *pdu->miphdr = hdr;
+
+    return 1;
+}
+
+/**
+ * Get the next frame of the last bundle received.
+ *
+ * interface: Pointer to store the index of the interface the bundle was received on.
+ *
+ * Returns a new PDU the caller must destroy, or NULL once every frame has been handed out.
+ */
+struct pdu *bundle_next(int *interface) {
+    struct mip_hdr hdr;
+    const uint32_t *sdu = next_record(&hdr);
+
+    if (sdu == NULL) {
+        return NULL;
+    }
+
+    struct pdu *pdu = create_PDU(hdr.src, hdr.dst, hdr.ttl, hdr.sdu_type, sdu, hdr.sdu_len);
+    *pdu->ethhdr = rx.ethhdr;
+    *interface = rx.interface;
+
+    return pdu;
+}
+
+/**
+ * Check whether frames of a received bundle are still waiting to be handled.
+ *
+ * Returns 1 if bundle_next has a frame, and 0 otherwise.
+ */
+int bundle_pending(void) {
+    return rx.offset < rx.len;
+}
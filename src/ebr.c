@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ebr.h"
+
+
+/**
+ * Set up a reclamation domain.
+ *
+ * ebr: The domain.
+ *
+ * A domain protects memory one thread publishes, by atomic pointer stores, to threads that
+ * only read it. Readers never lock and never wait, they announce the epoch they read in, see
+ * ebr_enter. Memory the writer replaces is retired and freed once no reader can still see
+ * it, see ebr_reclaim.
+ */
+void ebr_init(struct ebr *ebr) {
+    memset(ebr, 0, sizeof(*ebr));
+    atomic_store(&ebr->epoch, EBR_IDLE + 1);
+}
+
+/**
+ * Add a reading thread to a domain.
+ *
+ * ebr: The domain.
+ *
+ * Readers are never removed, a thread that stops reading just stays outside its read-side
+ * sections.
+ *
+ * Returns the reader, for the thread that reads, or NULL if the domain has EBR_MAX_READERS.
+ */
+struct ebr_reader *ebr_register(struct ebr *ebr) {
+    int index = atomic_fetch_add(&ebr->reader_count, 1);
+
+    if (index >= EBR_MAX_READERS) {
+        atomic_fetch_sub(&ebr->reader_count, 1);
+        return NULL;
+    }
+
+    atomic_store(&ebr->readers[index].epoch, EBR_IDLE);
+    return &ebr->readers[index];
+}
+
+/**
+ * Start a read-side section.
+ *
+ * ebr: The domain.
+ * reader: The reader of the calling thread.
+ *
+ * Memory loaded from a published pointer inside the section is not freed before ebr_exit.
+ * The only cost is a store to the reader's own cache line, which must be ordered before the
+ * loads of the section.
+ */
+void ebr_enter(struct ebr *ebr, struct ebr_reader *reader) {
+    atomic_store_explicit(&reader->epoch, atomic_load_explicit(&ebr->epoch, memory_order_acquire), memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+/**
+ * End a read-side section.
+ *
+ * reader: The reader of the calling thread.
+ *
+ * Nothing loaded in the section may be used after this. A thread should leave its section
+ * before it blocks, or it holds back every free.
+ */
+void ebr_exit(struct ebr_reader *reader) {
+    atomic_store_explicit(&reader->epoch, EBR_IDLE, memory_order_release);
+}
+
+/**
+ * Hand memory the writer has unpublished to the domain.
+ *
+ * ebr: The domain.
+ * ptr: The memory, no longer reachable from any published pointer.
+ * free_fn: Frees the memory.
+ *
+ * Only the writer retires. The epoch moves on, so a reader that enters from now on cannot
+ * find the memory, and it is freed by ebr_reclaim once every reader that may have found it
+ * has left its section.
+ */
+void ebr_retire(struct ebr *ebr, void *ptr, ebr_free_fn free_fn) {
+    struct ebr_retired *retired = malloc(sizeof(*retired));
+
+    if (retired == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    retired->ptr = ptr;
+    retired->free_fn = free_fn;
+    retired->epoch = atomic_fetch_add(&ebr->epoch, 1);
+    retired->next = ebr->limbo;
+    ebr->limbo = retired;
+
+    ebr->pending++;
+    ebr->retired++;
+
+    ebr_reclaim(ebr);
+}
+
+/**
+ * Free the retired memory no reader can see any more.
+ *
+ * ebr: The domain.
+ *
+ * Memory retired in an epoch is free once every reader is outside a section or entered in a
+ * later epoch. The writer calls this whenever it likes, it never waits for a reader.
+ *
+ * Returns the number of pieces of memory that were freed.
+ */
+size_t ebr_reclaim(struct ebr *ebr) {
+    uint64_t oldest = atomic_load(&ebr->epoch);
+    int count = atomic_load(&ebr->reader_count);
+    size_t freed = 0;
+
+    if (ebr->limbo == NULL) {
+        return 0;
+    }
+
+    atomic_thread_fence(memory_order_seq_cst);
+
+    // The oldest epoch a reader is still in
+    for (int i = 0; i < count && i < EBR_MAX_READERS; i++) {
+        uint64_t epoch = atomic_load_explicit(&ebr->readers[i].epoch, memory_order_acquire);
+        if (epoch != EBR_IDLE && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+
+    struct ebr_retired **link = &ebr->limbo;
+    while (*link != NULL) {
+        struct ebr_retired *retired = *link;
+
+        if (retired->epoch >= oldest) {
+            link = &retired->next;
+            continue;
+        }
+
+        *link = retired->next;
+        retired->free_fn(retired->ptr);
+        free(retired);
+        freed++;
+    }
+
+    ebr->pending -= freed;
+    ebr->freed += freed;
+    return freed;
+}
@@ -0,0 +1,331 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+
+#include "fec.h"
+#include "adj.h"
+#include "mip.h"
+
+static uint8_t configured_k[256];                // Block size per destination, 0 if not protected
+static struct fec_block tx_blocks[FEC_MAX_PEERS]; // Blocks being sent, one per neighbor
+static struct fec_block rx_blocks[FEC_MAX_PEERS]; // Blocks being received, one per neighbor
+static uint16_t next_id;                         // ID of the next block we send
+static struct ifs_data *tx_ifs;                  // Interfaces the blocks being sent go out on
+
+
+/**
+ * Protect the frames to a destination with parity frames.
+ *
+ * dst: MIP address of the destination.
+ * k: Number of data frames per parity frame, 0 to stop protecting the destination.
+ *
+ * Every frame to the destination that this daemon sends to a neighbor is protected on that
+ * hop, whether it comes from a local application or is forwarded. Other daemons on the path
+ * protect their hops only if they are configured for the destination too.
+ *
+ * Returns 0 on success, or -1 if the destination or block size is not valid.
+ */
+int fec_configure(uint8_t dst, int k) {
+    if (dst == BROADCAST_MIP_ADDR || k < 0 || k == 1 || k > FEC_MAX_K) {
+        return -1;
+    }
+
+    configured_k[dst] = (uint8_t) k;
+    return 0;
+}
+
+/**
+ * Check whether frames to a destination are protected.
+ *
+ * dst: MIP address of the destination.
+ *
+ * Returns the block size, or 0 if the frames are sent as they are.
+ */
+int fec_wanted(uint8_t dst) {
+    return configured_k[dst];
+}
+
+/**
+ * Put a LINK frame on the wire towards a neighbor.
+ *
+ * ifs: Pointer to the interface data structure.
+ * adj: Adjacency of the neighbor.
+ * sdu: The LINK SDU.
+ * sdu_len: Length of the SDU in words.
+ */
+static void send_link(struct ifs_data *ifs, const struct adjacency *adj, const uint32_t *sdu, size_t sdu_len) {
+    struct mip_hdr hdr = {
+        .dst = adj->mip,
+        .src = ifs->local_mip_addr,
+        .ttl = 1,
+        .sdu_len = sdu_len,
+        .sdu_type = SDU_TYPE_LINK
+    };
+
+    send_frame(ifs->rsock, adj, mip_pack_header(&hdr), sdu, sdu_len);
+}
+
+/**
+ * Send the parity frame of a block and close the block.
+ *
+ * ifs: Pointer to the interface data structure.
+ * block: Block being sent.
+ *
+ * The parity frame carries the number of frames in the block, so the receiver knows
+ * whether exactly one of them is missing. The parity is lost with the block if the
+ * neighbor is no longer resolved.
+ */
+static void send_parity(struct ifs_data *ifs, struct fec_block *block) {
+    uint32_t sdu[1 + MIP_MAX_SDU_WORDS];
+    const struct adjacency *adj = adj_lookup(block->neighbor);
+
+    block->valid = 0;
+    timer_cancel(&block->flush);
+    if (adj == NULL) {
+        return;
+    }
+
+    sdu[0] = ((uint32_t) LINK_FEC_PARITY << 24) | ((uint32_t) block->id << 8) | block->count;
+    memcpy(sdu + 1, block->parity, block->words * sizeof(uint32_t));
+
+    send_link(ifs, adj, sdu, 1 + block->words);
+}
+
+/**
+ * Send the parity of a block that has waited too long for more frames.
+ *
+ * arg: Block being sent.
+ *
+ * A frame at the end of a burst is not left without protection.
+ */
+static void flush_expired(void *arg) {
+    send_parity(tx_ifs, arg);
+}
+
+/**
+ * Find the block being sent to a neighbor, or start one.
+ *
+ * ifs: Pointer to the interface data structure.
+ * neighbor: MIP address of the neighbor.
+ * now: Current monotonic time in milliseconds.
+ *
+ * When the table is full, the oldest block is closed early to make room. A new block is
+ * closed by its timer after FEC_FLUSH ms if it has not filled up by then.
+ *
+ * Returns a pointer to the block.
+ */
+static struct fec_block *tx_lookup(struct ifs_data *ifs, uint8_t neighbor, uint64_t now) {
+    struct fec_block *victim = &tx_blocks[0];
+
+    for (int i = 0; i < FEC_MAX_PEERS; i++) {
+        struct fec_block *block = &tx_blocks[i];
+
+        if (block->valid && block->neighbor == neighbor) {
+            return block;
+        }
+        if (victim->valid && (!block->valid || block->started < victim->started)) {
+            victim = block;
+        }
+    }
+
+    if (victim->valid) {
+        send_parity(ifs, victim);
+    }
+
+    memset(victim->parity, 0, sizeof(victim->parity));
+    victim->valid = 1;
+    victim->neighbor = neighbor;
+    victim->id = next_id++;
+    victim->k = FEC_MAX_K;
+    victim->count = 0;
+    victim->words = 0;
+    victim->started = now;
+    timer_init(&victim->flush, flush_expired, victim);
+    timer_add(&victim->flush, FEC_FLUSH);
+    tx_ifs = ifs;
+
+    return victim;
+}
+
+/**
+ * Send a frame to a neighbor as part of a block.
+ *
+ * ifs: Pointer to the interface data structure.
+ * adj: Adjacency of the neighbor, see adj_lookup.
+ * pdu: Frame to send, the caller still owns it.
+ *
+ * The frame is wrapped in a LINK_FEC_DATA SDU that carries its MIP header, and added to the
+ * parity of the block towards the neighbor. Frames to destinations with different block
+ * sizes share the block, which closes at the smallest of their sizes. A frame too long to be
+ * wrapped is sent as it is.
+ */
+void fec_send(struct ifs_data *ifs, const struct adjacency *adj, const struct pdu *pdu) {
+    uint32_t sdu[FEC_HDR_WORDS + MIP_MAX_SDU_WORDS];
+    size_t sdu_len = pdu->miphdr->sdu_len;
+
+    if (sdu_len + FEC_HDR_WORDS > MIP_MAX_SDU_WORDS) {
+        send_frame(ifs->rsock, adj, mip_pack_header(pdu->miphdr), pdu->sdu, sdu_len);
+        return;
+    }
+
+    struct fec_block *block = tx_lookup(ifs, adj->mip, now_ms());
+    uint8_t k = configured_k[pdu->miphdr->dst];
+
+    if (k < block->k) {
+        block->k = k;
+    }
+
+    sdu[0] = ((uint32_t) LINK_FEC_DATA << 24) | ((uint32_t) block->id << 8) | block->count;
+    sdu[1] = ntohl(mip_pack_header(pdu->miphdr));
+    memcpy(sdu + FEC_HDR_WORDS, pdu->sdu, sdu_len * sizeof(uint32_t));
+
+    // The parity covers the MIP header too, a recovered frame needs its length and type
+    for (size_t i = 0; i < sdu_len + 1; i++) {
+        block->parity[i] ^= sdu[1 + i];
+    }
+    if (sdu_len + 1 > block->words) {
+        block->words = sdu_len + 1;
+    }
+    block->count++;
+
+    send_link(ifs, adj, sdu, sdu_len + FEC_HDR_WORDS);
+
+    if (block->count >= block->k) {
+        send_parity(ifs, block);
+    }
+}
+
+/**
+ * Find the block being received from a neighbor, or start one.
+ *
+ * neighbor: MIP address of the neighbor.
+ * id: Block ID of the frame just received.
+ * now: Current monotonic time in milliseconds.
+ *
+ * A neighbor sends one block at a time and a link does not reorder frames, so a new ID
+ * means the previous block is over, whatever is still missing from it. When the table is
+ * full, the neighbor heard from least recently loses its block.
+ *
+ * Returns a pointer to the block.
+ */
+static struct fec_block *rx_lookup(uint8_t neighbor, uint16_t id, uint64_t now) {
+    struct fec_block *block = NULL;
+
+    for (int i = 0; i < FEC_MAX_PEERS && block == NULL; i++) {
+        if (rx_blocks[i].valid && rx_blocks[i].neighbor == neighbor) {
+            block = &rx_blocks[i];
+        }
+    }
+    if (block != NULL && block->id == id) {
+        return block;
+    }
+
+    if (block == NULL) {
+        block = &rx_blocks[0];
+        for (int i = 0; i < FEC_MAX_PEERS; i++) {
+            if (block->valid && (!rx_blocks[i].valid || rx_blocks[i].started < block->started)) {
+                block = &rx_blocks[i];
+            }
+        }
+    }
+
+    memset(block->parity, 0, sizeof(block->parity));
+    block->valid = 1;
+    block->neighbor = neighbor;
+    block->id = id;
+    block->count = 0;
+    block->received = 0;
+    block->words = 0;
+    block->started = now;
+
+    return block;
+}
+
+/**
+ * Replace the LINK SDU of a PDU with the frame it carries.
+ *
+ * pdu: The received PDU.
+ * miphdr: MIP header of the carried frame, in host byte order.
+ * sdu: SDU of the carried frame.
+ * available: Words available at 'sdu'.
+ *
+ * Returns 1 if the PDU now holds the carried frame, or 0 if the header does not fit.
+ */
+static int unwrap(struct pdu *pdu, uint32_t miphdr, const uint32_t *sdu, size_t available) {
+    struct mip_hdr hdr;
+
+    mip_unpack_header(miphdr, &hdr);
+    if (hdr.sdu_len > available || hdr.sdu_type == SDU_TYPE_LINK) {
+        return 0;
+    }
+
+    memmove(pdu->sdu, sdu, hdr.sdu_len * sizeof(uint32_t));
+    *pdu->miphdr = hdr;
+
+    return 1;
+}
+
+/**
+ * Process a received SDU_TYPE_LINK PDU.
+ *
+ * pdu: The received PDU, its Ethernet header and interface stay those of the LINK frame.
+ * now: Current monotonic time in milliseconds.
+ *
+ * A LINK_FEC_DATA frame is added to the parity of its block and unwrapped. A parity frame
+ * that arrives with exactly one frame of its block missing is XORed with the frames that
+ * did arrive, which leaves the missing frame. Either way the PDU is rewritten in place to
+ * hold the carried frame, which the caller then handles as if it had been received as is.
+ *
+ * Returns 1 if the PDU holds a frame to handle, or 0 if there is nothing more to do.
+ */
+int fec_input(struct pdu *pdu, uint64_t now) {
+    uint32_t *sdu = pdu->sdu;
+    size_t sdu_len = pdu->miphdr->sdu_len;
+
+    if (sdu_len < FEC_HDR_WORDS) {
+        return 0;
+    }
+
+    uint8_t kind = sdu[0] >> 24;
+    uint16_t id = (sdu[0] >> 8) & 0xffff;
+    uint8_t index = sdu[0] & 0xff;
+    struct fec_block *block = rx_lookup(pdu->miphdr->src, id, now);
+
+    if (kind == LINK_FEC_DATA) {
+        if (index >= FEC_MAX_K || (block->received & (1 << index))) {
+            return 0;
+        }
+
+        for (size_t i = 0; i < sdu_len - 1; i++) {
+            block->parity[i] ^= sdu[1 + i];
+        }
+        if (sdu_len - 1 > block->words) {
+            block->words = sdu_len - 1;
+        }
+        block->received |= 1 << index;
+        block->count++;
+
+        return unwrap(pdu, sdu[1], sdu + FEC_HDR_WORDS, sdu_len - FEC_HDR_WORDS);
+    }
+
+    if (kind != LINK_FEC_PARITY) {
+        return 0;
+    }
+
+    // Nothing to recover if every frame arrived, nothing can be if two or more are missing
+    block->valid = 0;
+    if (block->count + 1 != index) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < sdu_len - 1; i++) {
+        block->parity[i] ^= sdu[1 + i];
+    }
+
+    if (debug_mode) {
+        printf("Recovered a lost frame of block %u from %u\n", id, pdu->miphdr->src);
+    }
+
+    return unwrap(pdu, block->parity[0], block->parity + 1, sdu_len - FEC_HDR_WORDS);
+}
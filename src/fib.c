@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "fib.h"
+#include "liveness.h"
+#include "utils.h"
+
+static struct fib_entry fib[FIB_SIZE];
+static uint32_t generation; // Bumped every time the routing daemon disconnects
+static uint32_t version;    // Bumped every time an entry changes, see fib_version
+static int syncing;         // 1 from the time a routing daemon connects until it has published its table
+
+
+/**
+ * Initialize the forwarding table.
+ *
+ * This function marks every entry as invalid, so the first packet to any destination
+ * has to ask the routing daemon.
+ */
+void fib_init(void) {
+    memset(fib, 0, sizeof(fib));
+    generation = 0;
+    syncing = 0;
+    version++;
+
+    for (int i = 0; i < FIB_SIZE; i++) {
+        fib[i].next_hop = FIB_NO_HOP;
+        fib[i].backup_hop = FIB_NO_HOP;
+    }
+}
+
+/**
+ * Store the next hops the routing daemon published for a destination.
+ *
+ * dst: Destination MIP address.
+ * next_hop: Primary next hop, FIB_NO_HOP if the destination is unreachable.
+ * backup_hop: Loop-free alternate next hop, FIB_NO_HOP if there is none.
+ *
+ * This is used both for route changes pushed by the routing daemon and for responses to
+ * requests. An unreachable answer is cached as a negative entry for FIB_NEGATIVE_TTL
+ * milliseconds, so packets to the destination are dropped without asking again. A restarted
+ * routing daemon answers FIB_NO_HOP for destinations it has not relearned yet. Such an answer
+ * does not replace a stale entry, the stale entry is kept until the routing daemon publishes
+ * a real route or signals that it has finished resynchronizing. Without a stale entry the
+ * answer is not cached either, the request stays outstanding until fib_end_sync.
+ */
+void fib_update(uint8_t dst, uint8_t next_hop, uint8_t backup_hop) {
+    struct fib_entry *entry = &fib[dst];
+
+    if (next_hop == FIB_NO_HOP && syncing && !fib_is_stale(dst)) {
+        return;
+    }
+
+    entry->requested = 0;
+
+    if (next_hop == FIB_NO_HOP && fib_is_stale(dst)) {
+        return;
+    }
+
+    entry->valid = 1;
+    entry->generation = generation;
+    entry->next_hop = next_hop;
+    entry->backup_hop = backup_hop;
+    entry->rerouted = 0;
+    entry->expires = next_hop == FIB_NO_HOP ? now_ms() + FIB_NEGATIVE_TTL : 0;
+    version++;
+}
+
+/**
+ * Remove the route to a destination.
+ *
+ * dst: Destination MIP address.
+ *
+ * This is called when the routing daemon withdraws a route. The next packet to the
+ * destination asks the routing daemon again.
+ */
+void fib_withdraw(uint8_t dst) {
+    struct fib_entry *entry = &fib[dst];
+
+    entry->valid = 0;
+    entry->rerouted = 0;
+    entry->requested = 0;
+    entry->next_hop = FIB_NO_HOP;
+    entry->backup_hop = FIB_NO_HOP;
+    version++;
+}
+
+/**
+ * Select the next hop to use for a destination.
+ *
+ * dst: Destination MIP address.
+ *
+ * The primary next hop is used unless the liveness protocol has declared it down while the
+ * backup is still up. In that case the backup is used right away, the routing daemon will
+ * publish the new primary once it has reconverged. Stale entries are still selected, so
+ * traffic keeps flowing while the routing daemon restarts.
+ *
+ * Returns the next hop to use, or FIB_NO_HOP if there is no usable entry for the destination.
+ */
+uint8_t fib_select(uint8_t dst) {
+    struct fib_entry *entry = &fib[dst];
+
+    if (!entry->valid) {
+        return FIB_NO_HOP;
+    }
+
+    if (liveness_enabled() && entry->next_hop != FIB_NO_HOP && !liveness_is_up(entry->next_hop)
+        && entry->backup_hop != FIB_NO_HOP && liveness_is_up(entry->backup_hop)) {
+        return entry->backup_hop;
+    }
+
+    return entry->next_hop;
+}
+
+/**
+ * Check if a destination is cached as unreachable.
+ *
+ * dst: Destination MIP address.
+ *
+ * A negative entry that has expired is removed, so the next packet to the destination
+ * asks the routing daemon again.
+ *
+ * Returns 1 if the routing daemon recently reported the destination unreachable, 0 otherwise.
+ */
+int fib_is_unreachable(uint8_t dst) {
+    struct fib_entry *entry = &fib[dst];
+
+    if (!entry->valid || entry->next_hop != FIB_NO_HOP) {
+        return 0;
+    }
+
+    if (now_ms() >= entry->expires) {
+        fib_withdraw(dst);
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Check if the entry for a destination was learned from an earlier routing daemon.
+ *
+ * dst: Destination MIP address.
+ *
+ * Returns 1 if the entry is valid and older than the current generation, 0 otherwise.
+ */
+int fib_is_stale(uint8_t dst) {
+    return fib[dst].valid && fib[dst].generation != generation;
+}
+
+/**
+ * Check if a request for a destination has to be sent to the routing daemon.
+ *
+ * dst: Destination MIP address.
+ *
+ * Requests are coalesced per destination. Only the first cold miss sends a request, packets
+ * arriving before the answer just wait for it.
+ *
+ * Returns 1 if the caller should send a request, 0 if one is already outstanding.
+ */
+int fib_need_request(uint8_t dst) {
+    if (fib[dst].requested) {
+        return 0;
+    }
+
+    fib[dst].requested = 1;
+    return 1;
+}
+
+/**
+ * Move every destination using a neighbor that went down to its backup next hop.
+ *
+ * neighbor: MIP address of the neighbor that went down.
+ *
+ * Moved entries are used by the forwarding path until the routing daemon publishes new
+ * next hops for them. Entries without a backup keep the dead primary until the routing
+ * daemon withdraws or changes the route.
+ *
+ * Returns the number of destinations that were moved to their backup.
+ */
+int fib_neighbor_down(uint8_t neighbor) {
+    int moved = 0;
+
+    for (int dst = 0; dst < FIB_SIZE; dst++) {
+        struct fib_entry *entry = &fib[dst];
+
+        if (entry->valid && entry->next_hop == neighbor && entry->backup_hop != FIB_NO_HOP) {
+            entry->next_hop = entry->backup_hop;
+            entry->backup_hop = FIB_NO_HOP;
+            entry->rerouted = 1;
+            moved++;
+        }
+    }
+    if (moved > 0) {
+        version++;
+    }
+
+    return moved;
+}
+
+/**
+ * Mark every entry as stale.
+ *
+ * This is called when the routing daemon disconnects. Bumping the generation makes every
+ * existing entry stale at once. Outstanding requests are forgotten, since the routing
+ * daemon that would have answered them is gone, and so is its synchronization.
+ *
+ * Returns the number of entries that are now stale.
+ */
+int fib_mark_stale(void) {
+    int marked = 0;
+
+    generation++;
+    syncing = 0;
+
+    for (int dst = 0; dst < FIB_SIZE; dst++) {
+        fib[dst].requested = 0;
+        if (fib[dst].valid) {
+            marked++;
+        }
+    }
+
+    return marked;
+}
+
+/**
+ * Start taking the routes of a routing daemon that just connected.
+ *
+ * Until fib_end_sync the routing daemon is still learning the network, so its FIB_NO_HOP
+ * answers are not final, see fib_update.
+ */
+void fib_begin_sync(void) {
+    syncing = 1;
+}
+
+/**
+ * Stop holding back FIB_NO_HOP answers, the routing daemon has published its full table.
+ *
+ * Requests that got a FIB_NO_HOP answer while the routing daemon was synchronizing are
+ * forgotten, so the packets still waiting for those destinations ask again.
+ *
+ * Returns the number of requests that were forgotten.
+ */
+int fib_end_sync(void) {
+    int forgotten = 0;
+
+    syncing = 0;
+
+    for (int dst = 0; dst < FIB_SIZE; dst++) {
+        if (fib[dst].requested) {
+            fib[dst].requested = 0;
+            forgotten++;
+        }
+    }
+
+    return forgotten;
+}
+
+/**
+ * Remove every entry that is still stale.
+ *
+ * This is called when a restarted routing daemon has published its full table. Any entry
+ * it did not refresh is no longer a valid route.
+ *
+ * Returns the number of entries that were removed.
+ */
+int fib_purge_stale(void) {
+    int purged = 0;
+
+    for (int dst = 0; dst < FIB_SIZE; dst++) {
+        if (fib_is_stale(dst)) {
+            fib_withdraw(dst);
+            purged++;
+        }
+    }
+
+    return purged;
+}
+
+/**
+ * Get the version of the forwarding table.
+ *
+ * The version changes whenever an entry is added, changed or removed, so a copy of what
+ * fib_select returns only has to be made again when it differs from the copy's version.
+ *
+ * Returns the version.
+ */
+uint32_t fib_version(void) {
+    return version;
+}
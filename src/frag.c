@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+
+#include "frag.h"
+#include "pdu.h"
+#include "mip.h"
+#include "fec.h"
+
+static struct frag_entry table[FRAG_TABLE_SIZE];
+static size_t max_sdu_words = MIP_MAX_SDU_WORDS; // Largest SDU that fits in one frame on every interface
+static uint16_t next_id;                         // ID of the next message we fragment
+
+
+/**
+ * Give up on a partial message that has waited too long for its missing fragments.
+ *
+ * arg: Reassembly entry of the message.
+ */
+static void frag_expired(void *arg) {
+    struct frag_entry *entry = arg;
+
+    if (debug_mode) {
+        printf("Reassembly of message %u from %u timed out, %u words received\n",
+               entry->id, entry->src, entry->received_words);
+    }
+    entry->valid = 0;
+}
+
+/**
+ * Free a reassembly entry.
+ *
+ * entry: The entry, complete or given up.
+ */
+static void frag_release(struct frag_entry *entry) {
+    entry->valid = 0;
+    timer_cancel(&entry->timer);
+}
+
+/**
+ * Initialize fragmentation and reassembly.
+ *
+ * ifs: Pointer to the interface data structure, the interfaces must already be known.
+ *
+ * This function forgets every partial message and sizes SDUs for the smallest MTU of the
+ * local interfaces, less the LINK header of FEC. A message is fragmented once by its source,
+ * so links further along the path are expected to have at least the same MTU.
+ */
+void frag_init(struct ifs_data *ifs) {
+    memset(table, 0, sizeof(table));
+    for (int i = 0; i < FRAG_TABLE_SIZE; i++) {
+        timer_init(&table[i].timer, frag_expired, &table[i]);
+    }
+    max_sdu_words = MIP_MAX_SDU_WORDS;
+
+    for (int interface = 0; interface < ifs->ifn; interface++) {
+        struct ifreq ifr;
+
+        memset(&ifr, 0, sizeof(ifr));
+        if (if_indextoname(ifs->addr[interface].sll_ifindex, ifr.ifr_name) == NULL ||
+            ioctl(ifs->rsock, SIOCGIFMTU, &ifr) == -1) {
+            perror("SIOCGIFMTU");
+            continue;
+        }
+
+        size_t words = (ifr.ifr_mtu - ETH_HDR_LEN - MIP_HDR_LEN) / 4;
+        if (ifr.ifr_mtu > (int) (ETH_HDR_LEN + MIP_HDR_LEN) && words < max_sdu_words) {
+            max_sdu_words = words;
+        }
+    }
+
+    // Leave room for the LINK header FEC puts in front of a protected frame
+    max_sdu_words = max_sdu_words > FEC_HDR_WORDS ? max_sdu_words - FEC_HDR_WORDS : 0;
+
+    // Every fragment must carry at least one word of payload
+    if (max_sdu_words <= FRAG_HDR_WORDS) {
+        max_sdu_words = FRAG_HDR_WORDS + 1;
+    }
+}
+
+/**
+ * Get the largest SDU that can be sent without fragmenting.
+ *
+ * Returns the size in 32-bit words.
+ */
+size_t frag_max_sdu_words(void) {
+    return max_sdu_words;
+}
+
+/**
+ * Get an ID for a new fragmented message.
+ *
+ * Returns the ID, which together with the source MIP address identifies the message.
+ */
+uint16_t frag_next_id(void) {
+    return next_id++;
+}
+
+/**
+ * Build one fragment of a message.
+ *
+ * sdu: Buffer to store the fragment in, at least frag_max_sdu_words() words long.
+ * msg: The whole message.
+ * msg_words: Length of the message in words.
+ * sdu_type: SDU type of the whole message.
+ * id: Message ID from frag_next_id.
+ * offset: Word offset in the message the fragment starts at.
+ *
+ * The first header word carries the message ID in the upper 16 bits, FRAG_MORE unless this
+ * is the last fragment, and the SDU type of the message in the lowest 3 bits. The second
+ * header word carries the offset. The caller sends a SDU_TYPE_FRAG PDU for every fragment,
+ * advancing the offset by the payload size until the whole message has been sent.
+ *
+ * Returns the size of the fragment in words, including the header.
+ */
+size_t frag_build(uint32_t *sdu, const uint32_t *msg, size_t msg_words, uint8_t sdu_type, uint16_t id, size_t offset) {
+    size_t payload = msg_words - offset;
+    uint32_t more = 0;
+
+    if (payload > max_sdu_words - FRAG_HDR_WORDS) {
+        payload = max_sdu_words - FRAG_HDR_WORDS;
+        more = FRAG_MORE;
+    }
+
+    sdu[0] = ((uint32_t) id << 16) | more | (sdu_type & 0x7);
+    sdu[1] = (uint32_t) offset;
+    memcpy(sdu + FRAG_HDR_WORDS, msg + offset, payload * sizeof(uint32_t));
+
+    return payload + FRAG_HDR_WORDS;
+}
+
+/**
+ * Find the reassembly entry of a message, or claim one for it.
+ *
+ * src: MIP address of the source.
+ * id: Message ID.
+ * now: Current monotonic time in milliseconds.
+ *
+ * When the table is full, the partial message closest to expiring is given up. A claimed
+ * entry is freed by its timer after FRAG_TIMEOUT if the message is not complete by then.
+ *
+ * Returns a pointer to the entry.
+ */
+static struct frag_entry *frag_lookup(uint8_t src, uint16_t id, uint64_t now) {
+    struct frag_entry *victim = &table[0];
+
+    for (int i = 0; i < FRAG_TABLE_SIZE; i++) {
+        struct frag_entry *entry = &table[i];
+
+        if (entry->valid && entry->src == src && entry->id == id) {
+            return entry;
+        }
+        if (victim->valid && (!entry->valid || entry->expires < victim->expires)) {
+            victim = entry;
+        }
+    }
+
+    if (victim->valid && debug_mode) {
+        printf("Reassembly table full, dropping message %u from %u\n", victim->id, victim->src);
+    }
+
+    victim->valid = 1;
+    victim->src = src;
+    victim->id = id;
+    victim->sdu_type = 0;
+    victim->total_words = 0;
+    victim->received_words = 0;
+    victim->expires = now + FRAG_TIMEOUT;
+    timer_add(&victim->timer, FRAG_TIMEOUT);
+    memset(victim->received, 0, sizeof(victim->received));
+
+    return victim;
+}
+
+/**
+ * Process a received fragment.
+ *
+ * src: MIP address of the source.
+ * sdu: SDU of the SDU_TYPE_FRAG PDU.
+ * sdu_len: Length of the SDU in words.
+ * now: Current monotonic time in milliseconds.
+ * sdu_type: Pointer to store the SDU type of a completed message.
+ * msg_words: Pointer to store the length of a completed message in words.
+ *
+ * Fragments may arrive in any order and more than once. A fragment that does not fit the
+ * message it claims to belong to drops the whole message.
+ *
+ * Returns a pointer to the message once the last missing fragment has arrived, and NULL
+ * otherwise. The message stays valid until the next call to this function.
+ */
+const uint32_t *frag_input(uint8_t src, const uint32_t *sdu, size_t sdu_len, uint64_t now,
+                           uint8_t *sdu_type, size_t *msg_words) {
+    if (sdu_len <= FRAG_HDR_WORDS) {
+        return NULL;
+    }
+
+    uint16_t id = sdu[0] >> 16;
+    uint8_t type = sdu[0] & 0x7;
+    int more = (sdu[0] & FRAG_MORE) != 0;
+    size_t offset = sdu[1];
+    size_t payload = sdu_len - FRAG_HDR_WORDS;
+
+    if (offset + payload > MIP_MAX_MSG_WORDS) {
+        return NULL;
+    }
+
+    struct frag_entry *entry = frag_lookup(src, id, now);
+
+    if (entry->sdu_type == 0) {
+        entry->sdu_type = type;
+    }
+
+    // The last fragment fixes the length, everything must agree with it
+    if (!more) {
+        if (entry->total_words != 0 && entry->total_words != offset + payload) {
+            frag_release(entry);
+            return NULL;
+        }
+        entry->total_words = offset + payload;
+    }
+    if (entry->sdu_type != type || (entry->total_words != 0 && offset + payload > entry->total_words)) {
+        frag_release(entry);
+        return NULL;
+    }
+
+    memcpy(entry->words + offset, sdu + FRAG_HDR_WORDS, payload * sizeof(uint32_t));
+    for (size_t word = offset; word < offset + payload; word++) {
+        if (!(entry->received[word / 8] & (1 << (word % 8)))) {
+            entry->received[word / 8] |= 1 << (word % 8);
+            entry->received_words++;
+        }
+    }
+
+    if (entry->total_words == 0 || entry->received_words != entry->total_words) {
+        return NULL;
+    }
+
+    // Complete, the slot can be reused while the caller still reads the message
+    frag_release(entry);
+    *sdu_type = entry->sdu_type;
+    *msg_words = entry->total_words;
+
+    return entry->words;
+}
@@ -9,6 +9,9 @@
 #include <arpa/inet.h>
 #include <pthread.h>
 #include <sys/un.h>      /* definitions for UNIX domain sockets */
+#include <sys/timerfd.h> /* timer file descriptors */
+
+#include "ring.h"
 
 
 #define MAX_CONNS 3
@@ -99,3 +102,137 @@ int add_to_epoll_table(int efd, int fd)
 
         return rc;
 }
+
+/**
+ * Create a periodic timer file descriptor.
+ * 
+ * interval_ms: Period of the timer in milliseconds.
+ * This function creates a non-blocking CLOCK_MONOTONIC timerfd that becomes readable 
+ * every interval_ms milliseconds, so timers can be driven from the same epoll loop as 
+ * the sockets. The first expiration happens one interval after creation.
+ * 
+ * Note: The owner must read the 8-byte expiration counter on every wakeup, otherwise 
+ * the descriptor stays readable.
+ * 
+ * Returns the timer descriptor on success, or -1 on failure.
+ */
+int create_timer_fd(long interval_ms)
+{
+        struct itimerspec its;
+        int fd;
+
+        fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (fd == -1) {
+                perror("timerfd_create");
+                return -1;
+        }
+
+        its.it_interval.tv_sec = interval_ms / 1000;
+        its.it_interval.tv_nsec = (interval_ms % 1000) * 1000000;
+        its.it_value = its.it_interval;
+
+        if (timerfd_settime(fd, 0, &its, NULL) == -1) {
+                perror("timerfd_settime");
+                close(fd);
+                return -1;
+        }
+
+        return fd;
+}
+
+/**
+ * Send file descriptors over a UNIX domain socket.
+ * 
+ * sd: Connected socket.
+ * fds: File descriptors to send.
+ * count: Number of file descriptors, at most RING_FDS.
+ * This function sends a one-byte message with the descriptors attached as SCM_RIGHTS 
+ * ancillary data. The receiver gets its own descriptors for the same open files, the 
+ * caller may close its copies afterwards.
+ * 
+ * Returns 0 on success, or -1 on failure.
+ */
+int send_fds(int sd, const int *fds, int count)
+{
+        char ctrl[CMSG_SPACE(RING_FDS * sizeof(int))];
+        uint8_t byte = 0;
+        struct iovec iov = { .iov_base = &byte, .iov_len = 1 };
+        struct msghdr msg;
+        struct cmsghdr *cmsg;
+
+        if (count < 1 || count > RING_FDS) {
+                return -1;
+        }
+
+        memset(&msg, 0, sizeof(msg));
+        memset(ctrl, 0, sizeof(ctrl));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = ctrl;
+        msg.msg_controllen = CMSG_SPACE(count * sizeof(int));
+
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(count * sizeof(int));
+        memcpy(CMSG_DATA(cmsg), fds, count * sizeof(int));
+
+        if (sendmsg(sd, &msg, 0) == -1) {
+                perror("sendmsg");
+                return -1;
+        }
+
+        return 0;
+}
+
+/**
+ * Receive file descriptors sent with send_fds.
+ * 
+ * sd: Connected socket.
+ * fds: Array to store the descriptors in.
+ * count: Number of descriptors expected, at most RING_FDS.
+ * This function blocks until the message arrives. A message with fewer descriptors than 
+ * expected is an error, any descriptors it carried are closed.
+ * 
+ * Returns 0 on success, or -1 on failure.
+ */
+int recv_fds(int sd, int *fds, int count)
+{
+        char ctrl[CMSG_SPACE(RING_FDS * sizeof(int))];
+        uint8_t byte;
+        struct iovec iov = { .iov_base = &byte, .iov_len = 1 };
+        struct msghdr msg;
+        struct cmsghdr *cmsg;
+        int received = 0;
+
+        if (count < 1 || count > RING_FDS) {
+                return -1;
+        }
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = ctrl;
+        msg.msg_controllen = sizeof(ctrl);
+
+        if (recvmsg(sd, &msg, MSG_CMSG_CLOEXEC) <= 0) {
+                perror("recvmsg");
+                return -1;
+        }
+
+        cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                received = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                memcpy(fds, CMSG_DATA(cmsg), (received < count ? received : count) * sizeof(int));
+        }
+
+        if (received != count) {
+                for (int i = 0; i < received && i < count; i++) {
+                        close(fds[i]);
+                }
+                fprintf(stderr, "Expected %d file descriptors, received %d\n", count, received);
+                return -1;
+        }
+
+        return 0;
+}
@@ -0,0 +1,374 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "libmip.h"
+#include "utils.h" // pdu.h and arp.h, for the constants shared with the daemon
+#include "pack.h"
+
+#define PREFIX_LEN 5 // "PING:" and "PONG:"
+#define UNREACHABLE_PREFIX "UNREACHABLE:"
+
+_Static_assert(MIP_ROLE_CLIENT == CLIENT && MIP_ROLE_SERVER == SERVER, "roles must match arp.h");
+_Static_assert(MIP_MSG_MAX == APP_MAX_MSG_LEN - PREFIX_LEN, "MIP_MSG_MAX must match pdu.h");
+
+static uint8_t *roles;   // Role of every open descriptor plus one, 0 if not opened by mip_open
+static int roles_len;    // Slots in 'roles'
+
+
+/**
+ * Connect to the MIP daemon.
+ *
+ * socket_path: Path of the UNIX socket of the daemon.
+ * role: MIP_ROLE_CLIENT or MIP_ROLE_SERVER.
+ * flags: 0 or MIP_NONBLOCK.
+ * local_addr: Pointer to store the MIP address of the daemon, only servers are told it, may
+ *             be NULL.
+ *
+ * The returned descriptor can be watched with poll or epoll like any socket, it is readable
+ * when a message is waiting. The handshake is done before MIP_NONBLOCK takes effect.
+ *
+ * Returns the descriptor on success, or -1 with errno set on error.
+ */
+int mip_open(const char *socket_path, int role, int flags, uint8_t *local_addr) {
+    struct sockaddr_un addr;
+    uint8_t registration[] = { 0x01, SDU_TYPE_PING, role };
+    uint8_t mip;
+
+    if (role != MIP_ROLE_CLIENT && role != MIP_ROLE_SERVER) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1 ||
+        write(fd, registration, sizeof(registration)) == -1) {
+        goto fail;
+    }
+
+    if (role == MIP_ROLE_SERVER) {
+        ssize_t rc = read(fd, &mip, 1);
+        if (rc != 1) {
+            if (rc == 0) {
+                errno = ECONNRESET;
+            }
+            goto fail;
+        }
+        if (local_addr != NULL) {
+            *local_addr = mip;
+        }
+    }
+
+    if ((flags & MIP_NONBLOCK) && fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1) {
+        goto fail;
+    }
+
+    if (fd >= roles_len) {
+        int new_len = fd + 16;
+        uint8_t *grown = realloc(roles, new_len);
+        if (grown == NULL) {
+            errno = ENOMEM;
+            goto fail;
+        }
+        memset(grown + roles_len, 0, new_len - roles_len);
+        roles = grown;
+        roles_len = new_len;
+    }
+    roles[fd] = role + 1;
+
+    return fd;
+
+fail:
+    {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+    }
+    return -1;
+}
+
+/**
+ * Close the connection to the MIP daemon.
+ *
+ * fd: Descriptor from mip_open.
+ *
+ * A server's unanswered requests are lost, their clients time out.
+ *
+ * Returns 0 on success, or -1 with errno set on error.
+ */
+int mip_close(int fd) {
+    if (fd >= 0 && fd < roles_len) {
+        roles[fd] = 0;
+    }
+    return close(fd);
+}
+
+/**
+ * Build the message the daemon expects from an application.
+ *
+ * fd: Descriptor from mip_open, tells the prefix.
+ * out: Buffer of at least APP_HDR_LEN + PREFIX_LEN + len bytes.
+ * buf: The message.
+ * len: Length of the message.
+ * dst: Destination MIP address.
+ * ttl: TTL.
+ *
+ * Returns the length of the built message, or -1 with errno set if the message is too long.
+ */
+static ssize_t build(int fd, uint8_t *out, const void *buf, size_t len, uint8_t dst, uint8_t ttl) {
+    int server = fd >= 0 && fd < roles_len && roles[fd] == MIP_ROLE_SERVER + 1;
+
+    if (len > MIP_MSG_MAX) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    out[0] = dst;
+    out[1] = ttl;
+    memcpy(out + APP_HDR_LEN, server ? "PONG:" : "PING:", PREFIX_LEN);
+    memcpy(out + APP_HDR_LEN + PREFIX_LEN, buf, len);
+
+    return APP_HDR_LEN + PREFIX_LEN + len;
+}
+
+/**
+ * Send a message.
+ *
+ * fd: Descriptor from mip_open.
+ * buf: The message, it must not contain NUL bytes.
+ * len: Length of the message, at most MIP_MSG_MAX bytes.
+ * dst: Destination MIP address.
+ * ttl: TTL, at most 15.
+ *
+ * A server's reply goes to the source of the oldest request it has not answered, with the
+ * TTL of that request, whatever 'dst' and 'ttl' say.
+ *
+ * Returns 'len' on success, or -1 with errno set on error.
+ */
+ssize_t mip_sendto(int fd, const void *buf, size_t len, uint8_t dst, uint8_t ttl) {
+    uint8_t out[APP_HDR_LEN + PREFIX_LEN + MIP_MSG_MAX];
+    ssize_t out_len = build(fd, out, buf, len, dst, ttl);
+
+    if (out_len == -1 || send(fd, out, out_len, 0) == -1) {
+        return -1;
+    }
+
+    return len;
+}
+
+/**
+ * Parse a message written by the daemon.
+ *
+ * words: The message after its header, a string packed by pack_string. Unpacked in place.
+ * words_len: Length of the message after its header in bytes.
+ * msg: Where the text goes, 'buf' and 'size' are read, 'len' and 'error' are set.
+ *
+ * The "PING:" or "PONG:" prefix is removed. "UNREACHABLE:<dst>" sets 'error' to
+ * EHOSTUNREACH. Text that does not fit in the buffer is cut.
+ */
+static void parse(uint32_t *words, size_t words_len, struct mip_mmsg *msg) {
+    size_t nwords = words_len / 4;
+    size_t len = nwords > 0 ? words[0] : 0;
+    char *text = (char *) (words + 1);
+
+    if (nwords == 0 || len > (nwords - 1) * 4) {
+        len = nwords > 0 ? (nwords - 1) * 4 : 0;
+    }
+    unpack_words((uint8_t *) text, words + 1, (len + 3) / 4);
+
+    msg->error = 0;
+    if (len >= strlen(UNREACHABLE_PREFIX) && memcmp(text, UNREACHABLE_PREFIX, strlen(UNREACHABLE_PREFIX)) == 0) {
+        msg->error = EHOSTUNREACH;
+        msg->len = 0;
+        return;
+    }
+    if (len >= PREFIX_LEN && (memcmp(text, "PING:", PREFIX_LEN) == 0 || memcmp(text, "PONG:", PREFIX_LEN) == 0)) {
+        text += PREFIX_LEN;
+        len -= PREFIX_LEN;
+    }
+
+    msg->len = len < msg->size ? len : msg->size;
+    memcpy(msg->buf, text, msg->len);
+}
+
+/**
+ * Receive a message.
+ *
+ * fd: Descriptor from mip_open.
+ * buf: Buffer to store the message in, it is not NUL terminated.
+ * size: Size of the buffer, a longer message is cut.
+ * src: Pointer to store the MIP address the message came from, may be NULL.
+ * ttl: Pointer to store the TTL the message arrived with, may be NULL.
+ *
+ * A client learns here that the daemon could not reach the destination of a request: the
+ * call fails with EHOSTUNREACH and 'src' holds the destination.
+ *
+ * Returns the length of the message, 0 if the daemon closed the connection, or -1 with
+ * errno set on error, EAGAIN if the descriptor is non-blocking and nothing is waiting.
+ */
+ssize_t mip_recvfrom(int fd, void *buf, size_t size, uint8_t *src, uint8_t *ttl) {
+    // The header sits in the last two bytes of the first word, so the SDU words are aligned
+    uint32_t in[1 + MIP_MAX_MSG_WORDS];
+    uint8_t *raw = (uint8_t *) in + sizeof(uint32_t) - APP_HDR_LEN;
+    struct mip_mmsg msg = { .buf = buf, .size = size };
+
+    ssize_t rc = recv(fd, raw, APP_HDR_LEN + MIP_MAX_MSG_LEN, 0);
+    if (rc <= 0) {
+        return rc;
+    }
+    if (rc < APP_HDR_LEN) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    parse(in + 1, rc - APP_HDR_LEN, &msg);
+    if (src != NULL) {
+        *src = raw[0];
+    }
+    if (ttl != NULL) {
+        *ttl = raw[1];
+    }
+    if (msg.error != 0) {
+        errno = msg.error;
+        return -1;
+    }
+
+    return msg.len;
+}
+
+/**
+ * Send a batch of messages with one system call.
+ *
+ * fd: Descriptor from mip_open.
+ * msgs: The messages, 'addr', 'ttl', 'buf' and 'len' are read.
+ * count: Number of messages, at most MIP_MMSG_MAX are sent.
+ *
+ * Returns the number of messages sent, which is less than 'count' if the socket filled up
+ * on a non-blocking descriptor, or -1 with errno set if none could be sent.
+ */
+int mip_sendmmsg(int fd, struct mip_mmsg *msgs, unsigned int count) {
+    struct mmsghdr hdrs[MIP_MMSG_MAX];
+    struct iovec iovs[MIP_MMSG_MAX];
+    size_t total = 0;
+
+    if (count > MIP_MMSG_MAX) {
+        count = MIP_MMSG_MAX;
+    }
+    for (unsigned int i = 0; i < count; i++) {
+        if (msgs[i].len > MIP_MSG_MAX) {
+            errno = EMSGSIZE;
+            return -1;
+        }
+        total += APP_HDR_LEN + PREFIX_LEN + msgs[i].len;
+    }
+
+    uint8_t *out = malloc(total > 0 ? total : 1);
+    if (out == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    uint8_t *pos = out;
+    for (unsigned int i = 0; i < count; i++) {
+        ssize_t len = build(fd, pos, msgs[i].buf, msgs[i].len, msgs[i].addr, msgs[i].ttl);
+
+        iovs[i].iov_base = pos;
+        iovs[i].iov_len = len;
+        memset(&hdrs[i], 0, sizeof(hdrs[i]));
+        hdrs[i].msg_hdr.msg_iov = &iovs[i];
+        hdrs[i].msg_hdr.msg_iovlen = 1;
+        pos += len;
+    }
+
+    int rc = sendmmsg(fd, hdrs, count, 0);
+    free(out);
+
+    return rc;
+}
+
+/**
+ * Receive a batch of messages with one system call.
+ *
+ * fd: Descriptor from mip_open.
+ * msgs: Where the messages go, 'buf' and 'size' are read, 'addr', 'ttl', 'len' and 'error'
+ *       are set, see mip_recvfrom.
+ * count: Number of messages wanted, at most MIP_MMSG_MAX are received.
+ *
+ * The call waits for the first message, unless the descriptor is non-blocking, and then
+ * takes what is already waiting. A message longer than its buffer is cut.
+ *
+ * Returns the number of messages received, 0 if the daemon closed the connection, or -1 with
+ * errno set on error.
+ */
+int mip_recvmmsg(int fd, struct mip_mmsg *msgs, unsigned int count) {
+    struct mmsghdr hdrs[MIP_MMSG_MAX];
+    struct iovec iovs[MIP_MMSG_MAX];
+    size_t slot_words[MIP_MMSG_MAX];
+    size_t total = 0;
+
+    if (count > MIP_MMSG_MAX) {
+        count = MIP_MMSG_MAX;
+    }
+    // Room for the header word, the length word and the text with the longest prefix
+    for (unsigned int i = 0; i < count; i++) {
+        size_t size = msgs[i].size < MIP_MSG_MAX ? msgs[i].size : MIP_MSG_MAX;
+        slot_words[i] = 2 + (size + strlen(UNREACHABLE_PREFIX) + 3) / 4;
+        total += slot_words[i];
+    }
+
+    uint32_t *in = malloc(total > 0 ? total * sizeof(uint32_t) : 1);
+    if (in == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    uint32_t *pos = in;
+    for (unsigned int i = 0; i < count; i++) {
+        iovs[i].iov_base = (uint8_t *) pos + sizeof(uint32_t) - APP_HDR_LEN;
+        iovs[i].iov_len = slot_words[i] * sizeof(uint32_t) - (sizeof(uint32_t) - APP_HDR_LEN);
+        memset(&hdrs[i], 0, sizeof(hdrs[i]));
+        hdrs[i].msg_hdr.msg_iov = &iovs[i];
+        hdrs[i].msg_hdr.msg_iovlen = 1;
+        pos += slot_words[i];
+    }
+
+    int rc = recvmmsg(fd, hdrs, count, MSG_WAITFORONE, NULL);
+
+    // A zero length message means the daemon is gone
+    if (rc > 0 && hdrs[0].msg_len == 0) {
+        rc = 0;
+    }
+
+    pos = in;
+    for (int i = 0; i < rc; i++) {
+        uint8_t *raw = iovs[i].iov_base;
+        size_t len = hdrs[i].msg_len;
+
+        if (len == 0) {
+            rc = i;
+            break;
+        }
+
+        msgs[i].addr = raw[0];
+        msgs[i].ttl = len > 1 ? raw[1] : 0;
+        parse(pos + 1, len > APP_HDR_LEN ? len - APP_HDR_LEN : 0, &msgs[i]);
+        pos += slot_words[i];
+    }
+
+    free(in);
+    return rc;
+}
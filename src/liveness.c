@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "liveness.h"
+#include "utils.h"
+#include "pdu.h"
+#include "mip.h"
+
+static struct liveness_session sessions[LIVENESS_MAX_NEIGHBORS];
+static uint32_t tx_interval;    // Local hello interval in ms, 0 when liveness is disabled
+static uint8_t  local_mult;     // Local detection multiplier
+static struct timer hello_timer; // Expires when the next hello is due
+static struct ifs_data *hello_ifs; // Interfaces the hellos are broadcast on
+static liveness_down_fn down_fn; // Told about neighbors that went down
+static void *down_ctx;          // Passed back to down_fn
+static uint32_t version;        // Bumped every time a neighbor goes up or down, see liveness_version
+
+
+/**
+ * Broadcast a hello and schedule the next one.
+ *
+ * arg: Unused.
+ */
+static void hello_expired(void *arg) {
+    send_liveness_hellos(hello_ifs);
+    timer_add(&hello_timer, tx_interval);
+}
+
+/**
+ * Declare a neighbor down that has been silent for its detection time.
+ *
+ * arg: Session of the neighbor.
+ */
+static void detect_expired(void *arg) {
+    struct liveness_session *session = arg;
+    uint8_t mip = session - sessions;
+    uint64_t detect_time = (uint64_t) session->remote_interval * session->remote_mult;
+
+    session->state = LIVENESS_DOWN;
+    version++;
+
+    printf("Neighbor %u down, no hello for %llu ms (detect time %llu ms)\n",
+           mip, (unsigned long long) (now_ms() - session->last_rx), (unsigned long long) detect_time);
+
+    down_fn(mip, down_ctx);
+}
+
+/**
+ * Initialize the liveness protocol.
+ *
+ * ifs: Pointer to the interface data structure, the hellos are broadcast on its interfaces.
+ * interval_ms: Interval in milliseconds between hellos, 0 disables liveness.
+ * detect_mult: Number of hello intervals without a hello before a neighbor is declared down.
+ * down: Called when a neighbor is declared down.
+ * ctx: Passed to 'down' unchanged.
+ *
+ * This function resets every session to LIVENESS_DOWN and starts sending hellos on the timer
+ * wheel, which must be set up already. Intervals below LIVENESS_MIN_INTERVAL are rounded up,
+ * since the daemon tick cannot resolve them.
+ */
+void liveness_init(struct ifs_data *ifs, uint32_t interval_ms, uint8_t detect_mult, liveness_down_fn down, void *ctx) {
+    memset(sessions, 0, sizeof(sessions));
+    for (int mip = 0; mip < LIVENESS_MAX_NEIGHBORS; mip++) {
+        timer_init(&sessions[mip].detect, detect_expired, &sessions[mip]);
+    }
+
+    if (interval_ms != 0 && interval_ms < LIVENESS_MIN_INTERVAL) {
+        interval_ms = LIVENESS_MIN_INTERVAL;
+    }
+
+    tx_interval = interval_ms;
+    local_mult = detect_mult ? detect_mult : LIVENESS_DEFAULT_MULT;
+    hello_ifs = ifs;
+    down_fn = down;
+    down_ctx = ctx;
+
+    timer_init(&hello_timer, hello_expired, NULL);
+    if (liveness_enabled()) {
+        timer_add(&hello_timer, 0);
+    }
+}
+
+/**
+ * Check if the liveness protocol is running.
+ *
+ * Returns 1 if a hello interval has been configured, 0 otherwise.
+ */
+int liveness_enabled(void) {
+    return tx_interval != 0;
+}
+
+/**
+ * Check if a neighbor is considered up by the liveness protocol.
+ *
+ * mip: MIP address of the neighbor.
+ *
+ * Returns 1 if liveness is enabled and the session to the neighbor is up, 0 otherwise.
+ */
+int liveness_is_up(uint8_t mip) {
+    return liveness_enabled() && sessions[mip].state == LIVENESS_UP;
+}
+
+/**
+ * Broadcast a liveness hello on every interface.
+ *
+ * ifs: Pointer to the interface data structure.
+ *
+ * The hello is a SDU_TYPE_CTRL SDU of LIVENESS_SDU_LEN words. The first word carries the
+ * CTRL_LIVENESS code and the local detection multiplier, the second word carries the local
+ * hello interval in milliseconds. A receiver uses both to compute its detection time for us,
+ * so the two ends do not need identical configuration.
+ */
+void send_liveness_hellos(struct ifs_data *ifs) {
+    uint32_t sdu[LIVENESS_SDU_LEN];
+
+    sdu[0] = ((uint32_t) CTRL_LIVENESS << 24) | ((uint32_t) local_mult << 8);
+    sdu[1] = tx_interval;
+
+    broadcast_PDU(ifs, SDU_TYPE_CTRL, sdu, LIVENESS_SDU_LEN);
+}
+
+/**
+ * Process a received liveness hello.
+ *
+ * mip: MIP address of the neighbor that sent the hello.
+ * interface: Index of the interface the hello was received on.
+ * sdu: Pointer to the SDU of the hello.
+ * sdu_len: Length of the SDU in 32-bit words.
+ * now: Current monotonic time in milliseconds.
+ *
+ * This function refreshes the session of the neighbor with the timers it advertises and
+ * restarts its detection timer, the neighbor is declared down when the timer expires. Hellos
+ * shorter than LIVENESS_SDU_LEN are ignored. An advertised interval below
+ * LIVENESS_MIN_INTERVAL is rounded up, a detection time of zero would take the session down
+ * between any two hellos.
+ *
+ * Returns 1 if the neighbor went from down to up, 0 otherwise.
+ */
+int liveness_rx(uint8_t mip, int interface, const uint32_t *sdu, size_t sdu_len, uint64_t now) {
+    if (!liveness_enabled() || sdu == NULL || sdu_len < LIVENESS_SDU_LEN) {
+        return 0;
+    }
+
+    struct liveness_session *session = &sessions[mip];
+
+    session->interface = interface;
+    session->remote_mult = (sdu[0] >> 8) & 0xff;
+    session->remote_interval = sdu[1];
+    session->last_rx = now;
+
+    if (session->remote_mult == 0) {
+        session->remote_mult = LIVENESS_DEFAULT_MULT;
+    }
+    if (session->remote_interval < LIVENESS_MIN_INTERVAL) {
+        session->remote_interval = LIVENESS_MIN_INTERVAL;
+    }
+    timer_add(&session->detect, (uint64_t) session->remote_interval * session->remote_mult);
+
+    if (session->state == LIVENESS_DOWN) {
+        session->state = LIVENESS_UP;
+        version++;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Get the version of the liveness sessions.
+ *
+ * The version changes whenever a neighbor goes up or down, which may change the next hop
+ * fib_select picks for a destination.
+ *
+ * Returns the version.
+ */
+uint32_t liveness_version(void) {
+    return version;
+}
@@ -8,6 +8,9 @@
 #include <net/ethernet.h>
 #include <arpa/inet.h>
 #include <pthread.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/signalfd.h>
 
 #include "arp.h"
 #include "ether.h"
@@ -16,10 +19,56 @@
 #include "mip.h"
 #include "ipc.h"
 #include "route.h"
-
-
-
-void parse_arguments(int argc, char *argv[], int *debug_mode, char **socket_upper, uint8_t *mip_addr);
+#include "liveness.h"
+#include "fib.h"
+#include "pack.h"
+#include "adj.h"
+#include "frag.h"
+#include "transport.h"
+#include "fec.h"
+#include "bundle.h"
+#include "apps.h"
+#include "ring.h"
+#include "txq.h"
+#include "ratelimit.h"
+#include "timer.h"
+#include "worker.h"
+#include "vector.h"
+
+#define TICK_INTERVAL 10 // Milliseconds between timer ticks, the resolution of the timer wheel
+
+// What sending a message needs, for the transport protocol and for PDUs that expired in a queue
+struct forward_ctx {
+    struct ifs_data *ifs;
+    struct queue_f *queue_forward;
+    int *route_fd;
+};
+
+// What the liveness protocol needs to report a neighbor that went down
+struct liveness_ctx {
+    struct ifs_data *ifs;
+    int *route_fd;
+};
+
+
+void parse_arguments(int argc, char *argv[], int *debug_mode, char **socket_upper, uint8_t *mip_addr,
+                     uint32_t *hello_interval, uint8_t *detect_mult, int *loss_percent, char **cc_name,
+                     uint32_t *bundle_delay, char **queue_spec, int *worker_threads);
+void forward_pdu(struct ifs_data *ifs, struct queue_f *queue_forward, int route_fd, struct pdu *pdu);
+void send_to_next_hop(struct ifs_data *ifs, struct pdu *packet, uint8_t next_hop);
+void flush_forward_queue(struct ifs_data *ifs, struct queue_f *queue_forward, int route_fd, uint8_t dst);
+void request_waiting_routes(struct ifs_data *ifs, struct queue_f *queue_forward, int route_fd);
+void drop_unreachable(struct ifs_data *ifs, struct queue_f *queue_forward, int route_fd, struct pdu *pdu);
+void send_message(struct ifs_data *ifs, struct queue_f *queue_forward, int route_fd, uint8_t dst, uint8_t ttl,
+                  uint8_t sdu_type, const uint32_t *msg, size_t msg_words);
+void transport_output_segment(void *ctx, uint8_t dst, const uint32_t *sdu, size_t sdu_len);
+void neighbor_down(uint8_t mip, void *ctx);
+void drop_expired(struct pdu *pdu, void *ctx);
+int drain_transport_ring(struct ring_end *ring);
+void arp_node(struct packet_vector *vec, void *ctx);
+void local_node(struct packet_vector *vec, void *ctx);
+void route_node(struct packet_vector *vec, void *ctx);
+void forward_node(struct packet_vector *vec, void *ctx);
 
 
 struct pdu_queue_slot queue[MAX_QUEUE_SIZE];
@@ -28,17 +77,32 @@ int main(int argc, char *argv[]) {
 
     // VARIABLES
     struct epoll_event events[MAX_EVENTS];
+    int event_count;   // Events epoll_wait returned, all handled before the next wait
     int epoll_fd;      // File descriptor for epoll instance
     int listening_fd;  // File descriptor for listening socket
     int raw_fd;        // File descriptor for RAW socket
-    int app_fd = -1;   // File descriptor for application socket
     int route_fd = -1; // File descriptor for routing daemon socket
+    int timer_fd;      // File descriptor for the periodic timer that drives the timer wheel
+    int transport_fd = -1;  // File descriptor for the transport application socket
+    int transport_paused = 0; // 1 while the transport application socket is not read
+    struct ring_end transport_ring = { .shm = NULL, .wait_fd = -1, .notify_fd = -1 }; // Shared memory of the transport application, if it asked for it
+    int bundle_fd = -1;       // File descriptor for the bundle flush timer, -1 while bundling is off
+    int txq_fd;               // File descriptor that is writable when queued frames can be sent
+    int signal_fd;            // File descriptor for SIGUSR1, which prints the queue and rate limit counters
+    int worker_fd = -1;       // File descriptor the forwarding threads wake the main thread with, -1 without threads
 
     int rc; // Return code
 
     // To be set by CLI
     char *socket_upper;        // UNIX socket path
     uint8_t local_mip_addr;    // MIP Adress
+    uint32_t hello_interval = 0;                 // Liveness hello interval in ms, 0 disables liveness
+    uint8_t detect_mult = LIVENESS_DEFAULT_MULT; // Missed liveness hellos before a neighbor is down
+    int loss_percent = 0;                        // Received frames dropped on purpose, emulates a lossy link
+    char *cc_name = NULL;                        // Transport congestion controller, NULL for the default
+    char *queue_spec = NULL;                     // Forward queue drop policy and limit, NULL for the default
+    uint32_t bundle_delay = 0;                   // Microseconds small frames wait to be bundled, 0 disables bundling
+    int worker_threads = 0;                      // Forwarding threads besides the main thread, 0 to forward on the main thread
 
     struct ping_data ping_data; // Struct for storing data from application
     // struct forward_data forward_data; // Struct for storing data to be forwarded while waiting for ARP reply
@@ -46,25 +110,27 @@ int main(int argc, char *argv[]) {
     struct queue_f queue_forward;
 
 
-    uint8_t mip_return = 0; // Used to store MIP adresses while talking to ping_server
-    uint8_t ttl_return;     // Used to store TTL while talking to ping_server
-
-    uint8_t broadcast_mac[6] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
-
-    uint8_t target_arp_mip_addr; // Used to store MIP address from SDU of ARP request
 
     struct ifs_data ifs; // Interface data
 
+    uint32_t sdu_buf[MIP_MAX_MSG_WORDS]; // Scratch buffer for packing outgoing messages
 
-    // Initialize arp table
-    arp_init();
+
+    // Initialize forwarding table
+    fib_init();
 
     // Initialize queues
     initialize_queue_arp();
     initialize_queue_forward(&queue_forward);
 
     // PARSE ARGUMENTS FROM CLI
-    parse_arguments(argc, argv, &debug_mode, &socket_upper, &local_mip_addr);
+    parse_arguments(argc, argv, &debug_mode, &socket_upper, &local_mip_addr, &hello_interval, &detect_mult, &loss_percent, &cc_name, &bundle_delay,
+                    &queue_spec, &worker_threads);
+    if (queue_spec != NULL && configure_queue_forward(&queue_forward, queue_spec) == -1) {
+        fprintf(stderr, "Unknown forward queue policy %s, use tail, head or red, optionally followed by :<limit>\n", queue_spec);
+        exit(EXIT_FAILURE);
+    }
+    srandom(getpid());
 
     // SET UP NETWORKING UTILITIES
     // Create epoll instance
@@ -74,6 +140,13 @@ int main(int argc, char *argv[]) {
             exit(EXIT_FAILURE);
     }
 
+    // Create the timer wheel, every timer of the daemon runs on its periodic timer
+    timer_fd = timer_wheel_init(TICK_INTERVAL);
+    if (timer_fd == -1) {
+        perror("timer_wheel_init");
+        exit(EXIT_FAILURE);
+    }
+
     // Create RAW socket for MIP traffic
     raw_fd = create_raw_socket();
     if (raw_fd == -1) {
@@ -84,6 +157,43 @@ int main(int argc, char *argv[]) {
     // Initialize interface data
     init_ifs(&ifs, raw_fd, local_mip_addr);
 
+    // Initialize adjacency table, this prebuilds the broadcast headers of every interface
+    adj_init(&ifs);
+
+    // Initialize neighbor liveness detection, neighbors that go down are reported right away
+    struct liveness_ctx liveness_ctx = { &ifs, &route_fd };
+    liveness_init(&ifs, hello_interval, detect_mult, neighbor_down, &liveness_ctx);
+
+    // Size fragments for the smallest interface MTU
+    frag_init(&ifs);
+
+    // Bundle small frames to the same neighbor into frames of the same size
+    if (bundle_delay > 0) {
+        bundle_fd = bundle_init(bundle_delay, frag_max_sdu_words());
+        if (bundle_fd == -1) {
+            perror("bundle_init");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Initialize the transport protocol, its segments go out like any other message
+    struct forward_ctx forward_ctx = { &ifs, &queue_forward, &route_fd };
+    transport_init(transport_output_segment, &forward_ctx);
+    if (cc_name != NULL && transport_set_cc(cc_name) == -1) {
+        fprintf(stderr, "Unknown congestion controller %s\n", cc_name);
+        exit(EXIT_FAILURE);
+    }
+
+    // PDUs that wait too long for a route or a next hop are dropped, and their senders told
+    set_pending_expired(drop_expired, &forward_ctx);
+
+    // Received frames go through the receive pipeline a vector at a time
+    vector_init(loss_percent);
+    vector_register(VECTOR_ARP, arp_node, &forward_ctx);
+    vector_register(VECTOR_LOCAL, local_node, &forward_ctx);
+    vector_register(VECTOR_ROUTE, route_node, &forward_ctx);
+    vector_register(VECTOR_FORWARD, forward_node, &forward_ctx);
+
     // Create UNIX listening socket for application traffic
     listening_fd = create_unix_sock(socket_upper);
     if (listening_fd == -1) {
@@ -97,6 +207,42 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
+    // Queue frames per interface and class once the RAW socket has no room for them
+    txq_fd = txq_init(epoll_fd, raw_fd);
+    if (txq_fd == -1) {
+        perror("txq_init");
+        exit(EXIT_FAILURE);
+    }
+
+    // Print the queue and rate limit counters on SIGUSR1, the signal is read from the epoll instance
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    if (sigprocmask(SIG_BLOCK, &signals, NULL) == -1) {
+        perror("sigprocmask");
+        exit(EXIT_FAILURE);
+    }
+    signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd == -1 || add_to_epoll_table(epoll_fd, signal_fd) == -1) {
+        perror("signalfd");
+        exit(EXIT_FAILURE);
+    }
+
+    // Receive on forwarding threads, which send transit frames on by themselves and hand 
+    // everything else to the main thread, so forwarding does not wait for the control plane. 
+    // Frames that are rate limited, bundled or dropped on purpose are all handled by the main 
+    // thread
+    if (worker_threads > 0) {
+        int fast_path = loss_percent == 0 && bundle_delay == 0 && !ratelimit_frames_limited();
+
+        worker_fd = worker_start(&ifs, worker_threads, fast_path);
+        if (worker_fd == -1 || add_to_epoll_table(epoll_fd, worker_fd) == -1) {
+            perror("worker_start");
+            exit(EXIT_FAILURE);
+        }
+        printf("%d forwarding threads%s\n\n", worker_threads, fast_path ? "" : ", every frame is handled by the main thread");
+    }
+
     // Add UNIX listening socket to epoll instance
     rc = add_to_epoll_table(epoll_fd, listening_fd);
     if (rc == -1) {
@@ -104,543 +250,1122 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
+    // Add timer to epoll instance
+    rc = add_to_epoll_table(epoll_fd, timer_fd);
+    if (rc == -1) {
+        perror("add_to_epoll_table");
+        exit(EXIT_FAILURE);
+    }
+
+    // Add bundle flush timer to epoll instance
+    if (bundle_fd != -1 && add_to_epoll_table(epoll_fd, bundle_fd) == -1) {
+        perror("add_to_epoll_table");
+        exit(EXIT_FAILURE);
+    }
+
 
     // MAIN LOOP FOR HANDLING TRAFFIC FROM APPLICATIONS AND MIP
     while(1) {
 
-        // Wait for incoming events
-        rc = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
-        if (rc == -1) {
+        // Stop reading from the transport application while a send window is full. The socket 
+        // leaves the epoll instance, since a hangup would still be reported with no events set
+        if (transport_fd != -1 && transport_ring.shm == NULL && transport_window_full() != transport_paused) {
+            transport_paused = !transport_paused;
+            if (transport_paused) {
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, transport_fd, NULL);
+            } else {
+                add_to_epoll_table(epoll_fd, transport_fd);
+            }
+        }
+
+        // A transport application with shared memory is read on every iteration, the socket 
+        // only tells when it goes away. What it wrote before it went away is still sent, as 
+        // with a socket, and the ring is closed once it is empty
+        if (transport_ring.shm != NULL && drain_transport_ring(&transport_ring) && transport_fd == -1) {
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, transport_ring.wait_fd, NULL);
+            ring_close(&transport_ring);
+        }
+
+        // The forwarding threads send on by the next hops the main thread last published
+        worker_sync();
+
+        // The frames of a received bundle, the frames the forwarding threads handed over and 
+        // the frames the receive pipeline left for its next run are handled, like frames read 
+        // from the RAW socket, before anything new is waited for
+        int pending = bundle_pending() || worker_pending() || vector_pending();
+
+        // Wait for incoming events, or only look for them while frames are pending so they 
+        // are not held back by a long run of frames. There is always room for the RAW socket
+        event_count = epoll_wait(epoll_fd, events, MAX_EVENTS - 1, pending ? 0 : -1);
+        if (event_count == -1) {
             perror("epoll_wait");
             exit(EXIT_FAILURE);
         }
-
-        // Add new application connection to epoll instance
-        if (events->data.fd == listening_fd) {
-            
-            // Accept new connection
-            int unix_fd = accept(listening_fd, NULL, NULL);
-            if (unix_fd == -1) {
-                perror("accept");
-                exit(EXIT_FAILURE);
+        if (pending) {
+            int raw_ready = 0;
+            for (int e = 0; e < event_count; e++) {
+                raw_ready |= events[e].data.fd == raw_fd;
             }
-            
-            // Read identifier from socket to determine type of application
-            uint8_t indentifier;
-            rc = read(unix_fd, &indentifier, 1);
-            if (rc == -1) {
-                perror("read");
-                exit(EXIT_FAILURE);
+            if (!raw_ready) {
+                events[event_count++].data.fd = raw_fd;
             }
+        }
 
-            // Ping client/server connected
-            if (indentifier == 0x01 && app_fd == -1) {
+        for (int e = 0; e < event_count; e++) {
+            int event_fd = events[e].data.fd;
 
-                app_fd = unix_fd;
-                rc = add_to_epoll_table(epoll_fd, app_fd);
-                if (rc == -1) {
-                    perror("add_to_epoll_table");
+            // Add new application connection to epoll instance
+            if (event_fd == listening_fd) {
+            
+                // Accept new connection
+                int unix_fd = accept(listening_fd, NULL, NULL);
+                if (unix_fd == -1) {
+                    perror("accept");
                     exit(EXIT_FAILURE);
                 }
+            
+                // Read identifier from socket to determine type of application, ping applications 
+                // also register for a SDU type and a role
+                uint8_t registration[APP_REGISTER_LEN];
+                rc = read(unix_fd, registration, sizeof(registration));
+                if (rc <= 0) {
+                    perror("read");
+                    close(unix_fd);
+                    continue;
+                }
+                uint8_t indentifier = registration[0];
+                int registration_len = rc;
 
-                printf("Ping/pong client connected\n\n"); //TODO: Remove
+                // Ping client/server connected, any number of them
+                if (indentifier == APP_ID_PING) {
 
-            // Routing daemon connected
-            } else if (indentifier == 0x02 && route_fd == -1) {
+                    if (apps_register(unix_fd, registration, registration_len) == -1 || add_to_epoll_table(epoll_fd, unix_fd) == -1) {
+                        printf("Invalid ping application registration\n\n");
+                        apps_unregister(unix_fd);
+                        close(unix_fd);
+                        continue;
+                    }
 
-                route_fd = unix_fd;
-                rc = add_to_epoll_table(epoll_fd, route_fd);
-                if (rc == -1) {
-                    perror("add_to_epoll_table");
-                    exit(EXIT_FAILURE);
-                }
+                    // A server is told the local MIP address, like the routing daemon
+                    if (apps_lookup(unix_fd)->role == SERVER && write(unix_fd, &local_mip_addr, 1) == -1) {
+                        perror("write");
+                    }
 
-                // Send local MIP address to routing daemon
-                rc = write(route_fd, &local_mip_addr, 1);
-                if (rc == -1) {
-                    perror("write");
-                    exit(EXIT_FAILURE);
-                }
+                    if (debug_mode) {
+                        printf("Ping %s connected on %d\n\n", apps_lookup(unix_fd)->role == SERVER ? "server" : "client", unix_fd);
+                    }
 
-                printf("Routing daemon connected\n\n"); //TODO: Remove
-            
-            } else {
-                printf("Unknown application connected\n\n"); //TODO: Remove
-            }
+                // Routing daemon connected
+                } else if (indentifier == APP_ID_ROUTING && route_fd == -1) {
 
+                    route_fd = unix_fd;
+                    rc = add_to_epoll_table(epoll_fd, route_fd);
+                    if (rc == -1) {
+                        perror("add_to_epoll_table");
+                        exit(EXIT_FAILURE);
+                    }
 
+                    // Send local MIP address to routing daemon
+                    rc = write(route_fd, &local_mip_addr, 1);
+                    if (rc == -1) {
+                        perror("write");
+                        exit(EXIT_FAILURE);
+                    }
 
-        // INCOMING MIP TRAFFIC
-        } else if (events->data.fd == raw_fd) {
+                    printf("Routing daemon connected\n\n"); //TODO: Remove
 
-            // Allocate memory for PDU struct
-            struct pdu *pdu = alloc_pdu();
+                    // Its "no route" answers are not final until it has published its table
+                    fib_begin_sync();
 
-            // Index of recieving ethernet interface, this is used when sending ARP replies 
-            int recv_interface;
+                    // Packets queued while no routing daemon was connected still need a next hop
+                    request_waiting_routes(&ifs, &queue_forward, route_fd);
+            
+                // Transport application connected
+                } else if (indentifier == APP_ID_TRANSPORT && transport_fd == -1 && transport_ring.shm == NULL) {
+
+                    transport_fd = unix_fd;
+                    rc = add_to_epoll_table(epoll_fd, transport_fd);
+                    if (rc == -1) {
+                        perror("add_to_epoll_table");
+                        exit(EXIT_FAILURE);
+                    }
+                    transport_paused = 0;
+                    transport_set_app(transport_fd);
+
+                    // The application asked to exchange messages through shared memory, it gets 
+                    // the memory and the eventfds over the socket
+                    if (registration_len >= 2 && registration[1] == TRANSPORT_APP_RING) {
+                        int app_fds[RING_FDS];
+
+                        if (ring_create(&transport_ring, app_fds) == -1) {
+                            printf("No shared memory for the transport application\n");
+                        } else if (send_fds(transport_fd, app_fds, RING_FDS) == -1 ||
+                                   add_to_epoll_table(epoll_fd, transport_ring.wait_fd) == -1) {
+                            close(app_fds[0]);
+                            ring_close(&transport_ring);
+                        } else {
+                            close(app_fds[0]);
+                            transport_set_app_ring(&transport_ring);
+                        }
+                    }
 
-            // Handle incoming MIP packet and determine type of packet
-            MIP_handle type = handle_mip_packet(&ifs, pdu, &recv_interface);
+                    printf("Transport application connected%s\n\n", transport_ring.shm != NULL ? " with shared memory" : "");
 
+                } else {
+                    printf("Unknown application connected\n\n"); //TODO: Remove
+                    close(unix_fd);
+                }
 
-            // FORWARD PACKET IF NOT FOR US
-            if (pdu->miphdr->dst != local_mip_addr && pdu->miphdr->dst != 255){
-                if (debug_mode){
 
-                    printf("Packet not for us, forwarding..\n");
-                }
-                
-                //Add to queue
-                printf("Adding to queue\n");
-                enqueue_forward(&queue_forward, pdu);
 
-                // Get next hop MIP address from routing table, we will send the packet if we find a next hop
-                printf("Finding next hop\n");
-                sendRequestToApp(route_fd, pdu->miphdr->dst, local_mip_addr); // TODO::
+            // INCOMING MIP TRAFFIC
+            } else if (event_fd == raw_fd) {
 
+                // Up to VECTOR_SIZE frames at a time, every node of the pipeline handles all of its 
+                // frames before the next one runs, see arp_node, local_node, route_node and forward_node
+                vector_run(&ifs);
 
-            // ACCEPT PACKET IF FOR US
-            } else {
-                if (debug_mode){
-                    printf("Packet for us!\n");
+            // INCOMING APPLICATION TRAFFIC
+            } else if (apps_lookup(event_fd) != NULL){
+                int app_fd = event_fd;
+                uint32_t drops = queue_forward_drops(&queue_forward); // Drops before this message
+
+                // A message over the rate of the application is dropped unread
+                if (!apps_admit(app_fd, now_ms())) {
+                    continue;
                 }
 
+                printf("Received APP msg\n"); // TODO: Remove
+                // Handle incoming application message and determine type of message
+                APP_handle type = handle_app_message(app_fd, &ping_data.dst_mip_addr, ping_data.msg, &ping_data.ttl);
+
                 switch (type){
+                
 
-                    // RECIEVED MIP PING FROM OTHER MIP DAEMON
-                    case MIP_PING: {
+                    // RECIEVED MESSAGE FROM PING_CLIENT
+                    case APP_PING: {
                         if (debug_mode){
-                            printf("\nReceived MIP_PING\n");
-                            print_pdu_content(pdu);
-                            printf("\n");
+                            printf("\nReceived APP_PING\n");
+                            printf("Content: %s\n", ping_data.msg);
                         }
 
-                        // Write SDU to ping_server
-                        rc = write(app_fd, pdu->sdu, pdu->miphdr->sdu_len*sizeof(uint32_t));
-                        if (rc == -1) {
-                            perror("write");
-                            exit(EXIT_FAILURE);
-                        }
 
-                        // Store MIP address and TTL for return packet
-                        mip_return = pdu->miphdr->src;
-                        ttl_return = pdu->miphdr->ttl;
+                        
+                        // Create SDU
+                        size_t sdu_len = pack_string(sdu_buf, MIP_MAX_MSG_WORDS, ping_data.msg);
+
+                        // The PONG is matched to this client when it arrives
+                        apps_ping_sent(app_fd, ping_data.dst_mip_addr, ping_data.msg);
 
+                        // Send as one PDU, or as fragments if it does not fit in one frame
+                        send_message(&ifs, &queue_forward, route_fd, ping_data.dst_mip_addr, ping_data.ttl,
+                                     SDU_TYPE_PING, sdu_buf, sdu_len);
+
+                        // Stop reading from the client while its messages do not fit in the forward queue,
+                        // or the links cannot keep up with them
+                        if (queue_forward_drops(&queue_forward) != drops || queue_forward_fill(&queue_forward, ping_data.dst_mip_addr) >= 100 ||
+                            txq_fill() >= APP_TXQ_FILL) {
+                            apps_throttle(epoll_fd, app_fd, ping_data.dst_mip_addr);
+                        }
+                    
                         break;
                     }
-                    // RECIEVED MIP PONG FROM OTHER MIP DAEMON
-                    case MIP_PONG: {
+
+                    // RECIEVED MESSAGE FROM PING_SERVER
+                    case APP_PONG: {
                         if (debug_mode){
-                            printf("\nReceived MIP_PONG\n");
-                            print_pdu_content(pdu);
-                            printf("\n");
+                            printf("Received APP_PONG\n");
                         }
 
-                        // Write SDU to ping_server
-                        rc = write(app_fd, pdu->sdu, pdu->miphdr->sdu_len*sizeof(uint32_t));
-                        if (rc == -1) {
-                            perror("write");
-                            exit(EXIT_FAILURE);
+                        // The server answers its PINGs in order, the oldest one is answered now
+                        uint8_t mip_return, ttl_return;
+                        if (apps_reply_to(app_fd, &mip_return, &ttl_return) == -1) {
+                            if (debug_mode) {
+                                printf("PONG without a PING, dropping it\n");
+                            }
+                            break;
                         }
 
+                        // Create SDU
+                        size_t sdu_len = pack_string(sdu_buf, MIP_MAX_MSG_WORDS, ping_data.msg);
+
+                        // Send as one PDU, or as fragments if it does not fit in one frame
+                        send_message(&ifs, &queue_forward, route_fd, mip_return, ttl_return,
+                                     SDU_TYPE_PING, sdu_buf, sdu_len);
+
+                        // Stop reading from the server while its messages do not fit in the forward queue,
+                        // or the links cannot keep up with them
+                        if (queue_forward_drops(&queue_forward) != drops || queue_forward_fill(&queue_forward, mip_return) >= 100 ||
+                            txq_fill() >= APP_TXQ_FILL) {
+                            apps_throttle(epoll_fd, app_fd, mip_return);
+                        }
+
+                        break;
+                    }
+
 
-                        // We are done with the ping_client, close the connection
+                    // APPLICATION CLOSED THE CONNECTION
+                    case APP_DISCONNECT: {
+                        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, app_fd, NULL);
+                        apps_unregister(app_fd);
                         close(app_fd);
 
+                        printf("Ping/pong client disconnected\n");
                         break;
                     }
 
-                    // RECIEVED MIP ARP REQUEST FROM OTHER MIP DAEMON
-                    case MIP_ARP_REQUEST: {
+                    default: {
                         if (debug_mode){
-                            printf("\nReceived MIP_ARP_REQUEST\n");
-                            print_pdu_content(pdu);
-                            printf("\n");
+                            printf("Received unknown APP message\n");
                         }
 
-                        // Get target MIP address from SDU of ARP request
-                        decode_sdu_miparp(pdu->sdu, &target_arp_mip_addr);
 
-                        // Check if ARP request is for this MIP daemon by comparing target MIP address with local MIP address
-                        if (target_arp_mip_addr == ifs.local_mip_addr) {
-                            if (debug_mode){
-                                printf("ARP request for us\n");
-                            }
+                    
+                        break;
+                    }
+                }
 
-                            // Create SDU for ARP reply containing matching MIP address
-                            uint32_t *sdu = create_sdu_miparp(ARP_TYPE_REPLY, ifs.local_mip_addr);
+            // TRANSPORT APPLICATION MADE ROOM IN ITS RING, OR WROTE TO AN EMPTY ONE
+            } else if (transport_ring.shm != NULL && event_fd == transport_ring.wait_fd) {
 
-                            // Update ARP table
-                            arp_insert(pdu->miphdr->src, pdu->ethhdr->src_mac, recv_interface);
+                // New messages are read at the top of the loop, deliveries that did not fit are retried here
+                ring_clear(&transport_ring);
+                transport_resume();
 
-                            // Send ARP reply
-                            if (debug_mode){
-                                printf("Sending MIP_ARP_REPLY to MIP: %u\n", pdu->miphdr->src);
-                            }
+            // INCOMING TRANSPORT APPLICATION TRAFFIC
+            } else if (event_fd == transport_fd) {
+
+                // Peer MIP address and port, then one message
+                uint8_t buf[TRANSPORT_APP_HDR_LEN + TRANSPORT_MSS + 1];
 
-                            // Create PDU for ARP reply
-                            struct pdu* packet = create_PDU(ifs.local_mip_addr, pdu->miphdr->src, 0, SDU_TYPE_MIPARP, sdu, 4);
+                rc = read(transport_fd, buf, sizeof(buf));
+                if (rc == 0 || (rc < 0 && errno == ECONNRESET)) {
+                    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, transport_fd, NULL);
+                    close(transport_fd);
+                    transport_fd = -1;
+                    transport_set_app(-1);
 
-                            // Set source MAC address by looking up the interface that recieved the ARP request
-                            uint8_t *src_mac_addr = ifs.addr[recv_interface].sll_addr;
+                    printf("Transport application disconnected\n");
+                } else if (rc < TRANSPORT_APP_HDR_LEN ||
+                           transport_send(buf[0], buf[1], buf + TRANSPORT_APP_HDR_LEN, rc - TRANSPORT_APP_HDR_LEN, now_ms()) == -1) {
+                    if (debug_mode) {
+                        printf("Dropping transport message of %d bytes\n", rc);
+                    }
+                }
 
-                            // Set destination MAC address
-                            uint8_t *dst_mac_addr = arp_lookup(pdu->miphdr->src);
+            // INCOMING ROUTING DAEMON TRAFFIC
+            } else if (event_fd == route_fd){
+                printf("Received ROUTE\n");
+                // print message
 
-                            fill_ethhdr(packet, src_mac_addr, dst_mac_addr);
+                uint8_t msg[1024];
 
-                            send_PDU(&ifs, packet, find_matching_sockaddr(&ifs, dst_mac_addr));
+                // Clear buffer
+                memset(msg, 0, sizeof(msg));
+
+
+                ROUTE_handle type = handle_route_message(route_fd, msg, sizeof(msg));
+                uint8_t recieved_mip = msg[0];
+                printf("recieved_mip: %u\n", recieved_mip);
+
+                switch (type)
+                {
+                    case ROUTE_HELLO: {
+                        printf("Received ROUTE_HELLO\n");
+                    
+
+                        // Create SDU
+                        size_t sdu_len = pack_words(sdu_buf, msg, 5);
+
+                        // Broadcast PDU, one copy per interface
+                        broadcast_PDU(&ifs, SDU_TYPE_ROUTE, sdu_buf, sdu_len);
 
 
-                            // If ARP request is not for this MIP daemon, throw packet away
-                        } else {
-                            if (debug_mode){
-                                printf("ARP request not for us\n");
-                            }
-                        }
                         break;
                     }
-                    // RECIEVED MIP ARP REPLY FROM OTHER MIP DAEMON
-                    case MIP_ARP_REPLY: {
-                        if (debug_mode){
-                            printf("\nReceived MIP_ARP_REPLY\n");
-                            print_pdu_content(pdu);
-                            printf("\n");
-                        }
 
+                    case ROUTE_UPDATE: {
+                        printf("Received ROUTE_UPDATE\n");
 
-                        // Update ARP table
-                        arp_insert(pdu->miphdr->src, pdu->ethhdr->src_mac, recv_interface);
-                        
-                        // Check if packet is waiting to be forwarded
-                        struct pdu_with_hop result = remove_packet_by_mac(pdu->ethhdr->src_mac);
 
 
-                        if (result.packet != NULL) {
-                            // Packet with the specified MAC address was found
-                            struct pdu* packet = result.packet;
-                            uint8_t next_hop = result.next_hop;
+                        // Create SDU
+                        size_t sdu_len = pack_words(sdu_buf, msg, 3 * MAX_NODES + 5);
 
-                            // Process the packet and use the next_hop information
-                            if (packet != NULL){
-
-                                // Get source MAC address by looking up the interface that recieved the ARP request
-                                uint8_t *src_mac_addr = ifs.addr[recv_interface].sll_addr;
+                        // Broadcast PDU, one copy per interface
+                        broadcast_PDU(&ifs, SDU_TYPE_ROUTE, sdu_buf, sdu_len);
+                        break;
+                    }
 
-                                // Get destination MAC
-                                uint8_t *dst_mac_addr = arp_lookup(next_hop);
+                    case ROUTE_RESPONSE: {
+                        printf("Received ROUTE_RESPONSE\n");
 
-                                // Set source and destination MAC address
-                                fill_ethhdr(packet, src_mac_addr, dst_mac_addr);
+                        uint8_t next_hop = msg[5];
+                        uint8_t backup_hop = msg[6];
+                        uint8_t destination = msg[7];
 
-                                // Send packet
-                                send_PDU(&ifs, packet, find_matching_sockaddr(&ifs, dst_mac_addr));
+                        // Remember both next hops, so we can fail over without asking again
+                        fib_update(destination, next_hop, backup_hop);
 
-                            }
-                            // Free the pdu after processing, if necessary
-                            destroy_pdu(packet);
-                        } else {
-                            // No packet with the specified MAC address was found
-                            // Do nothing
-                            printf("No packet with the specified MAC address was found\n");
+                        // Send every packet that was waiting for this destination
+                        flush_forward_queue(&ifs, &queue_forward, route_fd, destination);
+                        break;
+                    }
+                    // Restarted routing daemon asking its neighbors for a full update
+                    case ROUTE_SYNC_REQUEST: {
+                        if (debug_mode) {
+                            printf("Received ROUTE_SYNC_REQUEST\n");
                         }
 
+                        // Create SDU
+                        size_t sdu_len = pack_words(sdu_buf, msg, 5);
+
+                        // Broadcast PDU, one copy per interface
+                        broadcast_PDU(&ifs, SDU_TYPE_ROUTE, sdu_buf, sdu_len);
                         break;
                     }
 
-                    // RECIEVED MIP ROUTE HELLO FROM OTHER MIP DAEMON
-                    case MIP_ROUTE: {
-                        if (debug_mode){
-                            printf("\nReceived MIP_ROUTE\n");
-                            print_pdu_content(pdu);
-                            printf("\n");
+                    // Route added or changed, also used by a restarted routing daemon to republish
+                    case ROUTE_CHANGE: {
+                        if (debug_mode) {
+                            printf("Received ROUTE_CHANGE\n");
                         }
+                        fib_update(msg[5], msg[6], msg[7]);
+                        flush_forward_queue(&ifs, &queue_forward, route_fd, msg[5]);
+                        break;
+                    }
 
-
-                        size_t input_size = pdu->miphdr->sdu_len;
-                        size_t output_size = input_size * 4;
-
-                        uint8_t *msg = (uint8_t *)malloc(output_size * sizeof(uint8_t));
-                        if (msg == NULL) {
-                            // Handle memory allocation error
-                            return 1;
+                    // Route removed, the next packet to the destination asks again
+                    case ROUTE_WITHDRAW: {
+                        if (debug_mode) {
+                            printf("Received ROUTE_WITHDRAW\n");
                         }
+                        fib_withdraw(msg[5]);
+                        break;
+                    }
 
-                        uint32_to_uint8(pdu->sdu, input_size, msg);
+                    // Restarted routing daemon has republished all of its routes
+                    case ROUTE_END_OF_RIB: {
+                        int purged = fib_purge_stale();
+                        printf("Routing daemon resynchronized, %d stale routes purged\n", purged);
 
-                        // Write SDU to routing daemon
-                        rc = write(route_fd, msg, output_size);
+                        // Packets held back by a "no route" answer during the synchronization ask 
+                        // again, the answer is final now
+                        if (fib_end_sync() > 0) {
+                            request_waiting_routes(&ifs, &queue_forward, route_fd);
+                        }
+                        break;
+                    }
 
-                        // Now output_array contains the uint8_t representation of input_array
-                        // Remember to free output_array when done
-                        free(msg);
+                    // Routing daemon exited, keep forwarding on the routes we know until it is back
+                    case ROUTE_DISCONNECT: {
+                        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, route_fd, NULL);
+                        close(route_fd);
+                        route_fd = -1;
 
+                        int marked = fib_mark_stale();
+                        printf("Routing daemon disconnected, keeping %d routes as stale\n", marked);
                         break;
                     }
-                    // RECIEVED UNKNOWN MIP PACKET
+
                     default: {
-                        printf("Received unknown MIP packet\n");
+                        printf("Received unknown ROUTE message\n");
                         break;
                     }
                 }
-                destroy_pdu(pdu);
-            }
-        // INCOMING APPLICATION TRAFFIC
-        } else if (events->data.fd == app_fd){
 
+            // ROOM FOR QUEUED FRAMES
+            } else if (event_fd == txq_fd) {
 
-            printf("Received APP msg\n"); // TODO: Remove
-            // Handle incoming application message and determine type of message
-            APP_handle type = handle_app_message(app_fd, &ping_data.dst_mip_addr, ping_data.msg, &ping_data.ttl);
+                // Send what waits, control frames first
+                txq_flush(raw_fd);
 
-            switch (type){
-                
+            // FRAMES FROM THE FORWARDING THREADS
+            } else if (event_fd == worker_fd) {
 
-                // RECIEVED MESSAGE FROM PING_CLIENT
-                case APP_PING: {
-                    if (debug_mode){
-                        printf("\nReceived APP_PING\n");
-                        printf("Content: %s\n", ping_data.msg);
-                    }
+                // The frames are taken one per iteration, see worker_next
+                worker_wakeup();
 
+            // QUEUE AND RATE LIMIT COUNTERS REQUESTED
+            } else if (event_fd == signal_fd) {
 
-                        
-                    // Create SDU
-                    uint8_t sdu_len;
-                    uint32_t *sdu = stringToUint32Array(ping_data.msg, &sdu_len);
+                // Clear the pending signal
+                struct signalfd_siginfo info;
+                rc = read(signal_fd, &info, sizeof(info));
 
-                    // Create PDU
-                    struct pdu *pdu = create_PDU(ifs.local_mip_addr, ping_data.dst_mip_addr, ping_data.ttl, SDU_TYPE_PING, sdu, sdu_len);
+                print_pending_stats(&queue_forward);
+                txq_print_stats(&ifs);
+                ratelimit_print_stats();
+                apps_print_stats();
+                worker_print_stats();
+                vector_print_stats();
 
-                    // We do not know the next hop, add to queue and send routing request
-                    enqueue_forward(&queue_forward, pdu);
-                    sendRequestToApp(route_fd, ping_data.dst_mip_addr, local_mip_addr);
-                    
-                    break;
-                }
+            // BUNDLE FLUSH TIMER
+            } else if (event_fd == bundle_fd) {
 
-                // RECIEVED MESSAGE FROM PING_SERVER
-                case APP_PONG: {
-                    if (debug_mode){
-                        printf("Received APP_PONG\n");
-                    }
+                // Clear the expiration counter
+                uint64_t expirations;
+                rc = read(bundle_fd, &expirations, sizeof(expirations));
 
-                    // Create SDU
-                    uint8_t sdu_len;
-                    uint32_t *sdu = stringToUint32Array(ping_data.msg, &sdu_len);
+                // Send the small frames that waited long enough for company
+                bundle_flush(&ifs);
 
-                    // Create PDU
-                    struct pdu *pdu = create_PDU(ifs.local_mip_addr, mip_return, ttl_return, SDU_TYPE_PING, sdu, sdu_len);
+            // TIMER TICK
+            } else if (event_fd == timer_fd) {
 
+                // Clear the expiration counter
+                uint64_t expirations;
+                rc = read(timer_fd, &expirations, sizeof(expirations));
 
-                    // We do not know the next hop, add to queue and send routing request
-                    enqueue_forward(&queue_forward, pdu);
-                    sendRequestToApp(route_fd, mip_return, local_mip_addr);
+                // Liveness hellos and timeouts, ARP aging, reassembly and queue timeouts, 
+                // transport retransmissions and FEC flushes
+                timer_run(now_ms());
 
-                    // Reset mip_return and ttl_return for next ping
-                    mip_return = 0;
-                    ttl_return = 0;
+                // Read again from applications whose destinations have room in the forward queue
+                apps_unthrottle(epoll_fd, &queue_forward);
 
-                    break;
-                }
+            } else {
+                printf("Received unknown event\n");
 
+            }
+        }
 
-                default: {
-                    if (debug_mode){
-                        printf("Received unknown APP message\n");
-                    }
 
+    }
 
-                    
-                    break;
-                }
-            }
+    // Close listening socket
+    close(raw_fd);
 
-        // INCOMING ROUTING DAEMON TRAFFIC
-        } else if (events->data.fd == route_fd){
-            printf("Received ROUTE\n");
-            // print message
 
-            uint8_t msg[1024];
+    return 0;
+}
 
-            // Clear buffer
-            memset(msg, 0, sizeof(msg));
 
+/**
+ * Send a PDU towards its destination.
+ * 
+ * ifs: Pointer to the interface data structure.
+ * queue_forward: Queue of PDUs waiting for a routing response.
+ * route_fd: File descriptor of the routing daemon socket.
+ * pdu: PDU to be sent.
+ * 
+ * The routing daemon pushes every route change, so the forwarding table is normally enough 
+ * to send the PDU right away. This includes fast rerouted destinations and stale routes kept 
+ * while the routing daemon restarts. A PDU to a destination the routing daemon recently 
+ * reported as unreachable is dropped right away, see drop_unreachable. On a cold miss the PDU is queued until the routing daemon answers, 
+ * only the first miss for a destination sends a request. The queue is bounded, a PDU that 
+ * does not fit is dropped by its drop policy, see enqueue_forward.
+ */
+void forward_pdu(struct ifs_data *ifs, struct queue_f *queue_forward, int route_fd, struct pdu *pdu) {
+    uint8_t dst = pdu->miphdr->dst;
+    uint8_t next_hop = fib_select(dst);
+
+    if (next_hop != FIB_NO_HOP) {
+        send_to_next_hop(ifs, pdu, next_hop);
+        return;
+    }
 
-            ROUTE_handle type = handle_route_message(route_fd, msg, sizeof(msg));
-            uint8_t recieved_mip = msg[0];
-            printf("recieved_mip: %u\n", recieved_mip);
+    if (fib_is_unreachable(dst)) {
+        drop_unreachable(ifs, queue_forward, route_fd, pdu);
+        return;
+    }
 
-            switch (type)
-            {
-                case ROUTE_HELLO: {
-                    printf("Received ROUTE_HELLO\n");
-                    
+    if (enqueue_forward(queue_forward, pdu) == -1 && debug_mode) {
+        printf("Forward queue full, dropped a PDU (tail %u, head %u, early %u)\n",
+               queue_forward->tail_drops, queue_forward->head_drops, queue_forward->early_drops);
+    }
+    if (route_fd != -1 && fib_need_request(dst)) {
+        sendRequestToApp(route_fd, dst, ifs->local_mip_addr);
+    }
+}
 
-                    // Create SDU
-                    uint8_t sdu_len;
-                    uint32_t *sdu = uint8ArrayToUint32Array(msg, 5, &sdu_len);
+/**
+ * Send every queued PDU for a destination.
+ * 
+ * ifs: Pointer to the interface data structure.
+ * queue_forward: Queue of PDUs waiting for a routing response.
+ * route_fd: File descriptor of the routing daemon socket.
+ * dst: Destination MIP address the routing daemon has just answered for.
+ * 
+ * The PDUs are sent to the next hop now in the forwarding table, in the order they were 
+ * queued. If the destination is cached as unreachable they are dropped. If the forwarding 
+ * table did not take the answer, because the routing daemon is still synchronizing, they 
+ * keep waiting.
+ */
+void flush_forward_queue(struct ifs_data *ifs, struct queue_f *queue_forward, int route_fd, uint8_t dst) {
+    uint8_t next_hop = fib_select(dst);
+    struct pdu *packet;
+
+    if (next_hop == FIB_NO_HOP && !fib_is_unreachable(dst)) {
+        return;
+    }
 
-                    // print sdu
-                    for (int i = 0; i < sdu_len; i++){
-                        printf("%u ", sdu[i]);
-                    }
-                    
-                    // Create PDU
-                    struct pdu *pdu = create_PDU(ifs.local_mip_addr, BROADCAST_MIP_ADDR, 1, SDU_TYPE_ROUTE, sdu, sdu_len);
+    while ((packet = dequeue_forward_by_dst(queue_forward, dst)) != NULL) {
+        if (next_hop == FIB_NO_HOP) {
+            drop_unreachable(ifs, queue_forward, route_fd, packet);
+            continue;
+        }
+        send_to_next_hop(ifs, packet, next_hop);
+    }
+}
 
-                    // Broadcast PDU
-                    for (int interface = 0; interface < ifs.ifn; interface++){
-                        
-                        // Set source MAC address
-                        uint8_t *src_mac_addr = ifs.addr[interface].sll_addr;
+/**
+ * Ask the routing daemon for every destination that has PDUs waiting.
+ * 
+ * ifs: Pointer to the interface data structure.
+ * queue_forward: Queue of PDUs waiting for a routing response.
+ * route_fd: File descriptor of the routing daemon socket.
+ * 
+ * Only one request is sent per destination, see fib_need_request.
+ */
+void request_waiting_routes(struct ifs_data *ifs, struct queue_f *queue_forward, int route_fd) {
+    for (struct queue_node *node = queue_forward->front; node != NULL; node = node->next) {
+        if (fib_need_request(node->packet->miphdr->dst)) {
+            sendRequestToApp(route_fd, node->packet->miphdr->dst, ifs->local_mip_addr);
+        }
+    }
+}
 
-                        // Set destination MAC address
-                        uint8_t *dst_mac_addr = broadcast_mac;
+/**
+ * Drop a PDU that has no route and tell its sender.
+ * 
+ * ifs: Pointer to the interface data structure.
+ * queue_forward: Queue of PDUs waiting for a routing response.
+ * route_fd: File descriptor of the routing daemon socket.
+ * pdu: PDU to be dropped.
+ * 
+ * If the PDU came from a local application, the clients waiting for the destination are 
+ * notified directly. Otherwise a CTRL_UNREACH PDU is sent back to the source MIP daemon, 
+ * which notifies its clients. 
+ * Only PING PDUs and the first fragment of a fragmented ping are answered, so a lost 
+ * notification or routing packet never causes another notification.
+ */
+void drop_unreachable(struct ifs_data *ifs, struct queue_f *queue_forward, int route_fd, struct pdu *pdu) {
+    uint8_t dst = pdu->miphdr->dst;
+    uint8_t src = pdu->miphdr->src;
+    uint8_t sdu_type = pdu->miphdr->sdu_type;
+
+    // The fragment at offset 0 stands for the whole message
+    if (sdu_type == SDU_TYPE_FRAG && pdu->miphdr->sdu_len > FRAG_HDR_WORDS && pdu->sdu[1] == 0) {
+        sdu_type = pdu->sdu[0] & 0x7;
+    }
 
-                        // Set source and destination MAC address
-                        fill_ethhdr(pdu, src_mac_addr, dst_mac_addr);
+    if (debug_mode) {
+        printf("No route to %u, dropping packet from %u\n", dst, src);
+    }
+    destroy_pdu(pdu);
 
+    if (sdu_type != SDU_TYPE_PING) {
+        return;
+    }
 
-                        send_PDU(&ifs, pdu, find_matching_sockaddr(&ifs, ifs.addr[interface].sll_addr));
-                    }
+    if (src == ifs->local_mip_addr) {
+        apps_unreachable(dst);
+        return;
+    }
 
+    uint32_t sdu = ((uint32_t) CTRL_UNREACH << 24) | ((uint32_t) dst << 16);
+    struct pdu *notification = create_PDU(ifs->local_mip_addr, src, MIP_MAX_TTL, SDU_TYPE_CTRL, &sdu, 1);
+    forward_pdu(ifs, queue_forward, route_fd, notification);
+}
 
-                    break;
-                }
+/**
+ * Send a message from a local application towards its destination.
+ * 
+ * ifs: Pointer to the interface data structure.
+ * queue_forward: Queue of PDUs waiting for a routing response.
+ * route_fd: File descriptor of the routing daemon socket.
+ * dst: Destination MIP address.
+ * ttl: TTL of every PDU sent.
+ * sdu_type: SDU type of the message.
+ * msg: The message, already packed into words.
+ * msg_words: Length of the message in words.
+ * 
+ * A message that fits in one frame on every interface is sent as a single PDU. A larger one 
+ * is split into SDU_TYPE_FRAG PDUs that share a message ID, and the destination MIP daemon 
+ * puts them back together before the application sees the message. Every fragment is 
+ * forwarded on its own, see forward_pdu.
+ */
+void send_message(struct ifs_data *ifs, struct queue_f *queue_forward, int route_fd, uint8_t dst, uint8_t ttl,
+                  uint8_t sdu_type, const uint32_t *msg, size_t msg_words) {
+    if (msg_words <= frag_max_sdu_words()) {
+        struct pdu *pdu = create_PDU(ifs->local_mip_addr, dst, ttl, sdu_type, msg, msg_words);
+        forward_pdu(ifs, queue_forward, route_fd, pdu);
+        return;
+    }
 
-                case ROUTE_UPDATE: {
-                    printf("Received ROUTE_UPDATE\n");
+    uint32_t sdu[MIP_MAX_SDU_WORDS];
+    uint16_t id = frag_next_id();
+    size_t offset = 0;
 
+    while (offset < msg_words) {
+        size_t sdu_len = frag_build(sdu, msg, msg_words, sdu_type, id, offset);
+        offset += sdu_len - FRAG_HDR_WORDS;
 
+        struct pdu *pdu = create_PDU(ifs->local_mip_addr, dst, ttl, SDU_TYPE_FRAG, sdu, sdu_len);
+        forward_pdu(ifs, queue_forward, route_fd, pdu);
+    }
 
-                    // Create SDU
-                    uint8_t sdu_len;
-                    uint32_t *sdu = uint8ArrayToUint32Array(msg, 3 * MAX_NODES + 5, &sdu_len);
+    if (debug_mode) {
+        printf("Sent message of %zu words to %u in fragments\n", msg_words, dst);
+    }
+}
 
-                    // Create PDU
-                    struct pdu *pdu = create_PDU(ifs.local_mip_addr, BROADCAST_MIP_ADDR, 1, SDU_TYPE_ROUTE, sdu, sdu_len);
+/**
+ * Send a segment of the transport protocol.
+ * 
+ * ctx: Pointer to the forward_ctx of the daemon.
+ * dst: MIP address of the peer.
+ * sdu: The segment.
+ * sdu_len: Length of the segment in words.
+ * 
+ * Segments are sent with the largest TTL, see send_message.
+ */
+void transport_output_segment(void *ctx, uint8_t dst, const uint32_t *sdu, size_t sdu_len) {
+    struct forward_ctx *transport = ctx;
+
+    send_message(transport->ifs, transport->queue_forward, *transport->route_fd, dst, MIP_MAX_TTL,
+                 SDU_TYPE_TRANSPORT, sdu, sdu_len);
+}
 
-                    // Broadcast PDU
-                    for (int interface = 0; interface < ifs.ifn; interface++){
-                        
-                        // Set source MAC address
-                        uint8_t *src_mac_addr = ifs.addr[interface].sll_addr;
+/**
+ * Drop a PDU that waited too long for its route or next hop and tell its sender.
+ * 
+ * pdu: The PDU, taken out of its queue.
+ * ctx: Pointer to the forward_ctx of the daemon.
+ * 
+ * The sender is told the same way as for a destination without a route, see 
+ * drop_unreachable, so a local application does not wait for its own timeout.
+ */
+void drop_expired(struct pdu *pdu, void *ctx) {
+    struct forward_ctx *forward = ctx;
+
+    drop_unreachable(forward->ifs, forward->queue_forward, *forward->route_fd, pdu);
+}
+
+/**
+ * Report a neighbor the liveness protocol declared down.
+ *
+ * mip: MIP address of the neighbor.
+ * ctx: Pointer to the liveness_ctx of the daemon.
+ *
+ * Destinations behind the neighbor switch to their backup next hops, and the routing daemon
+ * is told right away, it should not wait for its own timeout.
+ */
+void neighbor_down(uint8_t mip, void *ctx) {
+    struct liveness_ctx *liveness = ctx;
+
+    int moved = fib_neighbor_down(mip);
+    if (moved > 0) {
+        printf("Fast reroute: %d destinations moved off neighbor %u\n", moved, mip);
+    }
+    sendNeighborEventToApp(*liveness->route_fd, mip, liveness->ifs->local_mip_addr, 0);
+}
 
-                        // Set destination MAC address
-                        uint8_t *dst_mac_addr = broadcast_mac;
+/**
+ * Hand the messages waiting in the ring of the transport application to the protocol.
+ * 
+ * ring: The daemon's end of the rings of the transport application.
+ * 
+ * Messages are taken while the send windows have room, the rest waits in the ring, which 
+ * holds the application back like a full socket. When the ring runs empty the application 
+ * is asked to wake the daemon, and it is woken once if it waits for room.
+ * 
+ * Returns 1 if the ring is empty, or 0 if messages are left for when the windows open.
+ */
+int drain_transport_ring(struct ring_end *ring) {
+    uint8_t buf[TRANSPORT_APP_HDR_LEN + TRANSPORT_MSS + 1];
+    ssize_t len;
+
+    while (!transport_window_full()) {
+        len = ring_pop(ring, buf, sizeof(buf));
+        if (len == -1) {
+            // A message that was written meanwhile did not wake the daemon
+            if (ring_arm(ring)) {
+                continue;
+            }
+            ring_notify(ring);
+            return 1;
+        }
+
+        if (len < TRANSPORT_APP_HDR_LEN ||
+            transport_send(buf[0], buf[1], buf + TRANSPORT_APP_HDR_LEN, len - TRANSPORT_APP_HDR_LEN, now_ms()) == -1) {
+            if (debug_mode) {
+                printf("Dropping transport message of %zd bytes\n", len);
+            }
+        }
+    }
+
+    ring_notify(ring);
+    return 0;
+}
 
-                        // Set source and destination MAC address
-                        fill_ethhdr(pdu, src_mac_addr, dst_mac_addr);
+/**
+ * Send a PDU to a neighbor.
+ * 
+ * ifs: Pointer to the interface data structure.
+ * packet: PDU to be sent.
+ * next_hop: MIP address of the neighbor.
+ * 
+ * If the neighbor has been resolved, the PDU is sent through its adjacency, which already 
+ * holds the Ethernet header and link-layer address. Otherwise the PDU is added to the ARP 
+ * queue and an ARP request is broadcast on all interfaces. The PDU is dropped if the ARP 
+ * queue, or the share of the next hop in it, is full.
+ * 
+ * Transport segments are marked CE on the way out while the transmit queue of the raw 
+ * socket, or of a forwarding thread, is filling up, so the sender slows down before frames 
+ * are lost.
+ */
+void send_to_next_hop(struct ifs_data *ifs, struct pdu *packet, uint8_t next_hop) {
+    const struct adjacency *adj = adj_lookup(next_hop);
+
+    if (adj != NULL) {
+        if (packet->miphdr->sdu_type == SDU_TYPE_TRANSPORT && (tx_queue_congested(ifs) || worker_congested())) {
+            transport_mark_ce(packet->sdu, packet->miphdr->sdu_len);
+        }
+        send_PDU(ifs, packet, adj);
+        return;
+    }
 
+    // Add to queue
+    if (enqueue_arp(packet, next_hop) == -1) {
+        if (debug_mode) {
+            printf("ARP queue full, dropping packet to %u\n", next_hop);
+        }
+        destroy_pdu(packet);
+        return;
+    }
 
+    // Send ARP request to all interfaces
+    uint32_t *sdu = create_sdu_miparp(ARP_TYPE_REQUEST, next_hop);
+    broadcast_PDU(ifs, SDU_TYPE_MIPARP, sdu, 1);
+    free(sdu);
+}
 
-                        send_PDU(&ifs, pdu, find_matching_sockaddr(&ifs, ifs.addr[interface].sll_addr));
-                    }
-                    break;
+/**
+ * Answer and learn from MIP-ARP messages, the arp node of the receive pipeline.
+ * 
+ * vec: MIP-ARP requests and replies for this daemon, or broadcast.
+ * ctx: Pointer to the forward_ctx of the daemon.
+ * 
+ * A request for our MIP address teaches us the adjacency of the requester, and the reply is 
+ * sent through it. Requests for other MIP addresses are thrown away. A reply resolves the 
+ * neighbor, and every packet that was waiting for it is sent.
+ */
+void arp_node(struct packet_vector *vec, void *ctx) {
+    struct forward_ctx *forward = ctx;
+    struct ifs_data *ifs = forward->ifs;
+
+    for (size_t i = 0; i < vec->count; i++) {
+        struct pdu *pdu = vec->pdus[i];
+
+        // RECIEVED MIP ARP REQUEST FROM OTHER MIP DAEMON
+        if (vec->types[i] == MIP_ARP_REQUEST) {
+            uint8_t target_arp_mip_addr; // MIP address from SDU of ARP request
+
+            if (debug_mode){
+                printf("\nReceived MIP_ARP_REQUEST\n");
+                print_pdu_content(pdu);
+                printf("\n");
+            }
+
+            // Get target MIP address from SDU of ARP request
+            decode_sdu_miparp(pdu->sdu, &target_arp_mip_addr);
+
+            // Check if ARP request is for this MIP daemon by comparing target MIP address with local MIP address
+            if (target_arp_mip_addr == ifs->local_mip_addr) {
+                if (debug_mode){
+                    printf("ARP request for us\n");
                 }
 
-                case ROUTE_RESPONSE: {
-                    printf("Received ROUTE_RESPONSE\n");
+                // Learn the adjacency of the requester, the reply is sent through it
+                adj_update(ifs, pdu->miphdr->src, pdu->ethhdr->src_mac, vec->interfaces[i]);
+
+                // Send ARP reply
+                if (debug_mode){
+                    printf("Sending MIP_ARP_REPLY to MIP: %u\n", pdu->miphdr->src);
+                }
 
+                // Create PDU for ARP reply containing matching MIP address
+                uint32_t *sdu = create_sdu_miparp(ARP_TYPE_REPLY, ifs->local_mip_addr);
+                struct pdu* packet = create_PDU(ifs->local_mip_addr, pdu->miphdr->src, 0, SDU_TYPE_MIPARP, sdu, 1);
+                free(sdu);
 
-                    uint8_t next_hop = msg[5];
+                send_PDU(ifs, packet, adj_lookup(pdu->miphdr->src));
+
+            // If ARP request is not for this MIP daemon, throw packet away
+            } else if (debug_mode){
+                printf("ARP request not for us\n");
+            }
+
+        // RECIEVED MIP ARP REPLY FROM OTHER MIP DAEMON
+        } else {
+            if (debug_mode){
+                printf("\nReceived MIP_ARP_REPLY\n");
+                print_pdu_content(pdu);
+                printf("\n");
+            }
 
-                    // Get PDU from queue_forward
-                    struct pdu* packet = dequeue_forward(&queue_forward);
+            // Learn the adjacency of the neighbor
+            adj_update(ifs, pdu->miphdr->src, pdu->ethhdr->src_mac, vec->interfaces[i]);
 
-                    // Get destination MAC
-                    uint8_t *dst_mac_addr = arp_lookup(next_hop);
+            // Send every packet that was waiting for the neighbor to be resolved
+            const struct adjacency *adj = adj_lookup(pdu->miphdr->src);
+            struct pdu_with_hop result;
 
-                    if (dst_mac_addr != NULL) {
+            while ((result = remove_packet_by_next_hop(pdu->miphdr->src)).packet != NULL) {
+                send_PDU(ifs, result.packet, adj);
+            }
+        }
 
-                        // Get source MAC
-                        uint8_t *src_mac_addr = ifs.addr[arp_lookup_interface(next_hop)].sll_addr;
+        destroy_pdu(pdu);
+    }
+}
 
-                        // Get destination MAC
-                        uint8_t *dst_mac_addr = arp_lookup(next_hop);
+/**
+ * Deliver PDUs to this daemon and its applications, the local node of the receive pipeline.
+ * 
+ * vec: PDUs for this daemon, or broadcast, other than MIP-ARP and routing messages.
+ * ctx: Pointer to the forward_ctx of the daemon.
+ * 
+ * Pings go to the ping applications, liveness hellos to the liveness protocol, fragments are 
+ * put back together, and transport segments go to the transport protocol.
+ */
+void local_node(struct packet_vector *vec, void *ctx) {
+    struct forward_ctx *forward = ctx;
+    struct ifs_data *ifs = forward->ifs;
+
+    for (size_t i = 0; i < vec->count; i++) {
+        struct pdu *pdu = vec->pdus[i];
+
+        if (debug_mode){
+            printf("Packet for us!\n");
+        }
 
-                        // Set source and destination MAC address
-                        fill_ethhdr(packet, src_mac_addr, dst_mac_addr);
+        switch (vec->types[i]){
 
-                        // Send packet
-                        send_PDU(&ifs, packet, find_matching_sockaddr(&ifs, dst_mac_addr));
-                    } else {
-                       
-                        // Add to queue
-                        enqueue_arp(packet, next_hop);
+            // RECIEVED MIP PING FROM OTHER MIP DAEMON
+            case MIP_PING: {
+                if (debug_mode){
+                    printf("\nReceived MIP_PING\n");
+                    print_pdu_content(pdu);
+                    printf("\n");
+                }
 
-                        // Send ARP request
-                        uint32_t *sdu = create_sdu_miparp(ARP_TYPE_REQUEST, next_hop);
+                // Write SDU to a ping_server, which remembers where the PONG goes
+                apps_deliver_ping(pdu->miphdr->src, pdu->miphdr->ttl, pdu->sdu, pdu->miphdr->sdu_len);
 
-                        // Send ARP request to all interfaces
-                        for (int interface = 0; interface < ifs.ifn; interface++){
+                break;
+            }
+            // RECIEVED MIP PONG FROM OTHER MIP DAEMON
+            case MIP_PONG: {
+                if (debug_mode){
+                    printf("\nReceived MIP_PONG\n");
+                    print_pdu_content(pdu);
+                    printf("\n");
+                }
 
-                            // Create PDU
-                            struct pdu *pdu = create_PDU(ifs.local_mip_addr, BROADCAST_MIP_ADDR, 1, SDU_TYPE_MIPARP, sdu, sizeof(uint32_t));
+                // Write SDU to the ping_client that sent the PING, it closes the connection itself
+                apps_deliver_pong(pdu->miphdr->src, pdu->miphdr->ttl, pdu->sdu, pdu->miphdr->sdu_len);
 
-                            // Get source MAC address
-                            uint8_t *src_mac_addr = ifs.addr[interface].sll_addr;
+                break;
+            }
 
-                            // Get destination MAC address
-                            uint8_t *dst_mac_addr = broadcast_mac;
+            // RECIEVED LIVENESS HELLO FROM NEIGHBOR MIP DAEMON
+            case MIP_LIVENESS: {
 
-                            // Set source and destination MAC address
-                            fill_ethhdr(pdu, src_mac_addr, dst_mac_addr);
+                // Tell the routing daemon right away if the neighbor just came up
+                if (liveness_rx(pdu->miphdr->src, vec->interfaces[i], pdu->sdu, pdu->miphdr->sdu_len, now_ms())) {
+                    printf("Neighbor %u up\n", pdu->miphdr->src);
+                    sendNeighborEventToApp(*forward->route_fd, pdu->miphdr->src, ifs->local_mip_addr, 1);
+                }
+                break;
+            }
 
+            // RECIEVED DESTINATION UNREACHABLE FROM OTHER MIP DAEMON
+            case MIP_UNREACH: {
+                uint8_t unreachable = (pdu->sdu[0] >> 16) & 0xff;
 
-                            // Send PDU
-                            send_PDU(&ifs, packet, find_matching_sockaddr(&ifs, dst_mac_addr));
-                        }
+                if (debug_mode){
+                    printf("\nReceived MIP_UNREACH for %u from %u\n", unreachable, pdu->miphdr->src);
+                }
 
+                // Let the application fail now instead of waiting for its timeout
+                apps_unreachable(unreachable);
+                break;
+            }
 
+            // RECIEVED FRAGMENT OF A LARGER MESSAGE FROM OTHER MIP DAEMON
+            case MIP_FRAG: {
+                uint8_t sdu_type;
+                size_t msg_words;
+                const uint32_t *msg = frag_input(pdu->miphdr->src, pdu->sdu, pdu->miphdr->sdu_len, now_ms(),
+                                                 &sdu_type, &msg_words);
 
+                // Wait for the rest of the message
+                if (msg == NULL) {
+                    break;
+                }
 
+                if (debug_mode){
+                    printf("\nReassembled message of %zu words from %u\n", msg_words, pdu->miphdr->src);
+                }
 
-                    }
+                if (sdu_type == SDU_TYPE_TRANSPORT) {
+                    transport_input(pdu->miphdr->src, msg, msg_words, now_ms());
                     break;
                 }
-                default: {
-                    printf("Received unknown ROUTE message\n");
+
+                // Otherwise only pings are large enough to be fragmented
+                if (sdu_type != SDU_TYPE_PING || msg_words < 2) {
                     break;
                 }
+
+                // Write the whole message to the application at once
+                if (msg[1] == 0x50494E47) {
+                    apps_deliver_ping(pdu->miphdr->src, pdu->miphdr->ttl, msg, msg_words);
+                } else {
+                    apps_deliver_pong(pdu->miphdr->src, pdu->miphdr->ttl, msg, msg_words);
+                }
+                break;
             }
 
-        } else {
-            printf("Received unknown event\n");
+            // RECIEVED TRANSPORT SEGMENT FROM OTHER MIP DAEMON
+            case MIP_TRANSPORT: {
+                transport_input(pdu->miphdr->src, pdu->sdu, pdu->miphdr->sdu_len, now_ms());
+                break;
+            }
 
+            // RECIEVED UNKNOWN MIP PACKET
+            default: {
+                printf("Received unknown MIP packet\n");
+                break;
+            }
         }
+        destroy_pdu(pdu);
+    }
+}
 
+/**
+ * Pass routing messages to the routing daemon, the route node of the receive pipeline.
+ * 
+ * vec: MIP_ROUTE PDUs for this daemon, or broadcast.
+ * ctx: Pointer to the forward_ctx of the daemon.
+ * 
+ * The SDU of every message is written to the routing daemon as is. The messages are dropped 
+ * while no routing daemon is connected.
+ */
+void route_node(struct packet_vector *vec, void *ctx) {
+    struct forward_ctx *forward = ctx;
+    uint8_t sdu_bytes[MIP_MAX_SDU_WORDS * 4]; // Scratch buffer for unpacking incoming SDUs
+
+    for (size_t i = 0; i < vec->count; i++) {
+        struct pdu *pdu = vec->pdus[i];
+
+        if (debug_mode){
+            printf("\nReceived MIP_ROUTE\n");
+            print_pdu_content(pdu);
+            printf("\n");
+        }
 
-    }
+        size_t input_size = pdu->miphdr->sdu_len;
+        size_t output_size = input_size * 4;
 
-    // Close listening socket
-    close(raw_fd);
+        unpack_words(sdu_bytes, pdu->sdu, input_size);
 
+        // Write SDU to routing daemon, if it is running
+        if (*forward->route_fd != -1 && write(*forward->route_fd, sdu_bytes, output_size) == -1) {
+            perror("write");
+        }
 
-    return 0;
+        destroy_pdu(pdu);
+    }
+}
+
+/**
+ * Send PDUs for other MIP daemons on, the forward node of the receive pipeline.
+ * 
+ * vec: PDUs in transit.
+ * ctx: Pointer to the forward_ctx of the daemon.
+ * 
+ * Every PDU is sent to its next hop, or queued until the routing daemon answers, see 
+ * forward_pdu.
+ */
+void forward_node(struct packet_vector *vec, void *ctx) {
+    struct forward_ctx *forward = ctx;
+
+    for (size_t i = 0; i < vec->count; i++) {
+        if (debug_mode){
+            printf("Packet not for us, forwarding..\n");
+        }
+
+        forward_pdu(forward->ifs, forward->queue_forward, *forward->route_fd, vec->pdus[i]);
+    }
 }
 
 
-void parse_arguments(int argc, char *argv[], int *debug_mode, char **socket_upper, uint8_t *mip_addr) {
+void parse_arguments(int argc, char *argv[], int *debug_mode, char **socket_upper, uint8_t *mip_addr,
+                     uint32_t *hello_interval, uint8_t *detect_mult, int *loss_percent, char **cc_name,
+                     uint32_t *bundle_delay, char **queue_spec, int *worker_threads) {
     int opt;
-    while ((opt = getopt(argc, argv, "dh")) != -1) {
+    while ((opt = getopt(argc, argv, "dhl:m:p:c:f:b:q:r:w:")) != -1) {
         switch (opt) {
             case 'd':
                 *debug_mode = 1;
                 break;
+            case 'l':
+                *hello_interval = (uint32_t) atoi(optarg);
+                break;
+            case 'm':
+                *detect_mult = (uint8_t) atoi(optarg);
+                break;
+            case 'p':
+                *loss_percent = atoi(optarg);
+                break;
+            case 'c':
+                *cc_name = optarg;
+                break;
+            case 'b':
+                *bundle_delay = (uint32_t) atoi(optarg);
+                break;
+            case 'q':
+                *queue_spec = optarg;
+                break;
+            case 'r':
+                if (ratelimit_configure(optarg) == -1) {
+                    fprintf(stderr, "Invalid rate limit %s, use app, src, src:<mip> or type:<sdu_type>, then =<rate>[/<burst>]\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 'w':
+                *worker_threads = atoi(optarg);
+                if (*worker_threads < 0 || *worker_threads > WORKER_MAX) {
+                    fprintf(stderr, "Invalid number of forwarding threads %s, use 0 to %d\n", optarg, WORKER_MAX);
+                    exit(1);
+                }
+                break;
+            case 'f': {
+                // Destination, optionally followed by the block size
+                char *k = strchr(optarg, ':');
+                if (fec_configure((uint8_t) atoi(optarg), k != NULL ? atoi(k + 1) : FEC_DEFAULT_K) == -1) {
+                    fprintf(stderr, "Invalid FEC destination or block size %s, the block size must be between 2 and %d\n",
+                            optarg, FEC_MAX_K);
+                    exit(1);
+                }
+                break;
+            }
             case 'h':
-                printf("Usage: %s [-h] [-d] <socket_upper> <MIP address>\n", argv[0]);
+                printf("Usage: %s [-h] [-d] [-l <hello_ms>] [-m <multiplier>] [-p <loss_percent>] [-c <aimd|fixed>] [-f <dst>[:<k>]] [-b <bundle_us>] [-q <tail|head|red>[:<limit>]] [-r <scope>=<rate>[/<burst>]] [-w <threads>] <socket_upper> <MIP address>\n", argv[0]);
                 exit(0);
             default:
-                fprintf(stderr, "Usage: %s [-h] [-d] <socket_upper> <MIP address>\n", argv[0]);
+                fprintf(stderr, "Usage: %s [-h] [-d] [-l <hello_ms>] [-m <multiplier>] [-p <loss_percent>] [-c <aimd|fixed>] [-f <dst>[:<k>]] [-b <bundle_us>] [-q <tail|head|red>[:<limit>]] [-r <scope>=<rate>[/<burst>]] [-w <threads>] <socket_upper> <MIP address>\n", argv[0]);
                 exit(1);
         }
     }
 
     // After processing options, optind points to the first non-option argument
     if (optind + 2 != argc) {
-        fprintf(stderr, "Usage: %s [-h] [-d] <socket_upper> <MIP address>\n", argv[0]);
+        fprintf(stderr, "Usage: %s [-h] [-d] [-l <hello_ms>] [-m <multiplier>] [-p <loss_percent>] [-c <aimd|fixed>] [-f <dst>[:<k>]] [-b <bundle_us>] [-q <tail|head|red>[:<limit>]] [-r <scope>=<rate>[/<burst>]] [-w <threads>] <socket_upper> <MIP address>\n", argv[0]);
         exit(1);
     }
 
@@ -0,0 +1,238 @@
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PACK_X86 1
+#endif
+
+#include "pack.h"
+
+typedef void (*swap_kernel)(void *dst, const void *src, size_t words);
+
+static swap_kernel simd_kernel; // Selected on first use, see select_kernel
+
+
+/**
+ * Copy 32-bit words while converting between network and host byte order.
+ *
+ * dst: Destination buffer, may be the same as 'src'.
+ * src: Source buffer.
+ * words: Number of 32-bit words to copy.
+ *
+ * SDUs carry the first byte of a string or message in the most significant byte of each
+ * word, so on a little-endian host every word is byte-reversed with a single bswap. The
+ * buffers do not need to be aligned.
+ */
+static void swap_words_scalar(void *dst, const void *src, size_t words) {
+    uint8_t *d = dst;
+    const uint8_t *s = src;
+
+    for (size_t i = 0; i < words; i++) {
+        uint32_t word;
+        memcpy(&word, s + i * 4, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        word = __builtin_bswap32(word);
+#endif
+        memcpy(d + i * 4, &word, sizeof(word));
+    }
+}
+
+#if defined(PACK_X86) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+
+/**
+ * SSSE3 version of swap_words_scalar, reversing four words per pshufb.
+ */
+__attribute__((target("ssse3")))
+static void swap_words_ssse3(void *dst, const void *src, size_t words) {
+    const __m128i mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    uint8_t *d = dst;
+    const uint8_t *s = src;
+    size_t i = 0;
+
+    for (; i + 4 <= words; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (s + i * 4));
+        _mm_storeu_si128((__m128i *) (d + i * 4), _mm_shuffle_epi8(v, mask));
+    }
+
+    swap_words_scalar(d + i * 4, s + i * 4, words - i);
+}
+
+/**
+ * AVX2 version of swap_words_scalar, reversing eight words per vpshufb.
+ */
+__attribute__((target("avx2")))
+static void swap_words_avx2(void *dst, const void *src, size_t words) {
+    const __m256i mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    uint8_t *d = dst;
+    const uint8_t *s = src;
+    size_t i = 0;
+
+    for (; i + 8 <= words; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (s + i * 4));
+        _mm256_storeu_si256((__m256i *) (d + i * 4), _mm256_shuffle_epi8(v, mask));
+    }
+
+    swap_words_scalar(d + i * 4, s + i * 4, words - i);
+}
+
+#endif
+
+/**
+ * Pick the fastest kernel the CPU supports.
+ *
+ * Returns a pointer to the AVX2 or SSSE3 kernel when the CPU has the instructions, and to
+ * the scalar kernel otherwise.
+ */
+static swap_kernel select_kernel(void) {
+#if defined(PACK_X86) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return swap_words_avx2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return swap_words_ssse3;
+    }
+#endif
+    return swap_words_scalar;
+}
+
+/**
+ * Copy 32-bit words while converting between network and host byte order.
+ *
+ * dst: Destination buffer, may be the same as 'src'.
+ * src: Source buffer.
+ * words: Number of 32-bit words to copy.
+ *
+ * Short payloads, like most ping messages, stay on the scalar kernel, where the setup of a
+ * vector loop does not pay off.
+ */
+static void swap_words(void *dst, const void *src, size_t words) {
+    if (words * 4 < PACK_SIMD_MIN) {
+        swap_words_scalar(dst, src, words);
+        return;
+    }
+
+    // Selecting twice is harmless, so threads may race on the first call
+    swap_kernel kernel = __atomic_load_n(&simd_kernel, __ATOMIC_RELAXED);
+    if (kernel == NULL) {
+        kernel = select_kernel();
+        __atomic_store_n(&simd_kernel, kernel, __ATOMIC_RELAXED);
+    }
+
+    kernel(dst, src, words);
+}
+
+/**
+ * Pack bytes into SDU words.
+ *
+ * dst: Buffer to store the words in, at least (len + 3) / 4 words long.
+ * src: Bytes to pack.
+ * len: Number of bytes to pack.
+ *
+ * The first byte ends up in the most significant byte of the first word. A trailing
+ * partial word is padded with zeroes.
+ *
+ * Returns the number of words written.
+ */
+size_t pack_words(uint32_t *dst, const uint8_t *src, size_t len) {
+    size_t words = len / 4;
+    size_t rest = len % 4;
+
+    swap_words(dst, src, words);
+
+    if (rest) {
+        uint8_t tail[4] = {0};
+        memcpy(tail, src + words * 4, rest);
+        swap_words_scalar(dst + words, tail, 1);
+        words++;
+    }
+
+    return words;
+}
+
+/**
+ * Unpack SDU words into bytes.
+ *
+ * dst: Buffer to store the bytes in, at least words * 4 bytes long.
+ * src: Words to unpack.
+ * words: Number of words to unpack.
+ *
+ * This is the inverse of pack_words.
+ */
+void unpack_words(uint8_t *dst, const uint32_t *src, size_t words) {
+    swap_words(dst, src, words);
+}
+
+/**
+ * Pack a string into SDU words.
+ *
+ * dst: Buffer to store the words in.
+ * dst_words: Size of 'dst' in words.
+ * str: NUL-terminated string to pack.
+ *
+ * The first word holds the length of the string in bytes, the string follows without its
+ * terminating NUL. This is the layout ping messages use between the MIP daemon and its
+ * applications.
+ *
+ * Returns the number of words written, or 0 if the string does not fit in 'dst'.
+ */
+size_t pack_string(uint32_t *dst, size_t dst_words, const char *str) {
+    size_t len = strlen(str);
+    size_t words = 1 + (len + 3) / 4;
+
+    if (words > dst_words) {
+        return 0;
+    }
+
+    dst[0] = (uint32_t) len;
+    pack_words(dst + 1, (const uint8_t *) str, len);
+
+    return words;
+}
+
+/**
+ * Unpack a string from SDU words.
+ *
+ * dst: Buffer to store the NUL-terminated string in.
+ * dst_size: Size of 'dst' in bytes.
+ * src: Words holding a string packed by pack_string.
+ * src_words: Number of words available in 'src'.
+ *
+ * A length that does not fit in 'src' or 'dst' is truncated, so a malformed SDU cannot make
+ * this function read or write out of bounds.
+ *
+ * Returns the length of the unpacked string.
+ */
+size_t unpack_string(char *dst, size_t dst_size, const uint32_t *src, size_t src_words) {
+    if (dst_size == 0) {
+        return 0;
+    }
+    if (src_words == 0) {
+        dst[0] = '\0';
+        return 0;
+    }
+
+    size_t len = src[0];
+    if (len > (src_words - 1) * 4) {
+        len = (src_words - 1) * 4;
+    }
+    if (len > dst_size - 1) {
+        len = dst_size - 1;
+    }
+
+    size_t words = len / 4;
+    size_t rest = len % 4;
+
+    unpack_words((uint8_t *) dst, src + 1, words);
+
+    if (rest) {
+        uint8_t tail[4];
+        unpack_words(tail, src + 1 + words, 1);
+        memcpy(dst + words * 4, tail, rest);
+    }
+
+    dst[len] = '\0';
+    return len;
+}
@@ -13,6 +13,12 @@
 #include "route.h"
 
 struct pdu_queue_slot queue_arp[MAX_QUEUE_SIZE];
+static uint8_t arp_hop_size[256];       // PDUs in the ARP queue per next hop
+static uint32_t arp_seq;                // Sequence number of the next PDU in the ARP queue
+static uint32_t arp_drops;              // PDUs the ARP queue had no room for
+static uint32_t arp_expired;            // PDUs dropped after waiting ARP_QUEUE_TIMEOUT ms
+static pending_expired_fn expired_fn;   // Told about expired PDUs, NULL to just destroy them
+static void *expired_ctx;               // Passed back to expired_fn
 
 /**
  * Allocate memory for a Protocol Data Unit (PDU) structure and its components.
@@ -102,17 +108,10 @@ void fill_pdu(struct pdu *pdu,
     pdu->miphdr->sdu_type = sdu_type;
     pdu->miphdr->sdu_len = sdu_len;
 
-    for (int i = 0; i < sdu_len; i++){
-        printf("%u ", sdu[i]);
-    }
     if (pdu->sdu) {
         free(pdu->sdu); // Free existing sdu memory
     }
 
-    for (int i = 0; i < sdu_len; i++){
-        printf("%u ", sdu[i]);
-    }
-
     pdu->sdu = (uint32_t *)calloc(sdu_len, sizeof(uint32_t));
     if (!pdu->sdu) {
         // Handle memory allocation failure
@@ -120,11 +119,46 @@ void fill_pdu(struct pdu *pdu,
     }
     
     memcpy(pdu->sdu, sdu, sdu_len * sizeof(uint32_t));
+}
+
+/**
+ * Pack a MIP header into the 32-bit wire format.
+ * 
+ * hdr: Pointer to the MIP header.
+ * 
+ * The fields are laid out as destination (8 bits), source (8 bits), TTL (4 bits), SDU length 
+ * in 32-bit words (9 bits) and SDU type (3 bits), from the most significant bit down.
+ * 
+ * Returns the packed header in network byte order, ready to be sent.
+ */
+uint32_t mip_pack_header(const struct mip_hdr *hdr)
+{
+    uint32_t miphdr = 0;
+    miphdr |= (uint32_t) hdr->dst << 24;
+    miphdr |= (uint32_t) hdr->src << 16;
+    miphdr |= (uint32_t) (hdr->ttl & 0xf) << 12;
+    miphdr |= (uint32_t) (hdr->sdu_len & 0x1ff) << 3;
+    miphdr |= (uint32_t) (hdr->sdu_type & 0x7);
 
+    /* prepare it to be sent from host to network */
+    return htonl(miphdr);
+}
 
-    for (int i = 0; i < sdu_len; i++){
-        printf("%u ", sdu[i]);
-    }
+/**
+ * Unpack a MIP header from the 32-bit wire format.
+ * 
+ * header: Packed header in host byte order.
+ * hdr: Pointer to the MIP header to fill in.
+ * 
+ * This is the reverse of mip_pack_header.
+ */
+void mip_unpack_header(uint32_t header, struct mip_hdr *hdr)
+{
+    hdr->dst = (uint8_t) (header >> 24);
+    hdr->src = (uint8_t) (header >> 16);
+    hdr->ttl = (uint8_t) ((header >> 12) & 0xf);
+    hdr->sdu_len = (uint16_t) ((header >> 3) & 0x1ff);
+    hdr->sdu_type = (uint8_t) (header & 0x7);
 }
 
 /**
@@ -150,22 +184,14 @@ size_t mip_serialize_pdu(struct pdu *pdu, uint8_t *snd_buf)
     snd_len += ETH_HDR_LEN;
 
     /* Copy MIP header */
-    uint32_t miphdr = 0;
-    miphdr |= (uint32_t) pdu->miphdr->dst << 24;
-    miphdr |= (uint32_t) pdu->miphdr->src << 16;
-    miphdr |= (uint32_t) (pdu->miphdr->ttl & 0xff) << 12;
-    miphdr |= (uint32_t) (pdu->miphdr->sdu_len & 0xff) << 3;
-    miphdr |= (uint32_t) (pdu->miphdr->sdu_type & 0xf);
-
-    /* prepare it to be sent from host to network */
-    miphdr = htonl(miphdr);
+    uint32_t miphdr = mip_pack_header(pdu->miphdr);
 
     memcpy(snd_buf + snd_len, &miphdr, MIP_HDR_LEN);
     snd_len += MIP_HDR_LEN;
 
-    /* Attach SDU */
-    memcpy(snd_buf + snd_len, pdu->sdu, pdu->miphdr->sdu_len);
-    snd_len += pdu->miphdr->sdu_len;
+    /* Attach SDU, sdu_len counts 32-bit words */
+    memcpy(snd_buf + snd_len, pdu->sdu, pdu->miphdr->sdu_len * sizeof(uint32_t));
+    snd_len += pdu->miphdr->sdu_len * sizeof(uint32_t);
 
 
 
@@ -177,52 +203,62 @@ size_t mip_serialize_pdu(struct pdu *pdu, uint8_t *snd_buf)
  * 
  * pdu: Pointer to the PDU structure where the deserialized data will be stored.
  * rcv_buf: Buffer containing the serialized PDU data.
+ * rcv_len: Number of bytes received into rcv_buf.
  * 
  * This function deserializes the data from the rcv_buf into the provided PDU structure.
- * It allocates memory and extracts the Ethernet header, MIP header, and SDU (if present), 
- * converting fields from network byte order to host byte order where necessary. The function
- * handles memory allocation failures and ensures proper cleanup in such cases.
+ * It extracts the Ethernet header, MIP header, and SDU (if present), converting fields from 
+ * network byte order to host byte order where necessary. The headers of a PDU from alloc_pdu 
+ * are reused, missing ones are allocated. The SDU length is the full 9-bit field, counted in 
+ * 32-bit words, and a frame shorter than its headers and SDU is rejected.
  * 
- * Returns the total length of the deserialized data, or 0 if memory allocation fails.
+ * Returns the total length of the deserialized data, or 0 if the frame is truncated or 
+ * memory allocation fails.
  */
-size_t mip_deserialize_pdu(struct pdu *pdu, uint8_t *rcv_buf) {
-    size_t rcv_len = 0;
+size_t mip_deserialize_pdu(struct pdu *pdu, uint8_t *rcv_buf, size_t rcv_len) {
+    size_t offset = 0;
+
+    if (rcv_len < ETH_HDR_LEN + MIP_HDR_LEN) {
+        return 0;
+    }
 
     // Unpack ethernet header
-    pdu->ethhdr = (struct eth_hdr *)malloc(ETH_HDR_LEN);
     if (!pdu->ethhdr) {
-        // Handle memory allocation failure
-        return 0;
+        pdu->ethhdr = (struct eth_hdr *)malloc(ETH_HDR_LEN);
+        if (!pdu->ethhdr) {
+            // Handle memory allocation failure
+            return 0;
+        }
     }
-    memcpy(pdu->ethhdr, rcv_buf + rcv_len, ETH_HDR_LEN);
-    rcv_len += ETH_HDR_LEN;
+    memcpy(pdu->ethhdr, rcv_buf + offset, ETH_HDR_LEN);
+    offset += ETH_HDR_LEN;
 
-    pdu->miphdr = (struct mip_hdr *)malloc(MIP_HDR_LEN);
     if (!pdu->miphdr) {
-        // Handle memory allocation failure
-        free(pdu->ethhdr);
+        pdu->miphdr = (struct mip_hdr *)malloc(MIP_HDR_LEN);
+        if (!pdu->miphdr) {
+            // Handle memory allocation failure
+            return 0;
+        }
+    }
+    uint32_t header;
+    memcpy(&header, rcv_buf + offset, sizeof(header));
+    mip_unpack_header(ntohl(header), pdu->miphdr);
+    offset += MIP_HDR_LEN;
+
+    size_t sdu_bytes = pdu->miphdr->sdu_len * sizeof(uint32_t);
+    if (rcv_len - offset < sdu_bytes) {
         return 0;
     }
-    uint32_t *tmp = (uint32_t *) (rcv_buf + rcv_len);
-    uint32_t header = ntohl(*tmp);
-    pdu->miphdr->dst = (uint8_t) (header >> 24);
-    pdu->miphdr->src = (uint8_t) (header >> 16);
-    pdu->miphdr->ttl = (uint8_t) (((header >> 12) & 0xf));
-    pdu->miphdr->sdu_len = (uint8_t) ((header >> 3) & 0x3f);
-    pdu->miphdr->sdu_type = (uint8_t) (header & 0xf);
-    rcv_len += MIP_HDR_LEN;
 
-    pdu->sdu = (uint32_t *)calloc(pdu->miphdr->sdu_len, sizeof(uint32_t));
+    free(pdu->sdu);
+    pdu->sdu = (uint32_t *)calloc(pdu->miphdr->sdu_len ? pdu->miphdr->sdu_len : 1, sizeof(uint32_t));
     if (!pdu->sdu) {
         // Handle memory allocation failure
-        free(pdu->miphdr);
-        free(pdu->ethhdr);
         return 0;
     }
-    memcpy(pdu->sdu, rcv_buf + rcv_len, pdu->miphdr->sdu_len * sizeof(uint32_t));
-    rcv_len += pdu->miphdr->sdu_len * sizeof(uint32_t);
+    memcpy(pdu->sdu, rcv_buf + offset, sdu_bytes);
+    offset += sdu_bytes;
 
-    return rcv_len;
+    return offset;
 }
 
 /**
@@ -288,6 +324,53 @@ void destroy_pdu(struct pdu *pdu)
 }
 
 
+/**
+ * Set what happens to PDUs that wait too long in the ARP queue or a forward queue.
+ *
+ * fn: Called with every expired PDU after it has been counted, NULL to destroy them.
+ * ctx: Passed to 'fn' unchanged.
+ *
+ * The MIP daemon uses this to tell the sender that its message did not get through.
+ */
+void set_pending_expired(pending_expired_fn fn, void *ctx) {
+    expired_fn = fn;
+    expired_ctx = ctx;
+}
+
+/**
+ * Hand an expired PDU to the handler, or destroy it.
+ *
+ * pdu: The PDU, no longer in any queue.
+ */
+static void pending_expired(struct pdu *pdu) {
+    if (expired_fn != NULL) {
+        expired_fn(pdu, expired_ctx);
+    } else {
+        destroy_pdu(pdu);
+    }
+}
+
+/**
+ * Drop a PDU that has waited too long for its next hop to be resolved.
+ *
+ * arg: Slot of the ARP queue holding the PDU.
+ */
+static void arp_queue_expired(void *arg) {
+    struct pdu_queue_slot *slot = arg;
+    struct pdu *packet = slot->packet;
+
+    if (debug_mode) {
+        printf("Next hop %u not resolved, dropping packet to %u\n", slot->next_hop, packet->miphdr->dst);
+    }
+
+    slot->packet = NULL;
+    slot->is_occupied = 0;
+    arp_hop_size[slot->next_hop]--;
+    arp_expired++;
+
+    pending_expired(packet);
+}
+
 /**
  * Initialize the queue for storing PDUs awaiting ARP responses.
  * 
@@ -303,6 +386,7 @@ void initialize_queue_arp() {
     for (int i = 0; i < MAX_QUEUE_SIZE; i++) {
         queue_arp[i].packet = NULL;
         queue_arp[i].is_occupied = 0;
+        timer_init(&queue_arp[i].expiry, arp_queue_expired, &queue_arp[i]);
     }
 }
 
@@ -315,57 +399,141 @@ void initialize_queue_arp() {
  * This function finds the first unoccupied slot in the 'queue_arp' array and 
  * enqueues the provided PDU packet. It sets the 'next_hop' for the packet and 
  * marks the slot as occupied. The queue's capacity is determined by MAX_QUEUE_SIZE.
+ * The PDU is dropped if the next hop has not been resolved within ARP_QUEUE_TIMEOUT ms. 
+ * Every slot keeps the next hop and the timer of its own PDU, and at most ARP_QUEUE_HOP_LIMIT 
+ * PDUs wait for one next hop, so a neighbor that never answers cannot hold up the others.
  * 
- * Note: The function does not return a value and does not handle the scenario where 
- * the queue is full. It is assumed that the queue has enough space for the new packet.
+ * Returns 0 on success, -1 if the queue or the share of the next hop is full. The caller 
+ * still owns the packet then.
  */
-void enqueue_arp(struct pdu* packet, uint8_t next_hop) {
+int enqueue_arp(struct pdu* packet, uint8_t next_hop) {
+    if (arp_hop_size[next_hop] >= ARP_QUEUE_HOP_LIMIT) {
+        arp_drops++;
+        return -1;
+    }
+
     for (int i = 0; i < MAX_QUEUE_SIZE; i++) {
         if (!queue_arp[i].is_occupied) {
             queue_arp[i].packet = packet;
             queue_arp[i].next_hop = next_hop;  // Set the next hop
             queue_arp[i].is_occupied = 1;
+            queue_arp[i].seq = arp_seq++;
+            timer_add(&queue_arp[i].expiry, ARP_QUEUE_TIMEOUT);
+            arp_hop_size[next_hop]++;
+            return 0;
         }
     }
+    arp_drops++;
+    return -1;
 }
 
 
 /**
- * Remove and return a packet from the ARP queue based on a MAC address.
+ * Remove and return a packet from the ARP queue based on its next hop.
  * 
- * mac_address: MAC address used to identify the packet to be removed.
+ * next_hop: MIP address of the neighbor that has just been resolved.
  * 
- * This function iterates through the 'queue_arp' array, searching for a packet whose 
- * destination MAC address matches the provided 'mac_address'. Upon finding such a packet, 
- * the function removes it from the queue and returns it along with its associated next hop. 
+ * This function iterates through the 'queue_arp' array, searching for a packet waiting for 
+ * the given next hop. Upon finding the oldest such packet, the function removes it from the queue 
+ * and returns it along with its associated next hop. 
  * The packet and next hop are wrapped in a 'pdu_with_hop' structure. If no matching packet is found, 
  * the function returns a 'pdu_with_hop' structure initialized with NULL for the packet and 0 for the next hop.
  * 
  * Returns a 'pdu_with_hop' structure containing the packet and its next hop, or NULL and 0 if no match is found.
  */
-struct pdu_with_hop remove_packet_by_mac(uint8_t* mac_address) {
+struct pdu_with_hop remove_packet_by_next_hop(uint8_t next_hop) {
     struct pdu_with_hop result;
     result.packet = NULL; // Initialize to NULL
     result.next_hop = 0;  // Initialize with a default value
 
-    for (int i = 0; i < MAX_QUEUE_SIZE; i++) {
-        if (queue_arp[i].is_occupied && memcmp(queue_arp[i].packet->ethhdr->dst_mac, mac_address, MAC_ADDR_SIZE) == 0) {
-            result.packet = queue_arp[i].packet;
-            result.next_hop = queue_arp[i].next_hop;
+    struct pdu_queue_slot *oldest = NULL;
 
-            queue_arp[i].packet = NULL;
-            queue_arp[i].is_occupied = 0;
+    if (arp_hop_size[next_hop] == 0) {
+        return result;
+    }
 
-            return result; // Return the found packet and next_hop
+    // Slots are reused in any order, the sequence number keeps the PDUs to a hop in order
+    for (int i = 0; i < MAX_QUEUE_SIZE; i++) {
+        struct pdu_queue_slot *slot = &queue_arp[i];
+        if (slot->is_occupied && slot->next_hop == next_hop &&
+            (oldest == NULL || (int32_t) (slot->seq - oldest->seq) < 0)) {
+            oldest = slot;
         }
     }
-    return result; // No packet found, return the initialized result
+    if (oldest == NULL) {
+        return result; // No packet found, return the initialized result
+    }
+
+    result.packet = oldest->packet;
+    result.next_hop = oldest->next_hop;
+
+    oldest->packet = NULL;
+    oldest->is_occupied = 0;
+    timer_cancel(&oldest->expiry);
+    arp_hop_size[next_hop]--;
+
+    return result; // Return the found packet and next_hop
 }
 
 
 
 
 
+/**
+ * Unlink a node from a forward queue and free it.
+ * 
+ * queue: Pointer to the queue.
+ * prev: Node in front of 'node', NULL if 'node' is the front.
+ * node: Node to remove.
+ * 
+ * Returns the PDU the node held.
+ */
+static struct pdu* unlink_forward(struct queue_f* queue, struct queue_node* prev, struct queue_node* node) {
+    struct pdu* packet = node->packet;
+
+    if (prev == NULL) {
+        queue->front = node->next;
+    } else {
+        prev->next = node->next;
+    }
+    if (queue->rear == node) {
+        queue->rear = prev;
+    }
+
+    free(node);
+    queue->size--;
+    queue->dst_size[packet->miphdr->dst]--;
+    return packet;
+}
+
+/**
+ * Drop the PDUs at the front of a forward queue that have waited too long for a route.
+ *
+ * arg: The queue.
+ *
+ * PDUs are queued in the order they expire, so only the front is looked at. The timer is
+ * started again for the PDU that is at the front afterwards. A PDU waiting for one 
+ * destination never holds up the PDUs to the others, they are sent as their routes arrive, 
+ * see dequeue_forward_by_dst.
+ */
+static void forward_expired(void *arg) {
+    struct queue_f* queue = arg;
+    uint64_t now = now_ms();
+
+    while (queue->front != NULL && queue->front->expires <= now) {
+        if (debug_mode) {
+            printf("No route to %u in time, dropping packet\n", queue->front->packet->miphdr->dst);
+        }
+        struct pdu* packet = unlink_forward(queue, NULL, queue->front);
+        queue->expired++;
+        pending_expired(packet);
+    }
+
+    if (queue->front != NULL) {
+        timer_add(&queue->expiry, queue->front->expires - now);
+    }
+}
+
 /**
  * Initialize a FIFO queue for PDUs waiting for DVR replies.
  * 
@@ -375,12 +543,99 @@ struct pdu_with_hop remove_packet_by_mac(uint8_t* mac_address) {
  * pointers to NULL, indicating an empty queue. It also sets the size of the queue to 0. This 
  * queue is specifically used to store PDUs that are waiting for Dynamic Virtual Routing (DVR) replies.
  * 
+ * The queue holds FORWARD_QUEUE_LIMIT PDUs, a quarter of them for any one destination, and 
+ * drops new PDUs when full, see configure_queue_forward. A PDU still waiting after 
+ * FORWARD_QUEUE_TIMEOUT ms is dropped.
+ * 
  * Note: This function assumes that the queue structure has already been allocated.
  */
 void initialize_queue_forward(struct queue_f* queue) {
+    memset(queue, 0, sizeof(*queue));
     queue->front = NULL;
     queue->rear = NULL;
     queue->size = 0;
+    queue->limit = FORWARD_QUEUE_LIMIT;
+    queue->dst_limit = FORWARD_QUEUE_LIMIT / 4;
+    queue->policy = FORWARD_DROP_TAIL;
+    timer_init(&queue->expiry, forward_expired, queue);
+}
+
+/**
+ * Set the drop policy and size of a forward queue.
+ * 
+ * queue: Pointer to the queue, empty.
+ * spec: "tail", "head" or "red", optionally followed by ":<limit>", the most PDUs queued.
+ * 
+ * A quarter of the limit, but at least one PDU, is the most queued for any one destination, 
+ * so one unreachable destination cannot take the whole queue. RED starts dropping when its 
+ * average passes a quarter of the limit and drops every new PDU past three quarters.
+ * 
+ * Returns 0 on success, or -1 if the policy or the limit is not valid.
+ */
+int configure_queue_forward(struct queue_f* queue, const char *spec) {
+    static const char *names[] = { "tail", "head", "red" };
+    const char *colon = strchr(spec, ':');
+    size_t name_len = colon != NULL ? (size_t) (colon - spec) : strlen(spec);
+    int limit = colon != NULL ? atoi(colon + 1) : FORWARD_QUEUE_LIMIT;
+
+    if (limit < 1) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strlen(names[i]) == name_len && strncmp(spec, names[i], name_len) == 0) {
+            queue->policy = (enum forward_drop) i;
+            queue->limit = limit;
+            queue->dst_limit = limit >= 4 ? limit / 4 : 1;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Drop the oldest PDU to a destination, or the oldest of all, to make room.
+ * 
+ * queue: Pointer to the queue.
+ * dst: Destination MIP address, or -1 for any destination.
+ */
+static void drop_head(struct queue_f* queue, int dst) {
+    struct queue_node* prev = NULL;
+
+    for (struct queue_node* node = queue->front; node != NULL; prev = node, node = node->next) {
+        if (dst == -1 || node->packet->miphdr->dst == dst) {
+            destroy_pdu(unlink_forward(queue, prev, node));
+            queue->head_drops++;
+            return;
+        }
+    }
+}
+
+/**
+ * Decide whether RED drops a new PDU.
+ * 
+ * queue: Pointer to the queue.
+ * 
+ * The average queue length is updated on every arriving PDU. Below a quarter of the limit 
+ * nothing is dropped, from there the drop probability rises linearly to FORWARD_RED_MAX_P 
+ * percent at three quarters, and past that every PDU is dropped.
+ * 
+ * Returns 1 if the PDU is dropped, or 0 otherwise.
+ */
+static int red_drop(struct queue_f* queue) {
+    queue->red_avg += queue->size - (queue->red_avg >> FORWARD_RED_WEIGHT);
+
+    uint32_t avg = queue->red_avg >> FORWARD_RED_WEIGHT;
+    uint32_t min_th = queue->limit / 4;
+    uint32_t max_th = queue->limit * 3 / 4;
+
+    if (avg < min_th || max_th <= min_th) {
+        return 0;
+    }
+    if (avg >= max_th) {
+        return 1;
+    }
+    return (uint32_t) (random() % (100 * (max_th - min_th))) < FORWARD_RED_MAX_P * (avg - min_th);
 }
 
 /**
@@ -392,17 +647,50 @@ void initialize_queue_forward(struct queue_f* queue) {
  * This function creates a new queue node and enqueues the provided PDU packet into the 
  * specified FIFO queue. It handles the case where the queue is initially empty, as well 
  * as when it already contains packets. The function increases the queue size upon successful 
- * enqueueing. In case of a memory allocation failure for the new queue node, the function 
- * returns -1.
+ * enqueueing.
  * 
- * Returns 0 on successful enqueue, -1 on memory allocation failure.
+ * The queue is bounded in total and per destination. A PDU that does not fit is handled by 
+ * the drop policy of the queue, see configure_queue_forward: tail drop and RED destroy the 
+ * new PDU, head drop destroys the oldest PDU to the same destination, or the oldest of all 
+ * if the whole queue is full. The PDU is destroyed as well if no node can be allocated. Every 
+ * drop is counted.
+ * 
+ * Returns 0 if the PDU was queued without a drop, or -1 if a PDU was dropped.
  */
 int enqueue_forward(struct queue_f* queue, struct pdu* packet) {
+    uint8_t dst = packet->miphdr->dst;
+    int dropped = 0;
+
+    if (queue->policy == FORWARD_DROP_RED && queue->size < queue->limit &&
+        queue->dst_size[dst] < queue->dst_limit && red_drop(queue)) {
+        destroy_pdu(packet);
+        queue->early_drops++;
+        return -1;
+    }
+
+    if (queue->dst_size[dst] >= queue->dst_limit || queue->size >= queue->limit) {
+        if (queue->policy != FORWARD_DROP_HEAD) {
+            destroy_pdu(packet);
+            queue->tail_drops++;
+            return -1;
+        }
+        drop_head(queue, queue->dst_size[dst] >= queue->dst_limit ? dst : -1);
+        dropped = 1;
+    }
+
     struct queue_node* newNode = (struct queue_node*)malloc(sizeof(struct queue_node));
-    if (!newNode) return -1;  // Memory allocation failed
+    if (!newNode) {  // Memory allocation failed
+        destroy_pdu(packet);
+        queue->tail_drops++;
+        return -1;
+    }
 
     newNode->packet = packet;
     newNode->next = NULL;
+    newNode->expires = now_ms() + FORWARD_QUEUE_TIMEOUT;
+    if (!timer_pending(&queue->expiry)) {
+        timer_add(&queue->expiry, FORWARD_QUEUE_TIMEOUT);
+    }
 
     if (queue->rear == NULL) {  // If queue is empty
         queue->front = queue->rear = newNode;
@@ -412,7 +700,24 @@ int enqueue_forward(struct queue_f* queue, struct pdu* packet) {
     }
 
     queue->size++;
-    return 0;  // Success
+    queue->dst_size[dst]++;
+    return dropped ? -1 : 0;
+}
+
+/**
+ * Tell how full a forward queue is for a destination.
+ * 
+ * queue: Pointer to the queue.
+ * dst: Destination MIP address.
+ * 
+ * Returns the larger of the share of the destination's limit and the share of the whole 
+ * limit in use, in percent. At 100 the next PDU to the destination is dropped.
+ */
+int queue_forward_fill(const struct queue_f* queue, uint8_t dst) {
+    int dst_fill = queue->dst_size[dst] * 100 / queue->dst_limit;
+    int fill = queue->size * 100 / queue->limit;
+
+    return dst_fill > fill ? dst_fill : fill;
 }
 
 /**
@@ -430,15 +735,62 @@ int enqueue_forward(struct queue_f* queue, struct pdu* packet) {
 struct pdu* dequeue_forward(struct queue_f* queue) {
     if (queue->front == NULL) return NULL;  // Queue is empty
 
-    struct queue_node* temp = queue->front;
-    struct pdu* packet = temp->packet;
+    return unlink_forward(queue, NULL, queue->front);
+}
+
+/**
+ * Remove the first PDU for a destination from a FIFO queue of PDUs awaiting DVR replies.
+ * 
+ * queue: Pointer to the FIFO queue to search.
+ * dst: Destination MIP address of the PDU to remove.
+ * 
+ * Responses and route changes from the routing daemon are per destination, so they do not 
+ * pair up with the front of the queue. Calling this function until it returns NULL drains 
+ * every PDU waiting for the destination, in the order they were queued.
+ * 
+ * Returns a pointer to the removed PDU packet, or NULL if no PDU for the destination is queued.
+ */
+struct pdu* dequeue_forward_by_dst(struct queue_f* queue, uint8_t dst) {
+    struct queue_node* prev = NULL;
 
-    queue->front = queue->front->next;
-    if (queue->front == NULL) {
-        queue->rear = NULL;
+    if (queue->dst_size[dst] == 0) {
+        return NULL;
     }
 
-    free(temp);
-    queue->size--;
-    return packet;
-}
\ No newline at end of file
+    for (struct queue_node* node = queue->front; node != NULL; prev = node, node = node->next) {
+        if (node->packet->miphdr->dst == dst) {
+            return unlink_forward(queue, prev, node);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Count the PDUs a forward queue has dropped.
+ * 
+ * queue: Pointer to the queue.
+ * 
+ * Returns the sum of the tail, head and early drops.
+ */
+uint32_t queue_forward_drops(const struct queue_f* queue) {
+    return queue->tail_drops + queue->head_drops + queue->early_drops;
+}
+
+/**
+ * Print the counters of the queues of PDUs waiting for a route or a next hop.
+ * 
+ * queue: Pointer to the forward queue.
+ */
+void print_pending_stats(const struct queue_f* queue) {
+    int arp_size = 0;
+
+    for (int i = 0; i < MAX_QUEUE_SIZE; i++) {
+        arp_size += queue_arp[i].is_occupied;
+    }
+
+    printf("Pending PDUs:\n");
+    printf("\t forward queue %d tail drops %u head drops %u early drops %u expired %u\n", queue->size,
+           queue->tail_drops, queue->head_drops, queue->early_drops, queue->expired);
+    printf("\t ARP queue %d drops %u expired %u\n", arp_size, arp_drops, arp_expired);
+}
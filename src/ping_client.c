@@ -3,15 +3,12 @@
 #include <unistd.h>		/* standard symbolic constants and types */
 #include <string.h>		/* string operations (strncpy, memset..) */
 #include <time.h>        /* time functions */
+#include <errno.h>
 #include <sys/epoll.h>	/* epoll */
-#include <sys/socket.h>	/* sockets operations */
-#include <sys/un.h>		/* definitions for UNIX domain sockets */
 #include <sys/time.h>
 
 
-#include "ipc.h"
-#include "utils.h"
-#include "pdu.h"
+#include "libmip.h"
 
 
 
@@ -38,46 +35,21 @@ int main(int argc, char *argv[]) {
     parse_arguments(argc, argv, &socket_lower, &destination_host, &message, &ttl);
 
     
-    struct sockaddr_un addr;
-    char   buf[512];
-    uint32_t read_buf[128];
+    char read_buf[MIP_MSG_MAX + 1];
+    uint8_t src;
 
-    sd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    // Connect to the MIP daemon as a client for PING SDUs
+    sd = mip_open(socket_lower, MIP_ROLE_CLIENT, 0, NULL);
     if (sd < 0) {
-            perror("socket");
+            perror("mip_open");
             exit(EXIT_FAILURE);
     }
-
-    memset(&addr, 0, sizeof(addr));
-    addr.sun_family = AF_UNIX;
-    strncpy(addr.sun_path, socket_lower, sizeof(addr.sun_path) - 1);
-
-    rc = connect(sd, (struct sockaddr *)&addr, sizeof(addr));
-    if ( rc < 0) {
-            perror("connect");
-            close(sd);
-            exit(EXIT_FAILURE);
-
-    }
-
-    // Write identifier to socket
-    uint8_t identifier = 0x01;
-    rc = write(sd, &identifier, 1);
-    if (rc < 0) {
-        perror("write");
-        close(sd);
-        exit(EXIT_FAILURE);
-    }
     
     printf("Connected to %s\n", socket_lower);
 
 
     printf("Sending message to %s with TTL %s\n", destination_host, ttl);
 
-    fill_ping_buf(buf, sizeof(buf), destination_host, message, ttl);
-
-
-
 
 
 
@@ -103,10 +75,10 @@ int main(int argc, char *argv[]) {
     
     gettimeofday(&start, NULL);
 
-    // Write to socket
-    rc = write(sd, buf, strlen(buf));
+    // Send the PING
+    rc = mip_sendto(sd, message, strlen(message), atoi(destination_host), atoi(ttl));
     if (rc < 0) {
-        perror("write");
+        perror("mip_sendto");
         close(epfd);
         exit(EXIT_FAILURE);
     }
@@ -125,10 +97,10 @@ int main(int argc, char *argv[]) {
         return 0;
     }
 
-    // Read from socket
-    rc = read(sd, read_buf, sizeof(read_buf));
-    if (rc < 0) {
-        perror("read");
+    // Read the PONG
+    rc = mip_recvfrom(sd, read_buf, sizeof(read_buf) - 1, &src, NULL);
+    if (rc < 0 && errno != EHOSTUNREACH) {
+        perror("mip_recvfrom");
         close(epfd);
         exit(EXIT_FAILURE);
     }
@@ -140,17 +112,24 @@ int main(int argc, char *argv[]) {
     useconds = end.tv_usec - start.tv_usec;
     mtime = ((seconds) * 1000 + useconds/1000.0) + 0.5;
 
+    // The MIP daemon answers right away when there is no route to the destination
+    if (rc < 0) {
+        printf("Destination %u unreachable after %ld milliseconds.\n", src, mtime);
+        mip_close(sd);
+        exit(EXIT_FAILURE);
+    }
+    read_buf[rc] = '\0';
+
     // Check if the elapsed time has passed a certain threshold
     if (mtime > 5000.0) { // Assume a 5-second threshold
         printf("Operation took too long: %ld milliseconds.\n", mtime);
     } else {
         printf("Operation completed in time: %ld milliseconds.\n", mtime);
     }
-    char *str = uint32ArrayToString(read_buf);
-    printf("%s\n", str);
+    printf("PONG:%s\n", read_buf);
 
 
-    close(sd);
+    mip_close(sd);
     return 0;
 }
 
@@ -3,12 +3,7 @@
 #include <unistd.h>		/* standard symbolic constants and types */
 #include <string.h>		/* string operations (strncpy, memset..) */
 
-#include <sys/epoll.h>	/* epoll */
-#include <sys/socket.h>	/* sockets operations */
-#include <sys/un.h>		/* definitions for UNIX domain sockets */
-#include "ipc.h"
-#include "utils.h"
-#include "pdu.h"
+#include "libmip.h"
 
 
 
@@ -23,89 +18,45 @@ int main(int argc, char *argv[]) {
     // Call the function to parse arguments
     parse_arguments(argc, argv, &socket_lower);
 
-    struct sockaddr_un addr;
-    char   buf[512];
-    uint32_t read_buf[256];
+    char read_buf[MIP_MSG_MAX + 1];
+    uint8_t localMIP, src, ttl;
 
-    sd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    // Connect to the MIP daemon as a server for PING SDUs, it tells its MIP address
+    sd = mip_open(socket_lower, MIP_ROLE_SERVER, 0, &localMIP);
     if (sd < 0) {
-            perror("socket");
+            perror("mip_open");
             exit(EXIT_FAILURE);
     }
-
-    memset(&addr, 0, sizeof(addr));
-    addr.sun_family = AF_UNIX;
-    strncpy(addr.sun_path, socket_lower, sizeof(addr.sun_path) - 1);
-
-    rc = connect(sd, (struct sockaddr *)&addr, sizeof(addr));
-    if ( rc < 0) {
-            perror("connect");
-            close(sd);
-            exit(EXIT_FAILURE);
-    }
-
-    // Write identifier to socket
-    uint8_t identifier = 0x01;
-    rc = write(sd, &identifier, 1);
-    if (rc < 0) {
-        perror("write");
-        close(sd);
-        exit(EXIT_FAILURE);
-    }
-    
-
-    uint8_t localMIP;
-    rc = read(sd, &localMIP, 1); // Read a single byte for the MIP address
-    if (rc < 0) {
-        perror("read");
-        close(sd);
-        exit(EXIT_FAILURE);
-    }
-    else if (rc == 0) {
-        printf("No data read, possible disconnection.\n");
-        close(sd);
-        exit(EXIT_FAILURE);
-    }
-    else {
-        printf("Received MIP address: %u\n", localMIP);
-    }
+    printf("Received MIP address: %u\n", localMIP);
 
 
     while(1){
-        // Read from socket
-        rc = read(sd, read_buf, sizeof(read_buf));
+        // Read the next PING
+        rc = mip_recvfrom(sd, read_buf, sizeof(read_buf) - 1, &src, &ttl);
+        if (rc == 0) {
+            printf("No data read, possible disconnection.\n");
+            break;
+        }
         if (rc < 0) {
-            perror("read");
-            close(sd);
+            perror("mip_recvfrom");
+            mip_close(sd);
             exit(EXIT_FAILURE);
         }
+        read_buf[rc] = '\0';
+        printf("PING:%s\n", read_buf);
 
-
-        char *str = uint32ArrayToString(read_buf);
-        printf("%s\n", str);
-
-        char *destination_host = "11"; // Filler value
-        
-        // Fill the buffer with the pong message
-
-        fill_pong_buf(buf, sizeof(buf), destination_host, strcpy(str, str + 5));
-
-        free(str);
-
-        str = NULL;
-
-        // Write back
-        rc = write(sd, buf, sizeof(buf));
+        // Echo the text back, the daemon sends it to the node that sent the PING
+        rc = mip_sendto(sd, read_buf, rc, src, ttl);
         if (rc < 0) {
-            perror("write");
-            close(sd);
+            perror("mip_sendto");
+            mip_close(sd);
             exit(EXIT_FAILURE);
         }
 
 
     }
 
-    close(sd);
+    mip_close(sd);
     return 0;
 }
 
@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "ratelimit.h"
+#include "ether.h"
+#include "mip.h"
+#include "pdu.h"
+
+static struct token_bucket src_buckets[256];                // Frames per source MIP address
+static uint8_t src_configured[256];                         // 1 if the source has a rate of its own
+static struct token_bucket type_buckets[RATELIMIT_TYPES];   // Frames per SDU type, all sources together
+static uint32_t app_rate;                                   // Messages per second of each local client, 0 for no limit
+static uint32_t app_burst;
+static int frames_limited;                                  // 1 once a source or SDU type has a rate
+
+
+/**
+ * Set the rate of a token bucket and fill it.
+ *
+ * bucket: The bucket.
+ * rate: Frames or messages per second, 0 for no limit.
+ * burst: Most let through back to back, 0 for RATELIMIT_BURST_MS worth of the rate.
+ */
+void bucket_init(struct token_bucket *bucket, uint32_t rate, uint32_t burst) {
+    memset(bucket, 0, sizeof(*bucket));
+
+    if (burst == 0) {
+        burst = (uint64_t) rate * RATELIMIT_BURST_MS / 1000;
+    }
+    bucket->rate = rate;
+    bucket->burst = burst > 0 ? burst : 1;
+    bucket->tokens = (uint64_t) bucket->burst * 1000;
+}
+
+/**
+ * Add the tokens earned since the last refill.
+ *
+ * bucket: The bucket, limited.
+ * now: Current monotonic time in milliseconds.
+ */
+static void refill(struct token_bucket *bucket, uint64_t now) {
+    if (now > bucket->last) {
+        // The rate is per second, so it is the thousandths earned per millisecond
+        bucket->tokens += (now - bucket->last) * bucket->rate;
+        if (bucket->tokens > (uint64_t) bucket->burst * 1000) {
+            bucket->tokens = (uint64_t) bucket->burst * 1000;
+        }
+    }
+    bucket->last = now;
+}
+
+/**
+ * Let one frame or message through a token bucket, if the rate allows it.
+ *
+ * bucket: The bucket.
+ * now: Current monotonic time in milliseconds.
+ *
+ * Returns 1 if it may pass, or 0 if it must be dropped, which is counted.
+ */
+int bucket_take(struct token_bucket *bucket, uint64_t now) {
+    if (bucket->rate == 0) {
+        return 1;
+    }
+
+    refill(bucket, now);
+    if (bucket->tokens < 1000) {
+        bucket->dropped++;
+        return 0;
+    }
+
+    bucket->tokens -= 1000;
+    bucket->passed++;
+    return 1;
+}
+
+/**
+ * Configure a rate limit from the command line.
+ *
+ * spec: "<scope>=<rate>[/<burst>]", the rate per second. The scope is "app" for every local
+ *       ping application, "src" for every source MIP address, "src:<mip>" for one source,
+ *       which takes precedence over "src", or "type:<sdu_type>" for all frames of a SDU type.
+ *
+ * Each source, SDU type and application has a bucket of its own, a source limit does not
+ * share its rate with other sources.
+ *
+ * Returns 0 on success, or -1 if the specification is not valid.
+ */
+int ratelimit_configure(const char *spec) {
+    const char *value = strchr(spec, '=');
+    const char *slash;
+    char *end;
+
+    if (value == NULL) {
+        return -1;
+    }
+
+    long rate = strtol(value + 1, &end, 10);
+    long burst = 0;
+    if (end == value + 1 || rate < 0 || rate > UINT32_MAX / 1000) {
+        return -1;
+    }
+    if (*end == '/') {
+        slash = end;
+        burst = strtol(slash + 1, &end, 10);
+        if (end == slash + 1 || burst < 0 || burst > UINT32_MAX / 1000) {
+            return -1;
+        }
+    }
+    if (*end != '\0') {
+        return -1;
+    }
+
+    size_t scope_len = value - spec;
+    if (scope_len == 3 && strncmp(spec, "app", 3) == 0) {
+        app_rate = rate;
+        app_burst = burst;
+
+    } else if (scope_len == 3 && strncmp(spec, "src", 3) == 0) {
+        for (int mip = 0; mip < 256; mip++) {
+            if (!src_configured[mip]) {
+                bucket_init(&src_buckets[mip], rate, burst);
+            }
+        }
+        frames_limited |= rate != 0;
+
+    } else if (scope_len > 4 && strncmp(spec, "src:", 4) == 0) {
+        long mip = strtol(spec + 4, &end, 10);
+        if (end != value || mip < 0 || mip >= BROADCAST_MIP_ADDR) {
+            return -1;
+        }
+        bucket_init(&src_buckets[mip], rate, burst);
+        src_configured[mip] = 1;
+        frames_limited |= rate != 0;
+
+    } else if (scope_len > 5 && strncmp(spec, "type:", 5) == 0) {
+        long type = strtol(spec + 5, &end, 10);
+        if (end != value || type < 0 || type >= RATELIMIT_TYPES) {
+            return -1;
+        }
+        bucket_init(&type_buckets[type], rate, burst);
+        frames_limited |= rate != 0;
+
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Set up the bucket of a newly connected local application.
+ *
+ * bucket: The bucket of the application.
+ */
+void ratelimit_app_bucket(struct token_bucket *bucket) {
+    bucket_init(bucket, app_rate, app_burst);
+}
+
+/**
+ * Check whether received frames are rate limited at all.
+ *
+ * Returns 1 if a source or SDU type has a rate, or 0 if every frame is let through.
+ */
+int ratelimit_frames_limited(void) {
+    return frames_limited;
+}
+
+/**
+ * Let a received frame through the buckets of its source and SDU type.
+ *
+ * src: Source MIP address of the frame.
+ * sdu_type: SDU type of the frame.
+ * now: Current monotonic time in milliseconds.
+ *
+ * A token is only taken when both buckets have one, so a frame dropped for its source does
+ * not use up the rate of its SDU type, and the other way around.
+ *
+ * Returns 1 if the frame may be handled, or 0 if it must be dropped.
+ */
+int ratelimit_admit(uint8_t src, uint8_t sdu_type, uint64_t now) {
+    struct token_bucket *by_src = &src_buckets[src];
+    struct token_bucket *by_type = &type_buckets[sdu_type % RATELIMIT_TYPES];
+
+    if (by_src->rate != 0) {
+        refill(by_src, now);
+        if (by_src->tokens < 1000) {
+            by_src->dropped++;
+            return 0;
+        }
+    }
+    if (by_type->rate != 0) {
+        refill(by_type, now);
+        if (by_type->tokens < 1000) {
+            by_type->dropped++;
+            return 0;
+        }
+    }
+
+    bucket_take(by_src, now);
+    bucket_take(by_type, now);
+    return 1;
+}
+
+/**
+ * Let a frame read from the RAW socket through, before anything is allocated for it.
+ *
+ * frame: The frame as received, Ethernet header first.
+ * len: Length of the frame in bytes.
+ * now: Current monotonic time in milliseconds.
+ *
+ * Only the MIP header is looked at. A LINK frame is let through, the frames it carries are
+ * checked one by one once they are unwrapped, and a frame too short for a MIP header is left
+ * for mip_deserialize_pdu to reject.
+ *
+ * Returns 1 if the frame may be handled, or 0 if it must be dropped.
+ */
+int ratelimit_frame(const uint8_t *frame, size_t len, uint64_t now) {
+    uint32_t header;
+
+    if (len < ETH_HDR_LEN + MIP_HDR_LEN) {
+        return 1;
+    }
+
+    memcpy(&header, frame + ETH_HDR_LEN, sizeof(header));
+    header = ntohl(header);
+
+    uint8_t sdu_type = header & 0x7;
+    if (sdu_type == SDU_TYPE_LINK) {
+        return 1;
+    }
+
+    return ratelimit_admit((uint8_t) (header >> 16), sdu_type, now);
+}
+
+/**
+ * Print the counters of every limited source and SDU type.
+ */
+void ratelimit_print_stats(void) {
+    printf("Rate limits:\n");
+    for (int type = 0; type < RATELIMIT_TYPES; type++) {
+        const struct token_bucket *bucket = &type_buckets[type];
+        if (bucket->rate != 0) {
+            printf("\t SDU type %d rate %u/s burst %u passed %llu dropped %llu\n", type, bucket->rate, bucket->burst,
+                   (unsigned long long) bucket->passed, (unsigned long long) bucket->dropped);
+        }
+    }
+    for (int mip = 0; mip < 256; mip++) {
+        const struct token_bucket *bucket = &src_buckets[mip];
+        if (bucket->rate != 0 && bucket->passed + bucket->dropped > 0) {
+            printf("\t source %d rate %u/s burst %u passed %llu dropped %llu\n", mip, bucket->rate, bucket->burst,
+                   (unsigned long long) bucket->passed, (unsigned long long) bucket->dropped);
+        }
+    }
+}
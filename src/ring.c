@@ -0,0 +1,290 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+
+#include "ring.h"
+
+
+/**
+ * Map the shared memory and set up one end of it.
+ *
+ * end: The end to set up.
+ * memfd: File descriptor of the shared memory.
+ * daemon: 1 for the daemon's end, 0 for the application's.
+ *
+ * Returns 0 on success, or -1 on error.
+ */
+static int map_end(struct ring_end *end, int memfd, int daemon) {
+    end->shm = mmap(NULL, sizeof(struct ring_shm), PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (end->shm == MAP_FAILED) {
+        perror("mmap");
+        end->shm = NULL;
+        return -1;
+    }
+
+    end->tx = daemon ? &end->shm->to_app : &end->shm->to_daemon;
+    end->rx = daemon ? &end->shm->to_daemon : &end->shm->to_app;
+
+    return 0;
+}
+
+/**
+ * Create the shared memory for an application, the daemon's side.
+ *
+ * end: The daemon's end, set up by this function.
+ * app_fds: Array to store the descriptors the application needs, see ring_attach. The
+ *          caller passes them on, e.g. with send_fds, and then closes them.
+ *
+ * The shared memory holds a ring in each direction. Each side has an eventfd the other
+ * side writes to wake it, the daemon watches its own with epoll.
+ *
+ * Returns 0 on success, or -1 on error.
+ */
+int ring_create(struct ring_end *end, int app_fds[RING_FDS]) {
+    int memfd = memfd_create("mip-ring", MFD_CLOEXEC);
+
+    memset(end, 0, sizeof(*end));
+    end->wait_fd = -1;
+    end->notify_fd = -1;
+
+    if (memfd == -1) {
+        perror("memfd_create");
+        return -1;
+    }
+    if (ftruncate(memfd, sizeof(struct ring_shm)) == -1) {
+        perror("ftruncate");
+        close(memfd);
+        return -1;
+    }
+
+    end->wait_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    end->notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (end->wait_fd == -1 || end->notify_fd == -1) {
+        perror("eventfd");
+        close(memfd);
+        ring_close(end);
+        return -1;
+    }
+
+    // map_end reports its own error
+    if (map_end(end, memfd, 1) == -1) {
+        close(memfd);
+        ring_close(end);
+        return -1;
+    }
+
+    app_fds[0] = memfd;
+    app_fds[1] = end->notify_fd; // The application waits on what the daemon writes
+    app_fds[2] = end->wait_fd;
+
+    return 0;
+}
+
+/**
+ * Attach to the shared memory created by the daemon, the application's side.
+ *
+ * end: The application's end, set up by this function.
+ * app_fds: The descriptors from ring_create: the shared memory, the eventfd to wait on and
+ *          the eventfd to wake the daemon with. The shared memory descriptor is closed.
+ *
+ * Returns 0 on success, or -1 if the shared memory is too small or cannot be mapped.
+ */
+int ring_attach(struct ring_end *end, const int app_fds[RING_FDS]) {
+    struct stat st;
+
+    memset(end, 0, sizeof(*end));
+    end->wait_fd = app_fds[1];
+    end->notify_fd = app_fds[2];
+
+    if (fstat(app_fds[0], &st) == -1 || st.st_size < (off_t) sizeof(struct ring_shm)) {
+        fprintf(stderr, "Shared memory from the MIP daemon is too small\n");
+        close(app_fds[0]);
+        return -1;
+    }
+
+    int rc = map_end(end, app_fds[0], 0);
+    close(app_fds[0]);
+
+    return rc;
+}
+
+/**
+ * Unmap the shared memory and close the eventfds of one end.
+ *
+ * end: The end to close, it may already be closed.
+ */
+void ring_close(struct ring_end *end) {
+    if (end->shm != NULL) {
+        munmap(end->shm, sizeof(struct ring_shm));
+        end->shm = NULL;
+    }
+    if (end->wait_fd != -1) {
+        close(end->wait_fd);
+        end->wait_fd = -1;
+    }
+    if (end->notify_fd != -1) {
+        close(end->notify_fd);
+        end->notify_fd = -1;
+    }
+}
+
+/**
+ * Write a message to the ring this end produces.
+ *
+ * end: The producing end.
+ * msg: The message.
+ * len: Length of the message, at most RING_MSG_MAX bytes.
+ *
+ * The consumer is not woken, the caller does that with ring_notify once it has written a
+ * batch. When the ring is full the consumer is asked to wake this end once it has made
+ * room, see ring_wait.
+ *
+ * Returns 0 on success, or -1 if the ring is full or the message too long.
+ */
+int ring_push(struct ring_end *end, const void *msg, size_t len) {
+    struct ring *ring = end->tx;
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    if (len > RING_MSG_MAX) {
+        return -1;
+    }
+
+    if (tail - atomic_load_explicit(&ring->head, memory_order_acquire) == RING_SLOTS) {
+        // The flag must be visible before the last look, or a consumer that empties the
+        // ring in between would not know to wake this end
+        atomic_store(&ring->producer_waiting, 1);
+        if (tail - atomic_load(&ring->head) == RING_SLOTS) {
+            return -1;
+        }
+    }
+
+    struct ring_slot *slot = &ring->slots[tail % RING_SLOTS];
+    slot->len = len;
+    memcpy(slot->data, msg, len);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+    return 0;
+}
+
+/**
+ * Read a message from the ring this end consumes.
+ *
+ * end: The consuming end.
+ * buf: Buffer to store the message in.
+ * len: Size of the buffer, a longer message is cut.
+ *
+ * A producer waiting for room is not woken, the caller does that with ring_notify.
+ *
+ * Returns the length of the message, or -1 if the ring is empty.
+ */
+ssize_t ring_pop(struct ring_end *end, void *buf, size_t len) {
+    struct ring *ring = end->rx;
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    if (head == atomic_load_explicit(&ring->tail, memory_order_acquire)) {
+        return -1;
+    }
+
+    struct ring_slot *slot = &ring->slots[head % RING_SLOTS];
+    size_t msg_len = slot->len < len ? slot->len : len;
+    if (msg_len > RING_MSG_MAX) {
+        msg_len = RING_MSG_MAX;
+    }
+    memcpy(buf, slot->data, msg_len);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    return msg_len;
+}
+
+/**
+ * Ask to be woken when a message arrives, before going to sleep.
+ *
+ * end: The consuming end.
+ *
+ * A message written between the last ring_pop and this call would not wake this end, so
+ * the ring is looked at once more after the request is visible.
+ *
+ * Returns 1 if a message is waiting and the caller must not sleep, or 0 otherwise.
+ */
+int ring_arm(struct ring_end *end) {
+    atomic_store(&end->rx->consumer_waiting, 1);
+
+    return atomic_load(&end->rx->tail) != atomic_load(&end->rx->head);
+}
+
+/**
+ * Wake the other end if it sleeps on what this end just did.
+ *
+ * end: This end.
+ *
+ * Called after a batch of ring_push or ring_pop. The eventfd is only written when the other
+ * end asked for it, so a busy ring costs no system calls.
+ */
+void ring_notify(struct ring_end *end) {
+    uint64_t one = 1;
+    int wake = 0;
+
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (atomic_load_explicit(&end->tx->consumer_waiting, memory_order_relaxed) &&
+        atomic_load(&end->tx->tail) != atomic_load(&end->tx->head) &&
+        atomic_exchange(&end->tx->consumer_waiting, 0)) {
+        wake = 1;
+    }
+    if (atomic_load_explicit(&end->rx->producer_waiting, memory_order_relaxed) &&
+        atomic_exchange(&end->rx->producer_waiting, 0)) {
+        wake = 1;
+    }
+
+    if (wake && write(end->notify_fd, &one, sizeof(one)) == -1) {
+        perror("write");
+    }
+}
+
+/**
+ * Reset the eventfd of this end after it woke the caller.
+ *
+ * end: This end.
+ */
+void ring_clear(struct ring_end *end) {
+    uint64_t count;
+
+    if (read(end->wait_fd, &count, sizeof(count)) == -1 && errno != EAGAIN) {
+        perror("read");
+    }
+}
+
+/**
+ * Sleep until the other end wakes this one, the application's side.
+ *
+ * end: This end, armed with ring_arm or a full ring_push.
+ * control_fd: The socket connected to the daemon, a hangup ends the wait.
+ *
+ * Returns 0 when woken, or -1 if the daemon has gone away.
+ */
+int ring_wait(struct ring_end *end, int control_fd) {
+    struct pollfd fds[2] = {
+        { .fd = end->wait_fd, .events = POLLIN },
+        { .fd = control_fd, .events = 0 } // Hangups and errors are always reported
+    };
+
+    while (poll(fds, 2, -1) == -1) {
+        if (errno != EINTR) {
+            perror("poll");
+            return -1;
+        }
+    }
+
+    if (fds[1].revents & (POLLHUP | POLLERR)) {
+        return -1;
+    }
+
+    ring_clear(end);
+    return 0;
+}
@@ -21,6 +21,12 @@
 
 extern int route_fd;
 
+// Next hops last published to the MIP daemon
+static uint8_t publishedNextHop[MAX_NODES];
+static uint8_t publishedBackupHop[MAX_NODES];
+static int routesPublished = 0;
+static int timeoutRouteFd = -1; // Routing updates caused by a neighbor timeout are sent here
+
 /**
  * Initialize a routing table with default values.
  * 
@@ -38,6 +44,7 @@ void initializeRoutingTable(struct RoutingEntry* table, int size) {
     for (int i = 0; i < size; i++) {
         table[i].destination = i; // MIP address as the destination
         table[i].next_hop = -1;    // -1 indicates unknown next hop
+        table[i].backup_hop = -1;  // -1 indicates no loop-free alternate
         table[i].distance = INFINITY; // INFINITY for no known path
     }
 }
@@ -60,7 +67,7 @@ struct RoutingEntry lookupRoutingEntry(int mipAddress, struct RoutingEntry* rout
     if (mipAddress >= 0 && mipAddress < MAX_NODES) {
         return routingTable[mipAddress];
     } else {
-        struct RoutingEntry invalidEntry = {mipAddress, -1, INFINITY};
+        struct RoutingEntry invalidEntry = {mipAddress, -1, INFINITY, -1};
         return invalidEntry;
     }
 }
@@ -92,32 +99,37 @@ void updateRoutingTable(int sourceMIP, struct RoutingEntry receivedTable[MAX_NOD
 }
 
 /**
- * Check for timeouts in neighbor nodes and update the routing table accordingly.
+ * Process a neighbor that has not sent a Hello for TIMEOUT_INTERVAL seconds.
  * 
- * route_fd: File descriptor used for sending routing updates.
+ * arg: Pointer to the neighbor's entry in the neighborStatus array.
+ * 
+ * The neighbor is handled exactly like a liveness down event, including the switch to the 
+ * loop-free alternates and the routing update, and the changes are pushed to the MIP daemon.
+ */
+static void neighborTimeout(void *arg) {
+    int neighborMIP = (struct NeighborStatus *) arg - neighborStatus;
+
+    if (neighborTable[neighborMIP]) {
+        handleNeighborDown(timeoutRouteFd, neighborMIP);
+        publishRouteChanges(timeoutRouteFd);
+    }
+}
+
+/**
+ * Prepare the neighbor timeouts.
  * 
- * This function iterates through the neighbor table and checks if any neighbor has 
- * exceeded the TIMEOUT_INTERVAL without sending a 'hello' message. For neighbors that 
- * have timed out, it sets their entry in the neighbor table to 0 (indicating they are 
- * no longer reachable), updates their status in the neighborStatus array, and modifies 
- * their corresponding entry in the routing table to reflect the loss of the route 
- * (setting next_hop to -1 and distance to INFINITY). After updating the routing table 
- * for a timed-out neighbor, it sends a routing update using the 'sendUpdateFromApp' function.
+ * route_fd: File descriptor used for sending routing updates when a neighbor times out.
  * 
- * Note: The function relies on global arrays 'neighborTable', 'neighborStatus', and 'routingTable'.
+ * Every neighbor has a timer on the timer wheel, started by each Hello it sends, so no 
+ * neighbor table is scanned for timeouts. The timer wheel must be set up already.
+ * 
+ * Note: The function modifies the global array 'neighborStatus'.
  */
-void checkForNeighborTimeouts(int route_fd) {
-    time_t currentTime = time(NULL);
+void startNeighborTimers(int route_fd) {
+    timeoutRouteFd = route_fd;
+
     for (int i = 0; i < MAX_NODES; i++) {
-        if (neighborTable[i] && (currentTime - neighborStatus[i].lastHelloReceived > TIMEOUT_INTERVAL)) {
-            neighborTable[i] = 0;
-            neighborStatus[i].isReachable = 0;
-            routingTable[i].next_hop = -1;
-            routingTable[i].distance = INFINITY;
-            
-            // Send routing update
-            sendUpdateFromApp(route_fd);
-        }
+        timer_init(&neighborStatus[i].timeout, neighborTimeout, &neighborStatus[i]);
     }
 }
 
@@ -144,6 +156,24 @@ int getNextHopMIP(int destinationMIP) {
     return 255;  // Return 255 if the destination is invalid or unreachable
 }
 
+/**
+ * Get the loop-free alternate next hop for a given destination MIP.
+ * 
+ * destinationMIP: The MIP address of the destination node.
+ * 
+ * Returns the precomputed backup next hop for the destination, or 255 if the destination 
+ * is invalid, unreachable, or has no loop-free alternate.
+ */
+int getBackupHopMIP(int destinationMIP) {
+    if (destinationMIP >= 0 && destinationMIP < MAX_NODES) {
+        struct RoutingEntry entry = lookupRoutingEntry(destinationMIP, routingTable);
+        if (entry.distance != INFINITY && entry.backup_hop != -1) {
+            return entry.backup_hop;
+        }
+    }
+    return 255;
+}
+
 
 
 
@@ -157,6 +187,7 @@ int getNextHopMIP(int destinationMIP) {
  * If so, it marks this MIP address as a neighbor in the neighbor table. Additionally, if 
  * this is a new neighbor (indicated by no existing route to it in the routing table), the 
  * function initializes a direct route to this neighbor in the routing table with a cost of 1.
+ * The neighbor's timeout starts over, see startNeighborTimers.
  * 
  * Note: The function modifies global arrays 'neighborTable' and 'routingTable'.
  */
@@ -166,15 +197,99 @@ void handleHelloMessage(int MIPgreeter) {
     if (MIPgreeter >= 0 && MIPgreeter < MAX_NODES) {
         // Mark this MIP address as a neighbor
         neighborTable[MIPgreeter] = 1;
+        neighborStatus[MIPgreeter].isReachable = 1;
+        timer_add(&neighborStatus[MIPgreeter].timeout, TIMEOUT_INTERVAL * 1000);
 
         // If this is a new neighbor, initialize a direct route in the routing table
         if (routingTable[MIPgreeter].next_hop == -1) {
             routingTable[MIPgreeter].next_hop = MIPgreeter;
             routingTable[MIPgreeter].distance = 1; // Cost is always 1 for a direct route
+            routingTableHasChanged = 1;
         }
+
+        // A new neighbor may be an alternate for routes we already have
+        computeBackupRoutes();
     }
 }
 
+/**
+ * Process a neighbor up event from the MIP daemon.
+ * 
+ * neighborMIP: The MIP address of the neighbor that came up.
+ * 
+ * The MIP daemon runs a fast liveness protocol on the links and tells us as soon as a 
+ * neighbor starts answering. This is treated like a Hello message, so the direct route 
+ * is installed without waiting for the next Hello interval.
+ */
+void handleNeighborUp(int neighborMIP) {
+    handleHelloMessage(neighborMIP);
+}
+
+/**
+ * Process a neighbor down event from the MIP daemon.
+ * 
+ * route_fd: File descriptor used for sending routing updates.
+ * neighborMIP: The MIP address of the neighbor that went down.
+ * 
+ * The MIP daemon declares a neighbor down after a few missed liveness hellos, which is much 
+ * faster than TIMEOUT_INTERVAL. The neighbor is removed from the neighbor table and every 
+ * route that uses it as next hop is moved to its loop-free alternate, or invalidated if it 
+ * has none. A routing update is sent right away so the rest of the network reconverges 
+ * without waiting for the next update interval.
+ * 
+ * Note: The function modifies global arrays 'neighborTable', 'neighborStatus', 'neighborVectors', 
+ * and 'routingTable'.
+ */
+void handleNeighborDown(int route_fd, int neighborMIP) {
+    if (neighborMIP < 0 || neighborMIP >= MAX_NODES) {
+        return;
+    }
+
+    neighborTable[neighborMIP] = 0;
+    neighborStatus[neighborMIP].isReachable = 0;
+    timer_cancel(&neighborStatus[neighborMIP].timeout);
+
+    for (int i = 0; i < MAX_NODES; i++) {
+        neighborVectors[neighborMIP][i] = VECTOR_INFINITY;
+    }
+
+    for (int i = 0; i < MAX_NODES; i++) {
+        if (routingTable[i].next_hop != neighborMIP) {
+            continue;
+        }
+
+        // Fast reroute: switch to the precomputed loop-free alternate if there is one
+        int backup = routingTable[i].backup_hop;
+        if (backup != -1 && neighborTable[backup]) {
+            routingTable[i].next_hop = backup;
+            routingTable[i].distance = (backup == i) ? 1 : neighborVectors[backup][i] + 1;
+        } else {
+            routingTable[i].next_hop = -1;
+            routingTable[i].distance = INFINITY;
+        }
+    }
+
+    computeBackupRoutes();
+
+    // Send routing update
+    sendUpdateFromApp(route_fd);
+}
+
+/**
+ * Process a sync request from a neighbor.
+ * 
+ * route_fd: File descriptor used for sending routing updates.
+ * neighborMIP: The MIP address of the neighbor that sent the request.
+ * 
+ * A restarted routing daemon knows nothing, while its neighbors only send updates when their 
+ * own tables change. The sync request asks them for a full update right away. The request 
+ * also proves the neighbor is alive, so it is handled like a Hello message first.
+ */
+void handleSyncRequest(int route_fd, int neighborMIP) {
+    handleHelloMessage(neighborMIP);
+    sendUpdateFromApp(route_fd);
+}
+
 void handleUpdateMessage(uint8_t *updateMessage, int messageLength) {
     if (messageLength < 3 * MAX_NODES + 5) { // Check for minimum length (header + at least one entry)
         printf("Invalid update message length.\n");
@@ -182,25 +297,115 @@ void handleUpdateMessage(uint8_t *updateMessage, int messageLength) {
     }
 
     uint8_t senderMIP = updateMessage[0];
-    // Assuming updateMessage[1], updateMessage[2], and updateMessage[3] are 'U', 'P', 'D'
+    // Assuming updateMessage[2], updateMessage[3], and updateMessage[4] are 'U', 'P', 'D'
+
+    if (senderMIP >= MAX_NODES) {
+        return;
+    }
+
+    // Updates are only exchanged between neighbors, so the update also counts as a hello. After a
+    // restart this gives us the direct route before the resynchronized table is published.
+    handleHelloMessage(senderMIP);
+
+    // The update replaces everything we knew about the sender's distances
+    for (int i = 0; i < MAX_NODES; i++) {
+        neighborVectors[senderMIP][i] = VECTOR_INFINITY;
+    }
+    neighborVectors[senderMIP][senderMIP] = 0;
     
-    int index = 4; // Start reading after the header
+    int index = 5; // Start reading after the header
     while (index + 2 < messageLength) {
         uint8_t destination = updateMessage[index++];
         uint8_t next_hop = updateMessage[index++];
         uint8_t distance = updateMessage[index++];
 
-        // Poisoned Reverse Check: Ignore routes where this node is the next hop
+        // Updates are padded with zeroes, a zero distance is only valid for the sender itself
+        if (destination >= MAX_NODES || (distance == 0 && destination != senderMIP)) {
+            continue;
+        }
+
+        // Poisoned Reverse Check: Ignore routes where this node is the next hop. The sender 
+        // cannot be used as an alternate for them either, its path loops back through us.
         if (next_hop == localMIP) {
             continue;
         }
 
-        // Update the routing table
+        neighborVectors[senderMIP][destination] = distance;
+
+        // Update the routing table. A route through the sender always follows the sender's 
+        // current distance, other routes are only replaced by shorter ones.
         int newDistance = distance + 1; // Assuming direct link cost to senderMIP is 1
-        if (newDistance < routingTable[destination].distance) {
+        if (distance == VECTOR_INFINITY) {
+            newDistance = INFINITY;
+        }
+        if (newDistance < routingTable[destination].distance || routingTable[destination].next_hop == senderMIP) {
+            if (routingTable[destination].distance != newDistance) {
+                routingTableHasChanged = 1;
+            }
             routingTable[destination].distance = newDistance;
-            routingTable[destination].next_hop = senderMIP;
+            routingTable[destination].next_hop = newDistance == INFINITY ? -1 : senderMIP;
+        }
+    }
+
+    // Destinations the sender no longer advertises are unreachable through it
+    for (int i = 0; i < MAX_NODES; i++) {
+        if (i != senderMIP && routingTable[i].next_hop == senderMIP 
+            && neighborVectors[senderMIP][i] == VECTOR_INFINITY) {
+            routingTable[i].distance = INFINITY;
+            routingTable[i].next_hop = -1;
+            routingTableHasChanged = 1;
+        }
+    }
+
+    computeBackupRoutes();
+}
+
+/**
+ * Precompute a loop-free alternate next hop for every destination.
+ * 
+ * For each destination with a primary route, this function looks for another neighbor N 
+ * whose reported distance to the destination satisfies the loop-free condition 
+ * 
+ *     dist(N, D) < dist(N, self) + dist(self, D)
+ * 
+ * with dist(N, self) = 1 for a direct neighbor. Traffic sent to such a neighbor can never 
+ * come back through this node, so it is safe to switch to it the moment the primary 
+ * neighbor goes down, without waiting for the network to reconverge. If several neighbors 
+ * qualify, the one with the shortest path is used. Destinations without an alternate get 
+ * a backup_hop of -1.
+ * 
+ * Note: The function relies on global arrays 'neighborTable', 'neighborVectors', and 'routingTable'.
+ */
+void computeBackupRoutes(void) {
+    for (int d = 0; d < MAX_NODES; d++) {
+        int primary = routingTable[d].next_hop;
+        int best = -1;
+        int bestDistance = INFINITY;
+
+        routingTable[d].backup_hop = -1;
+
+        if (primary == -1 || routingTable[d].distance == INFINITY) {
+            continue;
+        }
+
+        for (int n = 0; n < MAX_NODES; n++) {
+            if (!neighborTable[n] || n == primary || n == localMIP) {
+                continue;
+            }
+
+            int distance = (n == d) ? 0 : neighborVectors[n][d];
+            if (distance == VECTOR_INFINITY) {
+                continue;
+            }
+
+            // Loop-free condition, the link from us to n has cost 1
+            if (distance < 1 + routingTable[d].distance && distance + 1 < bestDistance) {
+                best = n;
+                bestDistance = distance + 1;
+            }
         }
+
+        routingTable[d].backup_hop = best;
     }
 }
 
@@ -230,7 +435,8 @@ void handleRequestMessage(int route_fd, uint8_t *requestMessage, int messageLeng
     // Assuming requestMessage[2], requestMessage[3], and requestMessage[4] are 'R', 'E', 'Q'
     
     uint8_t next_hop = getNextHopMIP(destinationMIP);
-    sendResponseFromApp(route_fd, next_hop);
+    uint8_t backup_hop = getBackupHopMIP(destinationMIP);
+    sendResponseFromApp(route_fd, next_hop, backup_hop, destinationMIP);
 }
 
 /**
@@ -239,11 +445,14 @@ void handleRequestMessage(int route_fd, uint8_t *requestMessage, int messageLeng
  * route_fd: File descriptor for reading routing messages.
  * 
  * This function reads messages from the specified file descriptor and determines the type 
- * of each message based on its contents. It handles three types of messages: 'hello', 
- * 'routing update', and 'request'. For each type, it calls the respective handler function 
- * ('handleHelloMessage', 'handleUpdateMessage', 'handleRequestMessage'). If the message type 
+ * of each message based on its contents. It handles 'hello', 'routing update', 'request' and 
+ * 'sync request' messages, as well as the 'neighbor up' and 'neighbor down' events from the 
+ * liveness protocol in the MIP daemon. For each type, it calls the respective handler function 
+ * ('handleHelloMessage', 'handleUpdateMessage', 'handleRequestMessage', 'handleSyncRequest', 
+ * 'handleNeighborUp', 'handleNeighborDown'). If the message type 
  * is unrecognized, it prints an error message and exits the program. The function also handles 
- * read errors by printing an error message and exiting.
+ * read errors by printing an error message and exiting. Route changes caused by the message are 
+ * pushed to the MIP daemon before returning.
  * 
  * Note: The function assumes the presence of handler functions for different message types 
  * and makes use of 'read_buf' for storing incoming message data.
@@ -255,6 +464,11 @@ void handleIncomingMessages(int route_fd) {
         perror("read");
         close(route_fd);
         exit(EXIT_FAILURE);
+    } else if (rc == 0) {
+        // The MIP daemon is gone, it keeps forwarding on stale routes until we are restarted
+        printf("MIP daemon closed the connection.\n");
+        close(route_fd);
+        exit(EXIT_SUCCESS);
     } else {
         printf("Received %d bytes.\n", rc);
     }
@@ -269,6 +483,15 @@ void handleIncomingMessages(int route_fd) {
     } else if (read_buf[2] == 0x52 && read_buf[3] == 0x45 && read_buf[4] == 0x51) {
         printf("Received request message.\n");
         handleRequestMessage(route_fd, read_buf, rc);
+    } else if (read_buf[2] == 0x53 && read_buf[3] == 0x59 && read_buf[4] == 0x4E) {
+        printf("Received sync request.\n");
+        handleSyncRequest(route_fd, read_buf[0]);
+    } else if (read_buf[2] == 0x4C && read_buf[3] == 0x55 && read_buf[4] == 0x50 && rc >= 6) {
+        printf("Neighbor %u up.\n", read_buf[5]);
+        handleNeighborUp(read_buf[5]);
+    } else if (read_buf[2] == 0x4C && read_buf[3] == 0x44 && read_buf[4] == 0x4E && rc >= 6) {
+        printf("Neighbor %u down.\n", read_buf[5]);
+        handleNeighborDown(route_fd, read_buf[5]);
     } else {
         printf("Invalid message type.\n");
 
@@ -277,6 +500,9 @@ void handleIncomingMessages(int route_fd) {
         exit(EXIT_FAILURE);
 
     }
+
+    // Push whatever the message changed, so the MIP daemon does not have to ask for it
+    publishRouteChanges(route_fd);
 }
 
 
@@ -311,6 +537,173 @@ void sendHelloFromApp(int route_fd) {
     }
 }
 
+/**
+ * Send a sync request message from the application through the specified routing file descriptor.
+ * 
+ * route_fd: File descriptor used for sending the sync request.
+ * 
+ * This function constructs and sends a sync request using the specified file descriptor. The 
+ * message has the same layout as the Hello message, with ASCII values for 'SYN' as the type. 
+ * The MIP daemon broadcasts it, and every neighbor answers with a full routing update.
+ * 
+ * Note: The function assumes the presence of a global variable 'localMIP'.
+ */
+void sendSyncRequestFromApp(int route_fd) {
+    uint8_t syncMessage[] = {
+        localMIP,       // MIP address
+        0x00,           // TTL set to zero
+        0x53,           // ASCII for 'S'
+        0x59,           // ASCII for 'Y'
+        0x4E            // ASCII for 'N'
+    };
+
+    int bytes_sent = send(route_fd, syncMessage, sizeof(syncMessage), 0);
+    if (bytes_sent < 0) {
+        perror("send");
+    } else {
+        printf("Sync request sent.\n");
+    }
+}
+
+/**
+ * Send a route change to the MIP daemon.
+ * 
+ * route_fd: File descriptor used for sending the message.
+ * destinationMIP: Destination of the route.
+ * next_hop: Next hop for the destination.
+ * backup_hop: Loop-free alternate next hop, 255 if there is none.
+ * 
+ * Returns 0 on success, -1 if the message could not be sent.
+ */
+static int sendRouteChangeFromApp(int route_fd, int destinationMIP, int next_hop, int backup_hop) {
+    uint8_t routeMessage[] = {
+        localMIP,               // MIP address
+        0x00,                   // TTL set to zero
+        0x52,                   // ASCII for 'R'
+        0x54,                   // ASCII for 'T'
+        0x45,                   // ASCII for 'E'
+        destinationMIP,         // Destination
+        next_hop,               // Next hop for the destination
+        backup_hop              // Loop-free alternate next hop
+    };
+
+    if (send(route_fd, routeMessage, sizeof(routeMessage), 0) < 0) {
+        perror("send");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Send a route withdrawal to the MIP daemon.
+ * 
+ * route_fd: File descriptor used for sending the message.
+ * destinationMIP: Destination that is no longer reachable.
+ * 
+ * Returns 0 on success, -1 if the message could not be sent.
+ */
+static int sendRouteWithdrawFromApp(int route_fd, int destinationMIP) {
+    uint8_t withdrawMessage[] = {
+        localMIP,               // MIP address
+        0x00,                   // TTL set to zero
+        0x57,                   // ASCII for 'W'
+        0x44,                   // ASCII for 'D'
+        0x52,                   // ASCII for 'R'
+        destinationMIP          // Destination
+    };
+
+    if (send(route_fd, withdrawMessage, sizeof(withdrawMessage), 0) < 0) {
+        perror("send");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Publish the full routing table to the MIP daemon.
+ * 
+ * route_fd: File descriptor used for sending the routes.
+ * 
+ * This function sends one 'RTE' message for every destination with a valid route, carrying 
+ * the destination, next hop and backup next hop, followed by an 'EOR' (end of RIB) message. 
+ * The MIP daemon refreshes its forwarding table from the 'RTE' messages and, on 'EOR', drops 
+ * every stale route it kept from a previous run of this daemon. The published routes become 
+ * the snapshot later changes are pushed against, see publishRouteChanges.
+ * 
+ * Note: The function assumes the presence of a global variable 'localMIP' and a global 'routingTable' array.
+ */
+void sendRouteSyncFromApp(int route_fd) {
+    int routes = 0;
+
+    for (int i = 0; i < MAX_NODES; i++) {
+        publishedNextHop[i] = getNextHopMIP(i);
+        publishedBackupHop[i] = getBackupHopMIP(i);
+
+        if (publishedNextHop[i] == 255) {
+            continue;
+        }
+
+        if (sendRouteChangeFromApp(route_fd, i, publishedNextHop[i], publishedBackupHop[i]) < 0) {
+            return;
+        }
+        routes++;
+    }
+
+    routesPublished = 1;
+
+    uint8_t endMessage[] = {
+        localMIP,       // MIP address
+        0x00,           // TTL set to zero
+        0x45,           // ASCII for 'E'
+        0x4F,           // ASCII for 'O'
+        0x52            // ASCII for 'R'
+    };
+
+    if (send(route_fd, endMessage, sizeof(endMessage), 0) < 0) {
+        perror("send");
+    } else {
+        printf("Published %d routes.\n", routes);
+    }
+}
+
+/**
+ * Push routing table changes to the MIP daemon.
+ * 
+ * route_fd: File descriptor used for sending the changes.
+ * 
+ * This function compares the next hops in the routing table with the ones last published. 
+ * A new or changed route is sent as an 'RTE' message, a route that is no longer reachable 
+ * as a 'WDR' (withdraw) message carrying only the destination. The MIP daemon keeps the 
+ * published routes in its forwarding table, so it does not have to ask for a next hop per 
+ * packet. Nothing is pushed before the full table has been published once.
+ * 
+ * Returns the number of changes that were pushed.
+ */
+int publishRouteChanges(int route_fd) {
+    int changes = 0;
+
+    for (int i = 0; routesPublished && i < MAX_NODES; i++) {
+        uint8_t next_hop = getNextHopMIP(i);
+        uint8_t backup_hop = getBackupHopMIP(i);
+
+        if (next_hop == publishedNextHop[i] && backup_hop == publishedBackupHop[i]) {
+            continue;
+        }
+
+        int rc = next_hop == 255 ? sendRouteWithdrawFromApp(route_fd, i)
+                                 : sendRouteChangeFromApp(route_fd, i, next_hop, backup_hop);
+        if (rc < 0) {
+            break;
+        }
+
+        publishedNextHop[i] = next_hop;
+        publishedBackupHop[i] = backup_hop;
+        changes++;
+    }
+
+    return changes;
+}
+
 /**
  * Send a routing update message from the application through the specified routing file descriptor.
  * 
@@ -326,6 +719,7 @@ void sendHelloFromApp(int route_fd) {
  */
 void sendUpdateFromApp(int route_fd) {
     uint8_t updateMessage[3 * MAX_NODES + 5]; // Header + 5 bytes for each entry
+    memset(updateMessage, 0, sizeof(updateMessage)); // Unused entries are sent as zero padding
     updateMessage[0] = localMIP; // MIP address of the sender
     updateMessage[1] = 0x00;     // TTL set to zero
     updateMessage[2] = 0x55;     // 'U'
@@ -342,7 +736,8 @@ void sendUpdateFromApp(int route_fd) {
         }
     }
 
-    int bytes_sent = send(route_fd, updateMessage, messageLength, 0);
+    // mipd always forwards a full-size update, send the padding so it never sees stale bytes
+    int bytes_sent = send(route_fd, updateMessage, sizeof(updateMessage), 0);
     if (bytes_sent < 0) {
         perror("send");
     } else {
@@ -356,22 +751,28 @@ void sendUpdateFromApp(int route_fd) {
  * 
  * route_fd: File descriptor used for sending the response message.
  * next_hop: The next hop MIP address to be included in the response message.
+ * backup_hop: The loop-free alternate next hop, or 255 if there is none.
+ * destinationMIP: The destination the response is for.
  * 
  * This function constructs a response message including the local MIP address, a TTL value set 
- * to zero, ASCII values for 'RES', and the provided next hop MIP address. The message is then 
- * sent using the specified file descriptor. The function handles sending errors by printing an 
- * error message. On successful sending, it prints a confirmation message.
+ * to zero, ASCII values for 'RES', the provided next hop MIP address, the backup next hop and the 
+ * destination. The MIP daemon keeps the backup so it can switch to it as soon as it sees the 
+ * primary neighbor go down. The message is then sent using the specified file descriptor. The 
+ * function handles sending errors by printing an error message. On successful sending, it prints 
+ * a confirmation message.
  * 
  * Note: The function assumes the presence of a global variable 'localMIP'.
  */
-void sendResponseFromApp(int route_fd, int next_hop) {
+void sendResponseFromApp(int route_fd, int next_hop, int backup_hop, int destinationMIP) {
     uint8_t responseMessage[] = {
         localMIP,       // MIP address
         0x00,           // TTL set to zero
         0x52,           // ASCII for 'R'
         0x45,           // ASCII for 'E'
         0x53,           // ASCII for 'S'
-        next_hop        // Next hop for the destination
+        next_hop,       // Next hop for the destination
+        backup_hop,     // Loop-free alternate next hop
+        destinationMIP  // Destination the response is for
     };
 
     int bytes_sent = send(route_fd, responseMessage, sizeof(responseMessage), 0);
@@ -381,5 +782,3 @@ void sendResponseFromApp(int route_fd, int next_hop) {
         printf("Response message sent.\n");
     }
 }
-
-
@@ -7,7 +7,7 @@
 #include <linux/if_packet.h>
 #include <net/ethernet.h>
 #include <arpa/inet.h>
-#include <pthread.h>
+#include <errno.h>
 #include <sys/un.h>      /* definitions for UNIX domain sockets */
 
 #include "arp.h"
@@ -17,20 +17,27 @@
 #include "mip.h"
 #include "ipc.h"
 #include "route.h"
+#include "timer.h"
 
 #define HELLO_INTERVAL 10    // Interval in seconds for sending hello messages
 #define TIMEOUT_INTERVAL 30  // Seconds
+#define SYNC_DELAY 3         // Seconds to collect neighbor updates before republishing routes
+#define ROUTE_TICK 100       // Milliseconds between timer ticks, the resolution of the timer wheel
 
 struct NeighborStatus neighborStatus[MAX_NODES];
 uint8_t localMIP;  // Global variable for local MIP
 struct RoutingEntry routingTable[MAX_NODES];
 int routingTableHasChanged = 0;  // Global flag for routing table change
 int neighborTable[MAX_NODES];     // 1 indicates a neighbor, 0 otherwise
+uint8_t neighborVectors[MAX_NODES][MAX_NODES]; // Distances last reported by each neighbor
+
+static struct timer syncTimer;  // Expires when the routes are republished after a restart
+static struct timer helloTimer; // Expires when the next Hello is due
 
 
 // Function prototypes
-void *sendMessagesThread(void *arg);
-void *receiveMessagesThread(void *arg);
+void syncTimerExpired(void *arg);
+void helloTimerExpired(void *arg);
 void parse_arguments(int argc, char *argv[], int *debug_mode, char **socket_lower);
 
 int main(int argc, char *argv[]) {
@@ -78,48 +85,77 @@ int main(int argc, char *argv[]) {
     }
     printf("Received MIP address: %u\n", localMIP);
 
-    pthread_t send_thread, receive_thread;
+    // Nothing is known yet, every destination is unreachable
+    initializeRoutingTable(routingTable, MAX_NODES);
+    memset(neighborVectors, VECTOR_INFINITY, sizeof(neighborVectors));
 
-    // Create threads
-    if (pthread_create(&send_thread, NULL, sendMessagesThread, &route_fd) != 0 ||
-        pthread_create(&receive_thread, NULL, receiveMessagesThread, &route_fd) != 0) {
-        perror("pthread_create");
+    // Messages from the MIP daemon and the timer wheel are handled in one event loop
+    int epoll_fd = epoll_create1(0);
+    int timer_fd = timer_wheel_init(ROUTE_TICK);
+    if (epoll_fd == -1 || timer_fd == -1 ||
+        add_to_epoll_table(epoll_fd, route_fd) == -1 || add_to_epoll_table(epoll_fd, timer_fd) == -1) {
+        perror("epoll");
         close(route_fd);
         exit(EXIT_FAILURE);
     }
+    startNeighborTimers(route_fd);
+    timer_init(&syncTimer, syncTimerExpired, &route_fd);
+    timer_init(&helloTimer, helloTimerExpired, &route_fd);
+
+    // The MIP daemon may still forward on routes from a previous run of this daemon. Relearn 
+    // the network from full neighbor updates, then publish the result so it can drop the rest.
+    sendHelloFromApp(route_fd);
+    sendSyncRequestFromApp(route_fd);
+    timer_add(&syncTimer, SYNC_DELAY * 1000);
 
-    // Join threads or handle as needed
-    pthread_join(send_thread, NULL);
-    pthread_join(receive_thread, NULL);
+    while (1) {
+        struct epoll_event event;
+
+        rc = epoll_wait(epoll_fd, &event, 1, -1);
+        if (rc == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            close(route_fd);
+            exit(EXIT_FAILURE);
+        }
+
+        if (event.data.fd == route_fd) {
+            handleIncomingMessages(route_fd);
+        } else if (event.data.fd == timer_fd) {
+            uint64_t expirations;
+            rc = read(timer_fd, &expirations, sizeof(expirations));
+
+            // Hellos, the republishing after a restart and neighbor timeouts
+            timer_run(now_ms());
+        }
+    }
 
     close(route_fd);
     return 0;
 }
 
-// Send messages to the main deamon
-void *sendMessagesThread(void *arg) {
+// Publish the routes relearned after a restart, then start sending Hellos
+void syncTimerExpired(void *arg) {
     int route_fd = *((int *)arg);
-    while (1) {
-        sendHelloFromApp(route_fd);
-        if (routingTableHasChanged) {
-            sendUpdateFromApp(route_fd);
-            routingTableHasChanged = 0;
-        }
 
-        
-        checkForNeighborTimeouts(route_fd);
-        sleep(HELLO_INTERVAL);
-    }
-    return NULL;
+    sendRouteSyncFromApp(route_fd);
+    helloTimerExpired(arg);
 }
 
-// Receive messages from the main deamon
-void *receiveMessagesThread(void *arg) {
+// Send a Hello, and a routing update if the table changed since the last one
+void helloTimerExpired(void *arg) {
     int route_fd = *((int *)arg);
-    while (1) {
-        handleIncomingMessages(route_fd);
+
+    sendHelloFromApp(route_fd);
+    if (routingTableHasChanged) {
+        sendUpdateFromApp(route_fd);
+        routingTableHasChanged = 0;
     }
-    return NULL;
+    publishRouteChanges(route_fd);
+
+    timer_add(&helloTimer, HELLO_INTERVAL * 1000);
 }
 
 // Parse command line arguments
@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "timer.h"
+#include "ipc.h"
+#include "utils.h"
+
+// Level 'n' has TIMER_SLOTS slots of TIMER_SLOTS^n ticks each
+static struct timer *wheel[TIMER_LEVELS][TIMER_SLOTS];
+static uint32_t tick;       // Milliseconds per tick
+static uint64_t origin;     // Monotonic time in ms of tick 0
+static uint64_t clk;        // Next tick to run, every tick before it has been run
+static size_t pending;      // Timers in the wheel
+
+
+/**
+ * Set up the timer wheel of the daemon.
+ *
+ * tick_ms: Resolution of the wheel in milliseconds.
+ *
+ * Timers expire on the first tick at or after their expiry time, never earlier, and the
+ * wheel reaches TIMER_SLOTS^TIMER_LEVELS ticks ahead. A timer further out is clamped to that.
+ *
+ * Returns a periodic timer descriptor for the event loop, which calls timer_run whenever it
+ * is readable, or -1 on failure.
+ */
+int timer_wheel_init(uint32_t tick_ms) {
+    memset(wheel, 0, sizeof(wheel));
+    tick = tick_ms > 0 ? tick_ms : 1;
+    origin = now_ms();
+    clk = 0;
+    pending = 0;
+
+    return create_timer_fd(tick);
+}
+
+/**
+ * Prepare a timer, not pending.
+ *
+ * timer: The timer.
+ * fn: Called when the timer expires.
+ * arg: Passed to fn.
+ */
+void timer_init(struct timer *timer, timer_fn fn, void *arg) {
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->expires = 0;
+    timer->fn = fn;
+    timer->arg = arg;
+}
+
+/**
+ * Put a timer in the slot for its expiry tick.
+ *
+ * timer: The timer, not pending.
+ *
+ * A timer is kept on the lowest level that still reaches its expiry tick. Timers on the
+ * higher levels move down a level whenever the level below has gone round once, see
+ * cascade. A timer that is already due goes into the slot of the next tick to run.
+ */
+static void enqueue(struct timer *timer) {
+    uint64_t expires = timer->expires;
+    uint64_t delta = expires - clk;
+    int level = 0;
+
+    if (expires < clk) {
+        expires = clk;
+    } else {
+        uint64_t limit = (uint64_t) 1 << (TIMER_BITS * TIMER_LEVELS);
+        if (delta >= limit) {
+            expires = clk + limit - 1;
+        }
+        while (level < TIMER_LEVELS - 1 && (expires - clk) >= (uint64_t) 1 << (TIMER_BITS * (level + 1))) {
+            level++;
+        }
+    }
+
+    struct timer **slot = &wheel[level][(expires >> (TIMER_BITS * level)) & TIMER_MASK];
+
+    timer->next = *slot;
+    if (*slot != NULL) {
+        (*slot)->pprev = &timer->next;
+    }
+    *slot = timer;
+    timer->pprev = slot;
+}
+
+/**
+ * Start a timer, or restart it if it is pending.
+ *
+ * timer: The timer, see timer_init.
+ * delay_ms: Milliseconds from now until it expires.
+ *
+ * Takes constant time whatever the number of timers.
+ */
+void timer_add(struct timer *timer, uint64_t delay_ms) {
+    timer_cancel(timer);
+
+    timer->expires = (now_ms() - origin + delay_ms + tick - 1) / tick;
+    enqueue(timer);
+    pending++;
+}
+
+/**
+ * Stop a timer.
+ *
+ * timer: The timer, nothing happens if it is not pending.
+ *
+ * Takes constant time whatever the number of timers.
+ */
+void timer_cancel(struct timer *timer) {
+    if (timer->pprev == NULL) {
+        return;
+    }
+
+    *timer->pprev = timer->next;
+    if (timer->next != NULL) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+    pending--;
+}
+
+/**
+ * Check whether a timer is waiting to expire.
+ *
+ * timer: The timer.
+ *
+ * Returns 1 if it is pending, or 0 otherwise.
+ */
+int timer_pending(const struct timer *timer) {
+    return timer->pprev != NULL;
+}
+
+/**
+ * Count the timers that are waiting to expire.
+ *
+ * Returns the number of pending timers.
+ */
+size_t timer_count(void) {
+    return pending;
+}
+
+/**
+ * Move the timers of one slot of a higher level down to the levels below.
+ *
+ * level: Level of the slot, at least 1.
+ * index: Index of the slot.
+ *
+ * Returns 1 if the slot was the first of its level, so the level above has gone round too.
+ */
+static int cascade(int level, int index) {
+    struct timer *timer = wheel[level][index];
+
+    wheel[level][index] = NULL;
+    while (timer != NULL) {
+        struct timer *next = timer->next;
+        enqueue(timer);
+        timer = next;
+    }
+
+    return index == 0;
+}
+
+/**
+ * Run every timer that has expired.
+ *
+ * now: Current monotonic time in milliseconds.
+ *
+ * This function is called when the descriptor from timer_wheel_init is readable. Every tick
+ * up to now is run, even if some wakeups were missed, and only the slot of each tick is
+ * looked at, so the cost does not grow with the number of pending timers. A callback may add
+ * or cancel any timer, including its own, a timer added for a tick that has passed expires
+ * on the next tick.
+ */
+void timer_run(uint64_t now) {
+    uint64_t target = (now - origin) / tick;
+
+    while (clk <= target) {
+        int index = clk & TIMER_MASK;
+
+        // Level 0 has gone round, bring the next stretch of timers down from above
+        if (index == 0) {
+            for (int level = 1; level < TIMER_LEVELS; level++) {
+                if (!cascade(level, (clk >> (TIMER_BITS * level)) & TIMER_MASK)) {
+                    break;
+                }
+            }
+        }
+
+        struct timer *expired = wheel[0][index];
+        wheel[0][index] = NULL;
+        if (expired != NULL) {
+            expired->pprev = &expired;
+        }
+        clk++;
+
+        // Detach each timer before its callback, which may add it again
+        while (expired != NULL) {
+            struct timer *timer = expired;
+
+            expired = timer->next;
+            if (expired != NULL) {
+                expired->pprev = &expired;
+            }
+            timer->next = NULL;
+            timer->pprev = NULL;
+            pending--;
+
+            timer->fn(timer->arg);
+        }
+    }
+}
@@ -0,0 +1,721 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+
+#include "transport.h"
+#include "utils.h"
+#include "pack.h"
+#include "mip.h"
+#include "ring.h"
+
+static struct transport_conn conns[TRANSPORT_MAX_CONNS];
+static transport_output output_fn; // Sends a segment, provided by the MIP daemon
+static void *output_ctx;           // Passed back to output_fn
+static int app = -1;               // Socket of the transport application, -1 if none is connected
+static struct ring_end *app_ring;  // Shared memory of the application, NULL if it uses the socket
+static const struct transport_cc *cc = &transport_cc_aimd; // Congestion controller of new connections
+
+// Congestion controllers that can be selected by name
+static const struct transport_cc *controllers[] = { &transport_cc_aimd, &transport_cc_fixed };
+
+static void rto_expired(void *arg);
+static void deliver_expired(void *arg);
+
+
+/**
+ * Initialize the transport protocol.
+ *
+ * output: Function that sends a SDU_TYPE_TRANSPORT SDU to a MIP address.
+ * ctx: Passed to 'output' unchanged.
+ *
+ * This function forgets every connection.
+ */
+void transport_init(transport_output output, void *ctx) {
+    memset(conns, 0, sizeof(conns));
+    output_fn = output;
+    output_ctx = ctx;
+    app = -1;
+}
+
+/**
+ * Select the congestion controller.
+ *
+ * name: Name of the controller, "aimd" or "fixed".
+ *
+ * Only connections opened afterwards use the new controller.
+ *
+ * Returns 0 on success, or -1 if there is no controller with that name.
+ */
+int transport_set_cc(const char *name) {
+    for (size_t i = 0; i < sizeof(controllers) / sizeof(controllers[0]); i++) {
+        if (strcmp(controllers[i]->name, name) == 0) {
+            cc = controllers[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Set the socket received data is delivered to.
+ *
+ * app_fd: Socket of the transport application, -1 when it has disconnected.
+ *
+ * Segments are not acknowledged while no application is connected, so the sender keeps
+ * them until one is. What the previous application did not take goes to the new one.
+ */
+void transport_set_app(int app_fd) {
+    app = app_fd;
+    app_ring = NULL;
+
+    for (int i = 0; app != -1 && i < TRANSPORT_MAX_CONNS; i++) {
+        if (conns[i].valid && conns[i].rcv_delivered != conns[i].rcv_nxt) {
+            timer_add(&conns[i].deliver_timer, 0);
+        }
+    }
+}
+
+/**
+ * Deliver received data through shared memory instead of the application socket.
+ *
+ * ring: The daemon's end of the rings of the application, NULL to go back to the socket.
+ *
+ * Called after transport_set_app, which keeps the socket to tell whether an application is
+ * connected.
+ */
+void transport_set_app_ring(struct ring_end *ring) {
+    app_ring = ring;
+}
+
+/**
+ * Find the connection to a port on a peer, or open one.
+ *
+ * peer: MIP address of the peer.
+ * port: Port.
+ * now: Current monotonic time in milliseconds.
+ *
+ * A new connection takes its epoch from the clock, so a restarted MIP daemon never reuses
+ * the sequence numbers of its previous run. Connections are never closed, the table only
+ * holds TRANSPORT_MAX_CONNS of them.
+ *
+ * Returns a pointer to the connection, or NULL if the table is full.
+ */
+static struct transport_conn *conn_lookup(uint8_t peer, uint8_t port, uint64_t now) {
+    struct transport_conn *free_conn = NULL;
+
+    for (int i = 0; i < TRANSPORT_MAX_CONNS; i++) {
+        struct transport_conn *conn = &conns[i];
+
+        if (conn->valid && conn->peer == peer && conn->port == port) {
+            return conn;
+        }
+        if (!conn->valid && free_conn == NULL) {
+            free_conn = conn;
+        }
+    }
+
+    if (free_conn == NULL) {
+        return NULL;
+    }
+
+    memset(free_conn, 0, sizeof(*free_conn));
+    free_conn->valid = 1;
+    free_conn->peer = peer;
+    free_conn->port = port;
+    free_conn->local_epoch = (uint32_t) now | 1;
+    free_conn->rto = TRANSPORT_INITIAL_RTO;
+    free_conn->peer_rwnd = TRANSPORT_WINDOW;
+    timer_init(&free_conn->rto_timer, rto_expired, free_conn);
+    timer_init(&free_conn->deliver_timer, deliver_expired, free_conn);
+    cc->init(free_conn);
+
+    return free_conn;
+}
+
+/**
+ * Send a segment.
+ *
+ * conn: Connection the segment belongs to.
+ * kind: TRANSPORT_DATA or TRANSPORT_ACK, with any flags.
+ * field: Payload length in bytes of a DATA segment, receive window in segments of an ACK.
+ * epoch: Epoch of the sender the segment belongs to.
+ * seq: Sequence number of a DATA segment, cumulative acknowledgement of an ACK.
+ * sack: Selective acknowledgement bitmap of an ACK, 0 for DATA.
+ * data: Payload, NULL for an ACK.
+ * len: Payload length in bytes.
+ *
+ * The first header word carries the kind and flags, the port and 'field'. The following 
+ * words carry the epoch, the sequence number and the SACK bitmap. Bit i of the bitmap is set
+ * when the receiver holds the segment i + 1 past the cumulative ACK.
+ */
+static void send_segment(struct transport_conn *conn, uint8_t kind, uint16_t field, uint32_t epoch, uint32_t seq,
+                         uint32_t sack, const uint8_t *data, size_t len) {
+    uint32_t sdu[TRANSPORT_HDR_WORDS + TRANSPORT_MSS / 4];
+
+    sdu[0] = ((uint32_t) kind << 24) | ((uint32_t) conn->port << 16) | field;
+    sdu[1] = epoch;
+    sdu[2] = seq;
+    sdu[3] = sack;
+
+    size_t words = TRANSPORT_HDR_WORDS + pack_words(sdu + TRANSPORT_HDR_WORDS, data, len);
+
+    output_fn(output_ctx, conn->peer, sdu, words);
+}
+
+/**
+ * (Re)transmit a DATA segment from the send window.
+ *
+ * conn: Connection the segment belongs to.
+ * seq: Sequence number of the segment.
+ * now: Current monotonic time in milliseconds.
+ */
+static void send_data(struct transport_conn *conn, uint32_t seq, uint64_t now) {
+    struct transport_segment *segment = &conn->snd[seq % TRANSPORT_WINDOW];
+
+    if (segment->sent_at != 0) {
+        segment->retransmitted = 1;
+    }
+    segment->sent_at = now;
+
+    send_segment(conn, TRANSPORT_DATA, segment->len, conn->local_epoch, seq, 0, segment->data, segment->len);
+}
+
+/**
+ * Get the number of segments a connection may have in flight.
+ *
+ * conn: The connection.
+ *
+ * Returns the smallest of the congestion window, the window the peer advertised and the
+ * size of the send buffer.
+ */
+static uint32_t send_window(const struct transport_conn *conn) {
+    uint32_t window = conn->cwnd < conn->peer_rwnd ? conn->cwnd : conn->peer_rwnd;
+
+    return window < TRANSPORT_WINDOW ? window : TRANSPORT_WINDOW;
+}
+
+/**
+ * Start the retransmission timer of a connection for what it has in flight.
+ *
+ * conn: The connection.
+ * now: Current monotonic time in milliseconds.
+ *
+ * The timer expires one RTO after the oldest unacknowledged segment was sent. With nothing in
+ * flight it only runs while the peer advertises a zero window, to time the next probe, and
+ * is stopped otherwise.
+ */
+static void arm_rto(struct transport_conn *conn, uint64_t now) {
+    uint64_t due;
+
+    if (conn->snd_una != conn->snd_nxt) {
+        due = conn->snd[conn->snd_una % TRANSPORT_WINDOW].sent_at + conn->rto;
+    } else if (conn->peer_rwnd == 0) {
+        due = conn->last_ack_at + conn->rto;
+    } else {
+        timer_cancel(&conn->rto_timer);
+        return;
+    }
+
+    timer_add(&conn->rto_timer, due > now ? due - now : 0);
+}
+
+/**
+ * Queue a message from the application and send it.
+ *
+ * peer: MIP address of the peer.
+ * port: Port on the peer.
+ * data: The message.
+ * len: Length of the message in bytes, at most TRANSPORT_MSS.
+ * now: Current monotonic time in milliseconds.
+ *
+ * Every message is one segment. It stays in the send window until the peer has acknowledged
+ * it, and the peer delivers messages to its application in the order they were sent.
+ *
+ * Returns 0 on success, or -1 if the message is too long, the connection table is full or
+ * the connection may not send more right now, see send_window.
+ */
+int transport_send(uint8_t peer, uint8_t port, const uint8_t *data, size_t len, uint64_t now) {
+    if (len > TRANSPORT_MSS) {
+        return -1;
+    }
+
+    struct transport_conn *conn = conn_lookup(peer, port, now);
+    if (conn == NULL || conn->snd_nxt - conn->snd_una >= send_window(conn)) {
+        return -1;
+    }
+
+    struct transport_segment *segment = &conn->snd[conn->snd_nxt % TRANSPORT_WINDOW];
+
+    segment->in_use = 1;
+    segment->sacked = 0;
+    segment->retransmitted = 0;
+    segment->sent_at = 0;
+    segment->len = len;
+    memcpy(segment->data, data, len);
+
+    send_data(conn, conn->snd_nxt++, now);
+    if (!timer_pending(&conn->rto_timer)) {
+        arm_rto(conn, now);
+    }
+    return 0;
+}
+
+/**
+ * Check if any connection has filled its send window.
+ *
+ * The MIP daemon stops reading from the transport application while this is the case, so
+ * the application is held back by its own socket buffer instead of losing messages. This is
+ * how both congestion control and the peer's flow control reach the application.
+ *
+ * Returns 1 if a send window is full, 0 otherwise.
+ */
+int transport_window_full(void) {
+    for (int i = 0; i < TRANSPORT_MAX_CONNS; i++) {
+        if (conns[i].valid && conns[i].snd_nxt - conns[i].snd_una >= send_window(&conns[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Update the retransmission timeout with a new RTT sample, as in RFC 6298.
+ *
+ * conn: Connection the sample was taken on.
+ * rtt: Round trip time in milliseconds.
+ */
+static void rtt_sample(struct transport_conn *conn, uint32_t rtt) {
+    if (!conn->rtt_valid) {
+        conn->srtt = rtt;
+        conn->rttvar = rtt / 2;
+        conn->rtt_valid = 1;
+    } else {
+        uint32_t delta = conn->srtt > rtt ? conn->srtt - rtt : rtt - conn->srtt;
+        conn->rttvar = (3 * conn->rttvar + delta) / 4;
+        conn->srtt = (7 * conn->srtt + rtt) / 8;
+    }
+
+    // The variation term is at least one daemon tick, the timers cannot resolve less
+    uint32_t variation = 4 * conn->rttvar > 10 ? 4 * conn->rttvar : 10;
+
+    conn->rto = conn->srtt + variation;
+    if (conn->rto < TRANSPORT_MIN_RTO) {
+        conn->rto = TRANSPORT_MIN_RTO;
+    }
+    if (conn->rto > TRANSPORT_MAX_RTO) {
+        conn->rto = TRANSPORT_MAX_RTO;
+    }
+}
+
+/**
+ * Retransmit every segment the peer is missing below the newest one it holds.
+ *
+ * conn: Connection to repair.
+ * now: Current monotonic time in milliseconds.
+ *
+ * The oldest unacknowledged segment is always missing, the others are known to be missing
+ * from the SACK bitmaps. Holes already retransmitted within the last smoothed RTT are
+ * skipped, their retransmission is still on its way.
+ *
+ * Returns the number of segments retransmitted.
+ */
+static int resend_holes(struct transport_conn *conn, uint64_t now) {
+    uint32_t highest = conn->snd_una;
+    int resent = 0;
+
+    for (uint32_t seq = conn->snd_una; seq != conn->snd_nxt; seq++) {
+        if (conn->snd[seq % TRANSPORT_WINDOW].sacked) {
+            highest = seq;
+        }
+    }
+
+    for (uint32_t seq = conn->snd_una; seq == conn->snd_una || (int32_t) (seq - highest) < 0; seq++) {
+        struct transport_segment *segment = &conn->snd[seq % TRANSPORT_WINDOW];
+
+        if (segment->sacked || (segment->retransmitted && now - segment->sent_at < conn->srtt)) {
+            continue;
+        }
+        send_data(conn, seq, now);
+        resent++;
+    }
+
+    return resent;
+}
+
+/**
+ * Process an ACK for data we sent.
+ *
+ * conn: Connection the ACK belongs to.
+ * flags: Flags of the ACK.
+ * rwnd: Receive window advertised by the peer, in segments past the cumulative ACK.
+ * epoch: Epoch echoed by the peer.
+ * ack: Cumulative acknowledgement, the next sequence number the peer expects.
+ * sack: Selective acknowledgement bitmap.
+ * now: Current monotonic time in milliseconds.
+ *
+ * Acknowledged segments leave the send window. TRANSPORT_DUPACKS duplicate ACKs start a
+ * recovery that retransmits every hole right away. Until everything that was in flight at 
+ * that point has been acknowledged, every partial ACK repairs the holes that are left, so 
+ * several losses in one window cost one round trip instead of one RTO each.
+ *
+ * The congestion controller grows the window on new ACKs outside of recovery, and shrinks it
+ * once per window of data on loss or on a CE echo.
+ */
+static void handle_ack(struct transport_conn *conn, uint8_t flags, uint16_t rwnd, uint32_t epoch, uint32_t ack,
+                       uint32_t sack, uint64_t now) {
+    // ACKs for a previous incarnation, or for data never sent, are ignored
+    if (epoch != conn->local_epoch || ack - conn->snd_una > conn->snd_nxt - conn->snd_una) {
+        return;
+    }
+
+    conn->peer_rwnd = rwnd;
+    conn->last_ack_at = now;
+
+    for (int i = 0; i < TRANSPORT_WINDOW - 1; i++) {
+        uint32_t seq = ack + 1 + i;
+        if ((sack & (1u << i)) && seq - conn->snd_una < conn->snd_nxt - conn->snd_una) {
+            conn->snd[seq % TRANSPORT_WINDOW].sacked = 1;
+        }
+    }
+
+    if (ack != conn->snd_una) {
+        // Only an ACK for segments that were sent once and arrived in order gives a fresh RTT
+        // sample, one that fills a hole also covers segments that waited at the receiver
+        int clean = !conn->in_recovery;
+
+        for (uint32_t seq = conn->snd_una; seq != ack; seq++) {
+            struct transport_segment *segment = &conn->snd[seq % TRANSPORT_WINDOW];
+
+            if (segment->retransmitted || segment->sacked) {
+                clean = 0;
+            }
+            segment->in_use = 0;
+        }
+        if (clean) {
+            rtt_sample(conn, (uint32_t) (now - conn->snd[(ack - 1) % TRANSPORT_WINDOW].sent_at));
+        }
+
+        uint32_t acked = ack - conn->snd_una;
+        conn->snd_una = ack;
+        conn->dupacks = 0;
+        conn->backoffs = 0;
+
+        if (conn->in_cwr && (int32_t) (conn->snd_una - conn->cwr_recover) >= 0) {
+            conn->in_cwr = 0;
+        }
+
+        if (conn->in_recovery && (int32_t) (conn->snd_una - conn->recover) < 0) {
+            // Partial ACK, more of the window was lost
+            conn->fast_retransmits += resend_holes(conn, now);
+        } else {
+            conn->in_recovery = 0;
+            cc->on_ack(conn, acked);
+        }
+    } else if (conn->snd_una != conn->snd_nxt) {
+        conn->dupacks++;
+        if (conn->dupacks == TRANSPORT_DUPACKS && !conn->in_recovery) {
+            conn->in_recovery = 1;
+            conn->recover = conn->snd_nxt;
+            conn->fast_retransmits += resend_holes(conn, now);
+
+            // A loss also counts as the reduction for any CE echo in the same window
+            cc->on_congestion(conn, 0);
+            conn->in_cwr = 1;
+            conn->cwr_recover = conn->snd_nxt;
+        }
+    }
+
+    if ((flags & TRANSPORT_FLAG_ECE) && !conn->in_cwr) {
+        cc->on_congestion(conn, 0);
+        conn->in_cwr = 1;
+        conn->cwr_recover = conn->snd_nxt;
+        conn->ce_echoes++;
+
+        if (debug_mode) {
+            printf("Transport to %u port %u: congestion on the path, cwnd now %u\n",
+                   conn->peer, conn->port, conn->cwnd);
+        }
+    }
+
+    arm_rto(conn, now);
+}
+
+/**
+ * Acknowledge what has arrived from the peer.
+ *
+ * conn: Connection to acknowledge.
+ *
+ * The ACK advertises the free part of the receive buffer as the receive window, so a sender
+ * never has more in flight than the receiver can hold while its application is slow.
+ */
+static void send_ack(struct transport_conn *conn) {
+    uint32_t buffered = conn->rcv_nxt - conn->rcv_delivered;
+    uint32_t sack = 0;
+
+    for (uint32_t i = 0; i < TRANSPORT_WINDOW - 1 && buffered + 1 + i < TRANSPORT_WINDOW; i++) {
+        if (conn->rcv[(conn->rcv_nxt + 1 + i) % TRANSPORT_WINDOW].in_use) {
+            sack |= 1u << i;
+        }
+    }
+
+    uint8_t kind = TRANSPORT_ACK | (conn->ece_pending ? TRANSPORT_FLAG_ECE : 0);
+    conn->ece_pending = 0;
+
+    send_segment(conn, kind, TRANSPORT_WINDOW - buffered, conn->remote_epoch, conn->rcv_nxt, sack, NULL, 0);
+}
+
+/**
+ * Write the segments that have arrived in order to the application.
+ *
+ * conn: Connection to deliver from.
+ *
+ * The write never blocks the daemon. When the application socket or ring is full, the rest 
+ * stays in the receive buffer, which shrinks the receive window, and is retried after 
+ * TRANSPORT_RETRY ms, or as soon as the application makes room in its ring.
+ *
+ * Returns the number of segments delivered.
+ */
+static int deliver(struct transport_conn *conn) {
+    uint8_t buf[TRANSPORT_APP_HDR_LEN + TRANSPORT_MSS];
+    int delivered = 0;
+
+    while (conn->rcv_delivered != conn->rcv_nxt) {
+        struct transport_segment *segment = &conn->rcv[conn->rcv_delivered % TRANSPORT_WINDOW];
+
+        buf[0] = conn->peer;
+        buf[1] = conn->port;
+        memcpy(buf + TRANSPORT_APP_HDR_LEN, segment->data, segment->len);
+
+        if (app_ring != NULL) {
+            if (ring_push(app_ring, buf, TRANSPORT_APP_HDR_LEN + segment->len) == -1) {
+                break;
+            }
+        } else if (send(app, buf, TRANSPORT_APP_HDR_LEN + segment->len, MSG_DONTWAIT) == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            perror("send");
+        }
+
+        segment->in_use = 0;
+        conn->rcv_delivered++;
+        delivered++;
+    }
+
+    // One wakeup for the whole batch
+    if (app_ring != NULL && delivered > 0) {
+        ring_notify(app_ring);
+    }
+
+    if (conn->rcv_delivered != conn->rcv_nxt) {
+        timer_add(&conn->deliver_timer, TRANSPORT_RETRY);
+    }
+
+    return delivered;
+}
+
+/**
+ * Process a DATA segment from the peer and acknowledge it.
+ *
+ * conn: Connection the segment belongs to.
+ * flags: Flags of the segment.
+ * epoch: Epoch of the peer's sender.
+ * seq: Sequence number of the segment.
+ * data: Packed payload.
+ * len: Payload length in bytes.
+ *
+ * In-order segments, and the out-of-order segments they make contiguous, are written to the
+ * application right away. Segments past the end of the receive buffer are dropped and left
+ * for the sender to retransmit. Every segment is answered with an ACK, duplicates included,
+ * so the sender learns about holes. A CE mark is echoed in the ACK.
+ */
+static void handle_data(struct transport_conn *conn, uint8_t flags, uint32_t epoch, uint32_t seq,
+                        const uint32_t *data, size_t len) {
+    // A new epoch means the peer restarted its sender, start over at sequence number 0
+    if (!conn->remote_known || epoch != conn->remote_epoch) {
+        conn->remote_known = 1;
+        conn->remote_epoch = epoch;
+        conn->rcv_nxt = 0;
+        conn->rcv_delivered = 0;
+        for (int i = 0; i < TRANSPORT_WINDOW; i++) {
+            conn->rcv[i].in_use = 0;
+        }
+    }
+
+    if (flags & TRANSPORT_FLAG_CE) {
+        conn->ece_pending = 1;
+    }
+
+    if (seq - conn->rcv_delivered < TRANSPORT_WINDOW) {
+        struct transport_segment *segment = &conn->rcv[seq % TRANSPORT_WINDOW];
+
+        if (!segment->in_use) {
+            segment->in_use = 1;
+            segment->len = len;
+            unpack_words(segment->data, data, (len + 3) / 4);
+        }
+    }
+
+    while (conn->rcv_nxt - conn->rcv_delivered < TRANSPORT_WINDOW && conn->rcv[conn->rcv_nxt % TRANSPORT_WINDOW].in_use) {
+        conn->rcv_nxt++;
+    }
+
+    deliver(conn);
+    send_ack(conn);
+}
+
+/**
+ * Process a received SDU_TYPE_TRANSPORT SDU.
+ *
+ * src: MIP address of the peer.
+ * sdu: The SDU.
+ * sdu_len: Length of the SDU in words.
+ * now: Current monotonic time in milliseconds.
+ */
+void transport_input(uint8_t src, const uint32_t *sdu, size_t sdu_len, uint64_t now) {
+    if (sdu_len < TRANSPORT_HDR_WORDS) {
+        return;
+    }
+
+    uint8_t kind = (sdu[0] >> 24) & TRANSPORT_KIND_MASK;
+    uint8_t flags = (sdu[0] >> 24) & ~TRANSPORT_KIND_MASK;
+    uint8_t port = (sdu[0] >> 16) & 0xff;
+    uint16_t field = sdu[0] & 0xffff;
+
+    // Without an application to deliver to, nothing is acknowledged
+    if (kind == TRANSPORT_DATA && app == -1) {
+        return;
+    }
+    if (kind == TRANSPORT_DATA && (field > TRANSPORT_MSS || TRANSPORT_HDR_WORDS + (field + 3) / 4 > sdu_len)) {
+        return;
+    }
+
+    struct transport_conn *conn = conn_lookup(src, port, now);
+    if (conn == NULL) {
+        if (debug_mode) {
+            printf("Transport connection table full, dropping segment from %u port %u\n", src, port);
+        }
+        return;
+    }
+
+    if (kind == TRANSPORT_DATA) {
+        handle_data(conn, flags, sdu[1], sdu[2], sdu + TRANSPORT_HDR_WORDS, field);
+    } else if (kind == TRANSPORT_ACK) {
+        handle_ack(conn, flags, field, sdu[1], sdu[2], sdu[3], now);
+    }
+}
+
+/**
+ * Retransmit after the RTO of a connection expired.
+ *
+ * arg: The connection.
+ *
+ * A sender facing a zero window is allowed one segment per RTO as a probe, in case the 
+ * window update got lost.
+ *
+ * When the oldest unacknowledged segment of a connection has waited longer than the RTO, it
+ * is retransmitted together with the holes the SACKs reported, the RTO is doubled and the 
+ * congestion window collapses. Partial ACKs that follow repair what is left, as after a fast 
+ * retransmit. After TRANSPORT_MAX_BACKOFF timeouts in a row the peer is considered gone: 
+ * everything in flight is dropped and the sender moves to a new epoch, so the peer does not 
+ * wait for the dropped segments if it comes back.
+ */
+static void rto_expired(void *arg) {
+    struct transport_conn *conn = arg;
+    uint64_t now = now_ms();
+
+    if (conn->snd_una == conn->snd_nxt) {
+        if (conn->peer_rwnd == 0 && now - conn->last_ack_at >= conn->rto) {
+            conn->peer_rwnd = 1;
+        }
+        arm_rto(conn, now);
+        return;
+    }
+
+    struct transport_segment *oldest = &conn->snd[conn->snd_una % TRANSPORT_WINDOW];
+    if (now - oldest->sent_at < conn->rto) {
+        arm_rto(conn, now);
+        return;
+    }
+
+    if (++conn->backoffs > TRANSPORT_MAX_BACKOFF) {
+        printf("Transport to %u port %u timed out, dropping %u segments\n",
+               conn->peer, conn->port, conn->snd_nxt - conn->snd_una);
+
+        for (int seq = 0; seq < TRANSPORT_WINDOW; seq++) {
+            conn->snd[seq].in_use = 0;
+        }
+        conn->local_epoch += 2;
+        conn->snd_una = conn->snd_nxt = 0;
+        conn->in_recovery = 0;
+        conn->in_cwr = 0;
+        conn->dupacks = 0;
+        conn->backoffs = 0;
+        conn->peer_rwnd = TRANSPORT_WINDOW;
+        cc->init(conn);
+        arm_rto(conn, now);
+        return;
+    }
+
+    conn->rto = conn->rto * 2 > TRANSPORT_MAX_RTO ? TRANSPORT_MAX_RTO : conn->rto * 2;
+    conn->timeouts++;
+    cc->on_congestion(conn, 1);
+
+    // Repair every known hole, the ACKs that follow walk through the rest
+    conn->in_recovery = 1;
+    conn->recover = conn->snd_nxt;
+    conn->dupacks = 0;
+    send_data(conn, conn->snd_una, now);
+    resend_holes(conn, now);
+    arm_rto(conn, now);
+
+    if (debug_mode) {
+        printf("Transport to %u port %u: RTO expired, resent %u, RTO now %u ms\n",
+               conn->peer, conn->port, conn->snd_una, conn->rto);
+    }
+}
+
+/**
+ * Retry the delivery to an application that had no room.
+ *
+ * arg: The connection.
+ */
+static void deliver_expired(void *arg) {
+    struct transport_conn *conn = arg;
+
+    if (conn->rcv_delivered != conn->rcv_nxt && app != -1 && deliver(conn) > 0) {
+        send_ack(conn);
+    }
+}
+
+/**
+ * Deliver what is waiting for the application.
+ *
+ * This function is called when the application makes room in its ring, so the delivery does
+ * not wait for the retry timer. The window that opens up is announced to the peers.
+ */
+void transport_resume(void) {
+    for (int i = 0; i < TRANSPORT_MAX_CONNS; i++) {
+        if (conns[i].valid) {
+            deliver_expired(&conns[i]);
+        }
+    }
+}
+
+/**
+ * Mark a transport segment as having passed a congested queue.
+ *
+ * sdu: SDU of a SDU_TYPE_TRANSPORT PDU about to be sent.
+ * sdu_len: Length of the SDU in words.
+ *
+ * Only DATA segments are marked. The receiver echoes the mark, and the sender slows down 
+ * before the queue overflows and frames are lost.
+ */
+void transport_mark_ce(uint32_t *sdu, size_t sdu_len) {
+    if (sdu_len >= TRANSPORT_HDR_WORDS && ((sdu[0] >> 24) & TRANSPORT_KIND_MASK) == TRANSPORT_DATA) {
+        sdu[0] |= (uint32_t) TRANSPORT_FLAG_CE << 24;
+    }
+}
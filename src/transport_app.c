@@ -0,0 +1,284 @@
+#include <stdio.h>		/* standard input/output library functions */
+#include <stdlib.h>		/* standard library definitions (macros) */
+#include <unistd.h>		/* standard symbolic constants and types */
+#include <string.h>		/* string operations (strncpy, memset..) */
+#include <sys/socket.h>	/* sockets operations */
+#include <sys/un.h>		/* definitions for UNIX domain sockets */
+#include <sys/time.h>
+
+#include "transport.h"
+#include "ipc.h"
+#include "ring.h"
+
+
+// Declaration of the parse_arguments function
+void parse_arguments(int argc, char *argv[], int *receive_mode, int *use_ring, char **socket_lower,
+                     char **destination_host, char **port, char **count, char **size);
+void run_sender(int sd, struct ring_end *ring, uint8_t destination, uint8_t port, long count, long size);
+void run_receiver(int sd, struct ring_end *ring);
+
+
+int main(int argc, char *argv[]) {
+    int receive_mode = 0;
+    int use_ring = 0;
+    char *socket_lower = NULL;
+    char *destination_host = NULL;
+    char *port = NULL;
+    char *count = NULL;
+    char *size = NULL;
+
+    int sd, rc;
+
+    // Call the function to parse arguments
+    parse_arguments(argc, argv, &receive_mode, &use_ring, &socket_lower, &destination_host, &port, &count, &size);
+
+    struct sockaddr_un addr;
+
+    sd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (sd < 0) {
+            perror("socket");
+            exit(EXIT_FAILURE);
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_lower, sizeof(addr.sun_path) - 1);
+
+    rc = connect(sd, (struct sockaddr *)&addr, sizeof(addr));
+    if ( rc < 0) {
+            perror("connect");
+            close(sd);
+            exit(EXIT_FAILURE);
+    }
+
+    // Write identifier to socket, and whether messages go through shared memory
+    uint8_t registration[] = { 0x03, use_ring ? TRANSPORT_APP_RING : 0x00 };
+    rc = write(sd, registration, sizeof(registration));
+    if (rc < 0) {
+        perror("write");
+        close(sd);
+        exit(EXIT_FAILURE);
+    }
+
+    // The MIP daemon answers with the shared memory and the eventfds
+    struct ring_end ring;
+    int fds[RING_FDS];
+    if (use_ring && (recv_fds(sd, fds, RING_FDS) == -1 || ring_attach(&ring, fds) == -1)) {
+        fprintf(stderr, "No shared memory from the MIP daemon\n");
+        close(sd);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Connected to %s%s\n", socket_lower, use_ring ? " with shared memory" : "");
+
+    if (receive_mode) {
+        run_receiver(sd, use_ring ? &ring : NULL);
+    } else {
+        run_sender(sd, use_ring ? &ring : NULL, atoi(destination_host), atoi(port), atol(count), atol(size));
+    }
+
+    if (use_ring) {
+        ring_close(&ring);
+    }
+    close(sd);
+    return 0;
+}
+
+/**
+ * Get the time elapsed since 'start'.
+ *
+ * start: Start time.
+ *
+ * Returns the elapsed time in seconds.
+ */
+static double elapsed_since(const struct timeval *start) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    return (now.tv_sec - start->tv_sec) + (now.tv_usec - start->tv_usec) / 1e6;
+}
+
+/**
+ * Send numbered messages to a port on another node.
+ *
+ * sd: Socket connected to the MIP daemon.
+ * ring: The application's end of the shared memory, NULL to write to the socket.
+ * destination: MIP address of the receiver.
+ * port: Port of the receiver.
+ * count: Number of messages to send.
+ * size: Size of each message in bytes, at least 4 and at most TRANSPORT_MSS.
+ *
+ * Every message starts with its number, so the receiver can check that nothing was lost or
+ * reordered. The MIP daemon stops reading while its send window is full, so the writes block
+ * at the rate the transport protocol gets the messages through. With shared memory the
+ * daemon is woken once every RING_BATCH messages, and the sender sleeps while the ring is 
+ * full instead.
+ */
+void run_sender(int sd, struct ring_end *ring, uint8_t destination, uint8_t port, long count, long size) {
+    uint8_t buf[TRANSPORT_APP_HDR_LEN + TRANSPORT_MSS];
+    struct timeval start;
+
+    if (size < 4 || size > TRANSPORT_MSS) {
+        fprintf(stderr, "Message size must be between 4 and %d bytes\n", TRANSPORT_MSS);
+        exit(1);
+    }
+
+    memset(buf, 'x', sizeof(buf));
+    buf[0] = destination;
+    buf[1] = port;
+
+    gettimeofday(&start, NULL);
+
+    for (long i = 0; i < count; i++) {
+        buf[2] = (i >> 24) & 0xff;
+        buf[3] = (i >> 16) & 0xff;
+        buf[4] = (i >> 8) & 0xff;
+        buf[5] = i & 0xff;
+
+        if (ring != NULL) {
+            while (ring_push(ring, buf, TRANSPORT_APP_HDR_LEN + size) == -1) {
+                ring_notify(ring);
+                if (ring_wait(ring, sd) == -1) {
+                    fprintf(stderr, "MIP daemon went away\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            if ((i + 1) % RING_BATCH == 0) {
+                ring_notify(ring);
+            }
+        } else if (write(sd, buf, TRANSPORT_APP_HDR_LEN + size) < 0) {
+            perror("write");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (ring != NULL) {
+        ring_notify(ring);
+    }
+
+    printf("Handed %ld messages of %ld bytes to the MIP daemon in %.3f seconds\n", count, size, elapsed_since(&start));
+}
+
+/**
+ * Read the next message from the MIP daemon.
+ *
+ * sd: Socket connected to the MIP daemon.
+ * ring: The application's end of the shared memory, NULL to read from the socket.
+ * buf: Buffer to store the message in.
+ * len: Size of the buffer.
+ *
+ * With shared memory the daemon is told about the room made in its ring only before the
+ * receiver goes to sleep, so a busy receiver costs the daemon no wakeups.
+ *
+ * Returns the length of the message, or 0 once the MIP daemon has gone away.
+ */
+static int next_message(int sd, struct ring_end *ring, uint8_t *buf, size_t len) {
+    if (ring == NULL) {
+        int rc = read(sd, buf, len);
+        return rc < 0 ? 0 : rc;
+    }
+
+    while (1) {
+        ssize_t rc = ring_pop(ring, buf, len);
+        if (rc >= 0) {
+            return rc;
+        }
+
+        ring_notify(ring);
+        if (!ring_arm(ring) && ring_wait(ring, sd) == -1) {
+            return 0;
+        }
+    }
+}
+
+/**
+ * Receive messages and report the goodput.
+ *
+ * sd: Socket connected to the MIP daemon.
+ * ring: The application's end of the shared memory, NULL to read from the socket.
+ *
+ * Prints a line for every second with traffic, with the goodput and the number of messages
+ * that did not carry the next expected number. Runs until the MIP daemon goes away, then
+ * prints the totals from the first to the last message.
+ */
+void run_receiver(int sd, struct ring_end *ring) {
+    uint8_t buf[TRANSPORT_APP_HDR_LEN + TRANSPORT_MSS];
+    struct timeval start, interval, last;
+    long messages = 0, bytes = 0, interval_bytes = 0, out_of_order = 0;
+    uint32_t expected = 0;
+    int rc;
+
+    while ((rc = next_message(sd, ring, buf, sizeof(buf))) > 0) {
+        if (rc < TRANSPORT_APP_HDR_LEN + 4) {
+            continue;
+        }
+
+        uint32_t number = ((uint32_t) buf[2] << 24) | ((uint32_t) buf[3] << 16) | ((uint32_t) buf[4] << 8) | buf[5];
+
+        if (messages == 0) {
+            gettimeofday(&start, NULL);
+            interval = start;
+        }
+        // A sender that starts over is not counted as out of order
+        if (number != expected && number != 0) {
+            out_of_order++;
+        }
+        expected = number + 1;
+
+        gettimeofday(&last, NULL);
+        messages++;
+        bytes += rc - TRANSPORT_APP_HDR_LEN;
+        interval_bytes += rc - TRANSPORT_APP_HDR_LEN;
+
+        double seconds = elapsed_since(&interval);
+        if (seconds >= 1.0) {
+            printf("From %u port %u: %ld messages, %ld bytes, %.1f kbit/s, %ld out of order\n",
+                   buf[0], buf[1], messages, bytes, interval_bytes * 8 / seconds / 1000, out_of_order);
+            gettimeofday(&interval, NULL);
+            interval_bytes = 0;
+        }
+    }
+
+    if (messages > 0) {
+        double seconds = (last.tv_sec - start.tv_sec) + (last.tv_usec - start.tv_usec) / 1e6;
+        printf("Total: %ld messages, %ld bytes in %.3f seconds, %.1f kbit/s, %ld out of order\n",
+               messages, bytes, seconds, seconds > 0 ? bytes * 8 / seconds / 1000 : 0.0, out_of_order);
+    }
+}
+
+// Definition of the parse_arguments function
+void parse_arguments(int argc, char *argv[], int *receive_mode, int *use_ring, char **socket_lower,
+                     char **destination_host, char **port, char **count, char **size) {
+    const char *usage = "Usage: %s [-h] [-r] -s <socket_lower>\n"
+                        "       %s [-h] [-r] <socket_lower> <destination_host> <port> <count> <size>\n";
+    int opt;
+    while ((opt = getopt(argc, argv, "hsr")) != -1) {
+        switch (opt) {
+            case 's':
+                *receive_mode = 1;
+                break;
+            case 'r':
+                *use_ring = 1;
+                break;
+            case 'h':
+                printf(usage, argv[0], argv[0]);
+                exit(0);
+            default:
+                fprintf(stderr, usage, argv[0], argv[0]);
+                exit(1);
+        }
+    }
+
+    if (optind + (*receive_mode ? 1 : 5) != argc) {
+        fprintf(stderr, usage, argv[0], argv[0]);
+        exit(1);
+    }
+
+    *socket_lower = argv[optind];
+    if (!*receive_mode) {
+        *destination_host = argv[optind + 1];
+        *port = argv[optind + 2];
+        *count = argv[optind + 3];
+        *size = argv[optind + 4];
+    }
+}
@@ -0,0 +1,90 @@
+#include <stdint.h>
+
+#include "transport.h"
+
+
+/**
+ * Start a connection in slow start.
+ *
+ * conn: The new connection.
+ */
+static void aimd_init(struct transport_conn *conn) {
+    conn->cwnd = TRANSPORT_INITIAL_CWND;
+    conn->ssthresh = TRANSPORT_WINDOW;
+    conn->cwnd_cnt = 0;
+}
+
+/**
+ * Grow the window on new ACKs.
+ *
+ * conn: The connection.
+ * acked: Number of segments the ACK acknowledged for the first time.
+ *
+ * Below the slow start threshold the window grows by one segment per segment acknowledged,
+ * doubling every round trip. Above it the window grows by one segment per window of data
+ * acknowledged. The window never grows past the send buffer, where it would mean nothing.
+ */
+static void aimd_on_ack(struct transport_conn *conn, uint32_t acked) {
+    if (conn->cwnd < conn->ssthresh) {
+        conn->cwnd += acked;
+    } else {
+        conn->cwnd_cnt += acked;
+        while (conn->cwnd_cnt >= conn->cwnd) {
+            conn->cwnd_cnt -= conn->cwnd;
+            conn->cwnd++;
+        }
+    }
+
+    if (conn->cwnd > TRANSPORT_WINDOW) {
+        conn->cwnd = TRANSPORT_WINDOW;
+    }
+}
+
+/**
+ * Shrink the window on congestion.
+ *
+ * conn: The connection.
+ * timeout: 1 if the RTO expired, 0 for a fast retransmit or a CE echo.
+ *
+ * The window is halved. After a timeout nothing is known about the path any more, so the
+ * connection starts over from one segment in slow start.
+ */
+static void aimd_on_congestion(struct transport_conn *conn, int timeout) {
+    conn->ssthresh = conn->cwnd / 2 > 2 ? conn->cwnd / 2 : 2;
+    conn->cwnd = timeout ? 1 : conn->ssthresh;
+    conn->cwnd_cnt = 0;
+}
+
+// Additive increase, multiplicative decrease, with slow start
+const struct transport_cc transport_cc_aimd = {
+    .name = "aimd",
+    .init = aimd_init,
+    .on_ack = aimd_on_ack,
+    .on_congestion = aimd_on_congestion,
+};
+
+
+/**
+ * Open the whole send buffer at once.
+ *
+ * conn: The new connection.
+ */
+static void fixed_init(struct transport_conn *conn) {
+    conn->cwnd = TRANSPORT_WINDOW;
+    conn->ssthresh = TRANSPORT_WINDOW;
+    conn->cwnd_cnt = 0;
+}
+
+static void fixed_on_ack(struct transport_conn *conn, uint32_t acked) {
+}
+
+static void fixed_on_congestion(struct transport_conn *conn, int timeout) {
+}
+
+// No congestion control, only the receive window limits the sender. Useful as a baseline
+const struct transport_cc transport_cc_fixed = {
+    .name = "fixed",
+    .init = fixed_init,
+    .on_ack = fixed_on_ack,
+    .on_congestion = fixed_on_congestion,
+};
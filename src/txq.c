@@ -0,0 +1,570 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "txq.h"
+#include "adj.h"
+#include "pdu.h"
+
+static struct txq queues[MAX_IF];
+static int watch_fd = -1;       // Duplicate of the RAW socket watched for room, -1 while queueing is off
+static int epoll_instance = -1; // The epoll instance watch_fd is in
+static int armed;               // 1 while watch_fd waits for EPOLLOUT
+static int batching;            // 1 while data frames are collected for one sendmmsg, see txq_batch_begin
+
+// A data frame collected for the next batch, copied since the PDU it comes from is freed first
+struct txq_batched {
+    const struct adjacency *adj;
+    uint32_t miphdr;                    // MIP header in network byte order
+    size_t sdu_len;                     // Length of the SDU in 32-bit words
+    uint32_t sdu[MIP_MAX_SDU_WORDS];
+};
+
+static struct txq_batched batch[TXQ_BATCH];
+static size_t batch_len;
+static size_t collected;        // Frames collected since txq_batch_begin
+
+static const char *class_names[TXQ_CLASSES] = { "control", "ping", "transport", "link" };
+static const size_t weights[TXQ_CLASSES] = { 0, TXQ_WEIGHT_PING, TXQ_WEIGHT_TRANSPORT, TXQ_WEIGHT_LINK };
+
+
+/**
+ * Turn on the transmit queues.
+ *
+ * epoll_fd: The epoll instance of the daemon.
+ * rsock: RAW socket frames are sent on.
+ *
+ * Frames are sent without blocking from now on. A frame the socket has no room for waits
+ * in the queue of its class on its interface, and the queues are sent from once the socket
+ * has room again. Before this is called every frame is sent right away.
+ *
+ * The send buffer of the socket is made small, since the kernel sends what it holds in
+ * order and a hello behind a full buffer of data would wait as long as without the queues.
+ *
+ * Returns a file descriptor that becomes writable when there is room, which the caller must
+ * answer with txq_flush, or -1 on error.
+ */
+int txq_init(int epoll_fd, int rsock) {
+    struct epoll_event ev = { .events = 0 };
+
+    int sndbuf = TXQ_SNDBUF;
+
+    memset(queues, 0, sizeof(queues));
+    for (int i = 0; i < MAX_IF; i++) {
+        queues[i].drr = TXQ_PING;
+    }
+
+    if (setsockopt(rsock, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) == -1) {
+        perror("setsockopt");
+    }
+
+    // The socket is already in the epoll instance for reading, a duplicate can be watched
+    // for writing on its own
+    watch_fd = dup(rsock);
+    if (watch_fd == -1) {
+        perror("dup");
+        return -1;
+    }
+
+    ev.data.fd = watch_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, watch_fd, &ev) == -1) {
+        perror("epoll_ctl");
+        close(watch_fd);
+        watch_fd = -1;
+        return -1;
+    }
+
+    epoll_instance = epoll_fd;
+    armed = 0;
+
+    return watch_fd;
+}
+
+/**
+ * Put one MIP frame on the wire.
+ *
+ * rsock: RAW socket to send on.
+ * adj: Adjacency of the neighbor, or broadcast adjacency of the interface.
+ * miphdr: MIP header in network byte order, see mip_pack_header.
+ * sdu: Pointer to the SDU data.
+ * sdu_len: Length of the SDU in 32-bit words.
+ * flags: Flags for sendmsg, MSG_DONTWAIT once the queues are on.
+ *
+ * The frame is gathered by sendmsg from the prebuilt Ethernet header of the adjacency, the
+ * MIP header and the SDU, so nothing is copied into a staging buffer.
+ *
+ * Returns the number of bytes sent, or -1 on error with errno set.
+ */
+static ssize_t xmit(int rsock, const struct adjacency *adj, uint32_t miphdr,
+                    const uint32_t *sdu, size_t sdu_len, int flags) {
+    struct iovec iov[3];
+    struct msghdr msg;
+
+    iov[0].iov_base = (void *) &adj->ethhdr;
+    iov[0].iov_len = ETH_HDR_LEN;
+    iov[1].iov_base = &miphdr;
+    iov[1].iov_len = MIP_HDR_LEN;
+    iov[2].iov_base = (void *) sdu;
+    iov[2].iov_len = sdu_len * sizeof(uint32_t);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = (void *) &adj->addr;
+    msg.msg_namelen = sizeof(struct sockaddr_ll);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = sdu_len > 0 ? 3 : 2;
+
+    return sendmsg(rsock, &msg, flags);
+}
+
+/**
+ * Find the class of a frame.
+ *
+ * header: MIP header in host byte order.
+ * sdu: Pointer to the SDU data.
+ * sdu_len: Length of the SDU in 32-bit words.
+ *
+ * A bundle is control traffic if any of its frames is, so a hello bundled with data is not
+ * held back by the data.
+ *
+ * Returns the class.
+ */
+static enum txq_class classify(uint32_t header, const uint32_t *sdu, size_t sdu_len) {
+    switch (header & 0x7) {
+        case SDU_TYPE_MIPARP:
+        case SDU_TYPE_CTRL:
+        case SDU_TYPE_ROUTE:
+            return TXQ_CONTROL;
+        case SDU_TYPE_PING:
+        case SDU_TYPE_FRAG:
+            return TXQ_PING;
+        case SDU_TYPE_TRANSPORT:
+            return TXQ_TRANSPORT;
+        default:
+            break;
+    }
+
+    if (sdu_len == 0 || sdu[0] >> 24 != LINK_BUNDLE) {
+        return TXQ_LINK;
+    }
+
+    // Frames of a bundle are a MIP header in host byte order followed by the SDU
+    enum txq_class first = TXQ_LINK;
+    for (size_t offset = 1; offset < sdu_len; offset += 1 + ((sdu[offset] >> 3) & 0x1ff)) {
+        enum txq_class class = classify(sdu[offset], NULL, 0);
+        if (class == TXQ_CONTROL) {
+            return TXQ_CONTROL;
+        }
+        if (offset == 1) {
+            first = class;
+        }
+    }
+
+    return first;
+}
+
+// Bytes a frame takes on the wire, what the data classes are weighted by
+static size_t frame_bytes(const struct txq_frame *frame) {
+    return ETH_HDR_LEN + MIP_HDR_LEN + frame->sdu_len * sizeof(uint32_t);
+}
+
+/**
+ * Watch the socket for room, or stop watching it.
+ *
+ * on: 1 while frames are waiting, 0 once every queue is empty.
+ */
+static void arm(int on) {
+    struct epoll_event ev = { .events = on ? EPOLLOUT : 0, .data.fd = watch_fd };
+
+    if (armed == on) {
+        return;
+    }
+    if (epoll_ctl(epoll_instance, EPOLL_CTL_MOD, watch_fd, &ev) == -1) {
+        perror("epoll_ctl");
+        return;
+    }
+    armed = on;
+}
+
+/**
+ * Remove the frame at the front of a class queue.
+ *
+ * q: The interface queues.
+ * cq: The class queue, not empty.
+ *
+ * Returns the frame, the caller frees it.
+ */
+static struct txq_frame *pop(struct txq *q, struct txq_class_queue *cq) {
+    struct txq_frame *frame = cq->head;
+
+    cq->head = frame->next;
+    if (cq->head == NULL) {
+        cq->tail = NULL;
+    }
+    cq->stats.depth--;
+    q->len--;
+
+    return frame;
+}
+
+/**
+ * Pick the class an interface sends from next.
+ *
+ * q: The interface queues, not empty.
+ *
+ * Control frames go first. The data classes take turns by deficit round robin: a class gets
+ * TXQ_QUANTUM bytes per weight each round and sends while its next frame fits, so each
+ * class gets its share of the link whatever the size of its frames.
+ *
+ * Returns the class queue, the frame at its front is the next to send.
+ */
+static struct txq_class_queue *next_class(struct txq *q) {
+    if (q->classes[TXQ_CONTROL].head != NULL) {
+        return &q->classes[TXQ_CONTROL];
+    }
+
+    while (1) {
+        struct txq_class_queue *cq = &q->classes[q->drr];
+
+        if (cq->head != NULL && frame_bytes(cq->head) <= cq->deficit) {
+            return cq;
+        }
+        if (cq->head == NULL) {
+            cq->deficit = 0; // An idle class does not save up for later
+        }
+
+        q->drr = q->drr + 1 < TXQ_CLASSES ? q->drr + 1 : TXQ_PING;
+        if (q->classes[q->drr].head != NULL) {
+            q->classes[q->drr].deficit += TXQ_QUANTUM * weights[q->drr];
+        }
+    }
+}
+
+/**
+ * Send the waiting frames of every interface while the socket has room.
+ *
+ * rsock: RAW socket to send on.
+ *
+ * The interfaces take turns frame by frame. Called when the descriptor from txq_init is
+ * writable, and whenever a frame has been queued.
+ */
+void txq_flush(int rsock) {
+    int progress = 1;
+
+    while (progress) {
+        progress = 0;
+
+        for (int i = 0; i < MAX_IF; i++) {
+            struct txq *q = &queues[i];
+            if (q->len == 0) {
+                continue;
+            }
+
+            struct txq_class_queue *cq = next_class(q);
+            struct txq_frame *frame = cq->head;
+
+            if (xmit(rsock, frame->adj, frame->miphdr, frame->sdu, frame->sdu_len, MSG_DONTWAIT) == -1) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    arm(1);
+                    return;
+                }
+                // Any other error only loses this frame, like a frame sent right away
+                if (debug_mode) {
+                    perror("sendmsg()");
+                }
+            } else {
+                cq->stats.sent++;
+                cq->stats.delayed++;
+            }
+
+            if (cq != &q->classes[TXQ_CONTROL]) {
+                cq->deficit -= frame_bytes(frame);
+            }
+            free(pop(q, cq));
+            progress = 1;
+        }
+    }
+
+    arm(0);
+}
+
+/**
+ * Copy a frame to the queue of its class.
+ *
+ * class: Class of the frame, see classify.
+ * adj: Adjacency of the neighbor, or broadcast adjacency of the interface.
+ * miphdr: MIP header in network byte order.
+ * sdu: Pointer to the SDU data.
+ * sdu_len: Length of the SDU in 32-bit words.
+ *
+ * When the interface already has TXQ_LIMIT frames waiting, a control frame takes the place
+ * of the oldest frame of the longest data class, and a data frame is dropped. The caller
+ * flushes the queues.
+ *
+ * Returns the number of bytes queued, or -1 if the frame was dropped.
+ */
+static ssize_t enqueue(enum txq_class class, const struct adjacency *adj, uint32_t miphdr,
+                       const uint32_t *sdu, size_t sdu_len) {
+    struct txq *q = &queues[adj->interface];
+    struct txq_class_queue *cq = &q->classes[class];
+
+    if (q->len >= TXQ_LIMIT) {
+        struct txq_class_queue *victim = NULL;
+
+        if (class == TXQ_CONTROL) {
+            for (int c = TXQ_PING; c < TXQ_CLASSES; c++) {
+                if (q->classes[c].head != NULL && (victim == NULL || q->classes[c].stats.depth > victim->stats.depth)) {
+                    victim = &q->classes[c];
+                }
+            }
+        }
+        if (victim == NULL) {
+            cq->stats.dropped++;
+            return -1;
+        }
+
+        victim->stats.dropped++;
+        free(pop(q, victim));
+    }
+
+    struct txq_frame *frame = malloc(sizeof(*frame) + sdu_len * sizeof(uint32_t));
+    if (frame == NULL) {
+        perror("malloc");
+        cq->stats.dropped++;
+        return -1;
+    }
+
+    size_t bytes = ETH_HDR_LEN + MIP_HDR_LEN + sdu_len * sizeof(uint32_t);
+    frame->next = NULL;
+    frame->adj = adj;
+    frame->miphdr = miphdr;
+    frame->sdu_len = sdu_len;
+    memcpy(frame->sdu, sdu, sdu_len * sizeof(uint32_t));
+
+    if (cq->tail != NULL) {
+        cq->tail->next = frame;
+    } else {
+        cq->head = frame;
+    }
+    cq->tail = frame;
+    q->len++;
+    if (++cq->stats.depth > cq->stats.max_depth) {
+        cq->stats.max_depth = cq->stats.depth;
+    }
+
+    return bytes;
+}
+
+/**
+ * Send the collected frames with sendmmsg.
+ *
+ * rsock: RAW socket to send on.
+ *
+ * The frames go out in the order they were collected. What the socket has no room for is
+ * queued in that order, behind nothing, since a frame is only collected while its interface
+ * has no frames waiting.
+ */
+static void send_batch(int rsock) {
+    struct mmsghdr msgs[TXQ_BATCH];
+    struct iovec iov[TXQ_BATCH][3];
+    size_t sent = 0;
+
+    memset(msgs, 0, batch_len * sizeof(msgs[0]));
+    for (size_t i = 0; i < batch_len; i++) {
+        struct txq_batched *frame = &batch[i];
+
+        iov[i][0].iov_base = (void *) &frame->adj->ethhdr;
+        iov[i][0].iov_len = ETH_HDR_LEN;
+        iov[i][1].iov_base = &frame->miphdr;
+        iov[i][1].iov_len = MIP_HDR_LEN;
+        iov[i][2].iov_base = frame->sdu;
+        iov[i][2].iov_len = frame->sdu_len * sizeof(uint32_t);
+
+        msgs[i].msg_hdr.msg_name = (void *) &frame->adj->addr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_ll);
+        msgs[i].msg_hdr.msg_iov = iov[i];
+        msgs[i].msg_hdr.msg_iovlen = frame->sdu_len > 0 ? 3 : 2;
+    }
+
+    while (sent < batch_len) {
+        int rc = sendmmsg(rsock, msgs + sent, batch_len - sent, MSG_DONTWAIT);
+
+        if (rc == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno != EINTR) {
+                // Any other error only loses the frame it failed on, like a frame sent right away
+                if (debug_mode) {
+                    perror("sendmmsg()");
+                }
+                sent++;
+            }
+            continue;
+        }
+
+        for (int i = 0; i < rc; i++) {
+            struct txq_batched *frame = &batch[sent + i];
+            queues[frame->adj->interface].classes[classify(ntohl(frame->miphdr), frame->sdu, frame->sdu_len)].stats.sent++;
+        }
+        sent += rc;
+    }
+
+    for (; sent < batch_len; sent++) {
+        struct txq_batched *frame = &batch[sent];
+        enqueue(classify(ntohl(frame->miphdr), frame->sdu, frame->sdu_len), frame->adj,
+                frame->miphdr, frame->sdu, frame->sdu_len);
+    }
+
+    batch_len = 0;
+    txq_flush(rsock);
+}
+
+/**
+ * Send a frame, or queue it until the socket has room.
+ *
+ * rsock: RAW socket to send on.
+ * adj: Adjacency of the neighbor, or broadcast adjacency of the interface.
+ * miphdr: MIP header in network byte order, see mip_pack_header.
+ * sdu: Pointer to the SDU data.
+ * sdu_len: Length of the SDU in 32-bit words.
+ *
+ * A frame is sent right away while nothing waits on its interface, so an idle link costs
+ * nothing. Otherwise the frame is copied to the queue of its class, see enqueue. Between
+ * txq_batch_begin and txq_batch_end a data frame that would be sent right away is collected
+ * instead, and sent with the others of the batch.
+ *
+ * Returns the number of bytes sent, collected or queued, or -1 if the frame was dropped.
+ */
+ssize_t txq_send(int rsock, const struct adjacency *adj, uint32_t miphdr,
+                 const uint32_t *sdu, size_t sdu_len) {
+    enum txq_class class = classify(ntohl(miphdr), sdu, sdu_len);
+    struct txq *q = &queues[adj->interface];
+    struct txq_class_queue *cq = &q->classes[class];
+
+    // A frame queued behind collected frames of its interface would overtake them when flushed
+    if (batching && batch_len > 0 && q->len > 0) {
+        send_batch(rsock);
+    }
+
+    // Control frames are not collected, they go ahead of the data of the batch
+    if (batching && class != TXQ_CONTROL && q->len == 0) {
+        if (batch_len == TXQ_BATCH) {
+            send_batch(rsock);
+        }
+        if (q->len == 0) {
+            struct txq_batched *frame = &batch[batch_len++];
+
+            frame->adj = adj;
+            frame->miphdr = miphdr;
+            frame->sdu_len = sdu_len;
+            memcpy(frame->sdu, sdu, sdu_len * sizeof(uint32_t));
+            collected++;
+            return ETH_HDR_LEN + MIP_HDR_LEN + sdu_len * sizeof(uint32_t);
+        }
+    }
+
+    // Nothing waits on the interface, so the frame cannot overtake anything
+    if (watch_fd == -1 || q->len == 0) {
+        ssize_t rc = xmit(rsock, adj, miphdr, sdu, sdu_len, watch_fd == -1 ? 0 : MSG_DONTWAIT);
+        if (rc >= 0) {
+            cq->stats.sent++;
+            return rc;
+        }
+        if (watch_fd == -1 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            if (debug_mode) {
+                perror("sendmsg()");
+            }
+            return -1;
+        }
+    }
+
+    ssize_t bytes = enqueue(class, adj, miphdr, sdu, sdu_len);
+    txq_flush(rsock);
+
+    return bytes;
+}
+
+/**
+ * Collect the data frames sent from now on, to be sent together by txq_batch_end.
+ *
+ * The receive pipeline calls this before its nodes run, so the frames a vector forwards
+ * take one system call instead of one each. Nothing is collected while queueing is off.
+ */
+void txq_batch_begin(void) {
+    batching = watch_fd != -1;
+    collected = 0;
+}
+
+/**
+ * Send the frames collected since txq_batch_begin and stop collecting.
+ *
+ * rsock: RAW socket to send on.
+ *
+ * Returns the number of frames that were collected.
+ */
+size_t txq_batch_end(int rsock) {
+    if (batch_len > 0) {
+        send_batch(rsock);
+    }
+    batching = 0;
+
+    return collected;
+}
+
+/**
+ * Count the frames of a class waiting on any interface.
+ *
+ * class: The class.
+ *
+ * Returns the number of frames.
+ */
+size_t txq_backlog(enum txq_class class) {
+    size_t depth = 0;
+
+    for (int i = 0; i < MAX_IF; i++) {
+        depth += queues[i].classes[class].stats.depth;
+    }
+
+    return depth;
+}
+
+/**
+ * Find how full the transmit queues are.
+ *
+ * Returns the percent of TXQ_LIMIT in use on the interface with the most frames waiting.
+ */
+int txq_fill(void) {
+    size_t len = 0;
+
+    for (int i = 0; i < MAX_IF; i++) {
+        if (queues[i].len > len) {
+            len = queues[i].len;
+        }
+    }
+
+    return len * 100 / TXQ_LIMIT;
+}
+
+/**
+ * Print the counters of every class on every interface.
+ *
+ * ifs: Pointer to the interface data structure.
+ */
+void txq_print_stats(const struct ifs_data *ifs) {
+    printf("Transmit queues:\n");
+    for (int i = 0; i < ifs->ifn; i++) {
+        for (int c = 0; c < TXQ_CLASSES; c++) {
+            const struct txq_stats *stats = &queues[i].classes[c].stats;
+            printf("\t interface %d %-9s sent %llu delayed %llu dropped %llu depth %u max %u\n", i, class_names[c],
+                   (unsigned long long) stats->sent, (unsigned long long) stats->delayed,
+                   (unsigned long long) stats->dropped, stats->depth, stats->max_depth);
+        }
+    }
+}
@@ -3,12 +3,16 @@
 #include <unistd.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/epoll.h>
 #include <linux/if_packet.h>
 #include <net/ethernet.h>
 #include <arpa/inet.h>
 #include <ifaddrs.h>
 #include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
 
 
 #include "utils.h"
@@ -17,6 +21,11 @@
 #include "pdu.h"
 #include "mip.h"
 #include "route.h"
+#include "pack.h"
+#include "adj.h"
+#include "fec.h"
+#include "bundle.h"
+#include "txq.h"
 
 #define REQUEST_MSG_LEN 6
 #define RESPONSE_MSG_LEN 6
@@ -187,14 +196,8 @@ void fill_ping_buf(char *buf, size_t buf_size, const char *destination_host, con
 
     buf[1] = atoi(ttl);
 
-    // Add "PING:"
-    strcat(buf, "PING:");
-
-    // Then add message
-    if (message != NULL) {
-        strcat(buf, message);
-    }
-
+    // Write after the header bytes, either of which may be zero
+    snprintf(buf + APP_HDR_LEN, buf_size - APP_HDR_LEN, "PING:%s", message != NULL ? message : "");
 }
 
 /**
@@ -218,35 +221,29 @@ void fill_pong_buf(char *buf, size_t buf_size, const char *destination_host, con
     buf[0] = atoi(destination_host);
     buf[1] = 0x00; // Filler value
 
-    // Add "PING:"
-    strcat(buf, "PONG:");
-
-    // Then add message
-    if (message != NULL) {
-        strcat(buf, message);
-    }
+    // Write after the header bytes, either of which may be zero
+    snprintf(buf + APP_HDR_LEN, buf_size - APP_HDR_LEN, "PONG:%s", message != NULL ? message : "");
 }
 
- /**
- * Handle received MIP packets and determine their type.
+/**
+ * Handle a received MIP frame and determine its type.
  *
- * raw_fd: File descriptor for the raw socket.
- * ifs: Pointer to the interface data structure.
  * pdu: Pointer to the protocol data unit structure.
- * recv_ifs_index: Pointer to store the index of the receiving interface.
+ * rcv_buf: The frame, as read by the rx node of the receive pipeline, see vector.c.
+ * rc: Length of the frame in bytes.
  * 
- * The function first checks if the pdu is not NULL. It then receives 
- * the serialized buffer from the raw socket and deserializes it into the PDU structure.
- * Based on the type of SDU present in the MIP header, the function determines 
- * if the received packet is of type MIP_ARP_REQUEST, MIP_ARP_REPLY, MIP_PING, or MIP_PONG.
+ * The function first checks if the pdu is not NULL. It then deserializes the frame into 
+ * the PDU structure. Based on the type of SDU present in the MIP header, the function 
+ * determines if the received packet is of type MIP_ARP_REQUEST, MIP_ARP_REPLY, MIP_PING, 
+ * MIP_PONG, MIP_FRAG or MIP_TRANSPORT.
  * 
  * If in debug mode, the function will print additional details about the received PDU.
  * 
  * Returns the type of the received MIP packet. If there's an error or an unknown type,
- * the function returns -1.
+ * the function returns -1. If the frame is not complete, the function returns -EINVAL and 
+ * the PDU must not be used.
  */
-
-MIP_handle handle_mip_packet(struct ifs_data *ifs, struct pdu *pdu, int *recv_ifs_index)
+MIP_handle handle_mip_packet(struct pdu *pdu, uint8_t *rcv_buf, ssize_t rc)
 {
     // Make sure pdu is not NULL
     if (pdu == NULL) {
@@ -254,29 +251,35 @@ MIP_handle handle_mip_packet(struct ifs_data *ifs, struct pdu *pdu, int *recv_if
         return -EINVAL;
     }
 
-    MIP_handle mip_type;
-
-    uint8_t rcv_buf[512];
-    struct sockaddr_ll from_addr;
-    socklen_t from_addr_len = sizeof(from_addr);
-    
-    /* Recv the serialized buffer via RAW socket */
-    if (recvfrom(ifs->rsock, rcv_buf, 512, 0, (struct sockaddr *)&from_addr, &from_addr_len) <= 0) {
-        perror("recvfrom()");
-        close(ifs->rsock);
-        return -1;
+    size_t rcv_len = mip_deserialize_pdu(pdu, rcv_buf, rc);
+    if (rcv_len == 0) {
+        if (debug_mode) {
+            printf("Dropping truncated MIP frame of %zd bytes\n", rc);
+        }
+        return -EINVAL;
     }
 
-    *recv_ifs_index = find_matching_if_index(ifs, &from_addr);
-
-    size_t rcv_len = mip_deserialize_pdu(pdu, rcv_buf);
-
-    printf("Received PDU with content (size %zu):\n", rcv_len);
-    print_pdu_content(pdu);
-
-
+    if (debug_mode) {
+        printf("Received PDU with content (size %zu):\n", rcv_len);
+        print_pdu_content(pdu);
+    }
 
+    return get_mip_handle(pdu);
+}
 
+/**
+ * Determine how a received PDU is to be handled.
+ * 
+ * pdu: The received PDU.
+ * 
+ * This is split from handle_mip_packet so frames unwrapped from a SDU_TYPE_LINK PDU can be 
+ * classified like any other.
+ * 
+ * Returns the MIP_handle of the PDU, or -1 if its type or code is unknown.
+ */
+MIP_handle get_mip_handle(struct pdu *pdu)
+{
+    MIP_handle mip_type;
 
     if (pdu->miphdr->sdu_type == SDU_TYPE_MIPARP) {
         int arp_type = (pdu->sdu[0] >> 31) & 1;
@@ -292,7 +295,13 @@ MIP_handle handle_mip_packet(struct ifs_data *ifs, struct pdu *pdu, int *recv_if
             return -1;
         }
     } else if (pdu->miphdr->sdu_type == SDU_TYPE_PING) {
-        if (pdu->sdu[1] == 0x50494E47) {
+        // The second word tells a PING from a PONG, shorter SDUs end before it
+        if (pdu->miphdr->sdu_len < 2) {
+            if (debug_mode) {
+                printf("Error: Truncated PING\n");
+            }
+            return -1;
+        } else if (pdu->sdu[1] == 0x50494E47) {
             mip_type = MIP_PING;
         } else if (pdu->sdu[1] == 0x504F4E47) {
             mip_type = MIP_PONG;
@@ -307,6 +316,29 @@ MIP_handle handle_mip_packet(struct ifs_data *ifs, struct pdu *pdu, int *recv_if
     } else if (pdu->miphdr->sdu_type == SDU_TYPE_ROUTE) {
             return MIP_ROUTE;
 
+    } else if (pdu->miphdr->sdu_type == SDU_TYPE_FRAG) {
+        mip_type = MIP_FRAG;
+
+    } else if (pdu->miphdr->sdu_type == SDU_TYPE_TRANSPORT) {
+        mip_type = MIP_TRANSPORT;
+
+    } else if (pdu->miphdr->sdu_type == SDU_TYPE_LINK) {
+        mip_type = MIP_LINK;
+
+    } else if (pdu->miphdr->sdu_type == SDU_TYPE_CTRL) {
+        uint8_t ctrl_code = (pdu->sdu[0] >> 24) & 0xff;
+
+        if (ctrl_code == CTRL_LIVENESS) {
+            mip_type = MIP_LIVENESS;
+        } else if (ctrl_code == CTRL_UNREACH) {
+            mip_type = MIP_UNREACH;
+        } else {
+            if (debug_mode) {
+                printf("Error: Unknown CTRL code\n");
+            }
+            return -1;
+        }
+
     } else {
         if (debug_mode) {
             printf("Error: Unknown SDU type\n");
@@ -337,7 +369,9 @@ MIP_handle handle_mip_packet(struct ifs_data *ifs, struct pdu *pdu, int *recv_if
  * of the received message. Currently, it only identifies the APP_PING type based 
  * on the PING: prefix.
  * 
- * In case of read errors, the function prints an error message and exits the program.
+ * If the application has closed the connection, APP_DISCONNECT is returned. A message of 
+ * unknown type returns -1. In case of other read errors, the function prints an error 
+ * message and exits the program.
  * 
  * Returns the type of the received application message.
  */
@@ -347,16 +381,19 @@ APP_handle handle_app_message(int app_fd, uint8_t *dst_mip_addr, char *msg, uint
     int rc;
     APP_handle app_type;
     
-    // Buffer to hold message from application
-    char buf[512];
+    // Buffer to hold message from application, the last byte always stays NUL
+    char buf[APP_HDR_LEN + APP_MAX_MSG_LEN + 1];
 
     // Clear buffer
     memset(buf, 0, sizeof(buf));
 
     printf("Handle app message 1\n");
     // Read message from application
-    rc = read(app_fd, buf, sizeof(buf));
-    if (rc <= 0) {
+    rc = read(app_fd, buf, sizeof(buf) - 1);
+    if (rc == 0 || (rc < 0 && errno == ECONNRESET)) {
+        return APP_DISCONNECT;
+    }
+    if (rc < 0) {
         perror("read");
         exit(EXIT_FAILURE);
     }
@@ -380,9 +417,11 @@ APP_handle handle_app_message(int app_fd, uint8_t *dst_mip_addr, char *msg, uint
         app_type = APP_ROUTE;
 
     } else {
-        perror("Unknown message type");
-        close(app_fd);
-        exit(EXIT_FAILURE);
+        // Other applications are still connected, only this message is dropped
+        if (debug_mode) {
+            printf("Unknown message type from application\n");
+        }
+        return -1;
     }
     // Copy the rest of the buffer to msg
     strcpy(msg, buf + offset);
@@ -399,13 +438,20 @@ APP_handle handle_app_message(int app_fd, uint8_t *dst_mip_addr, char *msg, uint
  * buf_size: The size of the buffer.
  * 
  * This function reads a message from the specified socket file descriptor and determines
- * its type based on the message header. It recognizes three types: HELLO, UPDATE, and RESPONSE.
- * The type is returned as a ROUTE_handle enum value.
+ * its type based on the message header. It recognizes HELLO, UPDATE and RESPONSE, the ROUTE 
+ * CHANGE and WITHDRAW notifications the routing daemon pushes, plus the SYNC REQUEST and END 
+ * OF RIB messages a restarted routing daemon uses to resynchronize. The type is returned as a 
+ * ROUTE_handle enum value.
  * 
  * Returns:
  *   - ROUTE_HELLO for hello messages
  *   - ROUTE_UPDATE for update messages
  *   - ROUTE_RESPONSE for response messages
+ *   - ROUTE_SYNC_REQUEST for requests to neighbors for a full update
+ *   - ROUTE_CHANGE for added or changed routes
+ *   - ROUTE_WITHDRAW for routes that were removed
+ *   - ROUTE_END_OF_RIB when resynchronization is complete
+ *   - ROUTE_DISCONNECT if the routing daemon closed the connection
  *   - -1 for unknown message types or read errors
  */
 ROUTE_handle handle_route_message(int route_fd, uint8_t *buf, size_t buf_size)
@@ -418,7 +464,10 @@ ROUTE_handle handle_route_message(int route_fd, uint8_t *buf, size_t buf_size)
 
     // Read message from application
     rc = read(route_fd, buf, buf_size);
-    if (rc <= 0) {
+    if (rc == 0 || (rc < 0 && errno == ECONNRESET)) {
+        return ROUTE_DISCONNECT;
+    }
+    if (rc < 0) {
         perror("read");
         return -1; // Return an error code
     }
@@ -429,6 +478,14 @@ ROUTE_handle handle_route_message(int route_fd, uint8_t *buf, size_t buf_size)
         route_type = ROUTE_UPDATE;
     } else if (buf[2] == 0x52 && buf[3] == 0x45 && buf[4] == 0x53) {
         route_type = ROUTE_RESPONSE;
+    } else if (buf[2] == 0x53 && buf[3] == 0x59 && buf[4] == 0x4E) {
+        route_type = ROUTE_SYNC_REQUEST;
+    } else if (buf[2] == 0x52 && buf[3] == 0x54 && buf[4] == 0x45) {
+        route_type = ROUTE_CHANGE;
+    } else if (buf[2] == 0x57 && buf[3] == 0x44 && buf[4] == 0x52) {
+        route_type = ROUTE_WITHDRAW;
+    } else if (buf[2] == 0x45 && buf[3] == 0x4F && buf[4] == 0x52) {
+        route_type = ROUTE_END_OF_RIB;
     } else {
         perror("Unknown message type");
         return -1; // Return an error code
@@ -437,83 +494,6 @@ ROUTE_handle handle_route_message(int route_fd, uint8_t *buf, size_t buf_size)
     return route_type;
 }
 
-/**
- * Find a matching sockaddr_ll structure based on the destination MAC address.
- * 
- * struct ifs_data *ifs: Pointer to the ifs_data structure containing interface information.
- * uint8_t *dst_mac_addr: Pointer to the destination MAC address to match.
- * 
- * Returns:
- * - Pointer to the matching sockaddr_ll structure if found, or NULL if not found.
- */
-struct sockaddr_ll* find_matching_sockaddr(struct ifs_data *ifs, uint8_t *dst_mac_addr) {
-    if (ifs == NULL || dst_mac_addr == NULL) {
-        return NULL;
-    }
-
-    for (int i = 0; i < ifs->ifn; ++i) {
-        uint8_t *mac_addr = ifs->addr[i].sll_addr;
-
-        if (memcmp(mac_addr, dst_mac_addr, 6) == 0) {
-            return &(ifs->addr[i]);
-        }
-    }
-
-    return NULL; // Return NULL if not found
-}
-
-/**
- * Convert a string to an array of uint32_t values.
- *
- * str: Pointer to the input string.
- * length: Pointer to store the output length in bytes of the resulting array.
- * 
- * The function calculates the number of uint32_t elements required to represent the string. 
- * The first uint32_t in the resulting array stores the length of the input string.
- * The subsequent uint32_t values store the characters of the string, with up to 
- * 4 characters packed into each uint32_t.
- * 
- * For example, the string "ABCD" would be stored in one uint32_t with 'A' in the most significant byte 
- * and 'D' in the least significant byte.
- * 
- * The function returns a pointer to the dynamically allocated uint32_t array. 
- * The caller is responsible for freeing this memory when it's no longer needed.
- * If memory allocation fails, the function returns NULL.
- */
-
-uint32_t* stringToUint32Array(const char* str, uint8_t *length) {
-    uint8_t str_length = strlen(str);
-
-
-    uint8_t num_elements = str_length / 4 + (str_length % 4 != 0) + 1;
-    // Allocate memory for the array
-    
-    
-    // Calculate length in bytes and set the output parameter
-    *length = num_elements;
-
-
-    
-    uint32_t *arr = (uint32_t*)calloc(num_elements, sizeof(uint32_t));
-
-    if (arr == NULL) {
-        return NULL; // Failed to allocate memory
-    }
-
-    arr[0] = (uint32_t)str_length; // Store the length in bytes in the first uint32_t
-
-    for (uint8_t i = 0; i < str_length; i++) {
-        uint8_t arr_idx = i / 4 + 1; // Start from index 1
-        uint8_t shift = (3 - (i % 4)) * 8;
-
-        arr[arr_idx] |= (uint32_t)str[i] << shift;
-    }
-    
-
-    return arr;
-}
-
-
 uint32_t find_matching_if_index(struct ifs_data *ifs, struct sockaddr_ll *from_addr) {
     for (int i = 0; i < ifs->ifn; i++) {
         if (ifs->addr[i].sll_ifindex == from_addr->sll_ifindex) {
@@ -562,40 +542,6 @@ void decode_fill_ping_buf(const char *buf, size_t buf_size, char *destination_ho
 }
 
 
-char* uint32ArrayToString(uint32_t* arr) {
-    if (arr == NULL) {
-        return NULL;
-    }
-
-    uint32_t str_length = arr[0];
-
-    char *str = (char*)calloc(str_length + 1, sizeof(char));
-
-    if (str == NULL) {
-        return NULL;
-    }
-
-    uint8_t num_elements = (str_length + 3) / 4 + 1;
-
-    for (uint8_t i = 1; i < num_elements; i++) {
-        uint32_t val = arr[i];
-
-        for (int j = 3; j >= 0; j--) {
-            uint8_t shift = j * 8;
-            char ch = (char)((val >> shift) & 0xFF);
-
-            if (str_length > 0) {
-                *str = ch;
-                str++;
-                str_length--;
-            }
-        }
-    }
-
-    *str = '\0';
-    return str - arr[0];
-}
-
 struct pdu* create_PDU(uint8_t src_mip_addr,
             uint8_t dst_mip_addr,
             uint8_t ttl,
@@ -603,40 +549,60 @@ struct pdu* create_PDU(uint8_t src_mip_addr,
             const uint32_t *sdu,
             uint16_t sdu_len)
 {
-
-    printf("inside create_PDU\n");
-    for (int i = 0; i < sdu_len; i++){
-        printf("%u ", sdu[i]);
-    }
     struct pdu *pdu = alloc_pdu();
     fill_pdu(pdu, src_mip_addr, dst_mip_addr, ttl, sdu_type, sdu, sdu_len);
 
     return pdu;
 }
 
-void send_PDU(struct ifs_data *ifs, struct pdu *pdu, struct sockaddr_ll *interface) {
-    uint8_t snd_buf[MAX_BUF_SIZE];
-    printf("TTL23: %d\n", pdu->miphdr->ttl);
-    // Check TTL
-    if (pdu->miphdr->ttl < 0) {
-        printf("TTL is 0, not sending packet\n");
+/**
+ * Put one MIP frame on the wire.
+ *
+ * rsock: RAW socket to send on.
+ * adj: Adjacency of the neighbor, or broadcast adjacency of the interface.
+ * miphdr: MIP header in network byte order, see mip_pack_header.
+ * sdu: Pointer to the SDU data.
+ * sdu_len: Length of the SDU in 32-bit words.
+ *
+ * The frame goes through the transmit queues of its interface, so control frames are not
+ * stuck behind data when the link is saturated, see txq_send. A failed send (e.g. the 
+ * interface is down) only loses this frame, the socket is still needed for the other
+ * interfaces.
+ *
+ * Returns the number of bytes sent or queued, or -1 on error.
+ */
+ssize_t send_frame(int rsock, const struct adjacency *adj, uint32_t miphdr,
+                   const uint32_t *sdu, size_t sdu_len) {
+    return txq_send(rsock, adj, miphdr, sdu, sdu_len);
+}
+
+/**
+ * Send a PDU to a neighbor and free it.
+ *
+ * ifs: Pointer to the interface data structure.
+ * pdu: PDU to be sent, the Ethernet header of the PDU is not used.
+ * adj: Adjacency of the neighbor, see adj_lookup. The PDU is dropped if this is NULL.
+ *
+ * A PDU to a destination protected by FEC goes out as part of a block, see fec_send. Other
+ * small PDUs may wait to share a frame with others to the same neighbor, see bundle_add.
+ */
+void send_PDU(struct ifs_data *ifs, struct pdu *pdu, const struct adjacency *adj) {
+    if (adj == NULL) {
+        destroy_pdu(pdu);
         return;
     }
 
-    size_t snd_len = mip_serialize_pdu(pdu, snd_buf);
-
-
-
-    // Send the serialized buffer via RAW socket
-    if (sendto(ifs->rsock, snd_buf, snd_len, 0,
-        (struct sockaddr *)interface,
-        sizeof(struct sockaddr_ll)) <= 0) {
-        perror("sendto()");
-        close(ifs->rsock);
+    if (fec_wanted(pdu->miphdr->dst)) {
+        fec_send(ifs, adj, pdu);
+    } else {
+        uint32_t miphdr = mip_pack_header(pdu->miphdr);
+        if (!bundle_add(ifs, adj, miphdr, pdu->sdu, pdu->miphdr->sdu_len)) {
+            send_frame(ifs->rsock, adj, miphdr, pdu->sdu, pdu->miphdr->sdu_len);
+        }
     }
 
     if (debug_mode) {
-        printf("Sending PDU with content (size %zu):\n", snd_len);
+        printf("Sending PDU on interface %u with content:\n", adj->interface);
         print_pdu_content(pdu);
     }
 
@@ -645,42 +611,118 @@ void send_PDU(struct ifs_data *ifs, struct pdu *pdu, struct sockaddr_ll *interfa
 
 
 
-void uint32_to_uint8(uint32_t *input, size_t input_size, uint8_t *output) {
-    for (size_t i = 0; i < input_size; ++i) {
-        uint32_t value = input[i];
-        
-        output[i * 4]     = (value >> 24) & 0xFF; // Extract the first byte
-        output[i * 4 + 1] = (value >> 16) & 0xFF; // Extract the second byte
-        output[i * 4 + 2] = (value >> 8) & 0xFF;  // Extract the third byte
-        output[i * 4 + 3] = value & 0xFF;         // Extract the fourth byte
+/**
+ * Broadcast a SDU on every interface.
+ *
+ * ifs: Pointer to the interface data structure.
+ * sdu_type: SDU type of the broadcast.
+ * sdu: Pointer to the SDU data.
+ * sdu_len: Length of the SDU in 32-bit words.
+ *
+ * This function sends one frame with destination BROADCAST_MIP_ADDR and TTL 1 out of each
+ * interface, using the broadcast adjacency of the interface. The MIP header is packed once 
+ * and the SDU is sent from the caller's buffer, so no PDU is allocated. Small broadcasts may 
+ * be bundled like unicast PDUs.
+ */
+void broadcast_PDU(struct ifs_data *ifs, uint8_t sdu_type, const uint32_t *sdu, uint16_t sdu_len) {
+    struct mip_hdr hdr = {
+        .dst = BROADCAST_MIP_ADDR,
+        .src = ifs->local_mip_addr,
+        .ttl = 1,
+        .sdu_len = sdu_len,
+        .sdu_type = sdu_type
+    };
+    uint32_t miphdr = mip_pack_header(&hdr);
+
+    for (int interface = 0; interface < ifs->ifn; interface++) {
+        const struct adjacency *adj = adj_broadcast(interface);
+        if (!bundle_add(ifs, adj, miphdr, sdu, sdu_len)) {
+            send_frame(ifs->rsock, adj, miphdr, sdu, sdu_len);
+        }
+    }
+}
+
+/**
+ * Check whether the transmit queue of the raw socket is filling up.
+ *
+ * ifs: Pointer to the interface data structure.
+ *
+ * The socket send buffer is looked up once. Frames still waiting in it mean the links
+ * cannot keep up with what this node sends, which is a congestion signal for the
+ * transport protocol before anything has to be dropped.
+ *
+ * Returns 1 if transport segments wait in the transmit queues or more than 1/TX_CE_FRACTION
+ * of the send buffer is in use, and 0 otherwise.
+ */
+int tx_queue_congested(struct ifs_data *ifs) {
+    static int sndbuf = 0;
+    int queued = 0;
+
+    if (sndbuf == 0) {
+        socklen_t optlen = sizeof(sndbuf);
+        if (getsockopt(ifs->rsock, SOL_SOCKET, SO_SNDBUF, &sndbuf, &optlen) == -1) {
+            perror("getsockopt");
+            sndbuf = INT_MAX;
+        }
+    }
+
+    // Segments waiting in the transmit queues have found the send buffer full already
+    if (txq_backlog(TXQ_TRANSPORT) > 0) {
+        return 1;
+    }
+
+    if (ioctl(ifs->rsock, SIOCOUTQ, &queued) == -1) {
+        return 0;
     }
+
+    return queued > sndbuf / TX_CE_FRACTION;
+}
+
+
+/**
+ * Convert an array of uint32_t values to bytes, most significant byte first.
+ * 
+ * input: Words to convert.
+ * input_size: Number of words.
+ * output: Buffer of at least input_size * 4 bytes.
+ * 
+ * Note: Kept for compatibility, this is unpack_words.
+ */
+void uint32_to_uint8(uint32_t *input, size_t input_size, uint8_t *output) {
+    unpack_words(output, input, input_size);
 }
 
 
 
 
+/**
+ * Convert bytes to a dynamically allocated array of uint32_t values.
+ * 
+ * byte_array: Bytes to convert.
+ * array_length: Number of bytes.
+ * length: Pointer to store the number of words in the resulting array.
+ * 
+ * The caller is responsible for freeing the returned array. Returns NULL if memory 
+ * allocation fails.
+ * 
+ * Note: Kept for compatibility, new code should call pack_words with its own buffer.
+ */
 uint32_t* uint8ArrayToUint32Array(const uint8_t* byte_array, uint8_t array_length, uint8_t *length) {
     uint8_t num_elements = array_length / 4 + (array_length % 4 != 0);
 
-    // Calculate length in uint32_t elements and set the output parameter
-    *length = num_elements;
-
     uint32_t *arr = (uint32_t*)calloc(num_elements, sizeof(uint32_t));
     if (arr == NULL) {
         return NULL; // Failed to allocate memory
     }
 
-
-    for (uint8_t i = 0; i < array_length; i++) {
-        uint8_t arr_idx = i / 4; // Start from index 1
-        uint8_t shift = (3 - (i % 4)) * 8;
-
-        arr[arr_idx] |= (uint32_t)byte_array[i] << shift;
-    }
-
+    *length = pack_words(arr, byte_array, array_length);
     return arr;
 }
 void sendRequestToApp(int route_fd, int destinationMIP, int localMIP) {
+    if (route_fd == -1) {
+        return; // No routing daemon, the request is sent again when it connects
+    }
+
     printf("Looking up MIP: %d\n", destinationMIP);
     uint8_t requestMessage[] = {
         localMIP, // MIP address
@@ -698,13 +740,47 @@ void sendRequestToApp(int route_fd, int destinationMIP, int localMIP) {
 }
 
 
-void fill_ethhdr(struct pdu *pdu, const uint8_t *src_mac, const uint8_t *dst_mac) {
-    if (!pdu || !pdu->ethhdr || !dst_mac || !src_mac) {
-        printf("Invalid arguments\n");
+/**
+ * Notify the routing daemon that a neighbor changed liveness state.
+ *
+ * route_fd: File descriptor of the routing daemon socket.
+ * neighborMIP: MIP address of the neighbor.
+ * localMIP: MIP address of this node.
+ * isUp: 1 if the neighbor came up, 0 if it went down.
+ *
+ * The message follows the layout of the request message, with 'LUP' or 'LDN' as the type
+ * and the neighbor MIP address in the last byte. Nothing is sent if no routing daemon is connected.
+ */
+void sendNeighborEventToApp(int route_fd, int neighborMIP, int localMIP, int isUp) {
+    if (route_fd == -1) {
         return;
     }
 
-    memcpy(pdu->ethhdr->dst_mac, dst_mac, MAC_ADDR_SIZE);
-    memcpy(pdu->ethhdr->src_mac, src_mac, MAC_ADDR_SIZE);
-    pdu->ethhdr->ethertype = htons(ETH_P_MIP);
-}
\ No newline at end of file
+    uint8_t eventMessage[] = {
+        localMIP,               // MIP address
+        0x00,                   // TTL set to zero
+        0x4C,                   // ASCII for 'L'
+        isUp ? 0x55 : 0x44,     // ASCII for 'U' or 'D'
+        isUp ? 0x50 : 0x4E,     // ASCII for 'P' or 'N'
+        neighborMIP             // Neighbor that changed state
+    };
+
+    int bytes_sent = send(route_fd, eventMessage, sizeof(eventMessage), 0);
+    if (bytes_sent < 0) {
+        perror("send");
+    }
+}
+
+/**
+ * Get the current monotonic time in milliseconds.
+ *
+ * Returns the value of CLOCK_MONOTONIC in milliseconds. The clock is not affected by
+ * changes to the wall clock, so it is safe to use for timeouts.
+ */
+uint64_t now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
@@ -0,0 +1,340 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include "vector.h"
+#include "bundle.h"
+#include "fec.h"
+#include "ratelimit.h"
+#include "worker.h"
+#include "txq.h"
+
+static const char *node_names[VECTOR_NODES] = { "rx", "parse", "classify", "arp", "local", "route", "forward", "tx" };
+
+static uint8_t frames[VECTOR_SIZE][MAX_BUF_SIZE];  // Frames read by the rx node
+static size_t frame_lens[VECTOR_SIZE];
+static int frame_interfaces[VECTOR_SIZE];
+static struct sockaddr_ll from[VECTOR_SIZE];
+static size_t frame_count;                          // Frames in 'frames'
+static size_t frame_next;                           // First frame the parse node has not handled yet
+
+static struct packet_vector parsed;                 // PDUs the classify node splits
+static struct packet_vector next[VECTOR_NODES];     // PDUs waiting for each node after classify
+static vector_fn handlers[VECTOR_NODES];
+static void *contexts[VECTOR_NODES];
+static struct vector_stats stats[VECTOR_NODES];
+static int loss;                                    // Received frames dropped on purpose, in percent
+
+
+// Monotonic time in nanoseconds, what the nodes are timed with
+static uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Set up the receive pipeline.
+ *
+ * loss_percent: Received frames dropped on purpose by the parse node, emulates a lossy link.
+ */
+void vector_init(int loss_percent) {
+    memset(&parsed, 0, sizeof(parsed));
+    memset(next, 0, sizeof(next));
+    memset(handlers, 0, sizeof(handlers));
+    memset(stats, 0, sizeof(stats));
+    frame_count = 0;
+    frame_next = 0;
+    loss = loss_percent;
+}
+
+/**
+ * Set the handler of a node after classify.
+ *
+ * node: VECTOR_ARP, VECTOR_LOCAL, VECTOR_ROUTE or VECTOR_FORWARD.
+ * fn: Handles every PDU the node is given, the PDUs are its to free.
+ * ctx: Passed to fn.
+ *
+ * PDUs for a node without a handler are dropped.
+ */
+void vector_register(enum vector_node node, vector_fn fn, void *ctx) {
+    if (node <= VECTOR_CLASSIFY || node > VECTOR_FORWARD) {
+        return;
+    }
+
+    handlers[node] = fn;
+    contexts[node] = ctx;
+}
+
+// Add a PDU to a vector, which has room for it
+static void push(struct packet_vector *vec, struct pdu *pdu, int interface, MIP_handle type) {
+    vec->pdus[vec->count] = pdu;
+    vec->interfaces[vec->count] = interface;
+    vec->types[vec->count] = type;
+    vec->count++;
+}
+
+/**
+ * Read the frames to handle.
+ *
+ * ifs: Pointer to the interface data structure.
+ *
+ * The rest of a received bundle comes first, its frames are already parsed and go straight
+ * to the classify node. Then come the frames the parse node left for this run, see parse.
+ * Only once those are handled are new frames read: the frames the forwarding threads handed
+ * over, and then what the RAW socket holds, all of it read with one system call. Nothing
+ * waits, so the node may be run whenever one of them has something.
+ */
+static void rx(struct ifs_data *ifs) {
+    struct vector_stats *stat = &stats[VECTOR_RX];
+    uint64_t now = now_ms();
+    size_t count = 0;
+    struct pdu *pdu;
+    int interface;
+
+    while (parsed.count < VECTOR_SIZE && (pdu = bundle_next(&interface)) != NULL) {
+        stat->packets++;
+        if (!ratelimit_admit(pdu->miphdr->src, pdu->miphdr->sdu_type, now)) {
+            stat->dropped++;
+            destroy_pdu(pdu);
+            continue;
+        }
+        push(&parsed, pdu, interface, get_mip_handle(pdu));
+    }
+
+    if (frame_next < frame_count) {
+        return;
+    }
+
+    size_t room = VECTOR_SIZE - parsed.count;
+    ssize_t len;
+
+    while (count < room && (len = worker_next(frames[count], MAX_BUF_SIZE, &frame_interfaces[count])) != -1) {
+        frame_lens[count++] = len;
+    }
+
+    if (count < room) {
+        struct mmsghdr msgs[VECTOR_SIZE];
+        struct iovec iov[VECTOR_SIZE];
+        size_t wanted = room - count;
+
+        memset(msgs, 0, wanted * sizeof(msgs[0]));
+        for (size_t i = 0; i < wanted; i++) {
+            iov[i].iov_base = frames[count + i];
+            iov[i].iov_len = MAX_BUF_SIZE;
+            msgs[i].msg_hdr.msg_name = &from[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int received = recvmmsg(ifs->rsock, msgs, wanted, MSG_DONTWAIT, NULL);
+        if (received == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            perror("recvmmsg");
+        }
+        for (int i = 0; i < received; i++) {
+            frame_lens[count] = msgs[i].msg_len;
+            frame_interfaces[count] = find_matching_if_index(ifs, &from[i]);
+            count++;
+        }
+    }
+
+    stat->packets += count;
+    frame_count = count;
+    frame_next = 0;
+}
+
+/**
+ * Turn the frames read by the rx node into PDUs.
+ *
+ * Frames over the rate of their source or SDU type are dropped before anything is allocated
+ * for them, as are truncated frames and frames lost on purpose. A LINK frame from a neighbor
+ * carries other frames. A frame protected by FEC is unwrapped, or recovered from a parity
+ * frame, and a bundle is split, the first frame then goes on as if it had arrived as is. The
+ * MIP header of the next frame is fetched into the cache while a frame is parsed.
+ *
+ * The other frames of a bundle are only kept until the next bundle is taken in, and go before
+ * the frames received after it. So parsing stops at the frame after a bundle that still has
+ * frames waiting, or once the vector is full, and the frames left go through the next run,
+ * after the rest of the bundle, see vector_pending.
+ */
+static void parse(void) {
+    struct vector_stats *stat = &stats[VECTOR_PARSE];
+    uint64_t now = now_ms();
+
+    for (; frame_next < frame_count; frame_next++) {
+        size_t i = frame_next;
+        uint8_t *frame = frames[i];
+
+        if (bundle_pending() || parsed.count == VECTOR_SIZE) {
+            return;
+        }
+
+        stat->packets++;
+        if (i + 1 < frame_count) {
+            __builtin_prefetch(frames[i + 1] + ETH_HDR_LEN);
+        }
+
+        if (!ratelimit_frame(frame, frame_lens[i], now)) {
+            stat->dropped++;
+            continue;
+        }
+
+        struct pdu *pdu = alloc_pdu();
+        MIP_handle type = handle_mip_packet(pdu, frame, frame_lens[i]);
+        if ((int) type == -EINVAL || (loss > 0 && random() % 100 < loss)) {
+            stat->dropped++;
+            destroy_pdu(pdu);
+            continue;
+        }
+
+        if (type == MIP_LINK) {
+            int unwrapped = (pdu->sdu[0] >> 24) == LINK_BUNDLE ? bundle_input(pdu, frame_interfaces[i])
+                                                               : fec_input(pdu, now);
+            if (!unwrapped || !ratelimit_admit(pdu->miphdr->src, pdu->miphdr->sdu_type, now)) {
+                stat->dropped++;
+                destroy_pdu(pdu);
+                continue;
+            }
+            type = get_mip_handle(pdu);
+        }
+
+        push(&parsed, pdu, frame_interfaces[i], type);
+    }
+}
+
+/**
+ * Split the parsed PDUs over the nodes that handle them.
+ *
+ * ifs: Pointer to the interface data structure.
+ *
+ * PDUs for other MIP daemons go to the forward node. PDUs for this daemon, or broadcast, go
+ * to the arp, route or local node by how they are handled.
+ */
+static void classify(struct ifs_data *ifs) {
+    stats[VECTOR_CLASSIFY].packets += parsed.count;
+
+    for (size_t i = 0; i < parsed.count; i++) {
+        struct pdu *pdu = parsed.pdus[i];
+        enum vector_node node;
+
+        if (i + 1 < parsed.count) {
+            __builtin_prefetch(parsed.pdus[i + 1]->miphdr);
+        }
+
+        if (pdu->miphdr->dst != ifs->local_mip_addr && pdu->miphdr->dst != BROADCAST_MIP_ADDR) {
+            node = VECTOR_FORWARD;
+        } else if (parsed.types[i] == MIP_ARP_REQUEST || parsed.types[i] == MIP_ARP_REPLY) {
+            node = VECTOR_ARP;
+        } else if (parsed.types[i] == MIP_ROUTE) {
+            node = VECTOR_ROUTE;
+        } else {
+            node = VECTOR_LOCAL;
+        }
+
+        push(&next[node], pdu, parsed.interfaces[i], parsed.types[i]);
+    }
+
+    parsed.count = 0;
+}
+
+/**
+ * Run the receive pipeline once.
+ *
+ * ifs: Pointer to the interface data structure.
+ *
+ * This function is called when the RAW socket is readable, a bundle or frames left by the
+ * last run are pending, or the forwarding threads handed over frames. Up to VECTOR_SIZE frames go through rx, parse and
+ * classify, then through the arp, local, route and forward nodes. Every node handles all of
+ * its packets before the next node runs, so each node's code stays in the instruction cache
+ * for the whole vector. MIP-ARP runs first, a reply in the vector resolves the neighbor before
+ * the frames to it are forwarded.
+ *
+ * The data frames the nodes send are collected by the transmit queues, and the tx node
+ * hands them to the socket with sendmmsg once the other nodes are done, see txq_batch_begin.
+ */
+void vector_run(struct ifs_data *ifs) {
+    uint64_t start = now_ns();
+    uint64_t end;
+
+    rx(ifs);
+    end = now_ns();
+    stats[VECTOR_RX].vectors++;
+    stats[VECTOR_RX].ns += end - start;
+
+    start = end;
+    parse();
+    end = now_ns();
+    stats[VECTOR_PARSE].vectors++;
+    stats[VECTOR_PARSE].ns += end - start;
+
+    start = end;
+    classify(ifs);
+    end = now_ns();
+    stats[VECTOR_CLASSIFY].vectors++;
+    stats[VECTOR_CLASSIFY].ns += end - start;
+
+    txq_batch_begin();
+    for (int node = VECTOR_ARP; node <= VECTOR_FORWARD; node++) {
+        struct packet_vector *vec = &next[node];
+
+        if (vec->count == 0) {
+            continue;
+        }
+
+        start = end;
+        stats[node].vectors++;
+        stats[node].packets += vec->count;
+        if (handlers[node] != NULL) {
+            handlers[node](vec, contexts[node]);
+        } else {
+            for (size_t i = 0; i < vec->count; i++) {
+                destroy_pdu(vec->pdus[i]);
+            }
+            stats[node].dropped += vec->count;
+        }
+        vec->count = 0;
+
+        end = now_ns();
+        stats[node].ns += end - start;
+    }
+
+    start = end;
+    size_t sent = txq_batch_end(ifs->rsock);
+    if (sent > 0) {
+        stats[VECTOR_TX].vectors++;
+        stats[VECTOR_TX].packets += sent;
+        stats[VECTOR_TX].ns += now_ns() - start;
+    }
+}
+
+/**
+ * Check whether received frames wait for the next run of the pipeline.
+ *
+ * Returns 1 if the parse node left frames, see parse, or 0 otherwise.
+ */
+int vector_pending(void) {
+    return frame_next < frame_count;
+}
+
+/**
+ * Print the counters of every node of the receive pipeline.
+ */
+void vector_print_stats(void) {
+    printf("Receive pipeline:\n");
+    for (int node = 0; node < VECTOR_NODES; node++) {
+        const struct vector_stats *stat = &stats[node];
+        if (stat->vectors == 0) {
+            continue;
+        }
+        printf("\t %-8s vectors %llu packets %llu (%.1f per vector) dropped %llu ns per packet %llu\n", node_names[node],
+               (unsigned long long) stat->vectors, (unsigned long long) stat->packets,
+               (double) stat->packets / stat->vectors, (unsigned long long) stat->dropped,
+               (unsigned long long) (stat->packets > 0 ? stat->ns / stat->packets : 0));
+    }
+}
@@ -0,0 +1,734 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <linux/sockios.h>
+#include <linux/if_packet.h>
+#include <linux/filter.h>
+
+#include "worker.h"
+#include "adj.h"
+#include "ebr.h"
+#include "fec.h"
+#include "fib.h"
+#include "liveness.h"
+#include "transport.h"
+#include "txq.h"
+
+#define WORKER_CACHELINE 64
+
+// How the forwarding threads send frames to one destination
+struct worker_hop {
+    uint8_t fast;               // 1 if a forwarding thread may send frames to the destination itself
+    uint8_t interface;          // Index of the interface of the next hop
+    struct eth_hdr ethhdr;      // Ethernet header of the next hop, written over the received one
+    struct sockaddr_ll addr;    // Link-layer address of the next hop
+};
+
+// The next hops of every destination, never changed once published, see worker_sync
+struct worker_table {
+    struct worker_hop hops[256];
+};
+
+// A frame a forwarding thread hands to the main thread
+struct worker_frame {
+    uint32_t len;               // Length of the frame in bytes
+    int interface;              // Index of the interface the frame arrived on
+    uint8_t data[MAX_BUF_SIZE]; // The frame, Ethernet header first
+};
+
+// Frames from one forwarding thread to the main thread. The indices only grow, a slot is
+// the index modulo WORKER_RING
+struct worker_ring {
+    _Atomic uint32_t head __attribute__((aligned(WORKER_CACHELINE))); // Next frame to read, moved by the main thread
+    _Atomic uint32_t tail __attribute__((aligned(WORKER_CACHELINE))); // Next slot to write, moved by the forwarding thread
+    struct worker_frame frames[WORKER_RING];
+};
+
+// A forwarded frame waiting until the socket of its thread has room
+struct worker_held {
+    uint32_t len;               // Length of the frame in bytes
+    struct sockaddr_ll to;      // Where the frame goes
+    uint8_t data[MAX_BUF_SIZE]; // The frame, Ethernet header of the next hop first
+};
+
+// Forwarded frames of one thread in the order they are sent, only used by the thread. The
+// indices only grow, a slot is the index modulo WORKER_TXQ
+struct worker_txq {
+    uint32_t head;              // Next frame to send
+    uint32_t tail;              // Next slot to hold a frame in
+    struct worker_held frames[WORKER_TXQ];
+};
+
+// One forwarding thread with the RAW socket it owns
+struct worker {
+    struct worker_ring ring;                    // Frames for the main thread
+    struct worker_txq txq;                      // Forwarded frames the socket has no room for yet
+    uint8_t frames[WORKER_BATCH][MAX_BUF_SIZE]; // Frames of one batch, forwarded from where they were received
+    struct sockaddr_ll from[WORKER_BATCH];      // Where the frames of the batch came from
+    struct sockaddr_ll to[WORKER_BATCH];        // Where the forwarded frames of the batch go
+    pthread_t thread;
+    int sock;                                   // RAW socket, one of the fanout group
+    int sndbuf;                                 // Send buffer of the socket in bytes
+    struct ebr_reader *reader;                  // Announces when the thread looks at the next hops
+    _Atomic uint64_t received;                  // Frames read from the socket
+    _Atomic uint64_t forwarded;                 // Frames sent on towards their destination
+    _Atomic uint64_t handed;                    // Frames handed to the main thread
+    _Atomic uint64_t delayed;                   // Of the forwarded frames, those that had to wait
+    _Atomic uint64_t dropped;                   // Frames dropped for a full ring or queue, or a failed send
+    _Atomic int congested;                      // 1 while the thread marks transport segments CE
+};
+
+static struct worker_table *_Atomic table; // Next hops the forwarding threads use, replaced by the main thread only
+static struct ebr ebr;                     // Frees the tables the forwarding threads may still be reading
+static struct worker *workers;           // The forwarding threads, NULL while there are none
+static int worker_count;
+static struct ifs_data *worker_ifs;      // Interfaces, only read once the threads run
+static int fast;                         // 1 if the forwarding threads forward transit frames themselves
+static int wake_fd = -1;                 // Eventfd the forwarding threads write when they hand over frames
+static size_t budget;                    // Frames the main thread takes before it waits again
+static int next_worker;                  // Ring the main thread reads next
+static _Atomic int control_waiting;      // 1 while control frames wait in the transmit queues of the main thread
+
+// Versions of the tables the next hops were last taken from, see worker_sync
+static int synced;
+static uint32_t synced_fib;
+static uint32_t synced_adj;
+static uint32_t synced_liveness;
+
+
+/**
+ * Publish the next hops of every destination to the forwarding threads.
+ *
+ * The main thread calls this before it waits for events. The next hops are only taken again
+ * from the forwarding, adjacency and liveness tables when one of them changed. If a next hop
+ * changed, a new table is published with one pointer store and the old one is retired, so a
+ * forwarding thread sees either table whole and never waits for the main thread. Retired
+ * tables are freed once no thread can still be reading them.
+ *
+ * A destination is forwarded by the threads only while it has a usable next hop that has been
+ * resolved and it is not protected by FEC. Frames to any other destination go to the main
+ * thread, which queues them, asks the routing daemon or MIP-ARP, or drops them.
+ *
+ * The threads are also told whether control frames wait in the transmit queues, they hold
+ * their frames back until those are sent, see worker_main.
+ */
+void worker_sync(void) {
+    uint32_t fib = fib_version();
+    uint32_t adj = adj_version();
+    uint32_t liveness = liveness_version();
+
+    if (workers == NULL) {
+        return;
+    }
+
+    atomic_store_explicit(&control_waiting, txq_backlog(TXQ_CONTROL) > 0, memory_order_relaxed);
+
+    ebr_reclaim(&ebr);
+    if (synced && fib == synced_fib && adj == synced_adj && liveness == synced_liveness) {
+        return;
+    }
+
+    struct worker_table *current = atomic_load_explicit(&table, memory_order_relaxed);
+    struct worker_table *next = NULL;
+
+    for (int dst = 0; dst < 256; dst++) {
+        struct worker_hop hop;
+        uint8_t next_hop = fib_select(dst);
+        const struct adjacency *neighbor = next_hop != FIB_NO_HOP ? adj_lookup(next_hop) : NULL;
+
+        memset(&hop, 0, sizeof(hop));
+        if (neighbor != NULL && !fec_wanted(dst)) {
+            hop.fast = 1;
+            hop.interface = neighbor->interface;
+            memcpy(&hop.ethhdr, &neighbor->ethhdr, sizeof(hop.ethhdr));
+            memcpy(&hop.addr, &neighbor->addr, sizeof(hop.addr));
+        }
+
+        if (current != NULL && memcmp(&hop, &current->hops[dst], sizeof(hop)) == 0) {
+            continue;
+        }
+
+        // Copy on the first change, the published table is never written
+        if (next == NULL) {
+            next = malloc(sizeof(*next));
+            if (next == NULL) {
+                perror("malloc");
+                return;
+            }
+            if (current != NULL) {
+                memcpy(next, current, sizeof(*next));
+            } else {
+                memset(next, 0, sizeof(*next));
+            }
+        }
+        memcpy(&next->hops[dst], &hop, sizeof(hop));
+    }
+
+    if (next != NULL) {
+        atomic_store_explicit(&table, next, memory_order_release);
+        if (current != NULL) {
+            ebr_retire(&ebr, current, free);
+        }
+    }
+
+    synced = 1;
+    synced_fib = fib;
+    synced_adj = adj;
+    synced_liveness = liveness;
+}
+
+/**
+ * Check whether a forwarding thread may send a frame on by itself.
+ *
+ * frame: The frame as received, Ethernet header first.
+ * len: Length of the frame in bytes, set to the length to send if the frame is forwarded.
+ * hops: The next hops, loaded once per batch.
+ * hop: Set to the next hop of the destination.
+ *
+ * Only PING, FRAG and TRANSPORT frames in transit are forwarded by the threads. Frames for
+ * this daemon, broadcasts, control, routing and LINK frames, and frames the threads have no
+ * next hop for are handed to the main thread.
+ *
+ * Returns 1 if the frame is forwarded, or 0 if it goes to the main thread.
+ */
+static int forwardable(const uint8_t *frame, size_t *len, const struct worker_table *hops, const struct worker_hop **hop) {
+    uint32_t header;
+
+    if (!fast || *len < ETH_HDR_LEN + MIP_HDR_LEN) {
+        return 0;
+    }
+
+    memcpy(&header, frame + ETH_HDR_LEN, sizeof(header));
+    header = ntohl(header);
+
+    uint8_t dst = header >> 24;
+    uint8_t sdu_type = header & 0x7;
+    size_t frame_len = ETH_HDR_LEN + MIP_HDR_LEN + ((header >> 3) & 0x1ff) * sizeof(uint32_t);
+
+    if (dst == worker_ifs->local_mip_addr || dst == BROADCAST_MIP_ADDR || *len < frame_len) {
+        return 0;
+    }
+    if (sdu_type != SDU_TYPE_PING && sdu_type != SDU_TYPE_FRAG && sdu_type != SDU_TYPE_TRANSPORT) {
+        return 0;
+    }
+
+    *hop = &hops->hops[dst];
+    if (!(*hop)->fast) {
+        return 0;
+    }
+
+    // Padding of short Ethernet frames is not sent on
+    *len = frame_len;
+    return 1;
+}
+
+/**
+ * Hand a frame to the main thread.
+ *
+ * worker: The forwarding thread that received the frame.
+ * frame: The frame, Ethernet header first.
+ * len: Length of the frame in bytes.
+ * from: Where the frame came from.
+ *
+ * Returns 1 if the frame was handed over, or 0 if the ring of the thread is full.
+ */
+static int hand_off(struct worker *worker, const uint8_t *frame, size_t len, struct sockaddr_ll *from) {
+    struct worker_ring *ring = &worker->ring;
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    if (tail - atomic_load_explicit(&ring->head, memory_order_acquire) == WORKER_RING) {
+        return 0;
+    }
+
+    struct worker_frame *slot = &ring->frames[tail & (WORKER_RING - 1)];
+    slot->len = len;
+    slot->interface = find_matching_if_index(worker_ifs, from);
+    memcpy(slot->data, frame, len);
+
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+/**
+ * Check whether the send buffer of a forwarding thread is filling up.
+ *
+ * worker: The forwarding thread.
+ *
+ * Returns 1 if frames wait in the queue of the thread or more than 1/TX_CE_FRACTION of the
+ * send buffer is in use, see tx_queue_congested.
+ */
+static int congested(struct worker *worker) {
+    int queued = 0;
+
+    if (worker->txq.tail != worker->txq.head) {
+        return 1;
+    }
+    if (ioctl(worker->sock, SIOCOUTQ, &queued) == -1) {
+        return 0;
+    }
+
+    return queued > worker->sndbuf / TX_CE_FRACTION;
+}
+
+/**
+ * Hold a forwarded frame until the socket has room.
+ *
+ * worker: The forwarding thread.
+ * msg: The frame with where it goes.
+ *
+ * Returns 1 if the frame is held, or 0 if the queue is full and the frame is dropped.
+ */
+static int hold(struct worker *worker, const struct msghdr *msg) {
+    struct worker_txq *txq = &worker->txq;
+
+    if (txq->tail - txq->head == WORKER_TXQ) {
+        return 0;
+    }
+
+    struct worker_held *held = &txq->frames[txq->tail & (WORKER_TXQ - 1)];
+    held->len = msg->msg_iov->iov_len;
+    memcpy(&held->to, msg->msg_name, sizeof(held->to));
+    memcpy(held->data, msg->msg_iov->iov_base, held->len);
+
+    txq->tail++;
+    return 1;
+}
+
+/**
+ * Send the held frames of a forwarding thread while its socket has room.
+ *
+ * worker: The forwarding thread.
+ *
+ * Nothing is sent while control frames wait on the main thread. A frame the socket refuses
+ * for any other reason than a full send buffer is dropped like a lost frame.
+ *
+ * Returns the number of frames dropped.
+ */
+static int send_held(struct worker *worker) {
+    struct worker_txq *txq = &worker->txq;
+    struct mmsghdr tx[WORKER_BATCH];
+    struct iovec iov[WORKER_BATCH];
+    int lost = 0;
+
+    while (txq->tail != txq->head && !atomic_load_explicit(&control_waiting, memory_order_relaxed)) {
+        int count = 0;
+
+        for (uint32_t i = txq->head; i != txq->tail && count < WORKER_BATCH; i++, count++) {
+            struct worker_held *held = &txq->frames[i & (WORKER_TXQ - 1)];
+
+            iov[count].iov_base = held->data;
+            iov[count].iov_len = held->len;
+            memset(&tx[count], 0, sizeof(tx[count]));
+            tx[count].msg_hdr.msg_name = &held->to;
+            tx[count].msg_hdr.msg_namelen = sizeof(held->to);
+            tx[count].msg_hdr.msg_iov = &iov[count];
+            tx[count].msg_hdr.msg_iovlen = 1;
+        }
+
+        int rc = sendmmsg(worker->sock, tx, count, MSG_DONTWAIT);
+        if (rc == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno != EINTR) {
+                txq->head++;
+                lost++;
+            }
+            continue;
+        }
+        txq->head += rc;
+        atomic_fetch_add_explicit(&worker->forwarded, rc, memory_order_relaxed);
+        atomic_fetch_add_explicit(&worker->delayed, rc, memory_order_relaxed);
+    }
+
+    return lost;
+}
+
+/**
+ * Wait until a forwarding thread has frames to read, or room for the frames it holds.
+ *
+ * worker: The forwarding thread, with frames held.
+ *
+ * While control frames wait on the main thread the socket is not watched for room, and the
+ * thread looks again after WORKER_HOLD milliseconds.
+ */
+static void wait_held(struct worker *worker) {
+    int hold_back = atomic_load_explicit(&control_waiting, memory_order_relaxed);
+    struct pollfd pfd = { .fd = worker->sock, .events = POLLIN | (hold_back ? 0 : POLLOUT) };
+
+    if (poll(&pfd, 1, hold_back ? WORKER_HOLD : -1) == -1 && errno != EINTR) {
+        perror("poll");
+    }
+}
+
+/**
+ * Read, forward and hand over frames until the daemon exits.
+ *
+ * arg: The forwarding thread.
+ *
+ * Frames are read WORKER_BATCH at a time into the buffers of the thread. A frame in transit
+ * gets the Ethernet header of its next hop written over the received one and is sent from
+ * the same buffer, every frame of the batch with one system call. Transport segments are
+ * marked CE while the send buffer fills up, as on the main thread. Nothing is allocated.
+ *
+ * The threads only send data, and control frames are sent first like in the transmit queues
+ * of the main thread. While the main thread has control frames waiting, or the socket has no
+ * room, forwarded frames are copied to the queue of the thread and sent in order once the
+ * control frames are out and there is room. A frame that does not fit in the queue is
+ * dropped, as by a full transmit queue.
+ *
+ * Returns nothing, the thread never stops.
+ */
+static void *worker_main(void *arg) {
+    struct worker *worker = arg;
+    struct mmsghdr rx[WORKER_BATCH];
+    struct mmsghdr tx[WORKER_BATCH];
+    struct iovec rx_iov[WORKER_BATCH];
+    struct iovec tx_iov[WORKER_BATCH];
+
+    while (1) {
+        memset(rx, 0, sizeof(rx));
+        for (int i = 0; i < WORKER_BATCH; i++) {
+            rx_iov[i].iov_base = worker->frames[i];
+            rx_iov[i].iov_len = MAX_BUF_SIZE;
+            rx[i].msg_hdr.msg_name = &worker->from[i];
+            rx[i].msg_hdr.msg_namelen = sizeof(worker->from[i]);
+            rx[i].msg_hdr.msg_iov = &rx_iov[i];
+            rx[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int dropped = 0;
+        int flags = MSG_WAITFORONE;
+
+        // Frames held back go out before new ones, and the thread waits for room for them as
+        // well as for frames to read
+        if (worker->txq.tail != worker->txq.head) {
+            dropped += send_held(worker);
+        }
+        if (worker->txq.tail != worker->txq.head) {
+            wait_held(worker);
+            flags = MSG_DONTWAIT;
+        }
+
+        // Wait for the first frame, then take what else is there
+        int received = recvmmsg(worker->sock, rx, WORKER_BATCH, flags, NULL);
+        if (received == -1) {
+            if (errno != EINTR && errno != EAGAIN) {
+                perror("recvmmsg");
+            }
+            atomic_fetch_add_explicit(&worker->dropped, dropped, memory_order_relaxed);
+            continue;
+        }
+
+        int out = 0;
+        int handed = 0;
+        int ce = -1; // Whether to mark transport segments, only found out once a segment is sent
+
+        // The next hops stay valid until the thread leaves, before it sends
+        ebr_enter(&ebr, worker->reader);
+        const struct worker_table *hops = atomic_load_explicit(&table, memory_order_acquire);
+
+        for (int i = 0; i < received; i++) {
+            uint8_t *frame = worker->frames[i];
+            size_t len = rx[i].msg_len;
+            const struct worker_hop *hop;
+
+            if (!forwardable(frame, &len, hops, &hop)) {
+                if (hand_off(worker, frame, len, &worker->from[i])) {
+                    handed++;
+                } else {
+                    dropped++;
+                }
+                continue;
+            }
+
+            memcpy(frame, &hop->ethhdr, ETH_HDR_LEN);
+
+            if ((frame[ETH_HDR_LEN + 3] & 0x7) == SDU_TYPE_TRANSPORT && len >= ETH_HDR_LEN + MIP_HDR_LEN + sizeof(uint32_t)) {
+                if (ce == -1) {
+                    ce = congested(worker);
+                }
+                if (ce) {
+                    uint32_t word;
+                    memcpy(&word, frame + ETH_HDR_LEN + MIP_HDR_LEN, sizeof(word));
+                    transport_mark_ce(&word, (len - ETH_HDR_LEN - MIP_HDR_LEN) / sizeof(uint32_t));
+                    memcpy(frame + ETH_HDR_LEN + MIP_HDR_LEN, &word, sizeof(word));
+                }
+            }
+
+            worker->to[out] = hop->addr;
+            tx_iov[out].iov_base = frame;
+            tx_iov[out].iov_len = len;
+            memset(&tx[out], 0, sizeof(tx[out]));
+            tx[out].msg_hdr.msg_name = &worker->to[out];
+            tx[out].msg_hdr.msg_namelen = sizeof(worker->to[out]);
+            tx[out].msg_hdr.msg_iov = &tx_iov[out];
+            tx[out].msg_hdr.msg_iovlen = 1;
+            out++;
+        }
+        ebr_exit(worker->reader);
+
+        // Send the whole batch unless frames are held back, what the socket has no room for is
+        // held, and a frame it refuses otherwise is dropped like a lost frame
+        int sent = 0;
+        int lost = 0;
+        while (sent < out && worker->txq.tail == worker->txq.head &&
+               !atomic_load_explicit(&control_waiting, memory_order_relaxed)) {
+            int rc = sendmmsg(worker->sock, tx + sent, out - sent, MSG_DONTWAIT);
+            if (rc == -1) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                if (errno != EINTR) {
+                    lost++;
+                    sent++;
+                }
+                continue;
+            }
+            sent += rc;
+        }
+        int forwarded = sent - lost;
+        for (; sent < out; sent++) {
+            if (!hold(worker, &tx[sent].msg_hdr)) {
+                lost++;
+            }
+        }
+
+        // The main thread marks its own transport segments while the threads are congested
+        if (ce == -1) {
+            ce = congested(worker);
+        }
+        atomic_store_explicit(&worker->congested, ce, memory_order_relaxed);
+
+        if (handed > 0) {
+            uint64_t one = 1;
+            if (write(wake_fd, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+                perror("write");
+            }
+        }
+
+        atomic_fetch_add_explicit(&worker->received, received, memory_order_relaxed);
+        atomic_fetch_add_explicit(&worker->forwarded, forwarded, memory_order_relaxed);
+        atomic_fetch_add_explicit(&worker->handed, handed, memory_order_relaxed);
+        atomic_fetch_add_explicit(&worker->dropped, dropped + lost, memory_order_relaxed);
+    }
+
+    return NULL;
+}
+
+/**
+ * Start the forwarding threads.
+ *
+ * ifs: Pointer to the interface data structure, its RAW socket stops receiving.
+ * count: Number of forwarding threads, 1 to WORKER_MAX.
+ * fast_path: 1 if the threads forward transit frames themselves, 0 if every frame goes to
+ *            the main thread, which is needed while received frames are rate limited,
+ *            bundled or dropped on purpose.
+ *
+ * Every thread owns a RAW socket of its own. The sockets form one PACKET_FANOUT_CBPF group
+ * that spreads received frames over them by the MIP source and destination, so the frames
+ * between two nodes stay in order. The kernel's flow hash does not look into MIP frames and
+ * would put every frame on the same socket. The threads are the data plane, they only receive, forward and send. The main thread
+ * is the control plane. Its RAW socket is only sent on from now on, so no frame in transit
+ * waits behind an application, a routing update or a debug print. What the threads do not
+ * forward goes to the main thread, which handles it as if it had read it from its own socket,
+ * so the adjacency, forwarding, queue and timer state keeps a single owner. The main thread
+ * tells the threads about changes by publishing the next hops, see worker_sync.
+ *
+ * The threads must be started after SIGUSR1 is blocked, they take the signal mask of the
+ * main thread.
+ *
+ * Returns an eventfd for the epoll instance of the main thread, which must call worker_wakeup
+ * when it is readable, or -1 on error.
+ */
+int worker_start(struct ifs_data *ifs, int count, int fast_path) {
+    int fanout = (getpid() & 0xffff) | (PACKET_FANOUT_CBPF << 16);
+    struct sock_filter drop_all = BPF_STMT(BPF_RET | BPF_K, 0);
+    struct sock_fprog filter = { .len = 1, .filter = &drop_all };
+
+    // The first half word of the MIP header is the destination and source, the frame starts
+    // there when the group looks at it. The kernel takes the result modulo the number of
+    // sockets, so the bits are mixed first
+    struct sock_filter by_addresses[] = {
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 0),
+        BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, 0x9e3779b1),
+        BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 16),
+        BPF_STMT(BPF_RET | BPF_A, 0)
+    };
+    struct sock_fprog spread = { .len = sizeof(by_addresses) / sizeof(by_addresses[0]), .filter = by_addresses };
+
+    if (count < 1 || count > WORKER_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    worker_ifs = ifs;
+    fast = fast_path;
+
+    // Frames the main thread's socket already holds are still read by the main thread
+    if (setsockopt(ifs->rsock, SOL_SOCKET, SO_ATTACH_FILTER, &filter, sizeof(filter)) == -1) {
+        perror("setsockopt");
+        return -1;
+    }
+
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd == -1) {
+        perror("eventfd");
+        return -1;
+    }
+
+    workers = aligned_alloc(WORKER_CACHELINE, sizeof(struct worker) * count);
+    if (workers == NULL) {
+        perror("aligned_alloc");
+        return -1;
+    }
+    memset(workers, 0, sizeof(struct worker) * count);
+
+    // The threads find the next hops in place from their first frame on
+    ebr_init(&ebr);
+    worker_sync();
+
+    for (int i = 0; i < count; i++) {
+        struct worker *worker = &workers[i];
+        int sndbuf = TXQ_SNDBUF;
+        socklen_t optlen = sizeof(worker->sndbuf);
+
+        worker->reader = ebr_register(&ebr);
+        worker->sock = create_raw_socket();
+        if (setsockopt(worker->sock, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) == -1 ||
+            getsockopt(worker->sock, SOL_SOCKET, SO_SNDBUF, &worker->sndbuf, &optlen) == -1) {
+            perror("setsockopt");
+            worker->sndbuf = INT_MAX;
+        }
+        if (setsockopt(worker->sock, SOL_PACKET, PACKET_FANOUT, &fanout, sizeof(fanout)) == -1 ||
+            (i == 0 && setsockopt(worker->sock, SOL_PACKET, PACKET_FANOUT_DATA, &spread, sizeof(spread)) == -1)) {
+            perror("setsockopt");
+            return -1;
+        }
+
+        if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+            perror("pthread_create");
+            return -1;
+        }
+        worker_count++;
+    }
+
+    return wake_fd;
+}
+
+/**
+ * Take note of the frames the forwarding threads have handed over.
+ *
+ * This function is called when the descriptor from worker_start is readable. The frames
+ * waiting now are handled one per iteration of the main loop, see worker_next, frames handed
+ * over after this wake the main thread again.
+ */
+void worker_wakeup(void) {
+    uint64_t count;
+
+    if (read(wake_fd, &count, sizeof(count)) == -1 && errno != EAGAIN) {
+        perror("read");
+    }
+
+    budget = 0;
+    for (int i = 0; i < worker_count; i++) {
+        struct worker_ring *ring = &workers[i].ring;
+        budget += atomic_load_explicit(&ring->tail, memory_order_acquire) - atomic_load_explicit(&ring->head, memory_order_relaxed);
+    }
+}
+
+/**
+ * Check whether handed over frames wait for the main thread.
+ *
+ * Returns 1 if worker_next has a frame, or 0 otherwise.
+ */
+int worker_pending(void) {
+    return budget > 0;
+}
+
+/**
+ * Take the next frame a forwarding thread handed over.
+ *
+ * buf: Buffer for the frame.
+ * size: Size of the buffer in bytes.
+ * recv_interface: Set to the index of the interface the frame arrived on.
+ *
+ * The rings of the threads are read in turn, so no thread holds back the frames of the
+ * others.
+ *
+ * Returns the length of the frame in bytes, or -1 if no frame waits.
+ */
+ssize_t worker_next(uint8_t *buf, size_t size, int *recv_interface) {
+    for (int tries = 0; budget > 0 && tries < worker_count; tries++) {
+        struct worker_ring *ring = &workers[next_worker].ring;
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+        next_worker = (next_worker + 1) % worker_count;
+        if (head == atomic_load_explicit(&ring->tail, memory_order_acquire)) {
+            continue;
+        }
+
+        struct worker_frame *slot = &ring->frames[head & (WORKER_RING - 1)];
+        size_t len = slot->len < size ? slot->len : size;
+        memcpy(buf, slot->data, len);
+        *recv_interface = slot->interface;
+
+        atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+        budget--;
+        return len;
+    }
+
+    budget = 0;
+    return -1;
+}
+
+/**
+ * Check whether the forwarding threads find the links filling up.
+ *
+ * Frames in transit and the frames of this node share the links, so transport segments the
+ * main thread sends are marked CE too while any thread is congested, see tx_queue_congested.
+ *
+ * Returns 1 if frames wait in the queue of a thread or its send buffer is filling up, or 0
+ * otherwise.
+ */
+int worker_congested(void) {
+    for (int i = 0; i < worker_count; i++) {
+        if (atomic_load_explicit(&workers[i].congested, memory_order_relaxed)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Print the counters of every forwarding thread.
+ */
+void worker_print_stats(void) {
+    if (workers == NULL) {
+        return;
+    }
+
+    printf("Forwarding threads:\n");
+    for (int i = 0; i < worker_count; i++) {
+        struct worker *worker = &workers[i];
+        printf("\t thread %d received %llu forwarded %llu delayed %llu handed over %llu dropped %llu\n", i,
+               (unsigned long long) atomic_load_explicit(&worker->received, memory_order_relaxed),
+               (unsigned long long) atomic_load_explicit(&worker->forwarded, memory_order_relaxed),
+               (unsigned long long) atomic_load_explicit(&worker->delayed, memory_order_relaxed),
+               (unsigned long long) atomic_load_explicit(&worker->handed, memory_order_relaxed),
+               (unsigned long long) atomic_load_explicit(&worker->dropped, memory_order_relaxed));
+    }
+    printf("\t next hop tables published %llu freed %llu waiting for readers %zu\n",
+           (unsigned long long) ebr.retired + 1, (unsigned long long) ebr.freed, ebr.pending);
+}
@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "ebr.h"
+
+#define TEST_READERS 4   // Reading threads of the stress test
+#define TEST_SECONDS 2   // How long the writer publishes new tables
+#define TEST_ENTRIES 256 // Entries of a table, like the next hops of the forwarding threads
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(EXIT_FAILURE); \
+        } \
+    } while (0)
+
+// A published table, every entry holds the generation of the table
+struct table {
+    uint64_t generation;
+    uint64_t entries[TEST_ENTRIES];
+};
+
+static struct ebr domain;
+static struct table *_Atomic published;
+static _Atomic int stop;
+static _Atomic uint64_t reads;
+static _Atomic int frees;
+
+
+// Monotonic time in seconds
+static double now_s(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Count a free without freeing, for the tests that look at what was freed when
+static void count_free(void *ptr) {
+    (void) ptr;
+    atomic_fetch_add(&frees, 1);
+}
+
+// Free a table after overwriting it, so a reader that still sees it finds it inconsistent
+static void poison_free(void *ptr) {
+    memset(ptr, 0xab, sizeof(struct table));
+    free(ptr);
+}
+
+static struct table *new_table(uint64_t generation) {
+    struct table *table = malloc(sizeof(*table));
+
+    CHECK(table != NULL);
+    table->generation = generation;
+    for (int i = 0; i < TEST_ENTRIES; i++) {
+        table->entries[i] = generation;
+    }
+
+    return table;
+}
+
+/**
+ * Memory is freed at once without readers, and held back only by readers that may see it.
+ */
+static void test_reclaim(void) {
+    static int a, b, c;
+    struct ebr ebr;
+
+    ebr_init(&ebr);
+    struct ebr_reader *reader = ebr_register(&ebr);
+    CHECK(reader != NULL);
+    atomic_store(&frees, 0);
+
+    // No reader in a section
+    ebr_retire(&ebr, &a, count_free);
+    CHECK(atomic_load(&frees) == 1 && ebr.pending == 0);
+
+    // A reader that entered before the retire holds the memory back until it leaves
+    ebr_enter(&ebr, reader);
+    ebr_retire(&ebr, &b, count_free);
+    CHECK(atomic_load(&frees) == 1 && ebr.pending == 1);
+    CHECK(ebr_reclaim(&ebr) == 0);
+    ebr_exit(reader);
+    CHECK(ebr_reclaim(&ebr) == 1 && ebr.pending == 0);
+
+    // A reader that entered after the retire cannot see the memory
+    ebr_enter(&ebr, reader);
+    ebr_retire(&ebr, &c, count_free);
+    ebr_exit(reader);
+    ebr_enter(&ebr, reader);
+    CHECK(ebr_reclaim(&ebr) == 1);
+    ebr_exit(reader);
+
+    CHECK(ebr.retired == 3 && ebr.freed == 3);
+    printf("ok reclaim\n");
+}
+
+/**
+ * A domain takes EBR_MAX_READERS readers and no more.
+ */
+static void test_register(void) {
+    static struct ebr ebr;
+
+    ebr_init(&ebr);
+    for (int i = 0; i < EBR_MAX_READERS; i++) {
+        CHECK(ebr_register(&ebr) != NULL);
+    }
+    CHECK(ebr_register(&ebr) == NULL);
+    CHECK(atomic_load(&ebr.reader_count) == EBR_MAX_READERS);
+
+    printf("ok register\n");
+}
+
+// Read the published table over and over, every entry must be of its generation
+static void *reader_main(void *arg) {
+    struct ebr_reader *reader = arg;
+    uint64_t count = 0;
+
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        ebr_enter(&domain, reader);
+        const struct table *table = atomic_load_explicit(&published, memory_order_acquire);
+
+        for (int i = 0; i < TEST_ENTRIES; i++) {
+            CHECK(table->entries[i] == table->generation);
+        }
+
+        ebr_exit(reader);
+        count++;
+    }
+
+    atomic_fetch_add(&reads, count);
+    return NULL;
+}
+
+/**
+ * Readers keep reading while the writer publishes a new table and retires the old one as
+ * fast as it can. A table freed while a reader still sees it is found poisoned, or reported
+ * by the address or thread sanitizer. Once the readers are done everything is freed.
+ */
+static void test_stress(void) {
+    pthread_t threads[TEST_READERS];
+    uint64_t generation = 0;
+
+    ebr_init(&domain);
+    atomic_store(&published, new_table(generation));
+
+    for (int i = 0; i < TEST_READERS; i++) {
+        struct ebr_reader *reader = ebr_register(&domain);
+        CHECK(reader != NULL);
+        CHECK(pthread_create(&threads[i], NULL, reader_main, reader) == 0);
+    }
+
+    double end = now_s() + TEST_SECONDS;
+    while (now_s() < end) {
+        struct table *old = atomic_load_explicit(&published, memory_order_relaxed);
+
+        atomic_store_explicit(&published, new_table(++generation), memory_order_release);
+        ebr_retire(&domain, old, poison_free);
+    }
+
+    atomic_store(&stop, 1);
+    for (int i = 0; i < TEST_READERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    ebr_reclaim(&domain);
+    CHECK(domain.pending == 0 && domain.freed == generation && domain.retired == generation);
+    free(atomic_load(&published));
+
+    printf("ok stress: %d readers, %llu tables published, %llu reads\n", TEST_READERS,
+           (unsigned long long) generation, (unsigned long long) atomic_load(&reads));
+}
+
+/**
+ * Test epoch-based reclamation, see ebr.c.
+ *
+ * Build with -fsanitize=thread or -fsanitize=address to have the stress test checked by a
+ * sanitizer, see 'make test-sanitize'.
+ */
+int main(void) {
+    test_reclaim();
+    test_register();
+    test_stress();
+
+    return EXIT_SUCCESS;
+}
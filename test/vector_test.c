@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "vector.h"
+#include "bundle.h"
+#include "pdu.h"
+
+#define TEST_LOCAL    30  // MIP address of the daemon under test
+#define TEST_NEIGHBOR 20  // MIP address the frames come from
+#define TEST_RECORDS  8   // Frames per bundle
+#define TEST_MAX      1024
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(EXIT_FAILURE); \
+        } \
+    } while (0)
+
+static struct ifs_data ifs;
+static int peer_fd;                    // Where the frames are written, the pipeline reads the other end
+static uint32_t delivered[TEST_MAX];   // First SDU word of every PDU the local node was given, in order
+static size_t delivered_count;
+
+
+// The local node, takes note of every PDU
+static void local_node(struct packet_vector *vec, void *ctx) {
+    (void) ctx;
+
+    for (size_t i = 0; i < vec->count; i++) {
+        CHECK(delivered_count < TEST_MAX);
+        delivered[delivered_count++] = vec->pdus[i]->sdu[0];
+        destroy_pdu(vec->pdus[i]);
+    }
+}
+
+// Send a PDU to the pipeline as a frame from the neighbor
+static void send_pdu(struct pdu *pdu) {
+    uint8_t frame[MAX_BUF_SIZE];
+
+    memset(pdu->ethhdr, 0, sizeof(*pdu->ethhdr));
+    size_t len = mip_serialize_pdu(pdu, frame);
+    CHECK(send(peer_fd, frame, len, 0) == (ssize_t) len);
+    destroy_pdu(pdu);
+}
+
+// Send a PING to this daemon that carries 'seq'
+static void send_ping(uint32_t seq) {
+    uint32_t sdu[2] = { seq, 0 };
+
+    send_pdu(create_PDU(TEST_NEIGHBOR, TEST_LOCAL, 1, SDU_TYPE_PING, sdu, 2));
+}
+
+/**
+ * Send a bundle of TEST_RECORDS PINGs to this daemon, laid out like send_bundle in bundle.c.
+ *
+ * first: Carried by the first PING, the others carry the numbers after it.
+ */
+static void send_bundle(uint32_t first) {
+    uint32_t words[1 + TEST_RECORDS * 3];
+    size_t len = 0;
+
+    words[len++] = ((uint32_t) LINK_BUNDLE << 24) | TEST_RECORDS;
+    for (int i = 0; i < TEST_RECORDS; i++) {
+        struct mip_hdr hdr = { .dst = TEST_LOCAL, .src = TEST_NEIGHBOR, .ttl = 1, .sdu_len = 2, .sdu_type = SDU_TYPE_PING };
+
+        words[len++] = ntohl(mip_pack_header(&hdr));
+        words[len++] = first + i;
+        words[len++] = 0;
+    }
+
+    send_pdu(create_PDU(TEST_NEIGHBOR, TEST_LOCAL, 1, SDU_TYPE_LINK, words, len));
+}
+
+// Run the pipeline until the socket is empty and nothing waits, as the main loop of mipd does
+static void run(void) {
+    int runs = 0;
+
+    do {
+        vector_run(&ifs);
+        CHECK(++runs < TEST_MAX);
+    } while (bundle_pending() || vector_pending() || recv(ifs.rsock, NULL, 0, MSG_PEEK | MSG_DONTWAIT) >= 0);
+}
+
+// Every number from 0 to 'count' arrived once, in order
+static void check_delivered(size_t count) {
+    CHECK(delivered_count == count);
+    for (size_t i = 0; i < count; i++) {
+        CHECK(delivered[i] == i);
+    }
+    delivered_count = 0;
+}
+
+/**
+ * Two bundles read in the same batch, the frames of the first are not lost to the second.
+ */
+static void test_back_to_back(void) {
+    send_bundle(0);
+    send_bundle(TEST_RECORDS);
+    send_ping(2 * TEST_RECORDS);
+    run();
+    check_delivered(2 * TEST_RECORDS + 1);
+
+    printf("ok back to back bundles\n");
+}
+
+/**
+ * Bundles between single frames, and more frames than fit in one vector, stay in order.
+ */
+static void test_full_vector(void) {
+    uint32_t seq = 0;
+
+    send_ping(seq++);
+    send_bundle(seq);
+    seq += TEST_RECORDS;
+    while (seq < VECTOR_SIZE + TEST_RECORDS) {
+        send_ping(seq++);
+    }
+    send_bundle(seq);
+    seq += TEST_RECORDS;
+    send_bundle(seq);
+    seq += TEST_RECORDS;
+    run();
+    check_delivered(seq);
+
+    printf("ok bundles in a full vector\n");
+}
+
+/**
+ * Test the receive pipeline, see vector.c.
+ *
+ * The frames are written to one end of a datagram socket pair, the pipeline reads the other
+ * end as if it were the RAW socket.
+ */
+int main(void) {
+    int fds[2];
+    int sndbuf = 4 * 1024 * 1024; // Every frame of a test is written before the pipeline runs
+
+    CHECK(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) == 0);
+    CHECK(setsockopt(fds[1], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) == 0);
+    memset(&ifs, 0, sizeof(ifs));
+    ifs.rsock = fds[0];
+    ifs.local_mip_addr = TEST_LOCAL;
+    peer_fd = fds[1];
+
+    vector_init(0);
+    vector_register(VECTOR_LOCAL, local_node, NULL);
+
+    test_back_to_back();
+    test_full_vector();
+
+    return EXIT_SUCCESS;
+}